@@ -16,9 +16,100 @@ LOCAL_MODULE    := nativeStillCapture
 LOCAL_CFLAGS    := -Werror -Wno-write-strings -std=c++11
 LOCAL_SRC_FILES := native-lib.cpp \
                    CV_Main.cpp \
+                   Face_Pipeline.cpp \
                    Native_Camera.cpp \
-                   Image_Reader.cpp
+                   Image_Reader.cpp \
+                   Motion_Detector.cpp \
+                   Grid_Regions.cpp \
+                   Skin_Mask.cpp \
+                   Haar_Cascade.cpp \
+                   Feature_Cache.cpp \
+                   Cascade_Evaluator.cpp \
+                   Cascade_Scheduler.cpp \
+                   Worker_Pool.cpp \
+                   Lbp_Cascade.cpp \
+                   Detection_Benchmark.cpp \
+                   Cascade_Binary.cpp \
+                   Asset_File.cpp \
+                   Box_Tracker.cpp \
+                   Hal_Face_Detector.cpp \
+                   Rep_Counter.cpp \
+                   Capture_Writer.cpp \
+                   Png_Encoder.cpp \
+                   Jpeg_Encoder.cpp \
+                   Zsl_Ring.cpp \
+                   Sharpness.cpp \
+                   Frame_Recorder.cpp \
+                   Camera_Source.cpp \
+                   Y4m_File.cpp \
+                   Thumbnail_Pyramid.cpp
 
-LOCAL_LDLIBS    := -llog -landroid -lcamera2ndk -lmediandk
+ifeq ($(TARGET_ARCH_ABI),armeabi-v7a)
+LOCAL_ARM_NEON  := true
+endif
+
+LOCAL_LDLIBS    := -llog -landroid -lcamera2ndk -lmediandk -lz
 LOCAL_LDFLAGS += -v
 include $(BUILD_SHARED_LIBRARY)
+
+# Converts cascade XML into the mmap-able Cascade_Binary format, see
+# Cascade_Convert.cpp
+include $(CLEAR_VARS)
+
+OPENCV_INSTALL_MODULES:=on
+OPENCV_LIB_TYPE:=SHARED
+include $(OPENCVROOT)/sdk/native/jni/OpenCV.mk
+
+LOCAL_MODULE    := cascade_convert
+LOCAL_CFLAGS    := -Werror -Wno-write-strings -std=c++11
+LOCAL_SRC_FILES := Cascade_Convert.cpp \
+                   Cascade_Binary.cpp \
+                   Asset_File.cpp \
+                   Cascade_Evaluator.cpp \
+                   Feature_Cache.cpp \
+                   Worker_Pool.cpp \
+                   Haar_Cascade.cpp \
+                   Lbp_Cascade.cpp
+
+ifeq ($(TARGET_ARCH_ABI),armeabi-v7a)
+LOCAL_ARM_NEON  := true
+endif
+
+LOCAL_LDLIBS    := -llog -landroid
+include $(BUILD_EXECUTABLE)
+
+# Runs the camera loop's Face_Pipeline on recorded frames, see
+# Frame_Replay.cpp
+include $(CLEAR_VARS)
+
+OPENCV_INSTALL_MODULES:=on
+OPENCV_LIB_TYPE:=SHARED
+include $(OPENCVROOT)/sdk/native/jni/OpenCV.mk
+
+LOCAL_MODULE    := frame_replay
+LOCAL_CFLAGS    := -Werror -Wno-write-strings -std=c++11
+LOCAL_SRC_FILES := Frame_Replay.cpp \
+                   Face_Pipeline.cpp \
+                   Replay_Source.cpp \
+                   Y4m_File.cpp \
+                   Frame_Recorder.cpp \
+                   Motion_Detector.cpp \
+                   Skin_Mask.cpp \
+                   Grid_Regions.cpp \
+                   Box_Tracker.cpp \
+                   Detection_Benchmark.cpp \
+                   Worker_Pool.cpp \
+                   Cascade_Scheduler.cpp \
+                   Cascade_Evaluator.cpp \
+                   Cascade_Binary.cpp \
+                   Asset_File.cpp \
+                   Feature_Cache.cpp \
+                   Haar_Cascade.cpp \
+                   Lbp_Cascade.cpp
+
+ifeq ($(TARGET_ARCH_ABI),armeabi-v7a)
+LOCAL_ARM_NEON  := true
+endif
+
+LOCAL_LDLIBS    := -llog -landroid
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,74 @@
+#include "Asset_File.h"
+#include "Util.h"
+#include <sys/mman.h>
+
+Asset_File::~Asset_File()
+{
+    Close();
+}
+
+void Asset_File::Close()
+{
+    if (m_map != nullptr)
+    {
+        munmap(m_map, m_map_size);
+        m_map = nullptr;
+        m_map_size = 0;
+    }
+    if (m_asset != nullptr)
+    {
+        AAsset_close(m_asset);
+        m_asset = nullptr;
+    }
+    m_data = nullptr;
+    m_size = 0;
+}
+
+bool Asset_File::Open(AAssetManager *manager, const std::string &name)
+{
+    Close();
+    if (manager == nullptr)
+    {
+        return false;
+    }
+
+    m_asset = AAssetManager_open(manager, name.c_str(), AASSET_MODE_BUFFER);
+    if (m_asset == nullptr)
+    {
+        return false;
+    }
+
+    // only works for assets stored uncompressed, the offset is into the APK
+    off_t start = 0;
+    off_t length = 0;
+    int fd = AAsset_openFileDescriptor(m_asset, &start, &length);
+    if (fd >= 0)
+    {
+        off_t page = (off_t) sysconf(_SC_PAGESIZE);
+        off_t aligned = start - start % page;
+        size_t map_size = (size_t) (length + start - aligned);
+        void *map = mmap(nullptr, map_size, PROT_READ, MAP_SHARED, fd, aligned);
+        close(fd);
+        if (map != MAP_FAILED)
+        {
+            m_map = map;
+            m_map_size = map_size;
+            m_data = (const uint8_t *) map + (start - aligned);
+            m_size = (size_t) length;
+            AAsset_close(m_asset);
+            m_asset = nullptr;
+            return true;
+        }
+        LOGE("Asset_File: cannot map %s, reading it instead", name.c_str());
+    }
+
+    m_data = (const uint8_t *) AAsset_getBuffer(m_asset);
+    m_size = (size_t) AAsset_getLength(m_asset);
+    if (m_data == nullptr)
+    {
+        LOGE("Asset_File: cannot read %s", name.c_str());
+        Close();
+        return false;
+    }
+    return true;
+}
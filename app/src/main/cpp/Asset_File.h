@@ -0,0 +1,45 @@
+#ifndef OPENCV_NDK_ASSET_FILE_H
+#define OPENCV_NDK_ASSET_FILE_H
+
+// Android
+#include <android/asset_manager.h>
+// STD Libs
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read only view of an APK asset without extracting it to storage. Assets
+// stored uncompressed (aaptOptions noCompress) are mapped straight out of
+// the APK through their file descriptor, compressed ones are inflated once
+// into memory by AAsset_getBuffer.
+class Asset_File
+{
+public:
+    Asset_File() = default;
+    ~Asset_File();
+    Asset_File(const Asset_File &) = delete;
+    Asset_File &operator=(const Asset_File &) = delete;
+
+    // False without logging when the asset does not exist
+    bool Open(AAssetManager *manager, const std::string &name);
+    void Close();
+
+    const uint8_t *GetData() const
+    { return m_data; }
+
+    size_t GetSize() const
+    { return m_size; }
+
+    // Whether the pages come from the APK rather than a private buffer
+    bool IsMapped() const
+    { return m_map != nullptr; }
+
+private:
+    AAsset *m_asset = nullptr;
+    void *m_map = nullptr;
+    size_t m_map_size = 0;
+    const uint8_t *m_data = nullptr;
+    size_t m_size = 0;
+};
+
+#endif  // OPENCV_NDK_ASSET_FILE_H
@@ -0,0 +1,186 @@
+#include "Box_Tracker.h"
+#include "Detection_Benchmark.h"
+#include <algorithm>
+#include <map>
+
+void SuppressOverlaps(std::vector<cv::Rect> &boxes, std::vector<int> &scores, float max_iou)
+{
+    std::vector<size_t> order(boxes.size());
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        order[i] = i;
+    }
+    // ties go to the larger box, which holds the smaller duplicates
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+    {
+        return scores[a] != scores[b] ? scores[a] > scores[b] : boxes[a].area() > boxes[b].area();
+    });
+
+    std::vector<cv::Rect> kept;
+    std::vector<int> kept_scores;
+    std::multimap<int32_t, size_t> by_left;
+    int32_t widest = 0;
+    for (size_t o = 0; o < order.size(); o++)
+    {
+        const cv::Rect &box = boxes[order[o]];
+        bool suppressed = false;
+        // only kept boxes starting less than widest to the left can reach it
+        std::multimap<int32_t, size_t>::const_iterator it = by_left.lower_bound(box.x - widest);
+        for (; it != by_left.end() && it->first < box.x + box.width && !suppressed; ++it)
+        {
+            suppressed = RectIoU(box, kept[it->second]) > max_iou;
+        }
+        if (!suppressed)
+        {
+            by_left.insert(std::make_pair(box.x, kept.size()));
+            widest = std::max(widest, box.width);
+            kept.push_back(box);
+            kept_scores.push_back(scores[order[o]]);
+        }
+    }
+    boxes.swap(kept);
+    scores.swap(kept_scores);
+}
+
+cv::Rect Box_Track::GetBox() const
+{
+    return cv::Rect(cvRound(state[0] - state[2] * 0.5f), cvRound(state[1] - state[3] * 0.5f),
+                    cvRound(state[2]), cvRound(state[3]));
+}
+
+Box_Tracker::Box_Tracker(float alpha, float beta, int32_t stable_hits, int32_t max_misses,
+                         float min_iou)
+        : m_alpha(alpha), m_beta(beta), m_stable_hits(stable_hits), m_max_misses(max_misses),
+          m_min_iou(min_iou)
+{
+}
+
+void Box_Tracker::Reset()
+{
+    m_tracks.clear();
+    m_next_id = 0;
+}
+
+void Box_Tracker::Update(const std::vector<cv::Rect> &detections,
+                         const std::vector<cv::Rect> &searched)
+{
+    // only tracks that were looked at move on to the next step
+    std::vector<bool> active(m_tracks.size(), false);
+    for (size_t t = 0; t < m_tracks.size(); t++)
+    {
+        cv::Rect box = m_tracks[t].GetBox();
+        for (size_t s = 0; s < searched.size() && !active[t]; s++)
+        {
+            active[t] = (box & searched[s]).area() > 0;
+        }
+        m_tracks[t].searched = active[t];
+        if (active[t])
+        {
+            for (int32_t k = 0; k < 4; k++)
+            {
+                m_tracks[t].state[k] += m_tracks[t].velocity[k];
+            }
+        }
+    }
+
+    // every sufficiently overlapping pair, best first
+    struct Pair
+    {
+        float iou;
+        size_t track;
+        size_t detection;
+    };
+    std::vector<Pair> pairs;
+    for (size_t t = 0; t < m_tracks.size(); t++)
+    {
+        if (!active[t])
+        {
+            continue;
+        }
+        cv::Rect predicted = m_tracks[t].GetBox();
+        for (size_t d = 0; d < detections.size(); d++)
+        {
+            float iou = RectIoU(predicted, detections[d]);
+            if (iou >= m_min_iou)
+            {
+                Pair pair = {iou, t, d};
+                pairs.push_back(pair);
+            }
+        }
+    }
+    std::sort(pairs.begin(), pairs.end(), [](const Pair &a, const Pair &b)
+    {
+        return a.iou > b.iou;
+    });
+
+    std::vector<bool> track_used(m_tracks.size(), false);
+    std::vector<bool> detection_used(detections.size(), false);
+    for (size_t p = 0; p < pairs.size(); p++)
+    {
+        if (track_used[pairs[p].track] || detection_used[pairs[p].detection])
+        {
+            continue;
+        }
+        track_used[pairs[p].track] = true;
+        detection_used[pairs[p].detection] = true;
+
+        Box_Track &track = m_tracks[pairs[p].track];
+        const cv::Rect &d = detections[pairs[p].detection];
+        const float measured[4] = {d.x + d.width * 0.5f, d.y + d.height * 0.5f,
+                                   (float) d.width, (float) d.height};
+        for (int32_t k = 0; k < 4; k++)
+        {
+            float residual = measured[k] - track.state[k];
+            track.state[k] += m_alpha * residual;
+            track.velocity[k] += m_beta * residual;
+        }
+        track.hits++;
+        track.misses = 0;
+    }
+
+    std::vector<Box_Track> tracks;
+    for (size_t t = 0; t < m_tracks.size(); t++)
+    {
+        if (active[t] && !track_used[t])
+        {
+            // coast on the prediction but stop drifting
+            m_tracks[t].misses++;
+            for (int32_t k = 0; k < 4; k++)
+            {
+                m_tracks[t].velocity[k] = 0.0f;
+            }
+        }
+        if (m_tracks[t].misses <= m_max_misses)
+        {
+            tracks.push_back(m_tracks[t]);
+        }
+    }
+
+    for (size_t d = 0; d < detections.size(); d++)
+    {
+        if (detection_used[d])
+        {
+            continue;
+        }
+        const cv::Rect &r = detections[d];
+        Box_Track track = {m_next_id++,
+                           {r.x + r.width * 0.5f, r.y + r.height * 0.5f,
+                            (float) r.width, (float) r.height},
+                           {0.0f, 0.0f, 0.0f, 0.0f}, 1, 0, true};
+        tracks.push_back(track);
+    }
+    m_tracks.swap(tracks);
+}
+
+std::vector<cv::Rect> Box_Tracker::GetStable() const
+{
+    std::vector<cv::Rect> boxes;
+    for (size_t t = 0; t < m_tracks.size(); t++)
+    {
+        if (m_tracks[t].searched && m_tracks[t].hits >= m_stable_hits)
+        {
+            boxes.push_back(m_tracks[t].GetBox());
+        }
+    }
+    return boxes;
+}
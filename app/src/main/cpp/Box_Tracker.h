@@ -0,0 +1,66 @@
+#ifndef OPENCV_NDK_BOX_TRACKER_H
+#define OPENCV_NDK_BOX_TRACKER_H
+
+// OpenCV
+#include <opencv2/core.hpp>
+// STD Libs
+#include <cstdint>
+#include <vector>
+
+// Greedy non-maximum suppression: boxes are visited from the highest score
+// down and dropped when their IoU with a kept box exceeds max_iou. Kept
+// boxes are indexed by their left edge so each box is only compared with
+// the ones it can overlap, O(n log n) for the usual sparse detections.
+// scores is reordered along with boxes.
+void SuppressOverlaps(std::vector<cv::Rect> &boxes, std::vector<int> &scores, float max_iou);
+
+struct Box_Track
+{
+    int32_t id;
+    // centre x, centre y, width and height, and their change per update
+    float state[4];
+    float velocity[4];
+    int32_t hits;
+    int32_t misses;
+    // inside the searched rectangles of the last update
+    bool searched;
+
+    cv::Rect GetBox() const;
+};
+
+// Follows boxes over frames and smooths them with an alpha-beta filter,
+// the steady state form of a constant velocity Kalman filter, on centre and
+// size. Detections are paired with the predicted tracks greedily by IoU.
+// A track counts as stable after stable_hits detections and is dropped
+// after max_misses updates without one.
+class Box_Tracker
+{
+public:
+    Box_Tracker(float alpha = 0.5f, float beta = 0.05f, int32_t stable_hits = 2,
+                int32_t max_misses = 2, float min_iou = 0.3f);
+
+    // detections were searched for inside searched only, tracks outside of
+    // it were not looked at and keep their state
+    void Update(const std::vector<cv::Rect> &detections, const std::vector<cv::Rect> &searched);
+
+    // Smoothed boxes of the stable tracks the last update searched, the
+    // others are left to whoever carries old results forward
+    std::vector<cv::Rect> GetStable() const;
+
+    const std::vector<Box_Track> &GetTracks() const
+    { return m_tracks; }
+
+    void Reset();
+
+private:
+    float m_alpha;
+    float m_beta;
+    int32_t m_stable_hits;
+    int32_t m_max_misses;
+    float m_min_iou;
+
+    std::vector<Box_Track> m_tracks;
+    int32_t m_next_id = 0;
+};
+
+#endif  // OPENCV_NDK_BOX_TRACKER_H
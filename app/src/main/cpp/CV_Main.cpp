@@ -1,4 +1,6 @@
 #include "CV_Main.h"
+#include "Post_Request.h"
+#include <sys/system_properties.h>
 
 
 
@@ -189,33 +191,202 @@ std::map<int, const char* > ACAMERA_metadata_tagnamemap = {
         { ACAMERA_DEPTH_END,"ACAMERA_DEPTH_END"}
 } ;
 
+// Parses a cascade XML straight out of the APK, or from dir when it is not
+// bundled
+template <class Cascade>
+static bool LoadCascadeXml(AAssetManager *manager, const std::string &dir, const std::string &name,
+                           Cascade &cascade)
+{
+    Asset_File asset;
+    if (asset.Open(manager, name))
+    {
+        return cascade.LoadMemory((const char *) asset.GetData(), asset.GetSize());
+    }
+    return cascade.Load(dir + name);
+}
+
+static Face_Backend ReadFaceBackend()
+{
+    char value[PROP_VALUE_MAX] = {0};
+    __system_property_get("debug.opencvndk.faces", value);
+    std::string backend(value);
+    if (backend == "lbp")
+    { return LBP_FACES; }
+    if (backend == "ab")
+    { return AB_FACES; }
+    if (backend == "cv")
+    { return OPENCV_AB_FACES; }
+    if (backend == "hal")
+    { return HAL_FACES; }
+    return HAAR_FACES;
+}
+
+// Faces are only searched in skin colored regions, off by default
+static bool ReadSkinPrefilter()
+{
+    char value[PROP_VALUE_MAX] = {0};
+    __system_property_get("debug.opencvndk.skin", value);
+    return std::string(value) == "1";
+}
+
+// Comma separated names of the optional cascades to run, none by default
+static std::vector<std::string> ReadOptionalCascades()
+{
+    char value[PROP_VALUE_MAX] = {0};
+    __system_property_get("debug.opencvndk.cascades", value);
+    std::vector<std::string> names;
+    std::string list(value);
+    for (size_t begin = 0; begin < list.size();)
+    {
+        size_t end = std::min(list.find(',', begin), list.size());
+        if (end > begin)
+        { names.push_back(list.substr(begin, end - begin)); }
+        begin = end + 1;
+    }
+    return names;
+}
+
+// Milliseconds of cascades per frame, 0 when unset runs every due cascade
+static double ReadFrameBudget()
+{
+    char value[PROP_VALUE_MAX] = {0};
+    __system_property_get("debug.opencvndk.budget", value);
+    return std::max(0.0, atof(value));
+}
+
+static Capture_Encoding ReadCaptureEncoding()
+{
+    char value[PROP_VALUE_MAX] = {0};
+    __system_property_get("debug.opencvndk.capture", value);
+    std::string encoding(value);
+    if (encoding == "bmp")
+    { return CAPTURE_BMP; }
+    if (encoding == "jpeg")
+    { return CAPTURE_JPEG; }
+    if (encoding == "bench")
+    { return CAPTURE_BENCHMARK; }
+    return CAPTURE_PNG;
+}
+
+static bool ReadZslMode()
+{
+    char value[PROP_VALUE_MAX] = {0};
+    __system_property_get("debug.opencvndk.zsl", value);
+    return std::string(value) == "1";
+}
+
+static int32_t ReadBurstCount()
+{
+    char value[PROP_VALUE_MAX] = {0};
+    __system_property_get("debug.opencvndk.burst", value);
+    return std::max(1, atoi(value));
+}
+
+static bool ReadBestShot()
+{
+    char value[PROP_VALUE_MAX] = {0};
+    __system_property_get("debug.opencvndk.best_shot", value);
+    return std::string(value) == "1";
+}
+
+// 0 when frames are not recorded
+static int32_t ReadRecordFormat()
+{
+    char value[PROP_VALUE_MAX] = {0};
+    __system_property_get("debug.opencvndk.record", value);
+    std::string format(value);
+    if (format == "y")
+    { return RECORD_Y; }
+    if (format == "yuv")
+    { return RECORD_YUV; }
+    return 0;
+}
+
+static bool ReadY4mExport()
+{
+    char value[PROP_VALUE_MAX] = {0};
+    __system_property_get("debug.opencvndk.y4m", value);
+    return std::string(value) == "1";
+}
+
+static int32_t ReadJpegQuality()
+{
+    char value[PROP_VALUE_MAX] = {0};
+    __system_property_get("debug.opencvndk.jpeg_quality", value);
+    int32_t quality = atoi(value);
+    return quality > 0 ? quality : 90;
+}
+
 CV_Main::CV_Main()
-        : m_camera_ready(false), m_image(nullptr), m_image_reader(nullptr),
+        : m_camera_ready(false), m_image_reader(nullptr),
           m_native_camera(nullptr), scan_mode(false)
 {
-
-//  AAssetDir* assetDir = AAssetManager_openDir(m_aasset_manager, "");
-//  const char* filename = (const char*)NULL;
-//  while ((filename = AAssetDir_getNextFileName(assetDir)) != NULL) {
-//    AAsset* asset = AAssetManager_open(m_aasset_manager, filename, AASSET_MODE_STREAMING);
-//    char buf[BUFSIZ];
-//    int nb_read = 0;
-//    FILE* out = fopen(filename, "w");
-//    while ((nb_read = AAsset_read(asset, buf, BUFSIZ)) > 0)
-//      fwrite(buf, nb_read, 1, out);
-//    fclose(out);
-//    AAsset_close(asset);
-//  }
-//  AAssetDir_close(assetDir);
-
-    if (!face_cascade.load(face_cascade_name))
-    { LOGE("--(!)Error loading face cascade\n"); };
-    if (!eyes_cascade.load(eyes_cascade_name))
-    { LOGE("--(!)Error loading eyes cascade\n"); };
+    // with the HAL backend the camera's faces replace the face cascade
+    // while it reports them
+    m_pipeline.SetFaceSource([this](int32_t width, int32_t height, std::vector<cv::Rect> &faces)
+    {
+        if (!m_hal_faces.IsEnabled())
+        {
+            return false;
+        }
+        faces = m_hal_faces.GetFaces(width, height, HAL_MIN_SCORE);
+        return true;
+    });
 };
 
+void CV_Main::SetAssetManager(AAssetManager *asset_manager)
+{
+    m_aasset_manager = asset_manager;
+    // onCreate runs again when the activity is recreated, load only once
+    if (!m_cascades_ready.valid())
+    {
+        // app start and opening the camera overlap with reading the models
+        m_cascades_ready = std::async(std::launch::async, &CV_Main::LoadCascades, this).share();
+    }
+}
+
+bool CV_Main::LoadCascades()
+{
+    Cascade_Loader loader;
+    loader.model = [this](const std::string &name, bool lbp)
+    {
+        return LoadModel(name, lbp);
+    };
+    loader.xml = [this](const std::string &name, Haar_Cascade &cascade)
+    {
+        return LoadCascadeXml(m_aasset_manager, cascade_dir, name, cascade);
+    };
+    m_pipeline.SetSkinPrefilter(ReadSkinPrefilter());
+    return m_pipeline.Load(loader, ReadFaceBackend(), ReadOptionalCascades(),
+                           ReadFrameBudget());
+}
+
+Cascade_Model CV_Main::LoadModel(const std::string &name, bool lbp) const
+{
+    Cascade_Model model;
+    // precompiled and bundled, then precompiled next to a file in cascade_dir
+    model.binary = std::make_shared<Cascade_Binary>();
+    if (model.binary->Open(m_aasset_manager, Cascade_Binary::BinaryName(name)) ||
+        model.binary->Map(cascade_dir + Cascade_Binary::BinaryName(name)))
+    {
+        model.loaded = true;
+        return model;
+    }
+
+    model.binary.reset();
+    model.loaded = lbp ? LoadCascadeXml(m_aasset_manager, cascade_dir, name, model.lbp) :
+                   LoadCascadeXml(m_aasset_manager, cascade_dir, name, model.haar);
+    return model;
+}
+
 CV_Main::~CV_Main()
 {
+    // the loader threads use this object
+    if (m_cascades_ready.valid())
+    {
+        m_cascades_ready.wait();
+    }
+
     // clean up VM and callback handles
     JNIEnv *env;
     java_vm->GetEnv(reinterpret_cast<void **>(&env), JNI_VERSION_1_6);
@@ -240,6 +411,7 @@ CV_Main::~CV_Main()
 
     if (m_image_reader != nullptr)
     {
+        m_camera_source.SetReader(nullptr);
         delete (m_image_reader);
         m_image_reader = nullptr;
     }
@@ -267,6 +439,9 @@ void CV_Main::openCamera(JNIEnv *env, jclass clazz, jobject jPreviewSurface, jst
 
     // set saving path to Imagereader
     readerListener.setDumpFilePathBase(outPath);
+    m_capture_writer.SetEncoding(ReadCaptureEncoding());
+    m_capture_writer.SetJpegQuality(ReadJpegQuality());
+    readerListener.setWriter(&m_capture_writer);
 
     // CameraIdList 구하기
     camera_status_t ret = testCase.initWithErrorLog();
@@ -290,18 +465,72 @@ void CV_Main::openCamera(JNIEnv *env, jclass clazz, jobject jPreviewSurface, jst
     readerListener.setDumpFilePathBase(outPath);
     media_status_t mediaRet = AMEDIA_ERROR_UNKNOWN;
 
-    mediaRet = testCase.initImageReaderWithErrorLog(
-            ANativeWindow_getWidth(previewAnw),ANativeWindow_getHeight(previewAnw),
-            AIMAGE_FORMAT_YUV_420_888, NUM_TEST_IMAGES,  &readerCb);
-    // AIMAGE_FORMAT_JPEG, AIMAGE_FORMAT_YUV_420_888
-
-    ASSERT(mediaRet == AMEDIA_OK, "testCase.initImageReaderWithErrorLog() ==> error");
-
-    ret = testCase.createCaptureSessionWithLog();
-    ASSERT(ret == ACAMERA_OK, "testCase.createCaptureSessionWithLog() ==> error");
+    // ZSL streams the largest YUV size into the reader, which keeps the
+    // ring's frames plus one for the camera and one for the writer
+    m_burst_count = ReadBurstCount();
+    m_best_shot = ReadBestShot();
+    m_record_format = ReadRecordFormat();
+    m_y4m_export = ReadY4mExport();
+    // counting repetitions, recording and export need every preview frame,
+    // the reader streams them as for ZSL but at the preview size stills are
+    // taken at without ZSL
+    const bool zsl_requested = ReadZslMode();
+    bool zsl = m_burst_count == 1 && testCase.initZsl(&m_zsl);
+    if (zsl && !zsl_requested)
+    {
+        m_zsl.SetSize(ANativeWindow_getWidth(previewAnw), ANativeWindow_getHeight(previewAnw));
+    }
+    if (zsl)
+    {
+        m_reader_images = (int32_t) m_zsl.GetCapacity() + 2;
+        zsl = testCase.initImageReaderWithErrorLog(
+                m_zsl.GetWidth(), m_zsl.GetHeight(), AIMAGE_FORMAT_YUV_420_888,
+                m_reader_images, &readerCb) == AMEDIA_OK &&
+              testCase.createCaptureSessionWithLog() == ACAMERA_OK;
+        if (!zsl)
+        {
+            LOGE("ZSL: cannot stream %dx%d, capturing with still requests",
+                 m_zsl.GetWidth(), m_zsl.GetHeight());
+            testCase.closeImageReader();
+        }
+    }
+    if (!zsl)
+    {
+        m_reader_images = std::min(std::max(BURST_READER_IMAGES, m_burst_count + 2),
+                                   BURST_MAX_READER_IMAGES);
+        mediaRet = testCase.initImageReaderWithErrorLog(
+                ANativeWindow_getWidth(previewAnw),ANativeWindow_getHeight(previewAnw),
+                AIMAGE_FORMAT_YUV_420_888, m_reader_images,  &readerCb);
+        // AIMAGE_FORMAT_JPEG, AIMAGE_FORMAT_YUV_420_888
+        ASSERT(mediaRet == AMEDIA_OK, "testCase.initImageReaderWithErrorLog() ==> error");
+
+        ret = testCase.createCaptureSessionWithLog();
+        ASSERT(ret == ACAMERA_OK, "testCase.createCaptureSessionWithLog() ==> error");
+    }
 
     ret = testCase.createRequestsWithErrorLog();
     ASSERT(ret == ACAMERA_OK, "testCase.createRequestsWithErrorLog() ==> error");
+    testCase.setBurstListener(&readerListener);
+
+    // without the stream the reader still serves the still request
+    if (zsl && testCase.streamToImageReader() != ACAMERA_OK)
+    {
+        LOGE("ZSL: cannot add the reader to the preview request");
+        zsl = false;
+    }
+    m_zsl_enabled = zsl;
+    readerListener.setZsl(m_zsl_enabled ? &m_zsl : nullptr);
+    m_zsl.Start();
+    m_sensor_rotation = testCase.getSensorOrientation();
+    StartFrameTap(m_zsl_enabled);
+
+    // best shot rates the faces the camera finds, the cascades only run on
+    // the preview
+    if ((ReadFaceBackend() == HAL_FACES || m_best_shot) &&
+        !testCase.enableFaceDetection(&m_hal_faces))
+    {
+        LOGI("No face detection in the camera, using the face cascade");
+    }
 
     ret = testCase.startPreview();
     ASSERT(ret == ACAMERA_OK, "testCase.startPreview() ==> error");
@@ -335,6 +564,8 @@ void CV_Main::openCamera(JNIEnv *env, jclass clazz, jobject jPreviewSurface, jst
 
 void CV_Main::captureCamera(JNIEnv *env, jobject clazz)
 {
+    // the moment of the press, before anything else takes time
+    int64_t press_ns = Zsl_Ring::Now();
     camera_status_t ret;
 
     // before capture, make filename to save jepg.
@@ -348,25 +579,93 @@ void CV_Main::captureCamera(JNIEnv *env, jobject clazz)
     strftime(buffer,sizeof(buffer),"img%Y%m%d_%H%M%S",timeinfo);
     readerListener.setFilenameCapture(buffer);
 
+    if (m_zsl_enabled)
+    {
+        AImage *image = m_best_shot ? m_zsl.TakeBest(press_ns, SHOT_WINDOW_NS, MakeShotScore())
+                                    : m_zsl.Take(press_ns);
+        if (image == nullptr)
+        {
+            LOGE("ZSL: no frame to capture yet");
+            return;
+        }
+        // the ring's frames aside, two reader slots are left
+        m_capture_writer.Submit(image, std::string(outPath) + "/" + buffer + ".", 2);
+        LOGI("ZSL capture queued %.1f ms after the press", (Zsl_Ring::Now() - press_ns) / 1e6);
+        return;
+    }
 
-    for (int capture = 0; capture < NUM_TEST_IMAGES; capture++)
+    // the whole burst goes to the camera as one capture sequence, the
+    // listener reports it once the frames are in and the button returns now
+    std::string path = std::string(outPath) + "/" + buffer + ".";
+    Burst_Callback done = [this, path](const Burst_Report &report, int32_t requested,
+                                       AImage *best, int32_t index, double score)
     {
-        ret = testCase.takePicture();
-        ASSERT(ret == ACAMERA_OK, "testCase.takePicture() ==> error");
+        OnBurstDone(report, requested, best, index, score, path);
+    };
+    if (m_best_shot)
+    {
+        readerListener.startBurst(m_burst_count, done, MakeShotScore());
     }
-    // wait until all capture finished
-    for (int i = 0; i < 50; i++)
+    else
     {
-        usleep(100000); // sleep 100ms
-        if (readerListener.onImageAvailableCount() == NUM_TEST_IMAGES)
-        {
-            LOGI("Session take ~%d ms to capture %d images",
-                 i * 100, NUM_TEST_IMAGES);
-            break;
-        }
+        readerListener.startBurst(m_burst_count, done);
+    }
+    ret = testCase.takeBurst(m_burst_count);
+    if (ret != ACAMERA_OK)
+    {
+        LOGE("Burst: capture of %d frames refused, ret %d", m_burst_count, ret);
+        readerListener.cancelBurst();
     }
-    ASSERT(readerListener.onImageAvailableCount() == NUM_TEST_IMAGES, "Not captured to NUM_TEST_IMAGES ==> error");
+}
 
+void CV_Main::OnBurstDone(const Burst_Report &report, int32_t requested, AImage *best,
+                          int32_t index, double score, const std::string &path)
+{
+    if (report.frames < requested)
+    {
+        LOGE("Burst: only %d of %d frames arrived", report.frames, requested);
+    }
+    LOGI("Burst: %d frames, first after %.1f ms, %.1f fps, %.1f ms exposure to arrival",
+         report.frames, report.first_frame_ms, report.fps, report.mean_latency_ms);
+    if (best != nullptr)
+    {
+        LOGI("Best shot: frame %d of %d, score %.1f", index, report.frames, score);
+        // the listener holds no other image of the reader
+        m_capture_writer.Submit(best, path, m_reader_images);
+    }
+    LOGI("Capture writer: %zu queued, %.1f ms to disk, %.1f ms writing, %lld written, "
+         "%lld refused", m_capture_writer.GetQueueDepth(), m_capture_writer.GetMeanLatency(),
+         m_capture_writer.GetMeanWriteTime(), (long long) m_capture_writer.GetWritten(),
+         (long long) m_capture_writer.GetRefused());
+}
+
+std::function<double(AImage *)> CV_Main::MakeShotScore()
+{
+    std::vector<cv::Rect> faces;
+    cv::Size frame;
+    {
+        std::lock_guard<std::mutex> lock(m_shot_mutex);
+        faces = m_shot_faces;
+        frame = m_shot_frame;
+    }
+    Hal_Face_Detector *hal_faces = m_hal_faces.IsEnabled() ? &m_hal_faces : nullptr;
+    const uint8_t min_score = HAL_MIN_SCORE;
+    return [faces, frame, hal_faces, min_score](AImage *image) -> double
+    {
+        Yuv_Planes planes;
+        if (!GetYuvPlanes(image, &planes))
+        {
+            return 0.0;
+        }
+        if (hal_faces != nullptr)
+        {
+            // the camera's latest faces, already on this frame's pixels
+            cv::Size size(planes.width, planes.height);
+            return MeasureSharpness(planes, hal_faces->GetFaces(size.width, size.height,
+                                                                min_score), size);
+        }
+        return MeasureSharpness(planes, faces, frame);
+    };
 }
 
 void CV_Main::closeCamera(JNIEnv *env, jobject clazz)
@@ -374,6 +673,16 @@ void CV_Main::closeCamera(JNIEnv *env, jobject clazz)
     camera_status_t ret;
     m_camera_thread_stopped = true;
 
+    // held captures belong to the reader the reset deletes
+    readerListener.setFrameTap(nullptr);
+    m_zsl.Stop();
+    readerListener.cancelBurst();
+    m_recorder.Stop();
+    if (m_y4m_export && !m_y4m_exporter.Stop())
+    {
+        LOGE("Y4M export to %s/preview.y4m failed", outPath);
+    }
+    m_capture_writer.Flush();
     ret = testCase.resetWithErrorLog();
     ASSERT(ret == ACAMERA_OK, "testCase.resetWithErrorLog() ==> error");
 
@@ -412,6 +721,7 @@ void CV_Main::FlipCamera(JNIEnv *env, jclass clazz, jobject jPreviewSurface, jst
     // reset info
     if (m_image_reader != nullptr)
     {
+        m_camera_source.SetReader(nullptr);
         delete (m_image_reader);
         m_image_reader = nullptr;
     }
@@ -442,16 +752,20 @@ void CV_Main::CameraLoop()
         { break; }
         if (!m_camera_ready || !m_image_reader)
         { continue; }
-        m_image = m_image_reader->GetLatestImage();
-        if (m_image == nullptr)
+        // Detection runs on the sensor orientation planes before DisplayImage()
+        // converts and frees them, only the results get rotated for display
+        m_camera_source.SetReader(m_image_reader);
+        m_camera_source.SetRotation(GetSensorRotation());
+        Yuv_Planes planes;
+        int32_t rotation = 0;
+        if (!m_camera_source.Acquire(&planes, &rotation))
         { continue; }
 
         ANativeWindow_acquire(m_native_window);
         ANativeWindow_Buffer buffer;
         if (ANativeWindow_lock(m_native_window, &buffer, nullptr) < 0)
         {
-            m_image_reader->DeleteImage(m_image);
-            m_image = nullptr;
+            m_camera_source.Release();
             continue;
         }
 
@@ -462,64 +776,78 @@ void CV_Main::CameraLoop()
                  buffer.format);
         }
 
-        m_image_reader->DisplayImage(&buffer, m_image);
+        // the scheduler is only ours once the loader is done with it
+        const bool detecting = scan_mode && CascadesLoaded();
+        if (detecting)
+        {
+            FaceDetect(planes, rotation);
+        }
+
+        m_image_reader->DisplayImage(&buffer, m_camera_source.TakeImage());
 
         display_mat = cv::Mat(buffer.height, buffer.stride, CV_8UC4, buffer.bits);
 
-        if (true == scan_mode)
+        if (detecting)
+        {
+            DrawFaces(display_mat, planes.width, planes.height, rotation);
+            DrawDetections(display_mat, planes.width, planes.height, rotation);
+        }
+        char reps[16];
         {
-            FaceDetect(display_mat);
+            std::lock_guard<std::mutex> lock(m_rep_mutex);
+            snprintf(reps, sizeof(reps), "%d", m_rep_counter.GetCount());
         }
+        cv::putText(display_mat, reps, cv::Point(40, 120), cv::FONT_HERSHEY_SIMPLEX, 3.0,
+                    CV_GREEN, 6);
 
         ANativeWindow_unlockAndPost(m_native_window);
         ANativeWindow_release(m_native_window);
     }
+}
 
+bool CV_Main::CascadesLoaded() const
+{
+    return m_cascades_ready.valid() &&
+           m_cascades_ready.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
 }
 
 // When scan button is hit
 void CV_Main::RunCV()
 {
+    // the cascades have been loading since SetAssetManager(), the UI thread
+    // does not wait for them, detection starts with the first frame after
+    if (!CascadesLoaded())
+    {
+        LOGI("Scanning starts once the cascades are loaded");
+    }
+    else if (!m_cascades_ready.get())
+    {
+        LOGE("--(!)Scanning without a face cascade\n");
+    }
     scan_mode = true;
+    if (CascadesLoaded())
+    {
+        m_pipeline.Reset();
+    }
+    m_face_count = 0;
     total_t = 0;
     start_t = clock();
 }
 
-void CV_Main::FaceDetect(cv::Mat &frame)
+void CV_Main::FaceDetect(const Yuv_Planes &planes, int32_t rotation)
 {
-
-    std::vector<cv::Rect> faces;
-    cv::Mat frame_gray;
-
-    cv::cvtColor(frame, frame_gray, CV_RGBA2GRAY);
-
-    // equalizeHist( frame_gray, frame_gray );
-
-    //-- Detect faces
-    face_cascade.detectMultiScale(frame_gray, faces, 1.18, 2, 0 | CV_HAAR_SCALE_IMAGE,
-                                  cv::Size(70, 70));
-
-    for (size_t i = 0; i < faces.size(); i++)
+    const bool ran = m_pipeline.Process(planes, rotation);
+    m_face_count = (int32_t) m_pipeline.GetFaces().size();
+    if (ran && m_best_shot)
     {
-        cv::Point center(faces[i].x + faces[i].width * 0.5, faces[i].y + faces[i].height * 0.5);
-
-        ellipse(frame, center, cv::Size(faces[i].width * 0.5, faces[i].height * 0.5), 0, 0, 360,
-                CV_PURPLE, 4, 8, 0);
-
-        cv::Mat faceROI = frame_gray(faces[i]);
-        std::vector<cv::Rect> eyes;
-
-        //-- In each face, detect eyes
-        eyes_cascade.detectMultiScale(faceROI, eyes, 1.2, 2, 0 | CV_HAAR_SCALE_IMAGE,
-                                      cv::Size(45, 45));
-
-        for (size_t j = 0; j < eyes.size(); j++)
+        std::lock_guard<std::mutex> lock(m_shot_mutex);
+        m_shot_faces.clear();
+        const std::vector<Face_Result> &faces = m_pipeline.GetFaces();
+        for (size_t i = 0; i < faces.size(); i++)
         {
-            cv::Point center(faces[i].x + eyes[j].x + eyes[j].width * 0.5,
-                             faces[i].y + eyes[j].y + eyes[j].height * 0.5);
-            int radius = cvRound((eyes[j].width + eyes[j].height) * 0.25);
-            circle(frame, center, radius, CV_RED, 4, 8, 0);
+            m_shot_faces.push_back(faces[i].face);
         }
+        m_shot_frame = cv::Size(planes.width, planes.height);
     }
 
     end_t = clock();
@@ -530,7 +858,106 @@ void CV_Main::FaceDetect(cv::Mat &frame)
         // stop after 20 seconds
         LOGI("DONE WITH 20 SECONDS");
         scan_mode = false;
+        // the post blocks on the network, keep it off the camera thread
+        std::lock_guard<std::mutex> lock(m_rep_mutex);
+        std::thread(jumpingJackPost, (int) m_rep_counter.GetCount(),
+                    (int) (m_rep_counter.GetElapsed() / 1000.0)).detach();
     }
     start_t = clock();
+}
+
+void CV_Main::DrawFaces(cv::Mat &frame, int32_t width, int32_t height, int32_t rotation)
+{
+    const std::vector<Face_Result> &faces = m_pipeline.GetFaces();
+    for (size_t i = 0; i < faces.size(); i++)
+    {
+        cv::Rect face = RotateRect(faces[i].face, width, height, rotation);
+        cv::Point center(face.x + face.width * 0.5, face.y + face.height * 0.5);
+
+        ellipse(frame, center, cv::Size(face.width * 0.5, face.height * 0.5), 0, 0, 360,
+                faces[i].smiling ? CV_GREEN : CV_PURPLE, 4, 8, 0);
+
+        const std::vector<cv::Rect> &eyes = faces[i].eyes;
+        for (size_t j = 0; j < eyes.size(); j++)
+        {
+            cv::Rect eye = RotateRect(eyes[j], width, height, rotation);
+            cv::Point center(eye.x + eye.width * 0.5, eye.y + eye.height * 0.5);
+            int radius = cvRound((eye.width + eye.height) * 0.25);
+            circle(frame, center, radius, CV_RED, 4, 8, 0);
+        }
+    }
+}
 
+void CV_Main::DrawDetections(cv::Mat &frame, int32_t width, int32_t height, int32_t rotation)
+{
+    std::vector<cv::Rect> objects = m_pipeline.GetObjects();
+    for (size_t i = 0; i < objects.size(); i++)
+    {
+        rectangle(frame, RotateRect(objects[i], width, height, rotation), CV_BLUE, 4, 8, 0);
+    }
+}
+
+int32_t CV_Main::GetSensorRotation()
+{
+    if (m_native_camera != nullptr)
+    {
+        return (int32_t) m_native_camera->GetOrientation();
+    }
+    return m_image_reader != nullptr ? m_image_reader->GetPresentRotation() : m_sensor_rotation;
+}
+
+void CV_Main::StartFrameTap(bool streaming)
+{
+    if (!streaming)
+    {
+        LOGE("Repetitions, recording and Y4M export need the reader to stream, not with "
+             "bursts or on LEGACY cameras");
+        m_record_format = 0;
+        m_y4m_export = false;
+        readerListener.setFrameTap(nullptr);
+        return;
+    }
+    const int32_t width = m_zsl.GetWidth();
+    const int32_t height = m_zsl.GetHeight();
+    if (m_record_format != 0 &&
+        !m_recorder.Start(std::string(outPath) + "/frames.rec", width, height,
+                          (Record_Format) m_record_format, RECORD_SLOTS))
+    {
+        m_record_format = 0;
+    }
+    if (m_y4m_export &&
+        !m_y4m_exporter.Start(std::string(outPath) + "/preview.y4m", width, height, true))
+    {
+        m_y4m_export = false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_rep_mutex);
+        m_rep_motion.Reset();
+        m_rep_counter.Reset();
+    }
+    readerListener.setFrameTap([this](AImage *image)
+    {
+        OnStreamFrame(image);
+    });
+}
+
+void CV_Main::OnStreamFrame(AImage *image)
+{
+    Yuv_Planes planes;
+    if (!GetYuvPlanes(image, &planes))
+    {
+        return;
+    }
+    // drops the frame once stopped or when the file could not be made
+    m_recorder.Record(planes, m_sensor_rotation, m_face_count);
+    // copied here, written on the exporter's thread
+    m_y4m_exporter.Export(planes);
+
+    std::lock_guard<std::mutex> lock(m_rep_mutex);
+    m_rep_motion.Update(planes.y, planes.width, planes.height, planes.y_stride);
+    if (m_rep_counter.Update(m_rep_motion, m_sensor_rotation, planes.timestamp / 1e6))
+    {
+        LOGI("Jumping jacks: %d, %.0f ms apart, %.2f ms per frame", m_rep_counter.GetCount(),
+             m_rep_counter.GetMeanPeriod(), m_rep_counter.GetMeanTime());
+    }
 }
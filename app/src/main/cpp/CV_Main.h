@@ -11,14 +11,33 @@
 #include <opencv2/objdetect.hpp>
 #include <opencv2/features2d.hpp>
 // OpenCV-NDK App
+#include "Asset_File.h"
+#include "Camera_Source.h"
+#include "Cascade_Binary.h"
+#include "Face_Pipeline.h"
+#include "Frame_Recorder.h"
+#include "Haar_Cascade.h"
+#include "Hal_Face_Detector.h"
 #include "Image_Reader.h"
+#include "Lbp_Cascade.h"
 #include "Native_Camera.h"
+#include "Rep_Counter.h"
+#include "Sharpness.h"
 #include "Util.h"
+#include "Y4m_File.h"
+#include "Zsl_Ring.h"
 // C Libs
 #include <unistd.h>
 #include <time.h>
 // STD Libs
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdlib>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <thread>
@@ -34,11 +53,8 @@ public:
 
     // Lets us know when app has started passing in VM info
     void OnCreate(JNIEnv *env, jobject caller_activity);
-    // sets Surface buffer reference pointer
-    void SetAssetManager(AAssetManager *asset_manager)
-    {
-        m_aasset_manager = asset_manager;
-    };
+    // Keeps the APK asset manager and loads the cascades from it
+    void SetAssetManager(AAssetManager *asset_manager);
 
     // Cache the Java VM used from the Java layer.
     void SetJavaVM(JavaVM *pjava_vm)
@@ -55,8 +71,34 @@ public:
 
     //========================================================
     void CameraLoop();
-    void FaceDetect(cv::Mat &frame);
+    // Detects on the sensor orientation planes, results stay in their
+    // coordinates until DrawFaces() rotates them onto the display frame
+    void FaceDetect(const Yuv_Planes &planes, int32_t rotation);
+    void DrawFaces(cv::Mat &frame, int32_t width, int32_t height, int32_t rotation);
+    // Outlines the latest detections of the optional cascades
+    void DrawDetections(cv::Mat &frame, int32_t width, int32_t height, int32_t rotation);
     void RunCV();
+    // Face, eyes and the enabled optional cascades, read in parallel on
+    // background threads. True when there is a face cascade.
+    bool LoadCascades();
+    // Whether LoadCascades() has finished, without waiting for it. Nothing
+    // may touch m_pipeline before, the loader registers with it.
+    bool CascadesLoaded() const;
+    // Maps the precompiled .cascade instead of parsing the XML when there
+    // is one. Assets come first, cascade_dir is only searched for files the
+    // APK does not bundle. Safe to call from any thread.
+    Cascade_Model LoadModel(const std::string &name, bool lbp) const;
+
+    Face_Backend GetFaceBackend() const
+    { return m_pipeline.GetBackend(); }
+
+    // Rotation from sensor to display, Native_Camera::GetOrientation()
+    int32_t GetSensorRotation();
+
+    // Optional chroma prefilter, off by default as it misses faces under
+    // strongly colored light
+    void SetSkinPrefilter(bool enable)
+    { m_pipeline.SetSkinPrefilter(enable); }
 
 
 private:
@@ -70,6 +112,12 @@ private:
 
     char outPath[256] ;
 
+    // Faces from the preview's capture results, used in place of the face
+    // cascade while the camera reports them. Eyes and smiles still run.
+    // Declared ahead of testCase, which points at it until it is destroyed.
+    Hal_Face_Detector m_hal_faces;
+    const uint8_t HAL_MIN_SCORE = 50;
+
     // CameraManager 구하기
     PreviewTestCase testCase;
     camera_type m_selected_camera_type = BACK_CAMERA; // Default
@@ -81,7 +129,63 @@ private:
             ImageReaderListener::validateImageCb
     };
 
-    const int NUM_TEST_IMAGES = 1;
+    // Frames per capture, more than one turns ZSL off and captures a burst
+    // of still requests. The reader keeps an image per burst frame plus one
+    // for the camera and one for the best shot, so the writer can hold the
+    // whole burst instead of copying each frame, within the limits below.
+    int32_t m_burst_count = 1;
+    int32_t m_reader_images = 4;
+    const int32_t BURST_READER_IMAGES = 4;
+    const int32_t BURST_MAX_READER_IMAGES = 12;
+
+    // Encodes and saves what readerListener receives. Declared after
+    // testCase so it is flushed before the reader holding its images goes.
+    // The queue takes a whole burst.
+    Capture_Writer m_capture_writer{2, 16};
+
+    // Recent full resolution frames for zero shutter lag captures, fed by
+    // the repeating request. Also declared after testCase, its frames belong
+    // to the reader. Opt in with debug.opencvndk.zsl=1, openCamera() falls
+    // back to still requests when the camera cannot stream the frames.
+    Zsl_Ring m_zsl{4};
+    bool m_zsl_enabled = false;
+
+    // Best shot: of the burst, or of the ZSL frames near the press, only the
+    // sharpest is written. Sharpness is measured on the latest faces when
+    // there are any: the camera's own when it detects faces, otherwise the
+    // cascades' copied here by the camera thread for the capture one.
+    bool m_best_shot = false;
+    const int64_t SHOT_WINDOW_NS = 200000000LL;
+    std::mutex m_shot_mutex;
+    std::vector<cv::Rect> m_shot_faces;
+    cv::Size m_shot_frame;
+    // Rates a capture candidate, on whichever thread the frames arrive
+    std::function<double(AImage *)> MakeShotScore();
+    // Logs a finished burst and queues its best shot as path, runs on the
+    // reader's thread
+    void OnBurstDone(const Burst_Report &report, int32_t requested, AImage *best, int32_t index,
+                     double score, const std::string &path);
+
+    // Keeps the latest preview frames in outPath/frames.rec for looking at
+    // later what the camera saw, tagged with the faces detected last.
+    // Started with the camera and fed by the reader's stream.
+    Frame_Recorder m_recorder;
+    int32_t m_record_format = 0;
+    const uint32_t RECORD_SLOTS = 900;
+    std::atomic<int32_t> m_face_count{0};
+    // from the camera's characteristics, for frames without Native_Camera
+    int32_t m_sensor_rotation = 0;
+    // Starts what the streamed frames feed and hands them the stream, or
+    // turns them off when the reader does not stream
+    void StartFrameTap(bool streaming);
+    // Every streamed frame, on the reader's thread
+    void OnStreamFrame(AImage *image);
+
+    // Streams every preview frame to outPath/preview.y4m for the Y4M tools,
+    // copied from the reader's stream and written on the exporter's thread,
+    // closed with the camera
+    Y4m_Exporter m_y4m_exporter;
+    bool m_y4m_export = false;
 
     //========================================================
 
@@ -96,12 +200,13 @@ private:
     // Image Reader
     ImageFormat m_view{0, 0, 0};
     Image_Reader *m_image_reader;
-    AImage *m_image;
+    // the camera loop's frames, from m_image_reader
+    Camera_Source m_camera_source;
 
     volatile bool m_camera_ready;
 
     // used to hold reference to assets in assets folder
-    AAssetManager *m_aasset_manager;
+    AAssetManager *m_aasset_manager = nullptr;
 
     // for timing OpenCV bottlenecks
     clock_t start_t, end_t;
@@ -112,12 +217,22 @@ private:
 
     // OpenCV values
     cv::Mat display_mat;
-    // Currently no way of getting file string for load() call, need to manually
-    // store the assents in the sdcard and grab them from there
-    cv::String face_cascade_name = "/sdcard/Download/opencv/haarcascade_frontalface_alt.xml";
-    cv::String eyes_cascade_name = "/sdcard/Download/opencv/haarcascade_eye_tree_eyeglasses.xml";
-    cv::CascadeClassifier face_cascade;
-    cv::CascadeClassifier eyes_cascade;
+    // Cascades are read from the APK assets, cascade_dir only holds the
+    // ones the APK does not bundle
+    std::string cascade_dir = "/sdcard/Download/opencv/";
+
+    // Motion gating, faces, eyes, smiles and the optional cascades, shared
+    // with frame_replay
+    Face_Pipeline m_pipeline;
+    // ready once the cascades are registered, see LoadCascades()
+    std::shared_future<bool> m_cascades_ready;
+
+    // Jumping jacks counted on every streamed frame from the camera's start,
+    // scanning or not, on motion planes of their own. Posted when a scan
+    // ends.
+    std::mutex m_rep_mutex;
+    Motion_Detector m_rep_motion;
+    Rep_Counter m_rep_counter;
 
     cv::Scalar CV_PURPLE = cv::Scalar(255, 0, 255);
     cv::Scalar CV_RED = cv::Scalar(255, 0, 0);
@@ -0,0 +1,52 @@
+#include "Camera_Source.h"
+
+Camera_Source::~Camera_Source()
+{
+    Release();
+}
+
+void Camera_Source::SetReader(Image_Reader *reader)
+{
+    if (reader != m_reader)
+    {
+        Release();
+        m_reader = reader;
+    }
+}
+
+bool Camera_Source::Acquire(Yuv_Planes *planes, int32_t *rotation)
+{
+    Release();
+    if (m_reader == nullptr)
+    {
+        return false;
+    }
+    m_image = m_reader->GetLatestImage();
+    if (m_image == nullptr)
+    {
+        return false;
+    }
+    if (!GetYuvPlanes(m_image, planes))
+    {
+        Release();
+        return false;
+    }
+    *rotation = m_rotation;
+    return true;
+}
+
+void Camera_Source::Release()
+{
+    if (m_image != nullptr)
+    {
+        m_reader->DeleteImage(m_image);
+        m_image = nullptr;
+    }
+}
+
+AImage *Camera_Source::TakeImage()
+{
+    AImage *image = m_image;
+    m_image = nullptr;
+    return image;
+}
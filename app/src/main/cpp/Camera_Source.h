@@ -0,0 +1,40 @@
+#ifndef OPENCV_NDK_CAMERA_SOURCE_H
+#define OPENCV_NDK_CAMERA_SOURCE_H
+
+// Android
+#include <media/NdkImage.h>
+// OpenCV-NDK App
+#include "Frame_Source.h"
+#include "Image_Reader.h"
+
+// Frames of the camera, the latest image of an Image_Reader each time
+class Camera_Source : public Frame_Source
+{
+public:
+    Camera_Source() = default;
+    ~Camera_Source() override;
+    Camera_Source(const Camera_Source &other) = delete;
+    Camera_Source &operator=(const Camera_Source &other) = delete;
+
+    // The reader can change with the camera, nullptr while there is none.
+    // A held image of the previous reader is deleted first.
+    void SetReader(Image_Reader *reader);
+
+    // Sensor to display rotation reported with every frame
+    void SetRotation(int32_t rotation)
+    { m_rotation = rotation; }
+
+    bool Acquire(Yuv_Planes *planes, int32_t *rotation) override;
+    void Release() override;
+
+    // Hands the acquired image over, for Image_Reader::DisplayImage() which
+    // deletes it. The planes are gone with it.
+    AImage *TakeImage();
+
+private:
+    Image_Reader *m_reader = nullptr;
+    AImage *m_image = nullptr;
+    int32_t m_rotation = 0;
+};
+
+#endif  // OPENCV_NDK_CAMERA_SOURCE_H
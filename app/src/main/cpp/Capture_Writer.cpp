@@ -0,0 +1,411 @@
+#include "Capture_Writer.h"
+#include "Image_Reader.h"
+#include "Jpeg_Encoder.h"
+#include "Png_Encoder.h"
+#include "Thumbnail_Pyramid.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+
+static double NowMs()
+{
+    return std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Capture_Writer::Capture_Writer(int32_t threads, size_t max_queue)
+        : m_max_queue(std::max((size_t) 1, max_queue)), m_encoding(CAPTURE_PNG),
+          m_jpeg_quality(90)
+{
+    for (int32_t i = 0; i < std::max(1, threads); i++)
+    {
+        m_threads.push_back(std::thread(&Capture_Writer::Run, this));
+    }
+}
+
+Capture_Writer::~Capture_Writer()
+{
+    Flush();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_work.notify_all();
+    for (size_t i = 0; i < m_threads.size(); i++)
+    {
+        m_threads[i].join();
+    }
+}
+
+std::unique_ptr<Capture_Frame> Capture_Writer::TakeFrame()
+{
+    if (m_pool.empty())
+    {
+        return std::unique_ptr<Capture_Frame>(new Capture_Frame());
+    }
+    std::unique_ptr<Capture_Frame> frame = std::move(m_pool.back());
+    m_pool.pop_back();
+    return frame;
+}
+
+// Y, U and V planes of a frame back to back without padding, the layout
+// Write() expects for copied frames
+static void CopyPlanes(const Yuv_Planes &planes, std::vector<uint8_t> &data)
+{
+    const int32_t uv_width = (planes.width + 1) / 2;
+    const int32_t uv_height = (planes.height + 1) / 2;
+    data.resize((size_t) planes.width * planes.height + (size_t) uv_width * uv_height * 2);
+    uint8_t *out = data.data();
+    for (int32_t y = 0; y < planes.height; y++, out += planes.width)
+    {
+        memcpy(out, planes.y + (size_t) y * planes.y_stride, planes.width);
+    }
+    const uint8_t *chroma[2] = {planes.u, planes.v};
+    for (int32_t c = 0; c < 2; c++)
+    {
+        for (int32_t y = 0; y < uv_height; y++, out += uv_width)
+        {
+            const uint8_t *row = chroma[c] + (size_t) y * planes.uv_stride;
+            if (planes.uv_pixel_stride == 1)
+            {
+                memcpy(out, row, uv_width);
+                continue;
+            }
+            for (int32_t x = 0; x < uv_width; x++)
+            {
+                out[x] = row[x * planes.uv_pixel_stride];
+            }
+        }
+    }
+}
+
+bool Capture_Writer::Submit(AImage *image, const std::string &path, int32_t max_images)
+{
+    if (image == nullptr)
+    {
+        return false;
+    }
+
+    // the queue slot and the held image are taken in one go, so concurrent
+    // submits can neither overfill the queue nor hold the reader's last slot
+    bool hold = false;
+    std::unique_ptr<Capture_Frame> frame;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_queue.size() + m_reserved >= m_max_queue)
+        {
+            m_refused++;
+            LOGE("Capture_Writer: %zu captures queued, dropping %s",
+                 m_queue.size() + m_reserved, path.c_str());
+            AImage_delete(image);
+            return false;
+        }
+        m_reserved++;
+        // one slot always stays free for the camera
+        hold = m_held_images + 1 < max_images;
+        if (hold)
+        {
+            m_held_images++;
+        }
+        frame = TakeFrame();
+    }
+
+    frame->queued_ms = NowMs();
+    frame->path = path;
+    frame->image = nullptr;
+    AImage_getFormat(image, &frame->format);
+    AImage_getWidth(image, &frame->width);
+    AImage_getHeight(image, &frame->height);
+
+    bool copied = true;
+    if (hold)
+    {
+        frame->image = image;
+    }
+    else if (frame->format == AIMAGE_FORMAT_JPEG)
+    {
+        uint8_t *data = nullptr;
+        int32_t length = 0;
+        copied = AImage_getPlaneData(image, 0, &data, &length) == AMEDIA_OK &&
+                 data != nullptr && length > 0;
+        if (copied)
+        {
+            frame->data.assign(data, data + length);
+        }
+        AImage_delete(image);
+    }
+    else
+    {
+        Yuv_Planes planes;
+        copied = GetYuvPlanes(image, &planes);
+        if (copied)
+        {
+            CopyPlanes(planes, frame->data);
+        }
+        AImage_delete(image);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_reserved--;
+        if (!copied)
+        {
+            LOGE("Capture_Writer: cannot copy the capture for %s", path.c_str());
+            m_refused++;
+            m_pool.push_back(std::move(frame));
+            m_idle.notify_all();
+            return false;
+        }
+        m_queue.push_back(std::move(frame));
+    }
+    m_work.notify_one();
+    return true;
+}
+
+void Capture_Writer::Flush()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this]()
+    {
+        return m_queue.empty() && m_busy == 0 && m_reserved == 0;
+    });
+}
+
+void Capture_Writer::Run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        m_work.wait(lock, [this]()
+        {
+            return m_stop || !m_queue.empty();
+        });
+        if (m_queue.empty())
+        {
+            return;
+        }
+        std::unique_ptr<Capture_Frame> frame = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_busy++;
+        lock.unlock();
+
+        double begin = NowMs();
+        bool written = Write(*frame);
+        double end = NowMs();
+        bool held = frame->image != nullptr;
+        if (held)
+        {
+            AImage_delete(frame->image);
+            frame->image = nullptr;
+        }
+
+        lock.lock();
+        if (held)
+        {
+            m_held_images--;
+        }
+        if (written)
+        {
+            m_written++;
+            m_total_write_ms += end - begin;
+            m_total_latency_ms += end - frame->queued_ms;
+        }
+        m_busy--;
+        m_pool.push_back(std::move(frame));
+        m_idle.notify_all();
+    }
+}
+
+bool Capture_Writer::Write(Capture_Frame &frame)
+{
+    if (frame.format == AIMAGE_FORMAT_JPEG)
+    {
+        const uint8_t *data = frame.data.data();
+        int32_t length = (int32_t) frame.data.size();
+        if (frame.image != nullptr)
+        {
+            uint8_t *plane = nullptr;
+            if (AImage_getPlaneData(frame.image, 0, &plane, &length) != AMEDIA_OK)
+            {
+                length = 0;
+            }
+            data = plane;
+        }
+        if (data == nullptr || length <= 0)
+        {
+            LOGE("Capture_Writer: no JPEG data for %s", frame.path.c_str());
+            return false;
+        }
+        std::string filename = frame.path + "jpg";
+        LOGI("Writing jpeg file to %s", filename.c_str());
+        FILE *file = fopen(filename.c_str(), "wb");
+        if (file == nullptr)
+        {
+            LOGE("Capture_Writer: cannot open %s", filename.c_str());
+            return false;
+        }
+        bool ok = fwrite(data, 1, (size_t) length, file) == (size_t) length;
+        return fclose(file) == 0 && ok;
+    }
+
+    Yuv_Planes planes;
+    if (frame.image != nullptr)
+    {
+        if (!GetYuvPlanes(frame.image, &planes))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        const int32_t uv_width = (frame.width + 1) / 2;
+        const int32_t uv_height = (frame.height + 1) / 2;
+        planes.y = frame.data.data();
+        planes.u = planes.y + (size_t) frame.width * frame.height;
+        planes.v = planes.u + (size_t) uv_width * uv_height;
+        planes.width = frame.width;
+        planes.height = frame.height;
+        planes.y_stride = frame.width;
+        planes.uv_stride = uv_width;
+        planes.uv_pixel_stride = 1;
+        planes.timestamp = 0;
+    }
+    // previews first, the gallery can show them while the capture encodes
+    double begin = NowMs();
+    Thumbnail_Pyramid thumbnails;
+    thumbnails.Build(planes, &m_encode_pool);
+    double built = NowMs();
+    if (thumbnails.Write(frame.path, &m_encode_pool))
+    {
+        LOGI("Thumbnails of %s: %.2f ms downsampling, %.2f ms encoding", frame.path.c_str(),
+             built - begin, NowMs() - built);
+    }
+
+    Capture_Encoding encoding = m_encoding;
+    if (encoding != CAPTURE_BENCHMARK)
+    {
+        return Encode(planes, frame.path, encoding, false);
+    }
+    bool ok = true;
+    for (int32_t e = 0; e < CAPTURE_BENCHMARK; e++)
+    {
+        ok = Encode(planes, frame.path, (Capture_Encoding) e, true) && ok;
+    }
+    return ok;
+}
+
+bool Capture_Writer::Encode(const Yuv_Planes &planes, const std::string &path,
+                            Capture_Encoding encoding, bool benchmark)
+{
+    static const char *EXTENSIONS[CAPTURE_BENCHMARK] = {"bmp", "png", "jpg"};
+    std::string filename = path + EXTENSIONS[encoding];
+    LOGI("Writing %s file to %s", EXTENSIONS[encoding], filename.c_str());
+
+    double begin = NowMs();
+    bool ok = false;
+    switch (encoding)
+    {
+        case CAPTURE_BMP:
+            ok = WriteBmp(planes, filename);
+            break;
+        case CAPTURE_PNG:
+            ok = WritePng(planes, filename, &m_encode_pool);
+            break;
+        case CAPTURE_JPEG:
+            ok = WriteJpeg(planes, filename, &m_encode_pool, m_jpeg_quality);
+            break;
+        default:
+            break;
+    }
+    if (!ok || !benchmark)
+    {
+        return ok;
+    }
+
+    double ms = NowMs() - begin;
+    struct stat info;
+    int64_t bytes = stat(filename.c_str(), &info) == 0 ? (int64_t) info.st_size : 0;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_bench_frames[encoding]++;
+    m_bench_ms[encoding] += ms;
+    m_bench_bytes[encoding] += bytes;
+    int64_t frames = m_bench_frames[encoding];
+    LOGI("Capture benchmark %s over %lld frames: %.1f ms, %lld bytes per frame",
+         EXTENSIONS[encoding], (long long) frames, m_bench_ms[encoding] / frames,
+         (long long) (m_bench_bytes[encoding] / frames));
+    return true;
+}
+
+size_t Capture_Writer::GetQueueDepth() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_queue.size() + m_busy;
+}
+
+double Capture_Writer::GetMeanLatency() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_written > 0 ? m_total_latency_ms / m_written : 0.0;
+}
+
+double Capture_Writer::GetMeanWriteTime() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_written > 0 ? m_total_write_ms / m_written : 0.0;
+}
+
+int64_t Capture_Writer::GetWritten() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_written;
+}
+
+int64_t Capture_Writer::GetRefused() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_refused;
+}
+
+bool WriteBmp(const Yuv_Planes &planes, const std::string &filename)
+{
+    FILE *file = fopen(filename.c_str(), "wb");
+    if (file == nullptr)
+    {
+        LOGE("WriteBmp: cannot open %s", filename.c_str());
+        return false;
+    }
+
+    const int32_t width = planes.width;
+    const int32_t height = planes.height;
+    const uint32_t filesize = 54 + (uint32_t) width * height * 4;
+    uint8_t header[54] = {'B', 'M', 0, 0, 0, 0, 0, 0, 0, 0, 54, 0, 0, 0,
+                          40, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 32, 0};
+    for (int32_t i = 0; i < 4; i++)
+    {
+        header[2 + i] = (uint8_t) (filesize >> (8 * i));
+        header[18 + i] = (uint8_t) ((uint32_t) width >> (8 * i));
+        header[22 + i] = (uint8_t) ((uint32_t) height >> (8 * i));
+    }
+    bool ok = fwrite(header, 1, sizeof(header), file) == sizeof(header);
+
+    // rows go bottom up, blue, green, red and alpha per pixel
+    std::vector<uint8_t> rgb((size_t) width * 3);
+    std::vector<uint8_t> row((size_t) width * 4);
+    for (int32_t y = height - 1; y >= 0 && ok; y--)
+    {
+        YuvRowToRgb(planes, y, rgb.data());
+        const uint8_t *in = rgb.data();
+        uint8_t *out = row.data();
+        for (int32_t x = 0; x < width; x++, in += 3, out += 4)
+        {
+            out[0] = in[2];
+            out[1] = in[1];
+            out[2] = in[0];
+            out[3] = 0xff;
+        }
+        ok = fwrite(row.data(), 1, row.size(), file) == row.size();
+    }
+    return fclose(file) == 0 && ok;
+}
@@ -0,0 +1,129 @@
+#ifndef OPENCV_NDK_CAPTURE_WRITER_H
+#define OPENCV_NDK_CAPTURE_WRITER_H
+
+// Android
+#include <media/NdkImage.h>
+// OpenCV-NDK App
+#include "Util.h"
+#include "Worker_Pool.h"
+// STD Libs
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// How YUV captures are stored, JPEG captures are always written as they are.
+// YUV captures also get Thumbnail_Pyramid previews next to them.
+// CAPTURE_BENCHMARK writes every one in each format and logs how they fare.
+enum Capture_Encoding
+{
+    CAPTURE_BMP,
+    CAPTURE_PNG,
+    CAPTURE_JPEG,
+    CAPTURE_BENCHMARK
+};
+
+// One capture waiting to be written. Either the AImage itself is held, while
+// the reader has slots to spare, or its planes were copied into a pooled
+// buffer and the image went straight back to the camera.
+struct Capture_Frame
+{
+    int32_t format = 0;
+    int32_t width = 0;
+    int32_t height = 0;
+    // file name without the extension
+    std::string path;
+    AImage *image = nullptr;
+    // JPEG bytes, or the Y, U and V planes back to back
+    std::vector<uint8_t> data;
+    double queued_ms = 0.0;
+};
+
+// Encodes and writes captures on its own threads so the AImageReader
+// callback only copies or hands over the image and returns. The queue is
+// bounded: when it is full new captures are refused instead of stalling the
+// camera, and the caller is told so.
+class Capture_Writer
+{
+public:
+    // threads: writer threads, max_queue: captures waiting at most
+    explicit Capture_Writer(int32_t threads = 2, size_t max_queue = 4);
+    ~Capture_Writer();
+    Capture_Writer(const Capture_Writer &other) = delete;
+    Capture_Writer &operator=(const Capture_Writer &other) = delete;
+
+    // Takes over image, JPEG or YUV_420_888, and queues it as path plus the
+    // format's extension. max_images is the reader's slot count, the image
+    // is only held while another slot stays free for the camera. False when
+    // the capture was refused, the image is deleted either way.
+    bool Submit(AImage *image, const std::string &path, int32_t max_images);
+
+    // Applies to captures written from now on, PNG unless changed
+    void SetEncoding(Capture_Encoding encoding)
+    { m_encoding = encoding; }
+
+    // libjpeg scale of 1 to 100 for CAPTURE_JPEG
+    void SetJpegQuality(int32_t quality)
+    { m_jpeg_quality = quality; }
+
+    // Blocks until every queued capture is written, needed before the
+    // reader that owns held images is deleted
+    void Flush();
+
+    size_t GetQueueDepth() const;
+    // Mean time from Submit() until the file was closed, and the encode
+    // and write part of it, in ms
+    double GetMeanLatency() const;
+    double GetMeanWriteTime() const;
+    int64_t GetWritten() const;
+    int64_t GetRefused() const;
+
+private:
+    void Run();
+    bool Write(Capture_Frame &frame);
+    // Writes planes as path plus the encoding's extension and, when
+    // benchmarking, adds the time and file size to its totals
+    bool Encode(const Yuv_Planes &planes, const std::string &path, Capture_Encoding encoding,
+                bool benchmark);
+    // Empty frame from the pool, or a new one while the pool is empty.
+    // Called with m_mutex held.
+    std::unique_ptr<Capture_Frame> TakeFrame();
+
+    const size_t m_max_queue;
+    std::atomic<Capture_Encoding> m_encoding;
+    std::atomic<int32_t> m_jpeg_quality;
+    // stripes of one PNG are compressed side by side
+    Worker_Pool m_encode_pool;
+    std::vector<std::thread> m_threads;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_work;
+    std::condition_variable m_idle;
+    std::deque<std::unique_ptr<Capture_Frame> > m_queue;
+    std::vector<std::unique_ptr<Capture_Frame> > m_pool;
+    int32_t m_busy = 0;
+    // queue slots taken by Submit() calls still copying their image
+    size_t m_reserved = 0;
+    int32_t m_held_images = 0;
+    bool m_stop = false;
+
+    int64_t m_written = 0;
+    int64_t m_refused = 0;
+    double m_total_latency_ms = 0.0;
+    double m_total_write_ms = 0.0;
+
+    // per encoding in CAPTURE_BENCHMARK: frames, ms and bytes
+    int64_t m_bench_frames[CAPTURE_BENCHMARK] = {};
+    double m_bench_ms[CAPTURE_BENCHMARK] = {};
+    int64_t m_bench_bytes[CAPTURE_BENCHMARK] = {};
+};
+
+// Writes a YUV frame as a bottom up 32 bit BMP, the uncompressed reference
+bool WriteBmp(const Yuv_Planes &planes, const std::string &filename);
+
+#endif  // OPENCV_NDK_CAPTURE_WRITER_H
@@ -0,0 +1,444 @@
+#include "Cascade_Binary.h"
+#include "Cascade_Evaluator.h"
+#include "Util.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// "OCVC" read as a little endian word
+static const uint32_t CASCADE_MAGIC = 0x4356434f;
+// bump whenever a record, the header or a conversion changes
+static const uint32_t CASCADE_VERSION = 2;
+static const uint32_t SECTION_ALIGNMENT = 16;
+static const int32_t ROTATIONS = 4;
+
+enum Section
+{
+    SECTION_STAGES,
+    SECTION_WEAKS,
+    SECTION_NODES,
+    SECTION_LEAVES,
+    SECTION_FEATURES,
+    SECTION_STUMP_FEATURE,
+    SECTION_STUMP_THRESHOLD,
+    SECTION_STUMP_LEFT,
+    SECTION_STUMP_RIGHT,
+    SECTION_LBP_FEATURES,
+    SECTION_SUBSETS,
+    SECTION_COUNT
+};
+
+static const uint32_t RECORD_SIZE[SECTION_COUNT] = {
+        sizeof(Cascade_Stage), sizeof(Cascade_Weak), sizeof(Cascade_Node), sizeof(float),
+        sizeof(Cascade_Haar_Feature), sizeof(int32_t), sizeof(float), sizeof(float),
+        sizeof(float), sizeof(Lbp_Feature), sizeof(int32_t)};
+
+// offset from the start of the file and number of records
+struct File_Section
+{
+    uint32_t offset;
+    uint32_t count;
+};
+
+struct File_Model
+{
+    int32_t angle;
+    int32_t type;
+    int32_t width;
+    int32_t height;
+    File_Section sections[SECTION_COUNT];
+};
+
+struct File_Header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t model_count;
+    File_Model models[ROTATIONS];
+};
+
+// Whether the evaluator's integral lookups for the rectangle stay inside a
+// width x height window, whose integrals are one larger each way
+static bool RectInWindow(const Haar_Rect &r, bool tilted, int32_t width, int32_t height)
+{
+    // 64 bit so corrupt coordinates cannot overflow into range
+    const int64_t x = r.x, y = r.y, w = r.width, h = r.height;
+    if (w <= 0 || h <= 0)
+    {
+        return false;
+    }
+    // a tilted rectangle reaches h left and w right of its top corner and
+    // w + h down
+    if (tilted)
+    {
+        return x - h >= 0 && y >= 0 && x + w <= width && y + w + h <= height;
+    }
+    return x >= 0 && y >= 0 && x + w <= width && y + h <= height;
+}
+
+// Points data into the file and checks every index and feature rectangle the
+// evaluator follows against the file and the window, so a truncated or
+// corrupt file cannot make it read outside the mapping or the integrals
+static bool Bind(const uint8_t *base, size_t size, const File_Model &model, Cascade_Data &data)
+{
+    const void *section[SECTION_COUNT];
+    int32_t count[SECTION_COUNT];
+    for (int32_t s = 0; s < SECTION_COUNT; s++)
+    {
+        const File_Section &fs = model.sections[s];
+        if (fs.offset % SECTION_ALIGNMENT != 0 || fs.offset > size ||
+            fs.count > (size - fs.offset) / RECORD_SIZE[s] || fs.count > INT32_MAX / 8)
+        {
+            return false;
+        }
+        section[s] = base + fs.offset;
+        count[s] = (int32_t) fs.count;
+    }
+
+    data = Cascade_Data();
+    data.type = model.type;
+    data.width = model.width;
+    data.height = model.height;
+    data.stages = (const Cascade_Stage *) section[SECTION_STAGES];
+    data.stage_count = count[SECTION_STAGES];
+    data.weaks = (const Cascade_Weak *) section[SECTION_WEAKS];
+    data.weak_count = count[SECTION_WEAKS];
+    data.nodes = (const Cascade_Node *) section[SECTION_NODES];
+    data.node_count = count[SECTION_NODES];
+    data.leaves = (const float *) section[SECTION_LEAVES];
+    data.leaf_count = count[SECTION_LEAVES];
+    data.features = (const Cascade_Haar_Feature *) section[SECTION_FEATURES];
+    data.feature_count = count[SECTION_FEATURES];
+    data.stump_feature = (const int32_t *) section[SECTION_STUMP_FEATURE];
+    data.stump_threshold = (const float *) section[SECTION_STUMP_THRESHOLD];
+    data.stump_left = (const float *) section[SECTION_STUMP_LEFT];
+    data.stump_right = (const float *) section[SECTION_STUMP_RIGHT];
+    data.lbp_features = (const Lbp_Feature *) section[SECTION_LBP_FEATURES];
+    data.lbp_feature_count = count[SECTION_LBP_FEATURES];
+    data.subsets = (const int32_t *) section[SECTION_SUBSETS];
+
+    if ((data.type != HAAR_CASCADE && data.type != LBP_CASCADE) || data.width < 3 ||
+        data.height < 3 || data.stage_count == 0)
+    {
+        return false;
+    }
+    bool lbp = data.type == LBP_CASCADE;
+    if (lbp ? count[SECTION_SUBSETS] != 8 * data.node_count : count[SECTION_SUBSETS] != 0)
+    {
+        return false;
+    }
+
+    for (int32_t s = 0; s < data.stage_count; s++)
+    {
+        const Cascade_Stage &stage = data.stages[s];
+        if (stage.weak_offset < 0 || stage.weak_count < 0 ||
+            stage.weak_offset > data.weak_count - stage.weak_count)
+        {
+            return false;
+        }
+    }
+
+    // the nodes of a weak classifier run up to the next one's, children
+    // only point forward so every walk ends in a leaf
+    const int32_t features = lbp ? data.lbp_feature_count : data.feature_count;
+    for (int32_t w = 0; w < data.weak_count; w++)
+    {
+        const Cascade_Weak &weak = data.weaks[w];
+        int32_t end = w + 1 < data.weak_count ? data.weaks[w + 1].node_offset : data.node_count;
+        if (weak.node_offset < 0 || weak.node_offset >= end || end > data.node_count ||
+            weak.leaf_offset < 0 || weak.leaf_offset >= data.leaf_count)
+        {
+            return false;
+        }
+        for (int32_t i = 0; i < end - weak.node_offset; i++)
+        {
+            const Cascade_Node &node = data.nodes[weak.node_offset + i];
+            const int32_t children[2] = {node.left, node.right};
+            for (int32_t c = 0; c < 2; c++)
+            {
+                if (children[c] > 0 ? children[c] <= i || children[c] >= end - weak.node_offset :
+                    children[c] < weak.leaf_offset - data.leaf_count + 1)
+                {
+                    return false;
+                }
+            }
+            if (node.feature < 0 || node.feature >= features)
+            {
+                return false;
+            }
+        }
+    }
+
+    for (int32_t f = 0; f < data.feature_count; f++)
+    {
+        const Cascade_Haar_Feature &feature = data.features[f];
+        if (feature.rect_count < 1 || feature.rect_count > 3)
+        {
+            return false;
+        }
+        for (int32_t r = 0; r < feature.rect_count; r++)
+        {
+            if (!RectInWindow(feature.rects[r], feature.tilted != 0, data.width, data.height))
+            {
+                return false;
+            }
+        }
+        data.tilted = data.tilted || feature.tilted;
+    }
+
+    // the 3x3 blocks of an LBP feature span three times its block size
+    for (int32_t f = 0; f < data.lbp_feature_count; f++)
+    {
+        const Lbp_Feature &feature = data.lbp_features[f];
+        if (feature.x < 0 || feature.y < 0 || feature.width <= 0 || feature.height <= 0 ||
+            feature.width > data.width / 3 || feature.height > data.height / 3 ||
+            feature.x > data.width - 3 * feature.width ||
+            feature.y > data.height - 3 * feature.height)
+        {
+            return false;
+        }
+    }
+
+    data.stumps = count[SECTION_STUMP_FEATURE] > 0;
+    for (int32_t s = SECTION_STUMP_FEATURE; s <= SECTION_STUMP_RIGHT; s++)
+    {
+        if (count[s] != (data.stumps ? data.weak_count : 0))
+        {
+            return false;
+        }
+    }
+    for (int32_t w = 0; data.stumps && w < data.weak_count; w++)
+    {
+        if (data.stump_feature[w] < 0 || data.stump_feature[w] >= features)
+        {
+            return false;
+        }
+    }
+
+    // same limit Cascade_Evaluator::Load() puts on XML cascades
+    return lbp || (int64_t) (data.width - 2) * (data.height - 2) * 255 * 255 <= 0xffffffffLL;
+}
+
+Cascade_Binary::~Cascade_Binary()
+{
+    Unmap();
+}
+
+void Cascade_Binary::Unmap()
+{
+    if (m_map != nullptr)
+    {
+        munmap(m_map, m_map_size);
+        m_map = nullptr;
+        m_map_size = 0;
+    }
+#ifdef __ANDROID__
+    m_asset.Close();
+#endif
+    m_data = nullptr;
+    m_size = 0;
+}
+
+bool Cascade_Binary::Map(const std::string &filename)
+{
+    Unmap();
+
+    int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(File_Header))
+    {
+        LOGE("Cascade_Binary: %s is too small", filename.c_str());
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // the mapping stays valid without the descriptor
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        LOGE("Cascade_Binary: cannot map %s", filename.c_str());
+        return false;
+    }
+    m_map = map;
+    m_map_size = (size_t) st.st_size;
+    return Attach((const uint8_t *) m_map, m_map_size, filename);
+}
+
+#ifdef __ANDROID__
+bool Cascade_Binary::Open(AAssetManager *manager, const std::string &name)
+{
+    Unmap();
+    if (!m_asset.Open(manager, name))
+    {
+        return false;
+    }
+    if (!m_asset.IsMapped())
+    {
+        LOGI("Cascade_Binary: %s is compressed, add it to noCompress", name.c_str());
+    }
+    return Attach(m_asset.GetData(), m_asset.GetSize(), name);
+}
+#endif
+
+bool Cascade_Binary::Attach(const uint8_t *data, size_t size, const std::string &name)
+{
+    // assets are only 4 byte aligned inside the APK, which the records need
+    if (size < sizeof(File_Header) || (uintptr_t) data % sizeof(int32_t) != 0)
+    {
+        LOGE("Cascade_Binary: %s is too small or misaligned", name.c_str());
+        Unmap();
+        return false;
+    }
+
+    const File_Header *header = (const File_Header *) data;
+    if (header->magic != CASCADE_MAGIC || header->version != CASCADE_VERSION)
+    {
+        LOGE("Cascade_Binary: %s is not a version %u cascade", name.c_str(), CASCADE_VERSION);
+        Unmap();
+        return false;
+    }
+
+    Cascade_Data model;
+    bool valid = header->size == size && header->model_count == ROTATIONS;
+    for (int32_t r = 0; valid && r < ROTATIONS; r++)
+    {
+        const File_Model &file_model = header->models[r];
+        valid = Bind(data, size, file_model, model) &&
+                (file_model.angle == 90 * r || (file_model.angle == 0 && model.tilted));
+    }
+    if (!valid)
+    {
+        LOGE("Cascade_Binary: %s is corrupt", name.c_str());
+        Unmap();
+        return false;
+    }
+    m_data = data;
+    m_size = size;
+    return true;
+}
+
+bool Cascade_Binary::Get(int32_t angle, Cascade_Data &data) const
+{
+    if (m_data == nullptr || angle % 90 != 0)
+    {
+        return false;
+    }
+    // Bind() repeats the checks Attach() made, microseconds once per rotation
+    const File_Header *header = (const File_Header *) m_data;
+    return Bind(m_data, m_size, header->models[(angle / 90) % ROTATIONS], data);
+}
+
+// Appends a 16 byte aligned section and records where it went
+static void AppendSection(std::vector<uint8_t> &file, File_Section &section, const void *records,
+                          int32_t count, uint32_t record_size)
+{
+    file.resize((file.size() + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT, 0);
+    section.offset = (uint32_t) file.size();
+    section.count = (uint32_t) count;
+    const uint8_t *bytes = (const uint8_t *) records;
+    file.insert(file.end(), bytes, bytes + (size_t) count * record_size);
+}
+
+static bool WriteFile(const std::string &filename, const Cascade_Evaluator *evaluators,
+                      const int32_t *angles)
+{
+    File_Header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = CASCADE_MAGIC;
+    header.version = CASCADE_VERSION;
+    header.model_count = ROTATIONS;
+
+    std::vector<uint8_t> file(sizeof(header), 0);
+    for (int32_t r = 0; r < ROTATIONS; r++)
+    {
+        const Cascade_Data &data = evaluators[r].GetData();
+        File_Model &model = header.models[r];
+        model.angle = angles[r];
+        model.type = data.type;
+        model.width = data.width;
+        model.height = data.height;
+
+        bool lbp = data.type == LBP_CASCADE;
+        int32_t stumps = data.stumps ? data.weak_count : 0;
+        const void *records[SECTION_COUNT] = {
+                data.stages, data.weaks, data.nodes, data.leaves, data.features,
+                data.stump_feature, data.stump_threshold, data.stump_left, data.stump_right,
+                data.lbp_features, data.subsets};
+        const int32_t counts[SECTION_COUNT] = {
+                data.stage_count, data.weak_count, data.node_count, data.leaf_count,
+                data.feature_count, stumps, stumps, stumps, stumps,
+                data.lbp_feature_count, lbp ? 8 * data.node_count : 0};
+        for (int32_t s = 0; s < SECTION_COUNT; s++)
+        {
+            AppendSection(file, model.sections[s], records[s], counts[s], RECORD_SIZE[s]);
+        }
+    }
+    header.size = (uint32_t) file.size();
+    memcpy(file.data(), &header, sizeof(header));
+
+    FILE *out = fopen(filename.c_str(), "wb");
+    if (out == nullptr)
+    {
+        LOGE("Cascade_Binary: cannot create %s", filename.c_str());
+        return false;
+    }
+    bool written = fwrite(file.data(), 1, file.size(), out) == file.size();
+    written = fclose(out) == 0 && written;
+    if (!written)
+    {
+        LOGE("Cascade_Binary: cannot write %s", filename.c_str());
+    }
+    return written;
+}
+
+bool Cascade_Binary::Write(const std::string &filename, const Haar_Cascade &cascade)
+{
+    // tilted features only stay exact upright, see Haar_Cascade::Rotated()
+    const bool tilted = cascade.HasTilted();
+    Cascade_Evaluator evaluators[ROTATIONS];
+    int32_t angles[ROTATIONS];
+    for (int32_t r = 0; r < ROTATIONS; r++)
+    {
+        angles[r] = tilted ? 0 : 90 * r;
+        if (!evaluators[r].Load(cascade.Rotated(angles[r])))
+        {
+            return false;
+        }
+    }
+    return WriteFile(filename, evaluators, angles);
+}
+
+bool Cascade_Binary::Write(const std::string &filename, const Lbp_Cascade &cascade)
+{
+    Cascade_Evaluator evaluators[ROTATIONS];
+    int32_t angles[ROTATIONS];
+    for (int32_t r = 0; r < ROTATIONS; r++)
+    {
+        angles[r] = 90 * r;
+        if (!evaluators[r].Load(cascade.Rotated(angles[r])))
+        {
+            return false;
+        }
+    }
+    return WriteFile(filename, evaluators, angles);
+}
+
+std::string Cascade_Binary::BinaryName(const std::string &xml)
+{
+    const std::string extension = ".xml";
+    if (xml.size() > extension.size() &&
+        xml.compare(xml.size() - extension.size(), extension.size(), extension) == 0)
+    {
+        return xml.substr(0, xml.size() - extension.size()) + ".cascade";
+    }
+    return xml + ".cascade";
+}
@@ -0,0 +1,136 @@
+#ifndef OPENCV_NDK_CASCADE_BINARY_H
+#define OPENCV_NDK_CASCADE_BINARY_H
+
+// OpenCV-NDK App
+#ifdef __ANDROID__
+#include "Asset_File.h"
+#endif
+#include "Haar_Cascade.h"
+#include "Lbp_Cascade.h"
+// STD Libs
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Records of the flattened cascade. Cascade_Evaluator walks them directly,
+// both from its own storage and from a mapped file, so they only hold 32 bit
+// fields and have the same layout on every ABI.
+enum Cascade_Type
+{
+    HAAR_CASCADE = 0,
+    LBP_CASCADE = 1
+};
+
+struct Cascade_Stage
+{
+    int32_t weak_offset;
+    int32_t weak_count;
+    float threshold;
+};
+
+struct Cascade_Weak
+{
+    int32_t node_offset;
+    int32_t leaf_offset;
+};
+
+// LBP nodes leave threshold unused and own 8 subset words instead
+struct Cascade_Node
+{
+    int32_t feature;
+    float threshold;
+    int32_t left, right;
+};
+
+struct Cascade_Haar_Feature
+{
+    Haar_Rect rects[3];
+    int32_t rect_count;
+    int32_t tilted;
+};
+
+static_assert(sizeof(Cascade_Stage) == 12, "Cascade_Stage layout");
+static_assert(sizeof(Cascade_Weak) == 8, "Cascade_Weak layout");
+static_assert(sizeof(Cascade_Node) == 16, "Cascade_Node layout");
+static_assert(sizeof(Cascade_Haar_Feature) == 68, "Cascade_Haar_Feature layout");
+static_assert(sizeof(Lbp_Feature) == 16, "Lbp_Feature layout");
+
+// One cascade as arrays, owned by somebody else. Stump cascades also have
+// the parallel stump_* arrays indexed by weak classifier.
+struct Cascade_Data
+{
+    int32_t type = HAAR_CASCADE;
+    int32_t width = 0;
+    int32_t height = 0;
+    bool stumps = false;
+    bool tilted = false;
+    const Cascade_Stage *stages = nullptr;
+    int32_t stage_count = 0;
+    const Cascade_Weak *weaks = nullptr;
+    int32_t weak_count = 0;
+    const Cascade_Node *nodes = nullptr;
+    int32_t node_count = 0;
+    const float *leaves = nullptr;
+    int32_t leaf_count = 0;
+    const Cascade_Haar_Feature *features = nullptr;
+    int32_t feature_count = 0;
+    const int32_t *stump_feature = nullptr;
+    const float *stump_threshold = nullptr;
+    const float *stump_left = nullptr;
+    const float *stump_right = nullptr;
+    const Lbp_Feature *lbp_features = nullptr;
+    int32_t lbp_feature_count = 0;
+    const int32_t *subsets = nullptr;  // 8 per node
+};
+
+// Precompiled cascade file. It holds the flattened cascade for each of the
+// four sensor rotations, so switching orientation is free, behind a small
+// versioned header. Every section starts 16 byte aligned and the records are
+// little endian, like every Android ABI, so a mapping of the file is used in
+// place: loading is one mmap plus a bounds check, nothing is parsed or
+// copied, and the read only pages are shared by every process mapping it.
+class Cascade_Binary
+{
+public:
+    Cascade_Binary() = default;
+    ~Cascade_Binary();
+    Cascade_Binary(const Cascade_Binary &) = delete;
+    Cascade_Binary &operator=(const Cascade_Binary &) = delete;
+
+    // Maps and validates a file written by Write(). A missing file fails
+    // quietly so callers can fall back to the XML.
+    bool Map(const std::string &filename);
+#ifdef __ANDROID__
+    // Same for an APK asset, used in place when stored uncompressed
+    bool Open(AAssetManager *manager, const std::string &name);
+#endif
+
+    // The cascade rotated by angle (0, 90, 180 or 270), pointing into the
+    // mapping. False when nothing is mapped. Cascades with tilted features
+    // are stored upright for every angle, see Haar_Cascade::Rotated().
+    bool Get(int32_t angle, Cascade_Data &data) const;
+
+    // Converts a parsed cascade, see Cascade_Convert.cpp
+    static bool Write(const std::string &filename, const Haar_Cascade &cascade);
+    static bool Write(const std::string &filename, const Lbp_Cascade &cascade);
+
+    // Where the precompiled version of a cascade XML is looked for
+    static std::string BinaryName(const std::string &xml);
+
+private:
+    // Validates data and keeps it as the cascade
+    bool Attach(const uint8_t *data, size_t size, const std::string &name);
+    void Unmap();
+
+    // backing store, either a mapped file or an asset
+    void *m_map = nullptr;
+    size_t m_map_size = 0;
+#ifdef __ANDROID__
+    Asset_File m_asset;
+#endif
+
+    const uint8_t *m_data = nullptr;
+    size_t m_size = 0;
+};
+
+#endif  // OPENCV_NDK_CASCADE_BINARY_H
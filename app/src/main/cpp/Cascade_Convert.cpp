@@ -0,0 +1,66 @@
+// Precompiles OpenCV cascade XML files into the format Cascade_Binary maps.
+// Built as a separate executable next to the app library, run it on the
+// device or on the bundled cascades before copying them over:
+//
+//   cascade_convert haarcascade_frontalface_alt.xml [out.cascade]
+//
+// Without an output name the file goes next to the XML, which is where
+// CV_Main looks for it. The bundled cascades are converted by a host build of
+// this tool while building the APK, see app/src/test/cpp/Makefile.
+
+// OpenCV
+#include <opencv2/core.hpp>
+// OpenCV-NDK App
+#include "Cascade_Binary.h"
+#include "Haar_Cascade.h"
+#include "Lbp_Cascade.h"
+// STD Libs
+#include <cstdio>
+#include <string>
+
+int main(int argc, char **argv)
+{
+    if (argc < 2 || argc > 3)
+    {
+        fprintf(stderr, "usage: %s cascade.xml [out.cascade]\n", argv[0]);
+        return 2;
+    }
+
+    std::string input = argv[1];
+    std::string output = argc == 3 ? argv[2] : Cascade_Binary::BinaryName(input);
+
+    cv::FileStorage fs(input, cv::FileStorage::READ);
+    if (!fs.isOpened())
+    {
+        fprintf(stderr, "cannot open %s\n", input.c_str());
+        return 1;
+    }
+
+    cv::FileNode root = fs.getFirstTopLevelNode();
+    bool written = false;
+    if ((std::string) root["featureType"] == "LBP")
+    {
+        Lbp_Cascade cascade;
+        written = cascade.Read(root) && Cascade_Binary::Write(output, cascade);
+    }
+    else
+    {
+        Haar_Cascade cascade;
+        written = cascade.Read(root) && Cascade_Binary::Write(output, cascade);
+    }
+    if (!written)
+    {
+        fprintf(stderr, "cannot convert %s\n", input.c_str());
+        return 1;
+    }
+
+    // read it back the way the app will
+    Cascade_Binary binary;
+    if (!binary.Map(output))
+    {
+        fprintf(stderr, "%s does not map back\n", output.c_str());
+        return 1;
+    }
+    printf("%s -> %s\n", input.c_str(), output.c_str());
+    return 0;
+}
@@ -0,0 +1,595 @@
+#include "Cascade_Evaluator.h"
+#include "Simd.h"
+#include "Util.h"
+#include <opencv2/objdetect.hpp>
+#include <algorithm>
+#include <cmath>
+
+Cascade_Evaluator::Cascade_Evaluator(const Cascade_Evaluator &other)
+{
+    *this = other;
+}
+
+Cascade_Evaluator &Cascade_Evaluator::operator=(const Cascade_Evaluator &other)
+{
+    m_storage = other.m_storage;
+    m_binary = other.m_binary;
+    m_data = other.m_data;
+    if (!m_binary)
+    {
+        Bind();
+    }
+    return *this;
+}
+
+void Cascade_Evaluator::Clear()
+{
+    m_storage = Storage();
+    m_binary.reset();
+    m_data = Cascade_Data();
+}
+
+void Cascade_Evaluator::Bind()
+{
+    m_data.stages = m_storage.stages.data();
+    m_data.stage_count = (int32_t) m_storage.stages.size();
+    m_data.weaks = m_storage.weaks.data();
+    m_data.weak_count = (int32_t) m_storage.weaks.size();
+    m_data.nodes = m_storage.nodes.data();
+    m_data.node_count = (int32_t) m_storage.nodes.size();
+    m_data.leaves = m_storage.leaves.data();
+    m_data.leaf_count = (int32_t) m_storage.leaves.size();
+    m_data.features = m_storage.features.data();
+    m_data.feature_count = (int32_t) m_storage.features.size();
+    m_data.stump_feature = m_storage.stump_feature.data();
+    m_data.stump_threshold = m_storage.stump_threshold.data();
+    m_data.stump_left = m_storage.stump_left.data();
+    m_data.stump_right = m_storage.stump_right.data();
+    m_data.lbp_features = m_storage.lbp_features.data();
+    m_data.lbp_feature_count = (int32_t) m_storage.lbp_features.size();
+    m_data.subsets = m_storage.subsets.data();
+}
+
+bool Cascade_Evaluator::Load(const Haar_Cascade &cascade)
+{
+    Clear();
+    m_data.type = HAAR_CASCADE;
+    m_data.width = cascade.width;
+    m_data.height = cascade.height;
+
+    for (size_t f = 0; f < cascade.features.size(); f++)
+    {
+        const Haar_Feature &source = cascade.features[f];
+        Cascade_Haar_Feature feature;
+        for (int32_t r = 0; r < 3; r++)
+        {
+            feature.rects[r] = source.rects[r];
+        }
+        feature.rect_count = source.rect_count;
+        feature.tilted = source.tilted ? 1 : 0;
+        m_storage.features.push_back(feature);
+        m_data.tilted = m_data.tilted || source.tilted;
+    }
+
+    for (size_t s = 0; s < cascade.stages.size(); s++)
+    {
+        const Haar_Stage &source = cascade.stages[s];
+        Cascade_Stage stage;
+        stage.weak_offset = (int32_t) m_storage.weaks.size();
+        stage.weak_count = (int32_t) source.weaks.size();
+        stage.threshold = source.threshold;
+
+        for (size_t w = 0; w < source.weaks.size(); w++)
+        {
+            Cascade_Weak weak;
+            weak.node_offset = (int32_t) m_storage.nodes.size();
+            weak.leaf_offset = (int32_t) m_storage.leaves.size();
+            for (size_t n = 0; n < source.weaks[w].nodes.size(); n++)
+            {
+                const Haar_Node &haar = source.weaks[w].nodes[n];
+                Cascade_Node node = {haar.feature, haar.threshold, haar.left, haar.right};
+                m_storage.nodes.push_back(node);
+            }
+            m_storage.leaves.insert(m_storage.leaves.end(), source.weaks[w].leaves.begin(),
+                                    source.weaks[w].leaves.end());
+            m_storage.weaks.push_back(weak);
+        }
+        m_storage.stages.push_back(stage);
+    }
+
+    // the unsigned squared integral only stays exact up to this window size
+    if ((int64_t) (m_data.width - 2) * (m_data.height - 2) * 255 * 255 > 0xffffffffLL)
+    {
+        LOGE("Cascade_Evaluator: %dx%d window is too large", m_data.width, m_data.height);
+        Clear();
+        return false;
+    }
+
+    const std::vector<Cascade_Weak> &weaks = m_storage.weaks;
+    const std::vector<Cascade_Node> &nodes = m_storage.nodes;
+    m_data.stumps = !weaks.empty();
+    for (size_t w = 0; w < weaks.size() && m_data.stumps; w++)
+    {
+        int32_t count = (w + 1 < weaks.size() ? weaks[w + 1].node_offset :
+                         (int32_t) nodes.size()) - weaks[w].node_offset;
+        m_data.stumps = count == 1;
+    }
+    for (size_t w = 0; w < weaks.size() && m_data.stumps; w++)
+    {
+        const Cascade_Node &node = nodes[weaks[w].node_offset];
+        m_storage.stump_feature.push_back(node.feature);
+        m_storage.stump_threshold.push_back(node.threshold);
+        m_storage.stump_left.push_back(m_storage.leaves[weaks[w].leaf_offset - node.left]);
+        m_storage.stump_right.push_back(m_storage.leaves[weaks[w].leaf_offset - node.right]);
+    }
+
+    Bind();
+    return !Empty();
+}
+
+bool Cascade_Evaluator::Load(const Lbp_Cascade &cascade)
+{
+    Clear();
+    m_data.type = LBP_CASCADE;
+    m_data.width = cascade.width;
+    m_data.height = cascade.height;
+    m_storage.lbp_features = cascade.features;
+
+    for (size_t s = 0; s < cascade.stages.size(); s++)
+    {
+        const Lbp_Stage &source = cascade.stages[s];
+        Cascade_Stage stage;
+        stage.weak_offset = (int32_t) m_storage.weaks.size();
+        stage.weak_count = (int32_t) source.weaks.size();
+        stage.threshold = source.threshold;
+
+        for (size_t w = 0; w < source.weaks.size(); w++)
+        {
+            Cascade_Weak weak;
+            weak.node_offset = (int32_t) m_storage.nodes.size();
+            weak.leaf_offset = (int32_t) m_storage.leaves.size();
+            for (size_t n = 0; n < source.weaks[w].nodes.size(); n++)
+            {
+                const Lbp_Node &lbp = source.weaks[w].nodes[n];
+                Cascade_Node node = {lbp.feature, 0.0f, lbp.left, lbp.right};
+                m_storage.nodes.push_back(node);
+                m_storage.subsets.insert(m_storage.subsets.end(), lbp.subset, lbp.subset + 8);
+            }
+            m_storage.leaves.insert(m_storage.leaves.end(), source.weaks[w].leaves.begin(),
+                                    source.weaks[w].leaves.end());
+            m_storage.weaks.push_back(weak);
+        }
+        m_storage.stages.push_back(stage);
+    }
+
+    Bind();
+    return !Empty();
+}
+
+bool Cascade_Evaluator::Load(const std::shared_ptr<const Cascade_Binary> &binary, int32_t angle)
+{
+    Clear();
+    if (!binary || !binary->Get(angle, m_data))
+    {
+        m_data = Cascade_Data();
+        return false;
+    }
+    m_binary = binary;
+    return !Empty();
+}
+
+// Sum over a rectangle from its four integral offsets
+static inline int32_t RectSum(const int32_t *p, const int32_t *ofs)
+{
+    return p[ofs[0]] - p[ofs[1]] - p[ofs[2]] + p[ofs[3]];
+}
+
+#if defined(OPENCV_NDK_NEON)
+// Integral values for four windows step pixels apart
+static inline int32x4_t Load4(const int32_t *p, int32_t step)
+{
+    return step == 1 ? vld1q_s32(p) : vld2q_s32(p).val[0];
+}
+
+static inline float32x4_t RectSum4(const int32_t *p, const int32_t *ofs, int32_t step)
+{
+    int32x4_t sum = vsubq_s32(vaddq_s32(Load4(p + ofs[0], step), Load4(p + ofs[3], step)),
+                              vaddq_s32(Load4(p + ofs[1], step), Load4(p + ofs[2], step)));
+    return vcvtq_f32_s32(sum);
+}
+
+int32_t Cascade_Evaluator::EvaluateStumps4(const int32_t *sum, const int32_t *tilted,
+                                           int32_t step, const float *inv_norm,
+                                           const Feature_Offsets *offsets) const
+{
+    float32x4_t norm = vld1q_f32(inv_norm);
+    uint32x4_t alive = vdupq_n_u32(0xffffffff);
+
+    for (int32_t s = 0; s < m_data.stage_count; s++)
+    {
+        const Cascade_Stage &stage = m_data.stages[s];
+        float32x4_t stage_sum = vdupq_n_f32(0.0f);
+
+        int32_t end = stage.weak_offset + stage.weak_count;
+        for (int32_t w = stage.weak_offset; w < end; w++)
+        {
+            const Feature_Offsets &f = offsets[m_data.stump_feature[w]];
+            const int32_t *p = f.tilted ? tilted : sum;
+            float32x4_t value = vmulq_n_f32(RectSum4(p, f.ofs[0], step), f.weight[0]);
+            value = vaddq_f32(value, vmulq_n_f32(RectSum4(p, f.ofs[1], step), f.weight[1]));
+            if (f.weight[2] != 0.0f)
+            {
+                value = vaddq_f32(value, vmulq_n_f32(RectSum4(p, f.ofs[2], step), f.weight[2]));
+            }
+            uint32x4_t left = vcltq_f32(vmulq_f32(value, norm),
+                                        vdupq_n_f32(m_data.stump_threshold[w]));
+            stage_sum = vaddq_f32(stage_sum, vbslq_f32(left, vdupq_n_f32(m_data.stump_left[w]),
+                                                       vdupq_n_f32(m_data.stump_right[w])));
+        }
+
+        alive = vandq_u32(alive, vcgeq_f32(stage_sum, vdupq_n_f32(stage.threshold)));
+        uint32x2_t any = vorr_u32(vget_low_u32(alive), vget_high_u32(alive));
+        if ((vget_lane_u32(any, 0) | vget_lane_u32(any, 1)) == 0)
+        {
+            return 0;
+        }
+    }
+
+    return (vgetq_lane_u32(alive, 0) & 1) | (vgetq_lane_u32(alive, 1) & 2) |
+           (vgetq_lane_u32(alive, 2) & 4) | (vgetq_lane_u32(alive, 3) & 8);
+}
+#elif defined(OPENCV_NDK_SSE2)
+// Integral values for four windows step pixels apart
+static inline __m128i Load4(const int32_t *p, int32_t step)
+{
+    if (step == 1)
+    {
+        return _mm_loadu_si128((const __m128i *) p);
+    }
+    __m128 low = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *) p));
+    __m128 high = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *) (p + 4)));
+    return _mm_castps_si128(_mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+static inline __m128 RectSum4(const int32_t *p, const int32_t *ofs, int32_t step)
+{
+    __m128i sum = _mm_sub_epi32(_mm_add_epi32(Load4(p + ofs[0], step), Load4(p + ofs[3], step)),
+                                _mm_add_epi32(Load4(p + ofs[1], step), Load4(p + ofs[2], step)));
+    return _mm_cvtepi32_ps(sum);
+}
+
+int32_t Cascade_Evaluator::EvaluateStumps4(const int32_t *sum, const int32_t *tilted,
+                                           int32_t step, const float *inv_norm,
+                                           const Feature_Offsets *offsets) const
+{
+    __m128 norm = _mm_loadu_ps(inv_norm);
+    int32_t alive = 0xf;
+
+    for (int32_t s = 0; s < m_data.stage_count; s++)
+    {
+        const Cascade_Stage &stage = m_data.stages[s];
+        __m128 stage_sum = _mm_setzero_ps();
+
+        int32_t end = stage.weak_offset + stage.weak_count;
+        for (int32_t w = stage.weak_offset; w < end; w++)
+        {
+            const Feature_Offsets &f = offsets[m_data.stump_feature[w]];
+            const int32_t *p = f.tilted ? tilted : sum;
+            __m128 value = _mm_mul_ps(RectSum4(p, f.ofs[0], step), _mm_set1_ps(f.weight[0]));
+            value = _mm_add_ps(value, _mm_mul_ps(RectSum4(p, f.ofs[1], step),
+                                                 _mm_set1_ps(f.weight[1])));
+            if (f.weight[2] != 0.0f)
+            {
+                value = _mm_add_ps(value, _mm_mul_ps(RectSum4(p, f.ofs[2], step),
+                                                     _mm_set1_ps(f.weight[2])));
+            }
+            __m128 left = _mm_cmplt_ps(_mm_mul_ps(value, norm),
+                                       _mm_set1_ps(m_data.stump_threshold[w]));
+            stage_sum = _mm_add_ps(stage_sum, _mm_or_ps(
+                    _mm_and_ps(left, _mm_set1_ps(m_data.stump_left[w])),
+                    _mm_andnot_ps(left, _mm_set1_ps(m_data.stump_right[w]))));
+        }
+
+        alive &= _mm_movemask_ps(_mm_cmpge_ps(stage_sum, _mm_set1_ps(stage.threshold)));
+        if (alive == 0)
+        {
+            return 0;
+        }
+    }
+    return alive;
+}
+#endif
+
+// One over the standard deviation of the window, OpenCV's normrect is the
+// window shrunk by one pixel. The variance is exact in 64 bit integers.
+static inline float InverseNorm(const int32_t *ps, const uint32_t *pq, const int32_t *norm_sum,
+                                const int32_t *norm_sq, int32_t norm_area)
+{
+    int64_t value_sum = RectSum(ps, norm_sum);
+    uint32_t value_sq = pq[norm_sq[0]] - pq[norm_sq[1]] - pq[norm_sq[2]] + pq[norm_sq[3]];
+    int64_t variance = (int64_t) norm_area * value_sq - value_sum * value_sum;
+    return variance > 0 ? (float) (1.0 / std::sqrt((double) variance)) : 1.0f;
+}
+
+bool Cascade_Evaluator::EvaluateWindow(const int32_t *sum, const int32_t *tilted,
+                                       float inv_norm, const Feature_Offsets *offsets) const
+{
+    for (int32_t s = 0; s < m_data.stage_count; s++)
+    {
+        const Cascade_Stage &stage = m_data.stages[s];
+        float stage_sum = 0.0f;
+
+        for (int32_t w = 0; w < stage.weak_count; w++)
+        {
+            const Cascade_Weak &weak = m_data.weaks[stage.weak_offset + w];
+            int32_t idx = 0;
+            do
+            {
+                const Cascade_Node &node = m_data.nodes[weak.node_offset + idx];
+                const Feature_Offsets &f = offsets[node.feature];
+                const int32_t *p = f.tilted ? tilted : sum;
+                float value = f.weight[0] * RectSum(p, f.ofs[0]) +
+                              f.weight[1] * RectSum(p, f.ofs[1]);
+                if (f.weight[2] != 0.0f)
+                {
+                    value += f.weight[2] * RectSum(p, f.ofs[2]);
+                }
+                idx = value * inv_norm < node.threshold ? node.left : node.right;
+            } while (idx > 0);
+            stage_sum += m_data.leaves[weak.leaf_offset - idx];
+        }
+
+        if (stage_sum < stage.threshold)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 8 bit code of the 3x3 block grid, ofs are its 4x4 corners row by row.
+// Same bit order as OpenCV: clockwise from the top left block, 128 to 1.
+static inline int32_t LbpCode(const int32_t *p, const int32_t *ofs)
+{
+    int32_t center = p[ofs[5]] - p[ofs[6]] - p[ofs[9]] + p[ofs[10]];
+    return (p[ofs[0]] - p[ofs[1]] - p[ofs[4]] + p[ofs[5]] >= center ? 128 : 0) |
+           (p[ofs[1]] - p[ofs[2]] - p[ofs[5]] + p[ofs[6]] >= center ? 64 : 0) |
+           (p[ofs[2]] - p[ofs[3]] - p[ofs[6]] + p[ofs[7]] >= center ? 32 : 0) |
+           (p[ofs[6]] - p[ofs[7]] - p[ofs[10]] + p[ofs[11]] >= center ? 16 : 0) |
+           (p[ofs[10]] - p[ofs[11]] - p[ofs[14]] + p[ofs[15]] >= center ? 8 : 0) |
+           (p[ofs[9]] - p[ofs[10]] - p[ofs[13]] + p[ofs[14]] >= center ? 4 : 0) |
+           (p[ofs[8]] - p[ofs[9]] - p[ofs[12]] + p[ofs[13]] >= center ? 2 : 0) |
+           (p[ofs[4]] - p[ofs[5]] - p[ofs[8]] + p[ofs[9]] >= center ? 1 : 0);
+}
+
+bool Cascade_Evaluator::EvaluateLbpWindow(const int32_t *sum, const int32_t *offsets) const
+{
+    for (int32_t s = 0; s < m_data.stage_count; s++)
+    {
+        const Cascade_Stage &stage = m_data.stages[s];
+        float stage_sum = 0.0f;
+
+        for (int32_t w = 0; w < stage.weak_count; w++)
+        {
+            const Cascade_Weak &weak = m_data.weaks[stage.weak_offset + w];
+            int32_t idx = 0;
+            do
+            {
+                int32_t n = weak.node_offset + idx;
+                const Cascade_Node &node = m_data.nodes[n];
+                int32_t code = LbpCode(sum, offsets + 16 * node.feature);
+                const int32_t *subset = m_data.subsets + 8 * n;
+                idx = (subset[code >> 5] & (int32_t) (1u << (code & 31))) ? node.left : node.right;
+            } while (idx > 0);
+            stage_sum += m_data.leaves[weak.leaf_offset - idx];
+        }
+
+        if (stage_sum < stage.threshold)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Cascade_Evaluator::DetectLevel(const Feature_Cache &cache, size_t level_index,
+                                    const cv::Rect &roi, cv::Size min_size, cv::Size max_size,
+                                    std::vector<cv::Rect> &hits) const
+{
+    const Feature_Level &level = cache.GetLevels()[level_index];
+    const double scale = level.scale;
+    cv::Size window(cvRound(m_data.width * scale), cvRound(m_data.height * scale));
+    if (window.width < min_size.width || window.height < min_size.height)
+    {
+        return;
+    }
+    if (max_size.area() > 0 && (window.width > max_size.width || window.height > max_size.height))
+    {
+        return;
+    }
+    if (m_data.tilted && level.tilted.empty())
+    {
+        return;
+    }
+
+    // roi in level pixels, windows have to fit entirely inside it
+    const cv::Rect &area = cache.GetArea();
+    cv::Rect local = roi & area;
+    if (local.area() == 0)
+    {
+        return;
+    }
+    local.x -= area.x;
+    local.y -= area.y;
+
+    // same window grid as detectMultiScale
+    const int32_t step = scale > 2.0 ? 1 : 2;
+    int32_t x0 = (int32_t) std::ceil(local.x / scale);
+    int32_t y0 = (int32_t) std::ceil(local.y / scale);
+    x0 = (x0 + step - 1) / step * step;
+    y0 = (y0 + step - 1) / step * step;
+    // a roi reaching the edge of the area gets the whole rounded level
+    int32_t right = local.x + local.width >= area.width ? level.image.cols :
+                    std::min((int32_t) ((local.x + local.width) / scale), level.image.cols);
+    int32_t bottom = local.y + local.height >= area.height ? level.image.rows :
+                     std::min((int32_t) ((local.y + local.height) / scale), level.image.rows);
+    int32_t x1 = right - m_data.width;
+    int32_t y1 = bottom - m_data.height;
+    if (x1 < x0 || y1 < y0)
+    {
+        return;
+    }
+
+    const int32_t sum_step = (int32_t) (level.sum.step / sizeof(int32_t));
+
+    if (m_data.type == LBP_CASCADE)
+    {
+        // LBP only needs the plain integral, no variance normalisation
+        std::vector<int32_t> offsets(m_data.lbp_feature_count * 16);
+        for (int32_t f = 0; f < m_data.lbp_feature_count; f++)
+        {
+            const Lbp_Feature &feature = m_data.lbp_features[f];
+            for (int32_t row = 0; row < 4; row++)
+            {
+                for (int32_t col = 0; col < 4; col++)
+                {
+                    offsets[f * 16 + row * 4 + col] = feature.x + col * feature.width +
+                            sum_step * (feature.y + row * feature.height);
+                }
+            }
+        }
+
+        for (int32_t y = y0; y <= y1; y += step)
+        {
+            const int32_t *sum_row = level.sum.ptr<int32_t>(y);
+            for (int32_t x = x0; x <= x1; x += step)
+            {
+                if (EvaluateLbpWindow(sum_row + x, offsets.data()))
+                {
+                    hits.push_back(cv::Rect(cvRound(x * scale) + area.x,
+                                            cvRound(y * scale) + area.y,
+                                            window.width, window.height));
+                }
+            }
+        }
+        return;
+    }
+
+    const int32_t sq_step = (int32_t) (level.sqsum.step / sizeof(uint32_t));
+    const int32_t tilted_step = level.tilted.empty() ? 0 :
+                                (int32_t) (level.tilted.step / sizeof(int32_t));
+
+    std::vector<Feature_Offsets> offsets(m_data.feature_count);
+    for (int32_t f = 0; f < m_data.feature_count; f++)
+    {
+        const Cascade_Haar_Feature &feature = m_data.features[f];
+        Feature_Offsets &o = offsets[f];
+        o.tilted = feature.tilted;
+        for (int32_t r = 0; r < 3; r++)
+        {
+            if (r >= feature.rect_count)
+            {
+                o.weight[r] = 0.0f;
+                o.ofs[r][0] = o.ofs[r][1] = o.ofs[r][2] = o.ofs[r][3] = 0;
+                continue;
+            }
+
+            const Haar_Rect &rect = feature.rects[r];
+            o.weight[r] = rect.weight;
+            if (feature.tilted)
+            {
+                o.ofs[r][0] = rect.x + tilted_step * rect.y;
+                o.ofs[r][1] = rect.x - rect.height + tilted_step * (rect.y + rect.height);
+                o.ofs[r][2] = rect.x + rect.width + tilted_step * (rect.y + rect.width);
+                o.ofs[r][3] = rect.x + rect.width - rect.height +
+                              tilted_step * (rect.y + rect.width + rect.height);
+            }
+            else
+            {
+                o.ofs[r][0] = rect.x + sum_step * rect.y;
+                o.ofs[r][1] = rect.x + rect.width + sum_step * rect.y;
+                o.ofs[r][2] = rect.x + sum_step * (rect.y + rect.height);
+                o.ofs[r][3] = rect.x + rect.width + sum_step * (rect.y + rect.height);
+            }
+        }
+    }
+
+    const int32_t norm_area = (m_data.width - 2) * (m_data.height - 2);
+    const int32_t norm_sum[4] = {1 + sum_step, m_data.width - 1 + sum_step,
+                                 1 + sum_step * (m_data.height - 1),
+                                 m_data.width - 1 + sum_step * (m_data.height - 1)};
+    const int32_t norm_sq[4] = {1 + sq_step, m_data.width - 1 + sq_step,
+                                1 + sq_step * (m_data.height - 1),
+                                m_data.width - 1 + sq_step * (m_data.height - 1)};
+
+    for (int32_t y = y0; y <= y1; y += step)
+    {
+        const int32_t *sum_row = level.sum.ptr<int32_t>(y);
+        const uint32_t *sq_row = level.sqsum.ptr<uint32_t>(y);
+        const int32_t *tilted_row = level.tilted.empty() ? nullptr : level.tilted.ptr<int32_t>(y);
+        int32_t x = x0;
+
+#if defined(OPENCV_NDK_NEON) || defined(OPENCV_NDK_SSE2)
+        // the strided loads of the last window read up to step - 1 values
+        // past it, which are still inside the row
+        for (; m_data.stumps && x + 4 * step - 1 <= x1; x += 4 * step)
+        {
+            float inv_norm[4];
+            for (int32_t lane = 0; lane < 4; lane++)
+            {
+                int32_t lx = x + lane * step;
+                inv_norm[lane] = InverseNorm(sum_row + lx, sq_row + lx, norm_sum, norm_sq,
+                                             norm_area);
+            }
+
+            int32_t alive = EvaluateStumps4(sum_row + x, tilted_row ? tilted_row + x : nullptr,
+                                            step, inv_norm, offsets.data());
+            for (int32_t lane = 0; alive != 0 && lane < 4; lane++)
+            {
+                if (alive & (1 << lane))
+                {
+                    hits.push_back(cv::Rect(cvRound((x + lane * step) * scale) + area.x,
+                                            cvRound(y * scale) + area.y,
+                                            window.width, window.height));
+                }
+            }
+        }
+#endif
+
+        for (; x <= x1; x += step)
+        {
+            float inv_norm = InverseNorm(sum_row + x, sq_row + x, norm_sum, norm_sq, norm_area);
+            if (EvaluateWindow(sum_row + x, tilted_row ? tilted_row + x : nullptr, inv_norm,
+                               offsets.data()))
+            {
+                hits.push_back(cv::Rect(cvRound(x * scale) + area.x, cvRound(y * scale) + area.y,
+                                        window.width, window.height));
+            }
+        }
+    }
+}
+
+void Cascade_Evaluator::Group(std::vector<cv::Rect> &hits, int min_neighbors)
+{
+    cv::groupRectangles(hits, min_neighbors, 0.2);
+}
+
+void Cascade_Evaluator::Group(std::vector<cv::Rect> &hits, std::vector<int> &neighbors,
+                              int min_neighbors)
+{
+    cv::groupRectangles(hits, neighbors, min_neighbors, 0.2);
+}
+
+void Cascade_Evaluator::Detect(const Feature_Cache &cache, const cv::Rect &roi,
+                               cv::Size min_size, cv::Size max_size, int min_neighbors,
+                               std::vector<cv::Rect> &objects) const
+{
+    std::vector<cv::Rect> hits;
+    for (size_t level = 0; level < cache.GetLevels().size(); level++)
+    {
+        DetectLevel(cache, level, roi, min_size, max_size, hits);
+    }
+
+    Group(hits, min_neighbors);
+    objects.insert(objects.end(), hits.begin(), hits.end());
+}
@@ -0,0 +1,108 @@
+#ifndef OPENCV_NDK_CASCADE_EVALUATOR_H
+#define OPENCV_NDK_CASCADE_EVALUATOR_H
+
+// OpenCV
+#include <opencv2/core.hpp>
+// OpenCV-NDK App
+#include "Cascade_Binary.h"
+#include "Feature_Cache.h"
+#include "Haar_Cascade.h"
+#include "Lbp_Cascade.h"
+// STD Libs
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Evaluates a Haar or LBP cascade against a shared Feature_Cache. The
+// arithmetic follows cv::CascadeClassifier (variance normalised Haar
+// features, same window step and grouping) so results match
+// detectMultiScale with SCALE_IMAGE, but any number of cascades can reuse
+// one set of integral images. The variance comes from the 32 bit squared
+// integral in exact integer arithmetic. Stump based Haar cascades, which
+// are most of the bundled ones, run four neighbouring windows per NEON or
+// SSE2 instruction. The flattened cascade lives either in the evaluator's
+// own storage or in a mapped Cascade_Binary.
+class Cascade_Evaluator
+{
+public:
+    Cascade_Evaluator() = default;
+    // copies point at their own storage, mapped files are shared
+    Cascade_Evaluator(const Cascade_Evaluator &other);
+    Cascade_Evaluator &operator=(const Cascade_Evaluator &other);
+
+    bool Load(const Haar_Cascade &cascade);
+    bool Load(const Lbp_Cascade &cascade);
+    // Uses the cascade rotated by angle in place, binary stays mapped for
+    // as long as the evaluator needs it
+    bool Load(const std::shared_ptr<const Cascade_Binary> &binary, int32_t angle);
+
+    bool Empty() const
+    { return m_data.stage_count == 0; }
+
+    cv::Size GetWindowSize() const
+    { return cv::Size(m_data.width, m_data.height); }
+
+    bool HasTilted() const
+    { return m_data.tilted; }
+
+    const Cascade_Data &GetData() const
+    { return m_data; }
+
+    // Scans one cache level and appends the raw, ungrouped hits in source
+    // pixels. Only windows fully inside roi (source pixels) whose size lies
+    // between min_size and max_size (ignored when empty) are evaluated.
+    void DetectLevel(const Feature_Cache &cache, size_t level, const cv::Rect &roi,
+                     cv::Size min_size, cv::Size max_size, std::vector<cv::Rect> &hits) const;
+
+    // Same grouping detectMultiScale applies to the raw hits
+    static void Group(std::vector<cv::Rect> &hits, int min_neighbors);
+    // Also returns how many raw hits each group merged
+    static void Group(std::vector<cv::Rect> &hits, std::vector<int> &neighbors, int min_neighbors);
+
+    // All levels followed by Group()
+    void Detect(const Feature_Cache &cache, const cv::Rect &roi, cv::Size min_size,
+                cv::Size max_size, int min_neighbors, std::vector<cv::Rect> &objects) const;
+
+private:
+    // Integral offsets of one feature for a given level stride
+    struct Feature_Offsets
+    {
+        int32_t ofs[3][4];
+        float weight[3];
+        bool tilted;
+    };
+
+    bool EvaluateWindow(const int32_t *sum, const int32_t *tilted, float inv_norm,
+                        const Feature_Offsets *offsets) const;
+    // Bitmask of the windows at sum, sum + step, sum + 2 * step and
+    // sum + 3 * step that pass every stage, NEON and SSE2 builds only
+    int32_t EvaluateStumps4(const int32_t *sum, const int32_t *tilted, int32_t step,
+                            const float *inv_norm, const Feature_Offsets *offsets) const;
+    // offsets holds the 16 grid corners of every LBP feature
+    bool EvaluateLbpWindow(const int32_t *sum, const int32_t *offsets) const;
+    void Clear();
+    // Points m_data at m_storage
+    void Bind();
+
+    Cascade_Data m_data;
+    std::shared_ptr<const Cascade_Binary> m_binary;
+
+    // Loaded from XML. Stump cascades are also kept as parallel arrays
+    // indexed by weak classifier, which is all the four window loop touches.
+    struct Storage
+    {
+        std::vector<Cascade_Haar_Feature> features;
+        std::vector<Cascade_Node> nodes;
+        std::vector<float> leaves;
+        std::vector<Cascade_Weak> weaks;
+        std::vector<Cascade_Stage> stages;
+        std::vector<int32_t> stump_feature;
+        std::vector<float> stump_threshold;
+        std::vector<float> stump_left;
+        std::vector<float> stump_right;
+        std::vector<Lbp_Feature> lbp_features;
+        std::vector<int32_t> subsets;
+    } m_storage;
+};
+
+#endif  // OPENCV_NDK_CASCADE_EVALUATOR_H
@@ -0,0 +1,562 @@
+#include "Cascade_Scheduler.h"
+#include "Box_Tracker.h"
+#include "Grid_Regions.h"
+#include "Util.h"
+#include <algorithm>
+#include <chrono>
+
+Cascade_Scheduler::Cascade_Scheduler(Worker_Pool *pool)
+        : m_pool(pool)
+{
+}
+
+int32_t Cascade_Scheduler::Add(const Cascade_Config &config, const Haar_Cascade &model)
+{
+    return AddEntry(config, model, Lbp_Cascade(), nullptr);
+}
+
+int32_t Cascade_Scheduler::Add(const Cascade_Config &config, const Lbp_Cascade &model)
+{
+    return AddEntry(config, Haar_Cascade(), model, nullptr);
+}
+
+int32_t Cascade_Scheduler::Add(const Cascade_Config &config,
+                               const std::shared_ptr<const Cascade_Binary> &binary)
+{
+    return AddEntry(config, Haar_Cascade(), Lbp_Cascade(), binary);
+}
+
+int32_t Cascade_Scheduler::AddEntry(const Cascade_Config &config, const Haar_Cascade &model,
+                                    const Lbp_Cascade &lbp_model,
+                                    const std::shared_ptr<const Cascade_Binary> &binary)
+{
+    if (model.Empty() && lbp_model.Empty() && !binary)
+    {
+        LOGE("Cascade_Scheduler: %s has no model", config.name.c_str());
+        return -1;
+    }
+    if (config.parent >= (int32_t) m_entries.size())
+    {
+        LOGE("Cascade_Scheduler: %s has an unknown parent", config.name.c_str());
+        return -1;
+    }
+
+    int32_t id = (int32_t) m_entries.size();
+    m_entries.push_back(Entry());
+    Entry &entry = m_entries.back();
+    entry.config = config;
+    entry.config.cadence = std::max(1, config.cadence);
+    entry.model = model;
+    entry.lbp_model = lbp_model;
+    entry.binary = binary;
+    if (!LoadRotated(entry))
+    {
+        LOGE("Cascade_Scheduler: cannot load %s", config.name.c_str());
+        m_entries.pop_back();
+        return -1;
+    }
+    // spread cascades with the same cadence over different frames
+    entry.next_frame = m_frame + id % entry.config.cadence;
+    return id;
+}
+
+bool Cascade_Scheduler::LoadRotated(Entry &entry)
+{
+    // upright objects on the display are turned the other way on the sensor
+    int32_t angle = (360 - m_rotation) % 360;
+    entry.upright = false;
+    if (entry.binary)
+    {
+        if (!entry.evaluator.Load(entry.binary, 0))
+        {
+            return false;
+        }
+    }
+    else if (!entry.lbp_model.Empty())
+    {
+        return entry.evaluator.Load(entry.lbp_model.Rotated(angle));
+    }
+    else if (!entry.evaluator.Load(entry.model))
+    {
+        return false;
+    }
+
+    // 45 degree features have no exact counterpart on a turned frame, see
+    // Haar_Cascade::Rotated(), so those cascades scan an upright copy
+    if (angle == 0 || entry.evaluator.HasTilted())
+    {
+        entry.upright = angle != 0;
+        return true;
+    }
+    return entry.binary ? entry.evaluator.Load(entry.binary, angle) :
+           entry.evaluator.Load(entry.model.Rotated(angle));
+}
+
+void Cascade_Scheduler::SetRotation(int32_t rotation)
+{
+    if (rotation == m_rotation)
+    {
+        return;
+    }
+
+    m_rotation = rotation;
+    for (size_t i = 0; i < m_entries.size(); i++)
+    {
+        if (!LoadRotated(m_entries[i]))
+        {
+            LOGE("Cascade_Scheduler: cannot rotate %s", m_entries[i].config.name.c_str());
+        }
+        m_entries[i].detections.clear();
+    }
+}
+
+void Cascade_Scheduler::Restrict(int32_t id, const std::vector<cv::Rect> &regions)
+{
+    m_entries[id].restricted = true;
+    m_entries[id].restriction = regions;
+}
+
+void Cascade_Scheduler::Reset()
+{
+    for (size_t i = 0; i < m_entries.size(); i++)
+    {
+        Entry &entry = m_entries[i];
+        entry.next_frame = m_frame + (int64_t) i % entry.config.cadence;
+        entry.ran = false;
+        entry.restricted = false;
+        entry.restriction.clear();
+        entry.provided = false;
+        entry.provision.clear();
+        entry.detections.clear();
+        entry.scores.clear();
+    }
+}
+
+void Cascade_Scheduler::Provide(int32_t id, const std::vector<cv::Rect> &detections)
+{
+    m_entries[id].provided = true;
+    m_entries[id].provision = detections;
+}
+
+std::vector<cv::Rect> Cascade_Scheduler::Merge(const std::vector<int32_t> &ids, float max_iou) const
+{
+    std::vector<cv::Rect> boxes;
+    std::vector<int> scores;
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        const Entry &entry = m_entries[ids[i]];
+        boxes.insert(boxes.end(), entry.detections.begin(), entry.detections.end());
+        scores.insert(scores.end(), entry.scores.begin(), entry.scores.end());
+    }
+    SuppressOverlaps(boxes, scores, max_iou);
+    return boxes;
+}
+
+// Part of an upright frame or detection, given in fractions of it, on the
+// sensor. rect is in sensor pixels.
+static cv::Rect MapRoi(const cv::Rect_<float> &roi, const cv::Rect &rect, int32_t rotation)
+{
+    bool swap = rotation == 90 || rotation == 270;
+    int32_t width = swap ? rect.height : rect.width;
+    int32_t height = swap ? rect.width : rect.height;
+    cv::Rect upright(cvRound(roi.x * width), cvRound(roi.y * height),
+                     cvRound(roi.width * width), cvRound(roi.height * height));
+    return RotateRect(upright, width, height, (360 - rotation) % 360) + rect.tl();
+}
+
+std::vector<Cascade_Scheduler::Search_Region> Cascade_Scheduler::GetSearchRegions(
+        const Entry &entry, const cv::Mat &luma, const std::vector<cv::Rect> &regions) const
+{
+    const Cascade_Config &config = entry.config;
+    std::vector<Search_Region> candidates;
+    if (config.parent >= 0)
+    {
+        // the roi of every parent detection, with window sizes that fit it
+        const std::vector<cv::Rect> &parents = m_entries[config.parent].detections;
+        for (size_t p = 0; p < parents.size(); p++)
+        {
+            Search_Region region;
+            region.rect = MapRoi(config.roi, parents[p], m_rotation) & parents[p];
+            region.min_size = config.min_size;
+            region.max_size = config.max_size;
+            if (config.parent_min_size > 0.0f)
+            {
+                region.min_size.width = std::max(region.min_size.width,
+                        cvRound(parents[p].width * config.parent_min_size));
+                region.min_size.height = std::max(region.min_size.height,
+                        cvRound(parents[p].height * config.parent_min_size));
+            }
+            if (config.parent_max_size > 0.0f)
+            {
+                cv::Size bound(cvRound(parents[p].width * config.parent_max_size),
+                               cvRound(parents[p].height * config.parent_max_size));
+                region.max_size = region.max_size.area() > 0 ?
+                                  cv::Size(std::min(region.max_size.width, bound.width),
+                                           std::min(region.max_size.height, bound.height)) :
+                                  bound;
+            }
+            candidates.push_back(region);
+        }
+    }
+    else
+    {
+        // roi is given on the upright frame, map it back onto the sensor
+        cv::Rect sensor = MapRoi(config.roi, cv::Rect(0, 0, luma.cols, luma.rows), m_rotation);
+        for (size_t r = 0; r < regions.size(); r++)
+        {
+            Search_Region region = {regions[r] & sensor, config.min_size, config.max_size};
+            candidates.push_back(region);
+        }
+    }
+
+    std::vector<Search_Region> search;
+    for (size_t c = 0; c < candidates.size(); c++)
+    {
+        if (!entry.restricted)
+        {
+            search.push_back(candidates[c]);
+            continue;
+        }
+        for (size_t k = 0; k < entry.restriction.size(); k++)
+        {
+            Search_Region region = candidates[c];
+            region.rect &= entry.restriction[k];
+            search.push_back(region);
+        }
+    }
+
+    // nothing below the minimum object size can hold a detection
+    std::vector<Search_Region> usable;
+    for (size_t s = 0; s < search.size(); s++)
+    {
+        const Search_Region &region = search[s];
+        bool empty_range = region.max_size.area() > 0 &&
+                           (region.max_size.width < region.min_size.width ||
+                            region.max_size.height < region.min_size.height);
+        if (!empty_range && region.rect.width >= std::max(region.min_size.width, 1) &&
+            region.rect.height >= std::max(region.min_size.height, 1))
+        {
+            usable.push_back(region);
+        }
+    }
+    return usable;
+}
+
+void Cascade_Scheduler::BuildUpright(const cv::Mat &luma, const Entry &entry,
+                                     const std::vector<Search_Region> &search)
+{
+    cv::Rect needed;
+    for (size_t s = 0; s < search.size(); s++)
+    {
+        cv::Rect rect = search[s].rect & cv::Rect(0, 0, luma.cols, luma.rows);
+        needed = needed.area() > 0 ? needed | rect : rect;
+    }
+    if (needed.area() == 0)
+    {
+        return;
+    }
+
+    const bool swap = m_rotation == 90 || m_rotation == 270;
+    cv::Size window = entry.evaluator.GetWindowSize();
+    double min_scale = entry.config.min_size.area() > 0 ?
+                       std::min((double) entry.config.min_size.width / window.width,
+                                (double) entry.config.min_size.height / window.height) :
+                       1.0;
+    bool built = m_upright_area.area() > 0;
+    if (built && (needed & m_upright_area) == needed && min_scale >= m_upright_min_scale)
+    {
+        return;
+    }
+    // a second upright entry on the same frame widens the copy to both
+    if (built)
+    {
+        needed |= m_upright_area;
+        min_scale = std::min(min_scale, m_upright_min_scale);
+    }
+    cv::Size frame = swap ? cv::Size(needed.height, needed.width) : needed.size();
+    double max_scale = std::min((double) frame.width / window.width,
+                                (double) frame.height / window.height);
+    max_scale = built ? std::max(max_scale, m_upright_max_scale) : max_scale;
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    RotateImage(luma(needed), m_upright_luma, m_rotation);
+    m_upright_cache.Build(m_upright_luma, cv::Rect(0, 0, m_upright_luma.cols, m_upright_luma.rows),
+                          SCALE_FACTOR, min_scale, max_scale, true, m_pool);
+    m_pyramid_ms += std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - begin).count();
+    m_upright_area = needed;
+    m_upright_min_scale = min_scale;
+    m_upright_max_scale = max_scale;
+}
+
+void Cascade_Scheduler::Detect(Entry &entry, const std::vector<Search_Region> &search)
+{
+    const Feature_Cache &cache = entry.upright ? m_upright_cache : m_cache;
+    const cv::Rect &area = entry.upright ? m_upright_area : m_area;
+    if (area.area() == 0)
+    {
+        entry.detections.clear();
+        entry.scores.clear();
+        return;
+    }
+    const size_t levels = cache.GetLevels().size();
+    std::vector<std::vector<cv::Rect> > hits(search.size() * levels);
+
+    // an upright cascade scans the rotated copy of its area, with window
+    // sizes given on the display
+    const bool swap = m_rotation == 90 || m_rotation == 270;
+    std::vector<Search_Region> local = search;
+    for (size_t s = 0; entry.upright && s < local.size(); s++)
+    {
+        local[s].rect = RotateRect((local[s].rect & area) - area.tl(), area.width, area.height,
+                                   m_rotation);
+        if (swap)
+        {
+            local[s].min_size = cv::Size(local[s].min_size.height, local[s].min_size.width);
+            local[s].max_size = cv::Size(local[s].max_size.height, local[s].max_size.width);
+        }
+    }
+
+    // one task per search rectangle and pyramid level
+    auto detect = [&](size_t t)
+    {
+        const Search_Region &region = local[t / levels];
+        entry.evaluator.DetectLevel(cache, t % levels, region.rect, region.min_size,
+                                    region.max_size, hits[t]);
+    };
+    if (m_pool != nullptr)
+    {
+        m_pool->ParallelFor(hits.size(), detect);
+    }
+    else
+    {
+        for (size_t t = 0; t < hits.size(); t++)
+        {
+            detect(t);
+        }
+    }
+
+    // grouped per search rectangle like separate detectMultiScale calls
+    entry.detections.clear();
+    entry.scores.clear();
+    for (size_t s = 0; s < search.size(); s++)
+    {
+        std::vector<cv::Rect> objects;
+        std::vector<int> neighbors;
+        for (size_t l = 0; l < levels; l++)
+        {
+            const std::vector<cv::Rect> &level_hits = hits[s * levels + l];
+            objects.insert(objects.end(), level_hits.begin(), level_hits.end());
+        }
+        Cascade_Evaluator::Group(objects, neighbors, entry.config.min_neighbors);
+        for (size_t i = 0; entry.upright && i < objects.size(); i++)
+        {
+            objects[i] = RotateRect(objects[i], swap ? area.height : area.width,
+                                    swap ? area.width : area.height,
+                                    (360 - m_rotation) % 360) + area.tl();
+        }
+        entry.detections.insert(entry.detections.end(), objects.begin(), objects.end());
+        entry.scores.insert(entry.scores.end(), neighbors.begin(), neighbors.end());
+    }
+
+    // overlapping search rectangles and neighbouring scales report the same
+    // object more than once
+    if (entry.config.nms_iou > 0.0f)
+    {
+        SuppressOverlaps(entry.detections, entry.scores, entry.config.nms_iou);
+    }
+}
+
+bool Cascade_Scheduler::Process(const cv::Mat &luma, const std::vector<cv::Rect> &regions)
+{
+    std::vector<bool> due(m_entries.size(), false);
+    for (size_t i = 0; i < m_entries.size(); i++)
+    {
+        m_entries[i].ran = false;
+        due[i] = m_frame >= m_entries[i].next_frame;
+    }
+    // a due child needs its parent's detections of this very frame, parents
+    // always have a lower id so one backwards pass covers whole chains
+    for (size_t i = m_entries.size(); i-- > 0;)
+    {
+        if (due[i] && m_entries[i].config.parent >= 0)
+        {
+            due[m_entries[i].config.parent] = true;
+        }
+    }
+
+    // by priority, with every parent ahead of its children
+    std::vector<int32_t> by_priority;
+    for (size_t i = 0; i < m_entries.size(); i++)
+    {
+        if (due[i])
+        {
+            by_priority.push_back((int32_t) i);
+        }
+    }
+    std::stable_sort(by_priority.begin(), by_priority.end(), [this](int32_t a, int32_t b)
+    {
+        return m_entries[a].config.priority > m_entries[b].config.priority;
+    });
+    std::vector<int32_t> order;
+    std::vector<bool> queued(m_entries.size(), false);
+    for (size_t p = 0; p < by_priority.size(); p++)
+    {
+        std::vector<int32_t> chain;
+        for (int32_t id = by_priority[p]; id >= 0 && !queued[id]; id = m_entries[id].config.parent)
+        {
+            chain.push_back(id);
+            queued[id] = true;
+        }
+        order.insert(order.end(), chain.rbegin(), chain.rend());
+    }
+
+    if (order.empty())
+    {
+        for (size_t i = 0; i < m_entries.size(); i++)
+        {
+            m_entries[i].provided = false;
+            m_entries[i].provision.clear();
+        }
+        m_frame++;
+        return false;
+    }
+
+    // one pyramid for every due cascade, children search inside their
+    // parent's detections which already lie inside its area
+    std::vector<std::vector<Search_Region> > search(m_entries.size());
+    cv::Rect area;
+    for (size_t o = 0; o < order.size(); o++)
+    {
+        if (m_entries[order[o]].config.parent < 0)
+        {
+            const Entry &entry = m_entries[order[o]];
+            search[order[o]] = GetSearchRegions(entry, luma, regions);
+            // a provided cascade does not scan, only its children need the
+            // pyramid around its detections
+            std::vector<cv::Rect> covered;
+            for (size_t s = 0; s < search[order[o]].size() && !entry.provided; s++)
+            {
+                covered.push_back(search[order[o]][s].rect);
+            }
+            if (entry.provided)
+            {
+                covered = entry.provision;
+            }
+            for (size_t c = 0; c < covered.size(); c++)
+            {
+                const cv::Rect &rect = covered[c];
+                area = area.area() ? area | rect : rect;
+            }
+        }
+    }
+
+    area &= cv::Rect(0, 0, luma.cols, luma.rows);
+    m_area = area;
+    m_upright_area = cv::Rect();
+    m_pyramid_ms = 0.0;
+    if (area.area() > 0)
+    {
+        // from the smallest scale any cascade needs up to the largest
+        // window that still fits in the area. Upright entries build their
+        // own cache once they run.
+        double min_scale = 0.0;
+        double max_scale = 0.0;
+        bool used = false;
+        bool with_tilted = false;
+        for (size_t o = 0; o < order.size(); o++)
+        {
+            const Entry &entry = m_entries[order[o]];
+            if (entry.upright)
+            {
+                continue;
+            }
+            cv::Size window = entry.evaluator.GetWindowSize();
+            double entry_min = entry.config.min_size.area() > 0 ?
+                               std::min((double) entry.config.min_size.width / window.width,
+                                        (double) entry.config.min_size.height / window.height) :
+                               1.0;
+            double entry_max = std::min((double) area.width / window.width,
+                                        (double) area.height / window.height);
+            min_scale = !used ? entry_min : std::min(min_scale, entry_min);
+            max_scale = std::max(max_scale, entry_max);
+            with_tilted = with_tilted || entry.evaluator.HasTilted();
+            used = true;
+        }
+        if (used)
+        {
+            std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+            m_cache.Build(luma, area, SCALE_FACTOR, min_scale, max_scale, with_tilted, m_pool);
+            m_pyramid_ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - begin).count();
+        }
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t o = 0; o < order.size(); o++)
+    {
+        Entry &entry = m_entries[order[o]];
+        double elapsed = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count();
+        if (m_budget_ms > 0.0 && o > 0 && elapsed > m_budget_ms)
+        {
+            // the rest stays due and is tried again next frame
+            break;
+        }
+
+        if (entry.config.parent >= 0)
+        {
+            if (!m_entries[entry.config.parent].ran)
+            {
+                continue;
+            }
+            search[order[o]] = GetSearchRegions(entry, luma, regions);
+        }
+
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        if (entry.provided)
+        {
+            entry.detections = entry.provision;
+            entry.scores.assign(entry.detections.size(), 0);
+        }
+        else if (area.area() > 0)
+        {
+            if (entry.upright)
+            {
+                BuildUpright(luma, entry, search[order[o]]);
+                begin = std::chrono::steady_clock::now();
+            }
+            Detect(entry, search[order[o]]);
+        }
+        else
+        {
+            entry.detections.clear();
+            entry.scores.clear();
+        }
+        if (entry.filter)
+        {
+            std::vector<cv::Rect> searched;
+            bool searched_any = area.area() > 0 || entry.provided;
+            for (size_t s = 0; s < search[order[o]].size() && searched_any; s++)
+            {
+                searched.push_back(search[order[o]][s].rect);
+            }
+            entry.filter(entry.detections, searched);
+            entry.scores.assign(entry.detections.size(), 0);
+        }
+        entry.last_ms = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - begin).count();
+        entry.ran = true;
+        entry.next_frame = m_frame + entry.config.cadence;
+    }
+
+    for (size_t i = 0; i < m_entries.size(); i++)
+    {
+        m_entries[i].restricted = false;
+        m_entries[i].restriction.clear();
+        m_entries[i].provided = false;
+        m_entries[i].provision.clear();
+    }
+    m_frame++;
+    return true;
+}
@@ -0,0 +1,203 @@
+#ifndef OPENCV_NDK_CASCADE_SCHEDULER_H
+#define OPENCV_NDK_CASCADE_SCHEDULER_H
+
+// OpenCV
+#include <opencv2/core.hpp>
+// OpenCV-NDK App
+#include "Cascade_Binary.h"
+#include "Cascade_Evaluator.h"
+#include "Feature_Cache.h"
+#include "Haar_Cascade.h"
+#include "Lbp_Cascade.h"
+#include "Worker_Pool.h"
+// STD Libs
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// How and when one cascade runs
+struct Cascade_Config
+{
+    std::string name;
+    // run every cadence-th frame, cascades with the same cadence are spread
+    // over different frames
+    int32_t cadence = 1;
+    // due cascades run from highest to lowest priority, the ones that do
+    // not fit in the frame budget are deferred to the next frame
+    int32_t priority = 0;
+    cv::Size min_size;
+    cv::Size max_size;  // empty for no limit
+    int32_t min_neighbors = 3;
+    // part of the upright (display) frame to search, in fractions of it.
+    // Children search this part of every upright parent detection instead.
+    cv::Rect_<float> roi = cv::Rect_<float>(0.0f, 0.0f, 1.0f, 1.0f);
+    // only search inside this frame's detections of another cascade,
+    // -1 for none. The parent is forced to run on the same frames.
+    int32_t parent = -1;
+    // children only try windows between these fractions of the parent
+    // detection's size, on top of min_size and max_size. 0 for no bound.
+    float parent_min_size = 0.0f;
+    float parent_max_size = 0.0f;
+    // after grouping, detections overlapping a stronger one of the same
+    // frame by more than this IoU are dropped, across search rectangles and
+    // scales. 0 keeps them all.
+    float nms_iou = 0.0f;
+};
+
+// Rewrites a cascade's detections right after it ran and before its
+// children search them. searched holds the rectangles that were scanned.
+typedef std::function<void(std::vector<cv::Rect> &detections,
+                           const std::vector<cv::Rect> &searched)> Detection_Filter;
+
+// Runs a set of Haar cascades over a frame. All of them share one
+// Feature_Cache built in a single pass and one Worker_Pool that scans the
+// pyramid levels in parallel. Cascades with tilted features cannot be
+// rotated exactly, on a turned sensor they share a second cache built from
+// an upright copy of only the rectangles they search, the face bands for
+// eyes and smiles.
+class Cascade_Scheduler
+{
+public:
+    // Without a pool everything runs on the calling thread
+    explicit Cascade_Scheduler(Worker_Pool *pool);
+
+    // Registers an upright model, returns its id or -1 if it is empty or
+    // the parent is unknown
+    int32_t Add(const Cascade_Config &config, const Haar_Cascade &model);
+    int32_t Add(const Cascade_Config &config, const Lbp_Cascade &model);
+    // Precompiled cascade, evaluated straight from the mapping
+    int32_t Add(const Cascade_Config &config, const std::shared_ptr<const Cascade_Binary> &binary);
+
+    // Sensor to display rotation, the models are rotated the other way so
+    // they find upright objects on the sensor oriented frame
+    void SetRotation(int32_t rotation);
+
+    // Time after which lower priority cascades wait for the next frame,
+    // 0 disables the budget
+    void SetFrameBudget(double milliseconds)
+    { m_budget_ms = milliseconds; }
+
+    // Installed filter runs on every Process() the cascade runs in, an
+    // empty one removes it
+    void SetFilter(int32_t id, const Detection_Filter &filter)
+    { m_entries[id].filter = filter; }
+
+    // Limits a cascade to regions (sensor pixels) for the next Process()
+    void Restrict(int32_t id, const std::vector<cv::Rect> &regions);
+
+    // Detections (sensor pixels) found elsewhere, by the camera for
+    // instance. When the cascade is due in the next Process() they are used
+    // as its result instead of running it, its children still search them.
+    void Provide(int32_t id, const std::vector<cv::Rect> &detections);
+
+    // Runs every due cascade inside regions (sensor pixels) of luma.
+    // Returns false when none was due.
+    bool Process(const cv::Mat &luma, const std::vector<cv::Rect> &regions);
+
+    // Whether the cascade ran in the last Process()
+    bool Ran(int32_t id) const
+    { return m_entries[id].ran; }
+
+    // Latest detections of a cascade in sensor pixels, kept until it runs again
+    const std::vector<cv::Rect> &GetDetections(int32_t id) const
+    { return m_entries[id].detections; }
+
+    // Neighbour count of each detection, all 0 once a filter rewrote them
+    const std::vector<int> &GetScores(int32_t id) const
+    { return m_entries[id].scores; }
+
+    // Latest detections of several cascades looking for the same kind of
+    // object, with overlaps above max_iou suppressed across them
+    std::vector<cv::Rect> Merge(const std::vector<int32_t> &ids, float max_iou) const;
+
+    // Wall time of the cascade's last run in ms, pyramid excluded
+    double GetLastTime(int32_t id) const
+    { return m_entries[id].last_ms; }
+
+    // Time spent building the shared pyramids in the last Process()
+    double GetPyramidTime() const
+    { return m_pyramid_ms; }
+
+    // Sensor pixels turned upright for the tilted cascades in the last
+    // Process(), empty when none of them searched
+    const cv::Rect &GetUprightArea() const
+    { return m_upright_area; }
+
+    int32_t GetRotation() const
+    { return m_rotation; }
+
+    const Cascade_Config &GetConfig(int32_t id) const
+    { return m_entries[id].config; }
+
+    size_t Size() const
+    { return m_entries.size(); }
+
+    void Reset();
+
+private:
+    struct Entry
+    {
+        Cascade_Config config;
+        // only one of the models is set
+        Haar_Cascade model;
+        Lbp_Cascade lbp_model;
+        std::shared_ptr<const Cascade_Binary> binary;
+        Cascade_Evaluator evaluator;
+        // evaluator holds the upright model, it scans m_upright_cache
+        bool upright = false;
+        int64_t next_frame = 0;
+        bool ran = false;
+        double last_ms = 0.0;
+        bool restricted = false;
+        std::vector<cv::Rect> restriction;
+        bool provided = false;
+        std::vector<cv::Rect> provision;
+        std::vector<cv::Rect> detections;
+        std::vector<int> scores;
+        Detection_Filter filter;
+    };
+
+    // One rectangle to scan and the window sizes allowed inside it
+    struct Search_Region
+    {
+        cv::Rect rect;
+        cv::Size min_size;
+        cv::Size max_size;
+    };
+
+    // Search rectangles of a due cascade for this frame
+    std::vector<Search_Region> GetSearchRegions(const Entry &entry, const cv::Mat &luma,
+                                                const std::vector<cv::Rect> &regions) const;
+    // Evaluator of the entry for the current rotation
+    bool LoadRotated(Entry &entry);
+    int32_t AddEntry(const Cascade_Config &config, const Haar_Cascade &model,
+                     const Lbp_Cascade &lbp_model,
+                     const std::shared_ptr<const Cascade_Binary> &binary);
+    // Turns the part of luma an upright entry searches upright, unless the
+    // copy of this frame covers it already
+    void BuildUpright(const cv::Mat &luma, const Entry &entry,
+                      const std::vector<Search_Region> &search);
+    void Detect(Entry &entry, const std::vector<Search_Region> &search);
+
+    Worker_Pool *m_pool;
+    std::vector<Entry> m_entries;
+    Feature_Cache m_cache;
+    // sensor pixels m_cache covers in the last Process()
+    cv::Rect m_area;
+    // the rectangles upright entries search turned upright, built when the
+    // first of them runs as children only know theirs once the parent ran
+    cv::Mat m_upright_luma;
+    Feature_Cache m_upright_cache;
+    cv::Rect m_upright_area;
+    double m_upright_min_scale = 0.0;
+    double m_upright_max_scale = 0.0;
+    int32_t m_rotation = 0;
+    int64_t m_frame = 0;
+    double m_budget_ms = 0.0;
+    double m_pyramid_ms = 0.0;
+    const double SCALE_FACTOR = 1.18;
+};
+
+#endif  // OPENCV_NDK_CASCADE_SCHEDULER_H
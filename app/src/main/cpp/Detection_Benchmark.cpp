@@ -0,0 +1,72 @@
+#include "Detection_Benchmark.h"
+#include "Util.h"
+
+float RectIoU(const cv::Rect &a, const cv::Rect &b)
+{
+    int32_t overlap = (a & b).area();
+    int32_t total = a.area() + b.area() - overlap;
+    return total > 0 ? (float) overlap / total : 0.0f;
+}
+
+Detection_Benchmark::Detection_Benchmark(const std::string &name_a, const std::string &name_b,
+                                         float min_iou)
+        : m_name_a(name_a), m_name_b(name_b), m_min_iou(min_iou)
+{
+}
+
+void Detection_Benchmark::Reset()
+{
+    m_frames = 0;
+    m_total_ms_a = m_total_ms_b = 0.0;
+    m_count_a = m_count_b = m_matched = 0;
+}
+
+void Detection_Benchmark::Add(double ms_a, const std::vector<cv::Rect> &a,
+                              double ms_b, const std::vector<cv::Rect> &b)
+{
+    m_frames++;
+    m_total_ms_a += ms_a;
+    m_total_ms_b += ms_b;
+    m_count_a += (int64_t) a.size();
+    m_count_b += (int64_t) b.size();
+
+    // a handful of detections per frame, quadratic matching is fine
+    std::vector<bool> used(b.size(), false);
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        int32_t best = -1;
+        float best_iou = m_min_iou;
+        for (size_t j = 0; j < b.size(); j++)
+        {
+            float iou = used[j] ? 0.0f : RectIoU(a[i], b[j]);
+            if (iou >= best_iou)
+            {
+                best = (int32_t) j;
+                best_iou = iou;
+            }
+        }
+        if (best >= 0)
+        {
+            used[best] = true;
+            m_matched++;
+        }
+    }
+}
+
+float Detection_Benchmark::GetAgreement() const
+{
+    int64_t total = m_count_a + m_count_b;
+    return total > 0 ? 2.0f * m_matched / total : 1.0f;
+}
+
+void Detection_Benchmark::LogEvery(int64_t interval) const
+{
+    if (m_frames == 0 || m_frames % interval != 0)
+    {
+        return;
+    }
+    LOGI("A/B %s vs %s over %lld frames: %.2f ms vs %.2f ms, %lld vs %lld detections, "
+         "agreement %.3f", m_name_a.c_str(), m_name_b.c_str(), (long long) m_frames,
+         m_total_ms_a / m_frames, m_total_ms_b / m_frames, (long long) m_count_a,
+         (long long) m_count_b, GetAgreement());
+}
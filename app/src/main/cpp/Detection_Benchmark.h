@@ -0,0 +1,52 @@
+#ifndef OPENCV_NDK_DETECTION_BENCHMARK_H
+#define OPENCV_NDK_DETECTION_BENCHMARK_H
+
+// OpenCV
+#include <opencv2/core.hpp>
+// STD Libs
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Intersection over union of two rectangles, 0 when they do not overlap
+float RectIoU(const cv::Rect &a, const cv::Rect &b);
+
+// A/B comparison of two detectors run on the same frames. Keeps the mean
+// time of each and how well their detections agree: every detection of A
+// is greedily paired with the best unpaired one of B above an IoU, and the
+// agreement is 2 * pairs / (count A + count B).
+class Detection_Benchmark
+{
+public:
+    Detection_Benchmark(const std::string &name_a, const std::string &name_b,
+                        float min_iou = 0.5f);
+
+    void Add(double ms_a, const std::vector<cv::Rect> &a,
+             double ms_b, const std::vector<cv::Rect> &b);
+
+    // Logs the running totals every interval frames
+    void LogEvery(int64_t interval) const;
+
+    void Reset();
+
+    int64_t GetFrames() const
+    { return m_frames; }
+
+    // 1 when both always found the same objects, also 1 before anything
+    // was detected at all
+    float GetAgreement() const;
+
+private:
+    std::string m_name_a;
+    std::string m_name_b;
+    float m_min_iou;
+
+    int64_t m_frames = 0;
+    double m_total_ms_a = 0.0;
+    double m_total_ms_b = 0.0;
+    int64_t m_count_a = 0;
+    int64_t m_count_b = 0;
+    int64_t m_matched = 0;
+};
+
+#endif  // OPENCV_NDK_DETECTION_BENCHMARK_H
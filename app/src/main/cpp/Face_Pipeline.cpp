@@ -0,0 +1,488 @@
+#include "Face_Pipeline.h"
+#include "Grid_Regions.h"
+#include <chrono>
+#include <future>
+
+// Cascade files bundled with the APK. Eyes and smiles are Haar whatever
+// finds the faces, OpenCV has no LBP eye or smile cascade.
+static const char *FACE_CASCADE = "haarcascade_frontalface_alt.xml";
+static const char *EYES_CASCADE = "haarcascade_eye_tree_eyeglasses.xml";
+static const char *SMILE_CASCADE = "haarcascade_smile.xml";
+static const char *LBP_FACE_CASCADE = "lbpcascade_frontalface.xml";
+
+// The other bundled cascades, loaded like the face cascade when Load() is
+// given their name. Running all of them every frame is far too slow, so
+// each one has a cadence and only searches the part of the upright frame it
+// applies to.
+struct Optional_Cascade
+{
+    const char *name;
+    const char *file;
+    int32_t cadence;
+    int32_t priority;
+    cv::Rect_<float> roi;
+    int32_t min_width;
+    int32_t min_height;
+    int32_t group;
+};
+
+static const Optional_Cascade OPTIONAL_CASCADES[] = {
+        {"plate", "haarcascade_russian_plate_number.xml", 3, 2,
+                cv::Rect_<float>(0.0f, 0.33f, 1.0f, 0.67f), 60, 20, 0},
+        {"plate16", "haarcascade_licence_plate_rus_16stages.xml", 3, 2,
+                cv::Rect_<float>(0.0f, 0.33f, 1.0f, 0.67f), 64, 16, 0},
+        {"upperbody", "haarcascade_upperbody.xml", 2, 1,
+                cv::Rect_<float>(0.0f, 0.0f, 1.0f, 1.0f), 44, 36, 1},
+        {"fullbody", "haarcascade_fullbody.xml", 4, 1,
+                cv::Rect_<float>(0.0f, 0.0f, 1.0f, 1.0f), 28, 56, 2},
+        {"lowerbody", "haarcascade_lowerbody.xml", 4, 0,
+                cv::Rect_<float>(0.0f, 0.33f, 1.0f, 0.67f), 28, 46, 3},
+        {"catface", "haarcascade_frontalcatface.xml", 3, 0,
+                cv::Rect_<float>(0.0f, 0.0f, 1.0f, 1.0f), 48, 48, 4},
+};
+
+bool Face_Pipeline::Load(const Cascade_Loader &loader, Face_Backend backend,
+                         const std::vector<std::string> &optional, double budget_ms)
+{
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    bool needs_lbp = backend == LBP_FACES || backend == AB_FACES;
+
+    // every model is read on its own thread, they only get registered with
+    // the scheduler afterwards and in a fixed order so ids stay the same
+    std::future<Cascade_Model> face_future =
+            std::async(std::launch::async, loader.model, std::string(FACE_CASCADE), false);
+    std::future<Cascade_Model> eyes_future =
+            std::async(std::launch::async, loader.model, std::string(EYES_CASCADE), false);
+    std::future<Cascade_Model> smile_future =
+            std::async(std::launch::async, loader.model, std::string(SMILE_CASCADE), false);
+    std::future<Cascade_Model> lbp_future;
+    if (needs_lbp)
+    {
+        lbp_future = std::async(std::launch::async, loader.model,
+                                std::string(LBP_FACE_CASCADE), true);
+    }
+    // detectMultiScale needs the parsed model whatever the scheduler uses
+    std::future<bool> reference_future;
+    if (backend == OPENCV_AB_FACES)
+    {
+        reference_future = std::async(std::launch::async, [this, &loader]()
+        {
+            return loader.xml && loader.xml(FACE_CASCADE, m_reference_model);
+        });
+    }
+    const size_t optional_count = sizeof(OPTIONAL_CASCADES) / sizeof(OPTIONAL_CASCADES[0]);
+    std::vector<std::future<Cascade_Model> > optional_futures(optional_count);
+    std::vector<bool> enabled(optional_count, false);
+    for (size_t n = 0; n < optional.size(); n++)
+    {
+        size_t i = 0;
+        while (i < optional_count && optional[n] != OPTIONAL_CASCADES[i].name)
+        { i++; }
+        if (i == optional_count)
+        {
+            LOGE("--(!)No optional cascade %s\n", optional[n].c_str());
+            continue;
+        }
+        enabled[i] = true;
+    }
+    for (size_t i = 0; i < optional_count; i++)
+    {
+        if (enabled[i])
+        {
+            optional_futures[i] = std::async(std::launch::async, loader.model,
+                                             std::string(OPTIONAL_CASCADES[i].file), false);
+        }
+    }
+
+    Cascade_Model lbp_model = needs_lbp ? lbp_future.get() : Cascade_Model();
+    if (needs_lbp && !lbp_model.loaded)
+    {
+        LOGE("--(!)Error loading LBP face cascade, using Haar\n");
+        backend = HAAR_FACES;
+    }
+
+    Cascade_Config face;
+    face.name = "face";
+    face.priority = 10;
+    face.min_size = FACE_MIN_SIZE;
+    face.min_neighbors = 2;
+    bool raw_faces = backend == AB_FACES || backend == OPENCV_AB_FACES;
+    face.nms_iou = raw_faces ? 0.0f : FACE_NMS_IOU;
+    Cascade_Model face_model = face_future.get();
+    m_face_id = AddCascade(face, backend == LBP_FACES ? lbp_model : face_model);
+    if (m_face_id < 0)
+    { LOGE("--(!)Error loading face cascade\n"); };
+    if (m_face_id >= 0 && !raw_faces)
+    {
+        m_scheduler.SetFilter(m_face_id, [this](std::vector<cv::Rect> &faces,
+                                                const std::vector<cv::Rect> &searched)
+        {
+            m_face_tracker.Update(faces, searched);
+            faces = m_face_tracker.GetStable();
+        });
+    }
+    if (backend == OPENCV_AB_FACES && !reference_future.get())
+    {
+        LOGE("--(!)Error loading reference face cascade\n");
+        backend = HAAR_FACES;
+    }
+
+    Cascade_Config eyes;
+    eyes.name = "eyes";
+    eyes.priority = 9;
+    eyes.cadence = EYE_CADENCE;
+    eyes.min_size = EYE_MIN_SIZE;
+    eyes.min_neighbors = 2;
+    eyes.parent = m_face_id;
+    eyes.roi = EYE_BAND;
+    eyes.parent_min_size = EYE_MIN_FRACTION;
+    eyes.parent_max_size = EYE_MAX_FRACTION;
+    Cascade_Model eyes_model = eyes_future.get();
+    if (m_face_id < 0 || (m_eyes_id = AddCascade(eyes, eyes_model)) < 0)
+    { LOGE("--(!)Error loading eyes cascade\n"); };
+
+    Cascade_Config smile;
+    smile.name = "smile";
+    smile.priority = 7;
+    smile.cadence = SMILE_CADENCE;
+    smile.min_neighbors = SMILE_MIN_NEIGHBORS;
+    smile.parent = m_face_id;
+    smile.roi = SMILE_BAND;
+    smile.parent_min_size = SMILE_MIN_FRACTION;
+    smile.parent_max_size = SMILE_MAX_FRACTION;
+    Cascade_Model smile_model = smile_future.get();
+    if (m_face_id < 0 || (m_smile_id = AddCascade(smile, smile_model)) < 0)
+    { LOGE("--(!)Error loading smile cascade\n"); };
+
+    if (backend == AB_FACES && m_face_id >= 0)
+    {
+        Cascade_Config ab = face;
+        ab.name = "face_lbp";
+        ab.priority = 8;
+        if ((m_face_ab_id = AddCascade(ab, lbp_model)) < 0)
+        {
+            LOGE("--(!)Error loading LBP face cascade, using Haar\n");
+            backend = HAAR_FACES;
+        }
+    }
+
+    for (size_t i = 0; i < optional_count; i++)
+    {
+        if (!enabled[i])
+        { continue; }
+        const Optional_Cascade &cascade = OPTIONAL_CASCADES[i];
+
+        Cascade_Config config;
+        config.name = cascade.file;
+        config.cadence = cascade.cadence;
+        config.priority = cascade.priority;
+        config.roi = cascade.roi;
+        config.min_size = cv::Size(cascade.min_width, cascade.min_height);
+        config.nms_iou = OPTIONAL_NMS_IOU;
+        int32_t id = AddCascade(config, optional_futures[i].get());
+        if (id < 0)
+        {
+            LOGE("--(!)Error loading %s\n", cascade.file);
+            continue;
+        }
+        m_optional_ids.push_back(id);
+        m_optional_groups.push_back(cascade.group);
+    }
+
+    m_face_backend = backend;
+    m_scheduler.SetFrameBudget(budget_ms);
+    LOGI("Cascades loaded in %.1f ms", std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - begin).count());
+    return m_face_id >= 0;
+}
+
+int32_t Face_Pipeline::AddCascade(const Cascade_Config &config, const Cascade_Model &model)
+{
+    if (!model.loaded)
+    {
+        return -1;
+    }
+    if (model.binary)
+    {
+        return m_scheduler.Add(config, model.binary);
+    }
+    return model.lbp.Empty() ? m_scheduler.Add(config, model.haar) :
+           m_scheduler.Add(config, model.lbp);
+}
+
+void Face_Pipeline::Reset()
+{
+    m_motion_detector.Reset();
+    m_scheduler.Reset();
+    m_face_benchmark.Reset();
+    m_reference_benchmark.Reset();
+    m_smile_total_ms = 0.0;
+    m_smile_runs = 0;
+    m_face_results.clear();
+    m_face_tracker.Reset();
+}
+
+bool Face_Pipeline::Process(const Yuv_Planes &planes, int32_t rotation)
+{
+    cv::Mat luma(planes.height, planes.width, CV_8UC1, (void *) planes.y,
+                 (size_t) planes.y_stride);
+    m_scheduler.SetRotation(rotation);
+
+    // Only search where the scene changed, a static scene keeps last results
+    if (!m_motion_detector.Update(luma.data, luma.cols, luma.rows, (int32_t) luma.step))
+    {
+        return false;
+    }
+
+    // Y only recordings have no chroma to find skin in
+    const bool skin = m_skin_prefilter && planes.u != nullptr && planes.v != nullptr;
+    if (skin)
+    {
+        m_skin_mask.Build(planes);
+        m_skin_regions = m_skin_mask.GetCandidateRegions(SKIN_MARGIN);
+    }
+
+    std::vector<cv::Rect> regions;
+    // eyes follow their face on frames the eye cascade skips
+    std::vector<Face_Result> previous = m_face_results;
+
+    if (m_motion_detector.GetActivity() >= MOTION_FULL_FRAME)
+    {
+        m_face_results.clear();
+        regions.push_back(cv::Rect(0, 0, luma.cols, luma.rows));
+    }
+    else
+    {
+        regions = m_motion_detector.GetMotionRegions(MOTION_MARGIN);
+
+        // faces outside of every moving region are carried forward
+        std::vector<Face_Result> results;
+        for (size_t i = 0; i < m_face_results.size(); i++)
+        {
+            bool touched = false;
+            for (size_t r = 0; r < regions.size() && !touched; r++)
+            {
+                touched = (m_face_results[i].face & regions[r]).area() > 0;
+            }
+            if (!touched)
+            {
+                results.push_back(m_face_results[i]);
+            }
+        }
+        m_face_results.swap(results);
+    }
+
+    if (skin && m_face_id >= 0)
+    {
+        m_scheduler.Restrict(m_face_id, m_skin_regions);
+        if (m_face_ab_id >= 0)
+        {
+            m_scheduler.Restrict(m_face_ab_id, m_skin_regions);
+        }
+    }
+
+    std::vector<cv::Rect> faces;
+    if (m_face_backend == HAL_FACES && m_face_id >= 0 && m_face_source &&
+        m_face_source(luma.cols, luma.rows, faces))
+    {
+        // the source's faces outside of every region are carried forward
+        std::vector<cv::Rect> touched;
+        for (size_t i = 0; i < faces.size(); i++)
+        {
+            for (size_t r = 0; r < regions.size(); r++)
+            {
+                if ((faces[i] & regions[r]).area() > 0)
+                {
+                    touched.push_back(faces[i]);
+                    break;
+                }
+            }
+        }
+        m_scheduler.Provide(m_face_id, touched);
+    }
+
+    // the scheduler decides which cascades are due on this frame
+    if (!m_scheduler.Process(luma, regions))
+    {
+        return false;
+    }
+    CollectFaces(previous, m_face_results);
+
+    if (m_smile_id >= 0 && m_scheduler.Ran(m_smile_id))
+    {
+        m_smile_total_ms += m_scheduler.GetLastTime(m_smile_id);
+        if (++m_smile_runs % BENCHMARK_LOG_INTERVAL == 0)
+        {
+            LOGI("Smile stage: %.2f ms per run over %lld runs",
+                 m_smile_total_ms / m_smile_runs, (long long) m_smile_runs);
+        }
+    }
+
+    if (m_face_ab_id >= 0 && m_scheduler.Ran(m_face_id) && m_scheduler.Ran(m_face_ab_id))
+    {
+        m_face_benchmark.Add(m_scheduler.GetLastTime(m_face_id),
+                             m_scheduler.GetDetections(m_face_id),
+                             m_scheduler.GetLastTime(m_face_ab_id),
+                             m_scheduler.GetDetections(m_face_ab_id));
+        m_face_benchmark.LogEvery(BENCHMARK_LOG_INTERVAL);
+    }
+    if (m_face_backend == OPENCV_AB_FACES && m_face_id >= 0 && m_scheduler.Ran(m_face_id))
+    {
+        RunReference(luma, regions);
+    }
+    return true;
+}
+
+void Face_Pipeline::CollectFaces(const std::vector<Face_Result> &previous,
+                           std::vector<Face_Result> &results)
+{
+    if (m_face_id < 0 || !m_scheduler.Ran(m_face_id))
+    {
+        return;
+    }
+
+    const std::vector<cv::Rect> &faces = m_scheduler.GetDetections(m_face_id);
+    for (size_t i = 0; i < faces.size(); i++)
+    {
+        Face_Result result;
+        result.face = faces[i];
+
+        // the same face on the previous frame, if it was seen
+        int32_t best = -1;
+        float best_iou = EYE_CARRY_IOU;
+        for (size_t p = 0; p < previous.size(); p++)
+        {
+            float iou = RectIoU(previous[p].face, result.face);
+            if (iou >= best_iou)
+            {
+                best = (int32_t) p;
+                best_iou = iou;
+            }
+        }
+
+        if (m_eyes_id >= 0 && m_scheduler.Ran(m_eyes_id))
+        {
+            const std::vector<cv::Rect> &eyes = m_scheduler.GetDetections(m_eyes_id);
+            for (size_t j = 0; j < eyes.size(); j++)
+            {
+                if ((eyes[j] & result.face) == eyes[j])
+                {
+                    result.eyes.push_back(eyes[j]);
+                }
+            }
+        }
+        else if (m_eyes_id >= 0 && best >= 0)
+        {
+            // carry the eyes of the previous face along
+            const cv::Rect &from = previous[best].face;
+            double sx = (double) result.face.width / from.width;
+            double sy = (double) result.face.height / from.height;
+            for (size_t j = 0; j < previous[best].eyes.size(); j++)
+            {
+                const cv::Rect &eye = previous[best].eyes[j];
+                result.eyes.push_back(cv::Rect(
+                        result.face.x + cvRound((eye.x - from.x) * sx),
+                        result.face.y + cvRound((eye.y - from.y) * sy),
+                        cvRound(eye.width * sx), cvRound(eye.height * sy)));
+            }
+        }
+
+        if (best >= 0)
+        {
+            result.smile_votes = previous[best].smile_votes;
+            result.smiling = previous[best].smiling;
+        }
+        if (m_smile_id >= 0 && m_scheduler.Ran(m_smile_id))
+        {
+            bool vote = false;
+            const std::vector<cv::Rect> &smiles = m_scheduler.GetDetections(m_smile_id);
+            for (size_t j = 0; j < smiles.size() && !vote; j++)
+            {
+                vote = (smiles[j] & result.face) == smiles[j];
+            }
+            result.smile_votes = ((result.smile_votes << 1) | (vote ? 1u : 0u)) &
+                                 ((1u << SMILE_WINDOW) - 1);
+
+            int32_t yes = 0;
+            for (int32_t k = 0; k < SMILE_WINDOW; k++)
+            {
+                yes += (result.smile_votes >> k) & 1;
+            }
+            result.smiling = yes >= SMILE_VOTES;
+        }
+        results.push_back(result);
+    }
+}
+
+void Face_Pipeline::RunReference(const cv::Mat &luma, const std::vector<cv::Rect> &regions)
+{
+    int32_t rotation = m_scheduler.GetRotation();
+    if (rotation != m_reference_rotation)
+    {
+        // same choice Cascade_Scheduler makes for tilted features
+        m_reference_upright = rotation != 0 && m_reference_model.HasTilted();
+        int32_t angle = m_reference_upright ? 0 : (360 - rotation) % 360;
+        if (!m_reference_model.Rotated(angle).ToClassifier(m_reference_classifier))
+        { LOGE("--(!)Error loading reference face cascade\n"); };
+        m_reference_rotation = rotation;
+    }
+    if (m_reference_classifier.empty())
+    {
+        return;
+    }
+
+    // same regions as the scheduler got, before any skin restriction
+    std::vector<cv::Rect> faces;
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < regions.size(); r++)
+    {
+        if (regions[r].width < FACE_MIN_SIZE.width || regions[r].height < FACE_MIN_SIZE.height)
+        { continue; }
+
+        std::vector<cv::Rect> found;
+        cv::Mat region = luma(regions[r]);
+        if (m_reference_upright)
+        {
+            RotateImage(luma(regions[r]), region, rotation);
+        }
+        m_reference_classifier.detectMultiScale(region, found, 1.18, 2,
+                                                0 | CV_HAAR_SCALE_IMAGE, FACE_MIN_SIZE);
+        for (size_t i = 0; i < found.size(); i++)
+        {
+            cv::Rect face = m_reference_upright ?
+                            RotateRect(found[i], region.cols, region.rows, (360 - rotation) % 360) :
+                            found[i];
+            faces.push_back(face + regions[r].tl());
+        }
+    }
+    double ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - begin).count();
+
+    m_reference_benchmark.Add(m_scheduler.GetPyramidTime() + m_scheduler.GetLastTime(m_face_id),
+                              m_scheduler.GetDetections(m_face_id), ms, faces);
+    m_reference_benchmark.LogEvery(BENCHMARK_LOG_INTERVAL);
+}
+
+std::vector<cv::Rect> Face_Pipeline::GetObjects()
+{
+    std::vector<cv::Rect> objects;
+    std::vector<bool> merged(m_optional_ids.size(), false);
+    for (size_t i = 0; i < m_optional_ids.size(); i++)
+    {
+        if (merged[i])
+        { continue; }
+
+        std::vector<int32_t> ids;
+        for (size_t k = i; k < m_optional_ids.size(); k++)
+        {
+            if (m_optional_groups[k] == m_optional_groups[i])
+            {
+                ids.push_back(m_optional_ids[k]);
+                merged[k] = true;
+            }
+        }
+        std::vector<cv::Rect> group = m_scheduler.Merge(ids, OPTIONAL_NMS_IOU);
+        objects.insert(objects.end(), group.begin(), group.end());
+    }
+    return objects;
+}
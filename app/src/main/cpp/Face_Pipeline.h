@@ -0,0 +1,215 @@
+#ifndef OPENCV_NDK_FACE_PIPELINE_H
+#define OPENCV_NDK_FACE_PIPELINE_H
+
+// OpenCV
+#include <opencv2/core.hpp>
+#include <opencv2/objdetect.hpp>
+// OpenCV-NDK App
+#include "Box_Tracker.h"
+#include "Cascade_Binary.h"
+#include "Cascade_Scheduler.h"
+#include "Detection_Benchmark.h"
+#include "Haar_Cascade.h"
+#include "Lbp_Cascade.h"
+#include "Motion_Detector.h"
+#include "Skin_Mask.h"
+#include "Util.h"
+#include "Worker_Pool.h"
+// STD Libs
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// A detected face and the eyes found inside it, all in frame coordinates
+struct Face_Result
+{
+    cv::Rect face;
+    std::vector<cv::Rect> eyes;
+    // smile votes of the frames the smile cascade ran on, newest in bit 0,
+    // handed on from the previous result of the same face
+    uint32_t smile_votes = 0;
+    bool smiling = false;
+};
+
+// One cascade read on a loader thread, either mapped or parsed
+struct Cascade_Model
+{
+    std::shared_ptr<Cascade_Binary> binary;
+    Haar_Cascade haar;
+    Lbp_Cascade lbp;
+    bool loaded = false;
+};
+
+// Which cascade finds the faces, the app reads it from the
+// debug.opencvndk.faces system property ("haar", "lbp", "ab", "cv" or "hal")
+enum Face_Backend
+{
+    HAAR_FACES,
+    LBP_FACES,
+    // Haar drives the app while LBP runs on the same frames for comparison
+    AB_FACES,
+    // Haar drives the app while cv::CascadeClassifier runs the same model
+    // on the same regions for comparison
+    OPENCV_AB_FACES,
+    // the camera finds the faces, Haar does on cameras without face
+    // detection
+    HAL_FACES
+};
+
+// Reads the cascades Face_Pipeline::Load() asks for by file name, from the
+// APK assets in the app and from a directory in frame_replay
+struct Cascade_Loader
+{
+    // precompiled when there is a .cascade for name, else the parsed XML
+    std::function<Cascade_Model(const std::string &name, bool lbp)> model;
+    // the parsed XML, for the cv::CascadeClassifier comparison
+    std::function<bool(const std::string &name, Haar_Cascade &cascade)> xml;
+};
+
+// Faces found outside the pipeline for a width x height frame, false while
+// there are none to use and the face cascade has to run
+typedef std::function<bool(int32_t width, int32_t height, std::vector<cv::Rect> &faces)>
+        Face_Source;
+
+// The face detection of the camera loop, without the camera: motion gating,
+// the optional skin prefilter, faces, eyes and smiles and the optional
+// cascades on the sensor orientation luma plane. CV_Main feeds it camera
+// frames, frame_replay recorded ones, so both detect alike.
+class Face_Pipeline
+{
+public:
+    Face_Pipeline() = default;
+    Face_Pipeline(const Face_Pipeline &other) = delete;
+    Face_Pipeline &operator=(const Face_Pipeline &other) = delete;
+
+    // Loads and registers the cascades of backend, falling back to Haar
+    // when its own fail to load, and the optional cascades named (plate,
+    // plate16, upperbody, fullbody, lowerbody, catface). budget_ms is the
+    // initial SetFrameBudget(). True when there is a face cascade. May run
+    // on a loader thread, nothing else may be called until it returns.
+    bool Load(const Cascade_Loader &loader, Face_Backend backend,
+              const std::vector<std::string> &optional = std::vector<std::string>(),
+              double budget_ms = 0.0);
+
+    // Searches only skin colored regions for faces, off by default as it
+    // misses faces under strongly colored light. Needs frames with chroma.
+    void SetSkinPrefilter(bool enable)
+    { m_skin_prefilter = enable; }
+
+    // Milliseconds of cascades per frame, lower priority ones that do not
+    // fit wait for the next frame. 0, the default, runs every due cascade.
+    void SetFrameBudget(double milliseconds)
+    { m_scheduler.SetFrameBudget(milliseconds); }
+
+    // Faces used in place of the face cascade with HAL_FACES
+    void SetFaceSource(const Face_Source &source)
+    { m_face_source = source; }
+
+    // Forgets previous frames, for a new scan
+    void Reset();
+
+    // Detects on a frame turned rotation degrees from upright. False when
+    // nothing ran, the scene did not move or no cascade was due, and the
+    // previous results stand.
+    bool Process(const Yuv_Planes &planes, int32_t rotation);
+
+    Face_Backend GetBackend() const
+    { return m_face_backend; }
+
+    const std::vector<Face_Result> &GetFaces() const
+    { return m_face_results; }
+
+    // Latest detections of the optional cascades, overlapping ones of the
+    // same object merged
+    std::vector<cv::Rect> GetObjects();
+
+    const Motion_Detector &GetMotion() const
+    { return m_motion_detector; }
+
+    int32_t GetRotation() const
+    { return m_scheduler.GetRotation(); }
+
+private:
+    int32_t AddCascade(const Cascade_Config &config, const Cascade_Model &model);
+    // Pairs this frame's face detections with the eyes found inside them.
+    // On frames the eye cascade skips, a face keeps the eyes of the
+    // previous face it overlaps, moved and scaled along with it. Smiles
+    // are voted on over the frames the smile cascade runs.
+    void CollectFaces(const std::vector<Face_Result> &previous,
+                      std::vector<Face_Result> &results);
+    // Runs detectMultiScale over regions and compares it with this frame's
+    // native face detections, pyramid time included on both sides
+    void RunReference(const cv::Mat &luma, const std::vector<cv::Rect> &regions);
+
+    const cv::Size FACE_MIN_SIZE = cv::Size(70, 70);
+    // Eyes are only searched in the upper band of the upright face, for
+    // windows sized relative to the face, every EYE_CADENCE-th frame.
+    // EYE_MIN_SIZE is just the floor below the face relative bounds.
+    const cv::Size EYE_MIN_SIZE = cv::Size(20, 20);
+    const cv::Rect_<float> EYE_BAND = cv::Rect_<float>(0.0f, 0.15f, 1.0f, 0.45f);
+    const float EYE_MIN_FRACTION = 0.15f;
+    const float EYE_MAX_FRACTION = 0.5f;
+    const int32_t EYE_CADENCE = 2;
+    const float EYE_CARRY_IOU = 0.3f;
+    // Raw faces overlapping a stronger one by FACE_NMS_IOU are dropped and
+    // the rest are smoothed over frames. Eyes and smiles only search the
+    // stable tracks, once per face. Both are left out of the A/B runs so
+    // the backends are compared on raw detections.
+    const float FACE_NMS_IOU = 0.4f;
+    Box_Tracker m_face_tracker;
+    // Smiles are searched in the lower band of the face on alternate
+    // frames. A face is smiling when SMILE_VOTES of the last SMILE_WINDOW
+    // runs found one, which steadies the noisy smile cascade.
+    const cv::Rect_<float> SMILE_BAND = cv::Rect_<float>(0.1f, 0.55f, 0.8f, 0.45f);
+    const float SMILE_MIN_FRACTION = 0.15f;
+    const float SMILE_MAX_FRACTION = 0.7f;
+    const int32_t SMILE_CADENCE = 2;
+    const int32_t SMILE_MIN_NEIGHBORS = 12;
+    const int32_t SMILE_WINDOW = 6;
+    const int32_t SMILE_VOTES = 4;
+
+    // Every cascade, faces and eyes included, runs through the scheduler so
+    // they share one pyramid of integral images and one set of threads
+    Worker_Pool m_worker_pool;
+    Cascade_Scheduler m_scheduler{&m_worker_pool};
+    int32_t m_face_id = -1;
+    int32_t m_eyes_id = -1;
+    int32_t m_smile_id = -1;
+    double m_smile_total_ms = 0.0;
+    int64_t m_smile_runs = 0;
+
+    Face_Backend m_face_backend = HAAR_FACES;
+    Face_Source m_face_source;
+    int32_t m_face_ab_id = -1;
+    Detection_Benchmark m_face_benchmark{"haar", "lbp"};
+    Haar_Cascade m_reference_model;
+    cv::CascadeClassifier m_reference_classifier;
+    int32_t m_reference_rotation = -1;
+    // tilted models stay upright and run on rotated regions
+    bool m_reference_upright = false;
+    Detection_Benchmark m_reference_benchmark{"native", "opencv"};
+    const int64_t BENCHMARK_LOG_INTERVAL = 30;
+    std::vector<int32_t> m_optional_ids;
+    // cascades of one group look for the same object, their overlapping
+    // detections are merged above OPTIONAL_NMS_IOU
+    std::vector<int32_t> m_optional_groups;
+    const float OPTIONAL_NMS_IOU = 0.4f;
+
+    // Frame differencing gate for the cascades. Above MOTION_FULL_FRAME of
+    // moving blocks the whole frame is searched again, otherwise only the
+    // moving regions grown by MOTION_MARGIN pixels are.
+    Motion_Detector m_motion_detector;
+    const float MOTION_FULL_FRAME = 0.5f;
+    const int32_t MOTION_MARGIN = 70;
+    std::vector<Face_Result> m_face_results;
+
+    // Skin colored regions of the current frame in sensor coordinates
+    Skin_Mask m_skin_mask;
+    bool m_skin_prefilter = false;
+    const int32_t SKIN_MARGIN = 16;
+    std::vector<cv::Rect> m_skin_regions;
+};
+
+#endif  // OPENCV_NDK_FACE_PIPELINE_H
@@ -0,0 +1,122 @@
+#include "Feature_Cache.h"
+#include <opencv2/imgproc.hpp>
+#include <cmath>
+#include <cstring>
+
+// Plain and squared integral in one pass. The squared one wraps around in
+// 32 bits, differences over a window of up to 2^32 / 255^2 pixels are still
+// exact in unsigned arithmetic and need no doubles.
+static void Integral(const cv::Mat &image, cv::Mat &sum, cv::Mat &sqsum)
+{
+    sum.create(image.rows + 1, image.cols + 1, CV_32S);
+    sqsum.create(image.rows + 1, image.cols + 1, CV_32S);
+    memset(sum.ptr<int32_t>(0), 0, (image.cols + 1) * sizeof(int32_t));
+    memset(sqsum.ptr<uint32_t>(0), 0, (image.cols + 1) * sizeof(uint32_t));
+
+    for (int32_t y = 0; y < image.rows; y++)
+    {
+        const uint8_t *src = image.ptr<uint8_t>(y);
+        const int32_t *sum_above = sum.ptr<int32_t>(y);
+        int32_t *sum_row = sum.ptr<int32_t>(y + 1);
+        const uint32_t *sq_above = sqsum.ptr<uint32_t>(y);
+        uint32_t *sq_row = sqsum.ptr<uint32_t>(y + 1);
+
+        int32_t acc = 0;
+        uint32_t sq_acc = 0;
+        sum_row[0] = 0;
+        sq_row[0] = 0;
+        for (int32_t x = 0; x < image.cols; x++)
+        {
+            acc += src[x];
+            sq_acc += (uint32_t) src[x] * src[x];
+            sum_row[x + 1] = sum_above[x + 1] + acc;
+            sq_row[x + 1] = sq_above[x + 1] + sq_acc;
+        }
+    }
+}
+
+void Feature_Cache::Clear()
+{
+    m_levels.clear();
+    m_area = cv::Rect();
+    m_with_tilted = false;
+}
+
+void Feature_Cache::Build(const cv::Mat &luma, const cv::Rect &area, double scale_factor,
+                          double min_scale, double max_scale, bool with_tilted,
+                          Worker_Pool *pool)
+{
+    m_area = area & cv::Rect(0, 0, luma.cols, luma.rows);
+    m_with_tilted = with_tilted;
+
+    // keep the allocated Mats between frames, the sizes rarely change
+    size_t count = 0;
+    std::vector<cv::Size> sizes;
+    for (double scale = 1.0; scale <= max_scale; scale *= scale_factor)
+    {
+        if (scale < min_scale)
+        {
+            continue;
+        }
+
+        cv::Size size(cvRound(m_area.width / scale), cvRound(m_area.height / scale));
+        if (size.width < 2 || size.height < 2)
+        {
+            break;
+        }
+
+        if (m_levels.size() <= count)
+        {
+            m_levels.resize(count + 1);
+        }
+        m_levels[count++].scale = scale;
+        sizes.push_back(size);
+    }
+    m_levels.resize(count);
+
+    cv::Mat source = luma(m_area);
+    auto build_level = [&](size_t i)
+    {
+        Feature_Level &level = m_levels[i];
+        if (sizes[i] == source.size())
+        {
+            // the unscaled level borrows the luma plane instead of copying it
+            level.image = source;
+            level.borrowed = true;
+        }
+        else
+        {
+            // never resize into a plane borrowed from a previous frame
+            if (level.borrowed)
+            {
+                level.image.release();
+                level.borrowed = false;
+            }
+            cv::resize(source, level.image, sizes[i], 0, 0, cv::INTER_LINEAR);
+        }
+
+        Integral(level.image, level.sum, level.sqsum);
+        if (with_tilted)
+        {
+            // OpenCV only hands out the tilted integral together with the others
+            cv::Mat sum, sqsum;
+            cv::integral(level.image, sum, sqsum, level.tilted, CV_32S, CV_64F);
+        }
+        else
+        {
+            level.tilted.release();
+        }
+    };
+
+    if (pool != nullptr)
+    {
+        pool->ParallelFor(count, build_level);
+    }
+    else
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            build_level(i);
+        }
+    }
+}
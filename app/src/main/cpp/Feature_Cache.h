@@ -0,0 +1,57 @@
+#ifndef OPENCV_NDK_FEATURE_CACHE_H
+#define OPENCV_NDK_FEATURE_CACHE_H
+
+// OpenCV
+#include <opencv2/core.hpp>
+// OpenCV-NDK App
+#include "Worker_Pool.h"
+// STD Libs
+#include <cstdint>
+#include <vector>
+
+// One pyramid level: the luma scaled down by scale and its integral images
+struct Feature_Level
+{
+    double scale;
+    cv::Mat image;   // CV_8U, area.size() / scale
+    cv::Mat sum;     // CV_32S integral, one row and column larger than image
+    cv::Mat sqsum;   // CV_32S integral of squares, wraps around, read as uint32_t
+    cv::Mat tilted;  // CV_32S 45 degree integral, empty unless requested
+    bool borrowed = false;  // image points into the source luma plane
+};
+
+// Per frame cache of the scaled images and integral images every Haar
+// cascade evaluates against. It is built once per frame so a second or
+// third cascade only pays for its own classifier evaluation.
+class Feature_Cache
+{
+public:
+    // Builds levels scale_factor^k for every k with a scale between
+    // min_scale and max_scale, covering only area of the luma plane.
+    // Tilted integrals are only computed when a cascade needs them. Levels
+    // are resized straight from the source, so with a pool they are built
+    // in parallel.
+    void Build(const cv::Mat &luma, const cv::Rect &area, double scale_factor,
+               double min_scale, double max_scale, bool with_tilted,
+               Worker_Pool *pool = nullptr);
+
+    void Clear();
+
+    const std::vector<Feature_Level> &GetLevels() const
+    { return m_levels; }
+
+    // Part of the luma plane the levels cover, level pixel (0, 0) maps to
+    // area.tl() in source pixels
+    const cv::Rect &GetArea() const
+    { return m_area; }
+
+    bool HasTilted() const
+    { return m_with_tilted; }
+
+private:
+    std::vector<Feature_Level> m_levels;
+    cv::Rect m_area;
+    bool m_with_tilted = false;
+};
+
+#endif  // OPENCV_NDK_FEATURE_CACHE_H
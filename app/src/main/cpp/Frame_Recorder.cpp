@@ -0,0 +1,530 @@
+#include "Frame_Recorder.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char RECORDING_MAGIC[8] = {'O', 'C', 'V', 'N', 'D', 'K', 'R', 'C'};
+static const uint32_t RECORDING_VERSION = 1;
+static const uint64_t PAGE = 4096;
+// a 32 bit process cannot map much more in one piece
+static const uint64_t MAX_MAP_32 = 1ULL << 30;
+
+static uint64_t PageAlign(uint64_t size)
+{
+    return (size + PAGE - 1) / PAGE * PAGE;
+}
+
+static uint64_t FrameBytes(int32_t width, int32_t height, int32_t format)
+{
+    uint64_t luma = (uint64_t) width * height;
+    if (format == RECORD_Y)
+    {
+        return luma;
+    }
+    return luma + 2 * (uint64_t) ((width + 1) / 2) * ((height + 1) / 2);
+}
+
+Frame_Recorder::Frame_Recorder(size_t buffers)
+        : m_buffers(std::max((size_t) 1, buffers))
+{
+}
+
+Frame_Recorder::~Frame_Recorder()
+{
+    Stop();
+}
+
+bool Frame_Recorder::Start(const std::string &path, int32_t width, int32_t height,
+                           Record_Format format, uint32_t slot_count)
+{
+    Stop();
+    if (width <= 0 || height <= 0 || slot_count == 0)
+    {
+        return false;
+    }
+
+    const uint64_t slot_size = PageAlign(FrameBytes(width, height, format));
+    if (sizeof(void *) < 8)
+    {
+        uint64_t fit = MAX_MAP_32 / (slot_size + sizeof(Recorded_Frame));
+        if (fit == 0)
+        {
+            LOGE("Frame_Recorder: %dx%d frames do not fit a 32 bit process", width, height);
+            return false;
+        }
+        if (fit < slot_count)
+        {
+            LOGI("Frame_Recorder: %u slots do not fit a 32 bit process, keeping %llu",
+                 slot_count, (unsigned long long) fit);
+            slot_count = (uint32_t) fit;
+        }
+    }
+
+    m_format = format;
+    m_max_width = width;
+    m_max_height = height;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_next_frame = 0;
+        m_dropped = 0;
+        m_stop = false;
+        m_failed = false;
+        m_recording = true;
+    }
+    // creating and reserving hundreds of MB takes a while, frames queue
+    // up meanwhile and are dropped once the buffers run out
+    m_thread = std::thread(&Frame_Recorder::Run, this, path, slot_count, slot_size);
+    return true;
+}
+
+bool Frame_Recorder::Create(const std::string &path, uint32_t slot_count, uint64_t slot_size)
+{
+    const uint64_t data_offset =
+            PageAlign(sizeof(Recording_Header) + (uint64_t) slot_count * sizeof(Recorded_Frame));
+    const uint64_t total = data_offset + (uint64_t) slot_count * slot_size;
+
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        LOGE("Frame_Recorder: cannot create %s", path.c_str());
+        return false;
+    }
+    // blocks are reserved now so the recording never runs out of space or
+    // waits for the file system to find some. A sparse file instead would
+    // fault with SIGBUS on the first store the disk has no room for.
+    int error = posix_fallocate(fd, 0, (off_t) total);
+    if (error != 0)
+    {
+        LOGE("Frame_Recorder: cannot reserve %llu bytes for %s: %s",
+             (unsigned long long) total, path.c_str(), strerror(error));
+        close(fd);
+        unlink(path.c_str());
+        return false;
+    }
+    void *map = mmap(nullptr, (size_t) total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        LOGE("Frame_Recorder: cannot map %s", path.c_str());
+        close(fd);
+        unlink(path.c_str());
+        return false;
+    }
+    // slots are filled front to back and wrap around
+    madvise(map, (size_t) total, MADV_SEQUENTIAL);
+
+    m_fd = fd;
+    m_map = static_cast<uint8_t *>(map);
+    m_map_size = (size_t) total;
+    m_header = reinterpret_cast<Recording_Header *>(m_map);
+    m_index = reinterpret_cast<Recorded_Frame *>(m_map + sizeof(Recording_Header));
+    memcpy(m_header->magic, RECORDING_MAGIC, sizeof(RECORDING_MAGIC));
+    m_header->version = RECORDING_VERSION;
+    m_header->slot_count = slot_count;
+    m_header->slot_size = slot_size;
+    m_header->data_offset = data_offset;
+    m_header->frame_count = 0;
+    m_header->dropped = 0;
+    for (uint32_t i = 0; i < slot_count; i++)
+    {
+        memset(&m_index[i], 0, sizeof(Recorded_Frame));
+        m_index[i].frame_number = -1;
+    }
+    LOGI("Frame_Recorder: %s, %u slots of %dx%d, %llu MB", path.c_str(), slot_count,
+         m_max_width, m_max_height, (unsigned long long) (total >> 20));
+    return true;
+}
+
+void Frame_Recorder::Stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!m_thread.joinable())
+        {
+            return;
+        }
+        m_recording = false;
+        // queued frames, the one being stored and the ones Record() is
+        // still copying all return to the pool
+        m_idle.wait(lock, [this]()
+        {
+            return m_outstanding == 0;
+        });
+        m_stop = true;
+    }
+    m_work.notify_all();
+    m_thread.join();
+
+    if (m_map == nullptr)
+    {
+        return;
+    }
+    m_header->dropped = m_dropped;
+    msync(m_map, m_map_size, MS_ASYNC);
+    munmap(m_map, m_map_size);
+    close(m_fd);
+    m_fd = -1;
+    m_map = nullptr;
+    m_map_size = 0;
+    m_header = nullptr;
+    m_index = nullptr;
+    LOGI("Frame_Recorder: %lld frames recorded, %lld dropped", (long long) m_next_frame,
+         (long long) m_dropped);
+}
+
+bool Frame_Recorder::IsRecording() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_recording;
+}
+
+bool Frame_Recorder::Record(const Yuv_Planes &planes, int32_t rotation, int32_t tag)
+{
+    std::unique_ptr<Pending_Frame> frame;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_recording || m_failed)
+        {
+            return false;
+        }
+        if (planes.width > m_max_width || planes.height > m_max_height)
+        {
+            m_dropped++;
+            return false;
+        }
+        // never wait for the recorder thread
+        if (m_outstanding >= m_buffers)
+        {
+            m_dropped++;
+            return false;
+        }
+        m_outstanding++;
+        if (m_pool.empty())
+        {
+            frame.reset(new Pending_Frame());
+        }
+        else
+        {
+            frame = std::move(m_pool.back());
+            m_pool.pop_back();
+        }
+        frame->info.frame_number = m_next_frame++;
+    }
+
+    Recorded_Frame &info = frame->info;
+    info.timestamp_ns = planes.timestamp;
+    info.width = planes.width;
+    info.height = planes.height;
+    info.format = m_format;
+    info.rotation = rotation;
+    info.tag = tag;
+    info.size = (uint32_t) FrameBytes(planes.width, planes.height, m_format);
+    frame->data.resize(info.size);
+
+    uint8_t *out = frame->data.data();
+    for (int32_t y = 0; y < planes.height; y++, out += planes.width)
+    {
+        memcpy(out, planes.y + (size_t) y * planes.y_stride, planes.width);
+    }
+    if (m_format == RECORD_YUV)
+    {
+        const int32_t uv_width = (planes.width + 1) / 2;
+        const int32_t uv_height = (planes.height + 1) / 2;
+        const uint8_t *chroma[2] = {planes.u, planes.v};
+        for (int32_t c = 0; c < 2; c++)
+        {
+            for (int32_t y = 0; y < uv_height; y++, out += uv_width)
+            {
+                const uint8_t *row = chroma[c] + (size_t) y * planes.uv_stride;
+                if (planes.uv_pixel_stride == 1)
+                {
+                    memcpy(out, row, uv_width);
+                    continue;
+                }
+                for (int32_t x = 0; x < uv_width; x++)
+                {
+                    out[x] = row[x * planes.uv_pixel_stride];
+                }
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_failed)
+        {
+            // the file could not be created while the planes were copied
+            m_pool.push_back(std::move(frame));
+            m_outstanding--;
+            m_idle.notify_all();
+            return false;
+        }
+        m_queue.push_back(std::move(frame));
+    }
+    m_work.notify_one();
+    return true;
+}
+
+bool Frame_Recorder::HasFailed() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_failed;
+}
+
+void Frame_Recorder::Run(std::string path, uint32_t slot_count, uint64_t slot_size)
+{
+    bool created = Create(path, slot_count, slot_size);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (!created)
+    {
+        // no file to store into, what is queued goes back to the pool
+        m_failed = true;
+        while (!m_queue.empty())
+        {
+            m_pool.push_back(std::move(m_queue.front()));
+            m_queue.pop_front();
+            m_outstanding--;
+        }
+        m_idle.notify_all();
+        return;
+    }
+    while (true)
+    {
+        m_work.wait(lock, [this]()
+        {
+            return m_stop || !m_queue.empty();
+        });
+        if (m_queue.empty())
+        {
+            return;
+        }
+        std::unique_ptr<Pending_Frame> frame = std::move(m_queue.front());
+        m_queue.pop_front();
+        int64_t dropped = m_dropped;
+        lock.unlock();
+
+        Store(*frame);
+        m_header->dropped = dropped;
+
+        lock.lock();
+        m_pool.push_back(std::move(frame));
+        m_outstanding--;
+        m_idle.notify_all();
+    }
+}
+
+void Frame_Recorder::Store(const Pending_Frame &frame)
+{
+    const int64_t n = frame.info.frame_number;
+    const uint32_t slot = (uint32_t) (n % m_header->slot_count);
+    Recorded_Frame *entry = &m_index[slot];
+
+    // the slot is invalid while its pixels change, readers skip it
+    entry->frame_number = -1;
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(m_map + m_header->data_offset + slot * m_header->slot_size, frame.data.data(),
+           frame.data.size());
+
+    Recorded_Frame info = frame.info;
+    info.frame_number = -1;
+    *entry = info;
+    std::atomic_thread_fence(std::memory_order_release);
+    entry->frame_number = n;
+    // frames are stored in order, one thread does it
+    m_header->frame_count = n + 1;
+}
+
+int64_t Frame_Recorder::GetRecorded() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_next_frame;
+}
+
+int64_t Frame_Recorder::GetDropped() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_dropped;
+}
+
+Frame_Recording::~Frame_Recording()
+{
+    Close();
+}
+
+bool Frame_Recording::Open(const std::string &path)
+{
+    Close();
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        LOGE("Frame_Recording: cannot open %s", path.c_str());
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (uint64_t) info.st_size < sizeof(Recording_Header))
+    {
+        LOGE("Frame_Recording: %s is no recording", path.c_str());
+        close(fd);
+        return false;
+    }
+    void *map = mmap(nullptr, (size_t) info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        LOGE("Frame_Recording: cannot map %s", path.c_str());
+        close(fd);
+        return false;
+    }
+
+    const Recording_Header *header = static_cast<const Recording_Header *>(map);
+    bool valid = memcmp(header->magic, RECORDING_MAGIC, sizeof(RECORDING_MAGIC)) == 0 &&
+                 header->version == RECORDING_VERSION && header->slot_count > 0 &&
+                 header->slot_size <= (uint64_t) info.st_size &&
+                 header->data_offset >= sizeof(Recording_Header) +
+                                        (uint64_t) header->slot_count * sizeof(Recorded_Frame) &&
+                 header->data_offset + (uint64_t) header->slot_count * header->slot_size <=
+                 (uint64_t) info.st_size;
+    if (!valid)
+    {
+        LOGE("Frame_Recording: %s is no recording or a different version", path.c_str());
+        munmap(map, (size_t) info.st_size);
+        close(fd);
+        return false;
+    }
+
+    m_fd = fd;
+    m_map = static_cast<const uint8_t *>(map);
+    m_map_size = (size_t) info.st_size;
+    m_header = header;
+    m_index = reinterpret_cast<const Recorded_Frame *>(m_map + sizeof(Recording_Header));
+    return true;
+}
+
+void Frame_Recording::Close()
+{
+    if (m_map != nullptr)
+    {
+        munmap(const_cast<uint8_t *>(m_map), m_map_size);
+        close(m_fd);
+    }
+    m_fd = -1;
+    m_map = nullptr;
+    m_map_size = 0;
+    m_header = nullptr;
+    m_index = nullptr;
+}
+
+int64_t Frame_Recording::GetFirst() const
+{
+    if (m_header == nullptr)
+    {
+        return 0;
+    }
+    return std::max((int64_t) 0, m_header->frame_count - (int64_t) m_header->slot_count);
+}
+
+int64_t Frame_Recording::GetLast() const
+{
+    return m_header != nullptr ? m_header->frame_count - 1 : -1;
+}
+
+const Recorded_Frame *Frame_Recording::Entry(int64_t n) const
+{
+    if (m_header == nullptr || n < GetFirst() || n > GetLast())
+    {
+        return nullptr;
+    }
+    const Recorded_Frame *entry = &m_index[n % m_header->slot_count];
+    return entry->frame_number == n ? entry : nullptr;
+}
+
+bool Frame_Recording::Get(int64_t n, Recorded_Frame *info, Yuv_Planes *planes) const
+{
+    const Recorded_Frame *entry = Entry(n);
+    if (entry == nullptr)
+    {
+        return false;
+    }
+    // the writer only stores frames that fit their slot, anything else is
+    // a damaged file and would read past the slot or the mapping
+    if (entry->width <= 0 || entry->height <= 0 ||
+        (entry->format != RECORD_Y && entry->format != RECORD_YUV) ||
+        entry->size != FrameBytes(entry->width, entry->height, entry->format) ||
+        entry->size > m_header->slot_size)
+    {
+        LOGE("Frame_Recording: frame %lld does not fit its slot", (long long) n);
+        return false;
+    }
+    *info = *entry;
+    const uint8_t *data = m_map + m_header->data_offset +
+                          (n % m_header->slot_count) * m_header->slot_size;
+    const int32_t uv_width = (info->width + 1) / 2;
+    const int32_t uv_height = (info->height + 1) / 2;
+    planes->y = data;
+    planes->u = info->format == RECORD_YUV ? data + (size_t) info->width * info->height : nullptr;
+    planes->v = planes->u != nullptr ? planes->u + (size_t) uv_width * uv_height : nullptr;
+    planes->width = info->width;
+    planes->height = info->height;
+    planes->y_stride = info->width;
+    planes->uv_stride = uv_width;
+    planes->uv_pixel_stride = 1;
+    planes->timestamp = info->timestamp_ns;
+    return true;
+}
+
+int64_t Frame_Recording::Find(int64_t timestamp_ns) const
+{
+    int64_t first = GetFirst();
+    int64_t last = GetLast();
+    // the ends may be mid write, step inwards until both are complete
+    while (first <= last && Entry(first) == nullptr)
+    {
+        first++;
+    }
+    while (last >= first && Entry(last) == nullptr)
+    {
+        last--;
+    }
+    if (first > last)
+    {
+        return -1;
+    }
+
+    const int64_t t_first = Entry(first)->timestamp_ns;
+    const int64_t t_last = Entry(last)->timestamp_ns;
+    int64_t n = first;
+    if (timestamp_ns >= t_last)
+    {
+        n = last;
+    }
+    else if (timestamp_ns > t_first && t_last > t_first)
+    {
+        n = first + (int64_t) ((double) (timestamp_ns - t_first) / (t_last - t_first) *
+                               (last - first));
+    }
+    // walk towards the closest timestamp, a step or two at a steady rate
+    while (true)
+    {
+        const Recorded_Frame *entry = Entry(n);
+        const Recorded_Frame *next = Entry(n + 1);
+        const Recorded_Frame *previous = Entry(n - 1);
+        int64_t distance = entry != nullptr ? std::llabs(entry->timestamp_ns - timestamp_ns) : 0;
+        if (entry != nullptr && next != nullptr &&
+            std::llabs(next->timestamp_ns - timestamp_ns) < distance)
+        {
+            n++;
+        }
+        else if (entry != nullptr && previous != nullptr &&
+                 std::llabs(previous->timestamp_ns - timestamp_ns) < distance)
+        {
+            n--;
+        }
+        else
+        {
+            return n;
+        }
+    }
+}
@@ -0,0 +1,166 @@
+#ifndef OPENCV_NDK_FRAME_RECORDER_H
+#define OPENCV_NDK_FRAME_RECORDER_H
+
+// OpenCV-NDK App
+#include "Util.h"
+// STD Libs
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// What a recording keeps of every frame
+enum Record_Format
+{
+    RECORD_Y = 1,    // luma only
+    RECORD_YUV = 2   // I420: luma, then the U and V planes at half size
+};
+
+// Everything a recording stores about a frame besides its pixels
+struct Recorded_Frame
+{
+    // frames ever recorded before this one, -1 for an empty slot
+    int64_t frame_number;
+    int64_t timestamp_ns;
+    int32_t width;
+    int32_t height;
+    int32_t format;
+    int32_t rotation;
+    // caller defined, the app stores the face count
+    int32_t tag;
+    uint32_t size;
+};
+
+// Layout of a recording file. The header and a fixed index of one entry per
+// slot come first, then the slots, each sized for the largest frame. Frame n
+// lives in slot n % slot_count, so the file is a ring that keeps the latest
+// slot_count frames however long the recording runs, and frame n is found
+// without a search. Entries are written after their pixels, a frame whose
+// entry is there is complete.
+struct Recording_Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t slot_count;
+    uint64_t slot_size;
+    uint64_t data_offset;
+    // frames recorded so far and frames the writer had to drop
+    int64_t frame_count;
+    int64_t dropped;
+};
+
+// Records frames into a preallocated, memory mapped ring file. Record() only
+// copies the planes into a pooled buffer and returns, a thread of its own
+// moves them into the mapping. When that thread falls behind by more than
+// the pool, frames are dropped and counted instead of stalling the camera.
+class Frame_Recorder
+{
+public:
+    // buffers: frames that can wait for the recorder thread
+    explicit Frame_Recorder(size_t buffers = 4);
+    ~Frame_Recorder();
+    Frame_Recorder(const Frame_Recorder &other) = delete;
+    Frame_Recorder &operator=(const Frame_Recorder &other) = delete;
+
+    // Records into path with room for slot_count frames of up to width x
+    // height in format. The file is created and its whole size reserved on
+    // the recorder's thread, HasFailed() tells when that did not work.
+    bool Start(const std::string &path, int32_t width, int32_t height, Record_Format format,
+               uint32_t slot_count);
+
+    // Writes out what is queued, including frames Record() is still
+    // copying, and unmaps the file
+    void Stop();
+
+    bool IsRecording() const;
+
+    // The file could not be created or its space reserved, Record() drops
+    // every frame until Stop()
+    bool HasFailed() const;
+
+    // Queues a frame, false when it was dropped or does not fit the slots
+    bool Record(const Yuv_Planes &planes, int32_t rotation, int32_t tag);
+
+    int64_t GetRecorded() const;
+    int64_t GetDropped() const;
+
+private:
+    struct Pending_Frame
+    {
+        Recorded_Frame info;
+        std::vector<uint8_t> data;
+    };
+
+    // creates and maps the file, on the recorder's thread
+    bool Create(const std::string &path, uint32_t slot_count, uint64_t slot_size);
+    void Run(std::string path, uint32_t slot_count, uint64_t slot_size);
+    void Store(const Pending_Frame &frame);
+
+    const size_t m_buffers;
+    Record_Format m_format = RECORD_Y;
+    int32_t m_max_width = 0;
+    int32_t m_max_height = 0;
+
+    int m_fd = -1;
+    uint8_t *m_map = nullptr;
+    size_t m_map_size = 0;
+    Recording_Header *m_header = nullptr;
+    Recorded_Frame *m_index = nullptr;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_work;
+    std::condition_variable m_idle;
+    std::deque<std::unique_ptr<Pending_Frame> > m_queue;
+    std::vector<std::unique_ptr<Pending_Frame> > m_pool;
+    // frames out of the pool: being copied, queued or being stored
+    size_t m_outstanding = 0;
+    bool m_recording = false;
+    bool m_failed = false;
+    bool m_stop = false;
+    std::thread m_thread;
+
+    int64_t m_next_frame = 0;
+    int64_t m_dropped = 0;
+};
+
+// Read side of a recording, for looking at what the camera saw
+class Frame_Recording
+{
+public:
+    Frame_Recording() = default;
+    ~Frame_Recording();
+    Frame_Recording(const Frame_Recording &other) = delete;
+    Frame_Recording &operator=(const Frame_Recording &other) = delete;
+
+    bool Open(const std::string &path);
+    void Close();
+
+    // Oldest and newest frame numbers still in the ring, first > last when
+    // it is empty
+    int64_t GetFirst() const;
+    int64_t GetLast() const;
+
+    // Frame number n, false when it was overwritten or never recorded.
+    // planes point into the mapping and stay valid until Close().
+    bool Get(int64_t n, Recorded_Frame *info, Yuv_Planes *planes) const;
+
+    // Number of the frame closest to timestamp_ns, -1 when empty. Frames
+    // come at a steady rate, so the first guess is interpolated from the
+    // ends and only a few neighbours are looked at from there.
+    int64_t Find(int64_t timestamp_ns) const;
+
+private:
+    const Recorded_Frame *Entry(int64_t n) const;
+
+    int m_fd = -1;
+    const uint8_t *m_map = nullptr;
+    size_t m_map_size = 0;
+    const Recording_Header *m_header = nullptr;
+    const Recorded_Frame *m_index = nullptr;
+};
+
+#endif  // OPENCV_NDK_FRAME_RECORDER_H
@@ -0,0 +1,235 @@
+// Runs the face detection of the camera loop on replayed frames and reports
+// its throughput. The same frames always give the same detections, so the
+// per frame lines on stdout can be diffed between two builds:
+//
+//   frame_replay <frames.rec | file.y4m | image dir> <cascade dir> [fps] [passes]
+//                [--faces=haar|lbp|ab|cv] [--skin] [--budget=ms]
+//                [--cascades=name,...]
+//
+// fps 0, the default, replays as fast as detection keeps up, a negative fps
+// follows the recorded timestamps. Detection is the app's Face_Pipeline:
+// faces, eyes and smiles from the cascades in cascade dir, precompiled by
+// cascade_convert or XML, with the app's backend, skin prefilter, frame
+// budget and optional cascade settings. The frames can also be converted for other tools
+// instead, without detection:
+//
+//   frame_replay <frames.rec | file.y4m | image dir> --y4m out.y4m
+//
+// Besides the device executable this builds on a Linux host with OpenCV
+// installed, the test Makefile has the same sources:
+//
+//   make -C app/src/test/cpp frame_replay
+
+// OpenCV
+#include <opencv2/core.hpp>
+// OpenCV-NDK App
+#include "Cascade_Binary.h"
+#include "Face_Pipeline.h"
+#include "Haar_Cascade.h"
+#include "Lbp_Cascade.h"
+#include "Replay_Source.h"
+#include "Y4m_File.h"
+// STD Libs
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+// As CV_Main::LoadModel() with dir in place of the APK
+static Cascade_Model LoadModel(const std::string &dir, const std::string &name, bool lbp)
+{
+    Cascade_Model model;
+    model.binary = std::make_shared<Cascade_Binary>();
+    if (model.binary->Map(dir + "/" + Cascade_Binary::BinaryName(name)))
+    {
+        model.loaded = true;
+        return model;
+    }
+    model.binary.reset();
+    model.loaded = lbp ? model.lbp.Load(dir + "/" + name) : model.haar.Load(dir + "/" + name);
+    return model;
+}
+
+static bool ParseBackend(const std::string &name, Face_Backend *backend)
+{
+    const char *names[] = {"haar", "lbp", "ab", "cv"};
+    const Face_Backend backends[] = {HAAR_FACES, LBP_FACES, AB_FACES, OPENCV_AB_FACES};
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        if (name == names[i])
+        {
+            *backend = backends[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+// Writes every frame of source to a Y4M file
+static int ExportY4m(Replay_Source &source, const std::string &output)
+{
+    Y4m_Writer writer;
+    Yuv_Planes planes;
+    int32_t rotation = 0;
+    while (source.Acquire(&planes, &rotation))
+    {
+        if (!writer.IsOpen() &&
+            !writer.Open(output, planes.width, planes.height, planes.u != nullptr))
+        {
+            return 1;
+        }
+        bool written = writer.Write(planes);
+        source.Release();
+        if (!written)
+        {
+            return 1;
+        }
+    }
+    if (!writer.Close())
+    {
+        return 1;
+    }
+    fprintf(stderr, "%lld frames -> %s\n", (long long) writer.GetFrames(), output.c_str());
+    return 0;
+}
+
+static int Usage(const char *name)
+{
+    fprintf(stderr, "usage: %s <frames.rec | file.y4m | image dir> <cascade dir> "
+                    "[fps] [passes] [--faces=haar|lbp|ab|cv] [--skin] [--budget=ms]\n"
+                    "       [--cascades=name,...]\n"
+                    "       %s <frames.rec | file.y4m | image dir> --y4m out.y4m\n",
+            name, name);
+    return 2;
+}
+
+int main(int argc, char **argv)
+{
+    bool export_y4m = argc == 4 && std::string(argv[2]) == "--y4m";
+    std::vector<std::string> args;
+    Face_Backend backend = HAAR_FACES;
+    bool skin = false;
+    double budget_ms = 0.0;
+    std::vector<std::string> optional;
+    for (int i = 1; i < argc && !export_y4m; i++)
+    {
+        std::string arg = argv[i];
+        if (arg.compare(0, 8, "--faces=") == 0)
+        {
+            if (!ParseBackend(arg.substr(8), &backend))
+            {
+                return Usage(argv[0]);
+            }
+        }
+        else if (arg == "--skin")
+        {
+            skin = true;
+        }
+        else if (arg.compare(0, 9, "--budget=") == 0)
+        {
+            budget_ms = atof(arg.c_str() + 9);
+        }
+        else if (arg.compare(0, 11, "--cascades=") == 0)
+        {
+            std::string list = arg.substr(11) + ",";
+            for (size_t begin = 0, end; (end = list.find(',', begin)) != std::string::npos;
+                 begin = end + 1)
+            {
+                if (end > begin)
+                { optional.push_back(list.substr(begin, end - begin)); }
+            }
+        }
+        else if (arg.compare(0, 2, "--") == 0)
+        {
+            return Usage(argv[0]);
+        }
+        else
+        {
+            args.push_back(arg);
+        }
+    }
+    if (!export_y4m && (args.size() < 2 || args.size() > 4))
+    {
+        return Usage(argv[0]);
+    }
+
+    Replay_Source source;
+    double fps = args.size() > 2 ? atof(args[2].c_str()) : 0.0;
+    int32_t passes = args.size() > 3 ? atoi(args[3].c_str()) : 1;
+    if (!source.Open(export_y4m ? argv[1] : args[0], fps, passes))
+    {
+        return 1;
+    }
+    if (export_y4m)
+    {
+        return ExportY4m(source, argv[3]);
+    }
+
+    const std::string dir = args[1];
+    Cascade_Loader loader;
+    loader.model = [&dir](const std::string &name, bool lbp)
+    {
+        return LoadModel(dir, name, lbp);
+    };
+    loader.xml = [&dir](const std::string &name, Haar_Cascade &cascade)
+    {
+        return cascade.Load(dir + "/" + name);
+    };
+    Face_Pipeline pipeline;
+    if (!pipeline.Load(loader, backend, optional, budget_ms))
+    {
+        fprintf(stderr, "no face cascade in %s\n", dir.c_str());
+        return 1;
+    }
+    pipeline.SetSkinPrefilter(skin);
+
+    std::vector<double> frame_ms;
+    int64_t face_count = 0;
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    Yuv_Planes planes;
+    int32_t rotation = 0;
+    while (source.Acquire(&planes, &rotation))
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        pipeline.Process(planes, rotation);
+        frame_ms.push_back(std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count());
+
+        // frame, timestamp, face count, then x,y,w,h,eyes,smiling per face
+        const std::vector<Face_Result> &faces = pipeline.GetFaces();
+        face_count += (int64_t) faces.size();
+        printf("%zu %lld %zu", frame_ms.size() - 1, (long long) planes.timestamp, faces.size());
+        for (size_t i = 0; i < faces.size(); i++)
+        {
+            const cv::Rect &face = faces[i].face;
+            printf(" %d,%d,%d,%d,%zu,%d", face.x, face.y, face.width, face.height,
+                   faces[i].eyes.size(), faces[i].smiling ? 1 : 0);
+        }
+        printf("\n");
+        source.Release();
+    }
+
+    if (frame_ms.empty())
+    {
+        fprintf(stderr, "no frame could be read\n");
+        return 1;
+    }
+    double elapsed_s = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - begin).count();
+    double total_ms = 0.0;
+    for (size_t i = 0; i < frame_ms.size(); i++)
+    {
+        total_ms += frame_ms[i];
+    }
+    std::vector<double> sorted = frame_ms;
+    std::sort(sorted.begin(), sorted.end());
+    fprintf(stderr, "%zu frames in %.2f s, %.1f fps, detection %.2f ms mean, %.2f ms p50, "
+                    "%.2f ms p95, %lld faces\n", frame_ms.size(), elapsed_s,
+            frame_ms.size() / elapsed_s, total_ms / frame_ms.size(), sorted[sorted.size() / 2],
+            sorted[std::min(sorted.size() - 1, sorted.size() * 95 / 100)],
+            (long long) face_count);
+    return 0;
+}
@@ -0,0 +1,32 @@
+#ifndef OPENCV_NDK_FRAME_SOURCE_H
+#define OPENCV_NDK_FRAME_SOURCE_H
+
+// OpenCV-NDK App
+#include "Util.h"
+// STD Libs
+#include <cstdint>
+
+// Where the CV path gets its frames from. Camera_Source hands out what the
+// camera's image reader delivers, Replay_Source reads recorded frames back
+// on any platform, so detection runs the same on a device and on a host.
+class Frame_Source
+{
+public:
+    virtual ~Frame_Source()
+    {}
+
+    // Next frame in sensor orientation and the rotation that makes it
+    // upright. False when no frame is ready, or for a finite source once it
+    // ran out, see AtEnd(). planes stay valid until Release() or the next
+    // Acquire().
+    virtual bool Acquire(Yuv_Planes *planes, int32_t *rotation) = 0;
+
+    // Gives the last acquired frame back
+    virtual void Release() = 0;
+
+    // Whether Acquire() will never return a frame again
+    virtual bool AtEnd() const
+    { return false; }
+};
+
+#endif  // OPENCV_NDK_FRAME_SOURCE_H
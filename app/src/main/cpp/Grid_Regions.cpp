@@ -0,0 +1,101 @@
+#include "Grid_Regions.h"
+#include <algorithm>
+
+std::vector<cv::Rect> GridRegions(const uint8_t *flags, int32_t cols, int32_t rows,
+                                  int32_t cell_width, int32_t cell_height,
+                                  int32_t margin, const cv::Rect &bounds)
+{
+    std::vector<cv::Rect> regions;
+    const int32_t count = cols * rows;
+    std::vector<uint8_t> visited(count, 0);
+    std::vector<int32_t> stack;
+
+    for (int32_t start = 0; start < count; start++)
+    {
+        if (!flags[start] || visited[start])
+        {
+            continue;
+        }
+
+        int32_t min_x = cols, min_y = rows, max_x = 0, max_y = 0;
+        visited[start] = 1;
+        stack.push_back(start);
+        while (!stack.empty())
+        {
+            int32_t index = stack.back();
+            stack.pop_back();
+            int32_t cx = index % cols;
+            int32_t cy = index / cols;
+            min_x = std::min(min_x, cx);
+            max_x = std::max(max_x, cx);
+            min_y = std::min(min_y, cy);
+            max_y = std::max(max_y, cy);
+
+            const int32_t neighbours[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+            for (int i = 0; i < 4; i++)
+            {
+                int32_t nx = cx + neighbours[i][0];
+                int32_t ny = cy + neighbours[i][1];
+                if (nx < 0 || ny < 0 || nx >= cols || ny >= rows)
+                { continue; }
+                int32_t next = ny * cols + nx;
+                if (flags[next] && !visited[next])
+                {
+                    visited[next] = 1;
+                    stack.push_back(next);
+                }
+            }
+        }
+
+        cv::Rect region(min_x * cell_width - margin,
+                        min_y * cell_height - margin,
+                        (max_x - min_x + 1) * cell_width + 2 * margin,
+                        (max_y - min_y + 1) * cell_height + 2 * margin);
+        region &= bounds;
+        if (region.area() > 0)
+        {
+            regions.push_back(region);
+        }
+    }
+
+    return regions;
+}
+
+cv::Rect RotateRect(const cv::Rect &rect, int32_t width, int32_t height, int32_t angle)
+{
+    switch (angle)
+    {
+        case 90:
+            // [x, y] --> [height - 1 - y, x]
+            return cv::Rect(height - rect.y - rect.height, rect.x, rect.height, rect.width);
+        case 180:
+            return cv::Rect(width - rect.x - rect.width, height - rect.y - rect.height,
+                            rect.width, rect.height);
+        case 270:
+            // [x, y] --> [y, width - 1 - x]
+            return cv::Rect(rect.y, width - rect.x - rect.width, rect.height, rect.width);
+        default:
+            return rect;
+    }
+}
+
+void RotateImage(const cv::Mat &src, cv::Mat &dst, int32_t angle)
+{
+    switch (angle)
+    {
+        case 90:
+            cv::transpose(src, dst);
+            cv::flip(dst, dst, 1);
+            break;
+        case 180:
+            cv::flip(src, dst, -1);
+            break;
+        case 270:
+            cv::transpose(src, dst);
+            cv::flip(dst, dst, 0);
+            break;
+        default:
+            src.copyTo(dst);
+            break;
+    }
+}
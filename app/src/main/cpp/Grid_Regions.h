@@ -0,0 +1,25 @@
+#ifndef OPENCV_NDK_GRID_REGIONS_H
+#define OPENCV_NDK_GRID_REGIONS_H
+
+// OpenCV
+#include <opencv2/core.hpp>
+// STD Libs
+#include <cstdint>
+#include <vector>
+
+// Groups the set cells of a cols x rows flag grid into 4-connected components
+// and returns their bounding boxes in pixels. Each box is grown by margin on
+// every side and clipped to bounds.
+std::vector<cv::Rect> GridRegions(const uint8_t *flags, int32_t cols, int32_t rows,
+                                  int32_t cell_width, int32_t cell_height,
+                                  int32_t margin, const cv::Rect &bounds);
+
+// Maps a rectangle of a width x height source image into the image produced
+// by the matching PresentImage90/180/270() rotation (angle 0, 90, 180, 270).
+cv::Rect RotateRect(const cv::Rect &rect, int32_t width, int32_t height, int32_t angle);
+
+// Same rotation for a whole image, pixels of src end up where RotateRect()
+// maps them in dst
+void RotateImage(const cv::Mat &src, cv::Mat &dst, int32_t angle);
+
+#endif  // OPENCV_NDK_GRID_REGIONS_H
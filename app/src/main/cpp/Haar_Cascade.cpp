@@ -0,0 +1,402 @@
+#include "Haar_Cascade.h"
+#include "Util.h"
+#include <algorithm>
+#include <cstdio>
+
+// Flattens a sequence node such as "8 7 12 1 -1." into numbers
+static void ReadNumbers(const cv::FileNode &node, std::vector<double> &values)
+{
+    values.clear();
+    if (node.isSeq())
+    {
+        for (cv::FileNodeIterator it = node.begin(); it != node.end(); ++it)
+        {
+            values.push_back((double) *it);
+        }
+    }
+    else if (node.isReal() || node.isInt())
+    {
+        values.push_back((double) node);
+    }
+}
+
+bool Haar_Cascade::Load(const std::string &filename)
+{
+    cv::FileStorage fs(filename, cv::FileStorage::READ);
+    if (!fs.isOpened())
+    {
+        LOGE("Haar_Cascade: cannot open %s", filename.c_str());
+        return false;
+    }
+    return Read(fs.getFirstTopLevelNode());
+}
+
+bool Haar_Cascade::LoadMemory(const char *data, size_t size)
+{
+    cv::FileStorage fs(cv::String(data, size), cv::FileStorage::READ | cv::FileStorage::MEMORY);
+    if (!fs.isOpened())
+    {
+        LOGE("Haar_Cascade: cannot parse %zu bytes", size);
+        return false;
+    }
+    return Read(fs.getFirstTopLevelNode());
+}
+
+bool Haar_Cascade::Read(const cv::FileNode &root)
+{
+    width = height = 0;
+    stages.clear();
+    features.clear();
+
+    bool ok = root["stageType"].empty() ? ReadOld(root) : ReadCurrent(root);
+    if (!ok)
+    {
+        stages.clear();
+        features.clear();
+    }
+    return ok;
+}
+
+int32_t Haar_Cascade::ReadFeature(const cv::FileNode &node)
+{
+    Haar_Feature feature;
+    feature.rect_count = 0;
+    feature.tilted = (int) node["tilted"] != 0;
+
+    std::vector<double> values;
+    cv::FileNode rects = node["rects"];
+    for (cv::FileNodeIterator it = rects.begin(); it != rects.end() && feature.rect_count < 3; ++it)
+    {
+        ReadNumbers(*it, values);
+        if (values.size() != 5)
+        {
+            return -1;
+        }
+        Haar_Rect &rect = feature.rects[feature.rect_count++];
+        rect.x = (int32_t) values[0];
+        rect.y = (int32_t) values[1];
+        rect.width = (int32_t) values[2];
+        rect.height = (int32_t) values[3];
+        rect.weight = (float) values[4];
+    }
+
+    if (feature.rect_count < 2)
+    {
+        return -1;
+    }
+    features.push_back(feature);
+    return (int32_t) features.size() - 1;
+}
+
+bool Haar_Cascade::ReadCurrent(const cv::FileNode &root)
+{
+    if ((std::string) root["stageType"] != "BOOST" || (std::string) root["featureType"] != "HAAR")
+    {
+        LOGE("Haar_Cascade: only BOOST cascades of HAAR features are supported");
+        return false;
+    }
+
+    width = (int) root["width"];
+    height = (int) root["height"];
+
+    std::vector<double> values;
+    cv::FileNode stage_nodes = root["stages"];
+    for (cv::FileNodeIterator s = stage_nodes.begin(); s != stage_nodes.end(); ++s)
+    {
+        Haar_Stage stage;
+        stage.threshold = (float) (*s)["stageThreshold"];
+
+        cv::FileNode weak_nodes = (*s)["weakClassifiers"];
+        for (cv::FileNodeIterator w = weak_nodes.begin(); w != weak_nodes.end(); ++w)
+        {
+            Haar_Weak weak;
+            ReadNumbers((*w)["internalNodes"], values);
+            if (values.empty() || values.size() % 4 != 0)
+            {
+                return false;
+            }
+            for (size_t i = 0; i < values.size(); i += 4)
+            {
+                Haar_Node node;
+                node.left = (int32_t) values[i + 0];
+                node.right = (int32_t) values[i + 1];
+                node.feature = (int32_t) values[i + 2];
+                node.threshold = (float) values[i + 3];
+                weak.nodes.push_back(node);
+            }
+
+            ReadNumbers((*w)["leafValues"], values);
+            for (size_t i = 0; i < values.size(); i++)
+            {
+                weak.leaves.push_back((float) values[i]);
+            }
+            stage.weaks.push_back(weak);
+        }
+        stages.push_back(stage);
+    }
+
+    cv::FileNode feature_nodes = root["features"];
+    for (cv::FileNodeIterator f = feature_nodes.begin(); f != feature_nodes.end(); ++f)
+    {
+        if (ReadFeature(*f) < 0)
+        {
+            return false;
+        }
+    }
+
+    // every node has to point at a parsed feature
+    for (size_t s = 0; s < stages.size(); s++)
+    {
+        for (size_t w = 0; w < stages[s].weaks.size(); w++)
+        {
+            const Haar_Weak &weak = stages[s].weaks[w];
+            for (size_t n = 0; n < weak.nodes.size(); n++)
+            {
+                if (weak.nodes[n].feature < 0 || weak.nodes[n].feature >= (int32_t) features.size())
+                {
+                    return false;
+                }
+            }
+        }
+    }
+
+    return width > 0 && height > 0 && !stages.empty();
+}
+
+bool Haar_Cascade::ReadOld(const cv::FileNode &root)
+{
+    std::vector<double> values;
+    ReadNumbers(root["size"], values);
+    if (values.size() != 2)
+    {
+        LOGE("Haar_Cascade: unknown cascade layout");
+        return false;
+    }
+    width = (int32_t) values[0];
+    height = (int32_t) values[1];
+
+    cv::FileNode stage_nodes = root["stages"];
+    for (cv::FileNodeIterator s = stage_nodes.begin(); s != stage_nodes.end(); ++s)
+    {
+        // stage trees (next != -1) only appear in very old experiments
+        if (!(*s)["next"].empty() && (int) (*s)["next"] != -1)
+        {
+            LOGE("Haar_Cascade: tree of stages is not supported");
+            return false;
+        }
+
+        Haar_Stage stage;
+        stage.threshold = (float) (*s)["stage_threshold"];
+
+        cv::FileNode trees = (*s)["trees"];
+        for (cv::FileNodeIterator t = trees.begin(); t != trees.end(); ++t)
+        {
+            Haar_Weak weak;
+            for (cv::FileNodeIterator n = (*t).begin(); n != (*t).end(); ++n)
+            {
+                Haar_Node node;
+                node.feature = ReadFeature((*n)["feature"]);
+                node.threshold = (float) (*n)["threshold"];
+                if (node.feature < 0)
+                {
+                    return false;
+                }
+
+                if (!(*n)["left_node"].empty())
+                {
+                    node.left = (int) (*n)["left_node"];
+                }
+                else
+                {
+                    node.left = -(int32_t) weak.leaves.size();
+                    weak.leaves.push_back((float) (*n)["left_val"]);
+                }
+
+                if (!(*n)["right_node"].empty())
+                {
+                    node.right = (int) (*n)["right_node"];
+                }
+                else
+                {
+                    node.right = -(int32_t) weak.leaves.size();
+                    weak.leaves.push_back((float) (*n)["right_val"]);
+                }
+                weak.nodes.push_back(node);
+            }
+
+            if (weak.nodes.empty())
+            {
+                return false;
+            }
+            stage.weaks.push_back(weak);
+        }
+        stages.push_back(stage);
+    }
+
+    return width > 0 && height > 0 && !stages.empty();
+}
+
+// Maps an upright rectangle of a width x height window, see RotateRect()
+static Haar_Rect RotateHaarRect(const Haar_Rect &r, int32_t width, int32_t height, int32_t angle)
+{
+    Haar_Rect out = r;
+    switch (angle)
+    {
+        case 90:
+            out.x = height - r.y - r.height;
+            out.y = r.x;
+            out.width = r.height;
+            out.height = r.width;
+            break;
+        case 180:
+            out.x = width - r.x - r.width;
+            out.y = height - r.y - r.height;
+            break;
+        case 270:
+            out.x = r.y;
+            out.y = width - r.x - r.width;
+            out.width = r.height;
+            out.height = r.width;
+            break;
+        default:
+            break;
+    }
+    return out;
+}
+
+// Same for a 45 degree rectangle turned by 180 degrees. Its corners are
+// (x, y), (x + w, y + w), (x - h, y + h) and (x + w - h, y + w + h), the
+// bottom one becomes the new top corner. OpenCV's tilted integral at column
+// X sums a triangle centred on pixel column X - 1, so the mirrored corner
+// lands one column further right than the plain mirror of x.
+static Haar_Rect RotateTiltedRect180(const Haar_Rect &r, int32_t width, int32_t height)
+{
+    Haar_Rect out = r;
+    out.x = width - r.x - r.width + r.height + 1;
+    out.y = height - r.y - r.width - r.height;
+    return out;
+}
+
+bool Haar_Cascade::HasTilted() const
+{
+    for (size_t f = 0; f < features.size(); f++)
+    {
+        if (features[f].tilted)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+Haar_Cascade Haar_Cascade::Rotated(int32_t angle) const
+{
+    if ((angle == 90 || angle == 270) && HasTilted())
+    {
+        return Haar_Cascade();
+    }
+
+    Haar_Cascade rotated = *this;
+    if (angle == 90 || angle == 270)
+    {
+        rotated.width = height;
+        rotated.height = width;
+    }
+
+    for (size_t f = 0; f < rotated.features.size(); f++)
+    {
+        Haar_Feature &feature = rotated.features[f];
+        for (int32_t r = 0; r < feature.rect_count; r++)
+        {
+            if (!feature.tilted)
+            {
+                feature.rects[r] = RotateHaarRect(feature.rects[r], width, height, angle);
+            }
+            else if (angle == 180)
+            {
+                feature.rects[r] = RotateTiltedRect180(feature.rects[r], width, height);
+            }
+        }
+    }
+    return rotated;
+}
+
+std::string Haar_Cascade::ToXml() const
+{
+    char buf[256];
+    size_t max_weak = 0;
+    for (size_t s = 0; s < stages.size(); s++)
+    {
+        max_weak = std::max(max_weak, stages[s].weaks.size());
+    }
+
+    std::string xml = "<?xml version=\"1.0\"?>\n<opencv_storage>\n"
+            "<cascade type_id=\"opencv-cascade-classifier\">\n"
+            "<stageType>BOOST</stageType>\n<featureType>HAAR</featureType>\n";
+    snprintf(buf, sizeof(buf),
+             "<height>%d</height>\n<width>%d</width>\n"
+             "<stageParams><maxWeakCount>%d</maxWeakCount></stageParams>\n"
+             "<featureParams><maxCatCount>0</maxCatCount></featureParams>\n"
+             "<stageNum>%d</stageNum>\n<stages>\n",
+             height, width, (int) max_weak, (int) stages.size());
+    xml += buf;
+
+    for (size_t s = 0; s < stages.size(); s++)
+    {
+        const Haar_Stage &stage = stages[s];
+        snprintf(buf, sizeof(buf),
+                 "<_><maxWeakCount>%d</maxWeakCount><stageThreshold>%.9g</stageThreshold>\n"
+                 "<weakClassifiers>\n",
+                 (int) stage.weaks.size(), stage.threshold);
+        xml += buf;
+
+        for (size_t w = 0; w < stage.weaks.size(); w++)
+        {
+            const Haar_Weak &weak = stage.weaks[w];
+            xml += "<_><internalNodes>";
+            for (size_t n = 0; n < weak.nodes.size(); n++)
+            {
+                const Haar_Node &node = weak.nodes[n];
+                snprintf(buf, sizeof(buf), " %d %d %d %.9g", node.left, node.right,
+                         node.feature, node.threshold);
+                xml += buf;
+            }
+            xml += "</internalNodes><leafValues>";
+            for (size_t l = 0; l < weak.leaves.size(); l++)
+            {
+                snprintf(buf, sizeof(buf), " %.9g", weak.leaves[l]);
+                xml += buf;
+            }
+            xml += "</leafValues></_>\n";
+        }
+        xml += "</weakClassifiers></_>\n";
+    }
+    xml += "</stages>\n<features>\n";
+
+    for (size_t f = 0; f < features.size(); f++)
+    {
+        const Haar_Feature &feature = features[f];
+        xml += "<_><rects>";
+        for (int32_t r = 0; r < feature.rect_count; r++)
+        {
+            const Haar_Rect &rect = feature.rects[r];
+            snprintf(buf, sizeof(buf), "<_>%d %d %d %d %.9g</_>", rect.x, rect.y,
+                     rect.width, rect.height, rect.weight);
+            xml += buf;
+        }
+        snprintf(buf, sizeof(buf), "</rects><tilted>%d</tilted></_>\n", feature.tilted ? 1 : 0);
+        xml += buf;
+    }
+    xml += "</features>\n</cascade>\n</opencv_storage>\n";
+    return xml;
+}
+
+bool Haar_Cascade::ToClassifier(cv::CascadeClassifier &classifier) const
+{
+    if (Empty())
+    {
+        return false;
+    }
+    cv::FileStorage fs(ToXml(), cv::FileStorage::READ | cv::FileStorage::MEMORY);
+    return fs.isOpened() && classifier.read(fs.getFirstTopLevelNode());
+}
@@ -0,0 +1,93 @@
+#ifndef OPENCV_NDK_HAAR_CASCADE_H
+#define OPENCV_NDK_HAAR_CASCADE_H
+
+// OpenCV
+#include <opencv2/core.hpp>
+#include <opencv2/objdetect.hpp>
+// STD Libs
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One weighted rectangle of a Haar feature, in window pixels
+struct Haar_Rect
+{
+    int32_t x, y, width, height;
+    float weight;
+};
+
+// Up to three rectangles. Tilted rectangles are rotated by 45 degrees around
+// their top corner (x, y), same convention as OpenCV.
+struct Haar_Feature
+{
+    Haar_Rect rects[3];
+    int32_t rect_count;
+    bool tilted;
+};
+
+// Decision tree node. A child index > 0 is another node of the same tree,
+// <= 0 is the leaf -index, same encoding as the OpenCV internalNodes.
+struct Haar_Node
+{
+    int32_t left, right;
+    int32_t feature;
+    float threshold;
+};
+
+struct Haar_Weak
+{
+    std::vector<Haar_Node> nodes;
+    std::vector<float> leaves;
+};
+
+struct Haar_Stage
+{
+    float threshold;
+    std::vector<Haar_Weak> weaks;
+};
+
+// In memory copy of a Haar cascade, independent of cv::CascadeClassifier so
+// the app can inspect and transform the bundled models before handing them
+// to a detector. Reads both the current BOOST/HAAR layout and the old
+// opencv-haar-classifier one.
+class Haar_Cascade
+{
+public:
+    bool Load(const std::string &filename);
+    // Parses XML already in memory, e.g. an Asset_File
+    bool LoadMemory(const char *data, size_t size);
+    bool Read(const cv::FileNode &root);
+
+    bool Empty() const
+    { return stages.empty(); }
+
+    // Whether any feature uses the 45 degree integral
+    bool HasTilted() const;
+
+    // Same cascade for objects turned by the matching PresentImage90/180/270()
+    // rotation, i.e. features are mapped through RotateRect(). A quarter turn
+    // of a tilted rectangle is no tilted rectangle on OpenCV's discrete 45
+    // degree integral, so cascades with tilted features come back empty for
+    // 90 and 270. At 180 tilted rectangles along the left edge end one
+    // integral column past the window. Cascade_Scheduler runs tilted
+    // cascades upright on a rotated copy of the frame instead.
+    Haar_Cascade Rotated(int32_t angle) const;
+
+    // Serialises to the current OpenCV cascade XML layout
+    std::string ToXml() const;
+
+    // Loads the cascade into an OpenCV classifier without touching storage
+    bool ToClassifier(cv::CascadeClassifier &classifier) const;
+
+    int32_t width = 0;
+    int32_t height = 0;
+    std::vector<Haar_Stage> stages;
+    std::vector<Haar_Feature> features;
+
+private:
+    bool ReadCurrent(const cv::FileNode &root);
+    bool ReadOld(const cv::FileNode &root);
+    int32_t ReadFeature(const cv::FileNode &node);
+};
+
+#endif  // OPENCV_NDK_HAAR_CASCADE_H
@@ -0,0 +1,146 @@
+#include "Hal_Face_Detector.h"
+#include "Util.h"
+#include <algorithm>
+
+bool Hal_Face_Detector::Init(const ACameraMetadata *characteristics)
+{
+    m_mode = ACAMERA_STATISTICS_FACE_DETECT_MODE_OFF;
+    m_enabled = false;
+    if (characteristics == nullptr)
+    {
+        return false;
+    }
+
+    ACameraMetadata_const_entry entry;
+    if (ACameraMetadata_getConstEntry(characteristics,
+                                      ACAMERA_STATISTICS_INFO_AVAILABLE_FACE_DETECT_MODES,
+                                      &entry) != ACAMERA_OK)
+    {
+        return false;
+    }
+    // SIMPLE only reports rectangles and scores, all the app uses
+    for (uint32_t i = 0; i < entry.count; i++)
+    {
+        uint8_t mode = entry.data.u8[i];
+        if (mode == ACAMERA_STATISTICS_FACE_DETECT_MODE_SIMPLE ||
+            (mode == ACAMERA_STATISTICS_FACE_DETECT_MODE_FULL &&
+             m_mode == ACAMERA_STATISTICS_FACE_DETECT_MODE_OFF))
+        {
+            m_mode = mode;
+        }
+    }
+
+    if (ACameraMetadata_getConstEntry(characteristics, ACAMERA_SENSOR_INFO_ACTIVE_ARRAY_SIZE,
+                                      &entry) != ACAMERA_OK || entry.count < 4)
+    {
+        m_mode = ACAMERA_STATISTICS_FACE_DETECT_MODE_OFF;
+        return false;
+    }
+    m_active_array = cv::Rect(entry.data.i32[0], entry.data.i32[1], entry.data.i32[2],
+                              entry.data.i32[3]);
+    return m_mode != ACAMERA_STATISTICS_FACE_DETECT_MODE_OFF && m_active_array.area() > 0;
+}
+
+bool Hal_Face_Detector::Enable(ACaptureRequest *request)
+{
+    if (request == nullptr || m_mode == ACAMERA_STATISTICS_FACE_DETECT_MODE_OFF)
+    {
+        return false;
+    }
+    camera_status_t status = ACaptureRequest_setEntry_u8(
+            request, ACAMERA_STATISTICS_FACE_DETECT_MODE, 1, &m_mode);
+    if (status != ACAMERA_OK)
+    {
+        LOGE("Hal_Face_Detector: cannot set face detect mode (reason: %d)", status);
+        return false;
+    }
+    m_enabled = true;
+    return true;
+}
+
+void Hal_Face_Detector::OnResult(const ACameraMetadata *result)
+{
+    if (!m_enabled || result == nullptr)
+    {
+        return;
+    }
+
+    std::vector<cv::Rect> faces;
+    std::vector<uint8_t> scores;
+    ACameraMetadata_const_entry entry;
+    if (ACameraMetadata_getConstEntry(result, ACAMERA_STATISTICS_FACE_RECTANGLES,
+                                      &entry) == ACAMERA_OK)
+    {
+        // left, top, right and bottom per face
+        for (uint32_t i = 0; i + 3 < entry.count; i += 4)
+        {
+            faces.push_back(cv::Rect(cv::Point(entry.data.i32[i], entry.data.i32[i + 1]),
+                                     cv::Point(entry.data.i32[i + 2], entry.data.i32[i + 3])));
+        }
+    }
+    scores.assign(faces.size(), 100);
+    if (ACameraMetadata_getConstEntry(result, ACAMERA_STATISTICS_FACE_SCORES,
+                                      &entry) == ACAMERA_OK)
+    {
+        for (uint32_t i = 0; i < entry.count && i < scores.size(); i++)
+        {
+            scores[i] = entry.data.u8[i];
+        }
+    }
+
+    cv::Rect crop = m_active_array;
+    if (ACameraMetadata_getConstEntry(result, ACAMERA_SCALER_CROP_REGION,
+                                      &entry) == ACAMERA_OK && entry.count >= 4)
+    {
+        crop = cv::Rect(entry.data.i32[0], entry.data.i32[1], entry.data.i32[2],
+                        entry.data.i32[3]);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_faces.swap(faces);
+    m_scores.swap(scores);
+    m_crop = crop;
+}
+
+void Hal_Face_Detector::Disable()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_enabled = false;
+    m_faces.clear();
+    m_scores.clear();
+}
+
+std::vector<cv::Rect> Hal_Face_Detector::GetFaces(int32_t width, int32_t height,
+                                                  uint8_t min_score) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::vector<cv::Rect> faces;
+    if (m_crop.area() <= 0 || width <= 0 || height <= 0)
+    {
+        return faces;
+    }
+
+    // the stream is the crop region scaled down, with its longer side
+    // trimmed to the stream's aspect ratio around the centre
+    double scale = std::min((double) m_crop.width / width, (double) m_crop.height / height);
+    double left = m_crop.x + (m_crop.width - width * scale) * 0.5;
+    double top = m_crop.y + (m_crop.height - height * scale) * 0.5;
+    cv::Rect frame(0, 0, width, height);
+    for (size_t i = 0; i < m_faces.size(); i++)
+    {
+        if (m_scores[i] < min_score)
+        {
+            continue;
+        }
+        const cv::Rect &face = m_faces[i];
+        cv::Rect mapped(cvRound((face.x - left) / scale), cvRound((face.y - top) / scale),
+                        cvRound(face.width / scale), cvRound(face.height / scale));
+        mapped &= frame;
+        if (mapped.area() > 0)
+        {
+            faces.push_back(mapped);
+        }
+    }
+    return faces;
+}
@@ -0,0 +1,55 @@
+#ifndef OPENCV_NDK_HAL_FACE_DETECTOR_H
+#define OPENCV_NDK_HAL_FACE_DETECTOR_H
+
+// Android
+#include <camera/NdkCameraMetadata.h>
+#include <camera/NdkCaptureRequest.h>
+// OpenCV
+#include <opencv2/core.hpp>
+// STD Libs
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Faces found by the camera's ISP. Enabled on the preview request, the
+// rectangles then arrive with every capture result at no CPU cost. They are
+// given on the sensor's active pixel array and mapped onto the frames of the
+// image reader here, so they line up with the luma plane the cascades see.
+class Hal_Face_Detector
+{
+public:
+    // Picks the cheapest face detect mode the camera lists, false when it
+    // has none and the cascades have to find the faces
+    bool Init(const ACameraMetadata *characteristics);
+
+    // Turns face detection on in request, Init() must have succeeded
+    bool Enable(ACaptureRequest *request);
+
+    bool IsEnabled() const
+    { return m_enabled; }
+
+    // Called with every capture result, on the camera's callback thread
+    void OnResult(const ACameraMetadata *result);
+
+    // Faces of the latest result scoring at least min_score (1 to 100), in
+    // pixels of a width x height frame
+    std::vector<cv::Rect> GetFaces(int32_t width, int32_t height, uint8_t min_score) const;
+
+    // The request is gone, forget its results
+    void Disable();
+
+private:
+    uint8_t m_mode = 0;
+    // read on the camera's callback thread
+    std::atomic<bool> m_enabled{false};
+    // left, top, width and height on the sensor
+    cv::Rect m_active_array;
+
+    mutable std::mutex m_mutex;
+    std::vector<cv::Rect> m_faces;
+    std::vector<uint8_t> m_scores;
+    cv::Rect m_crop;
+};
+
+#endif  // OPENCV_NDK_HAL_FACE_DETECTOR_H
@@ -455,4 +455,36 @@ void Image_Reader::PresentImage270(ANativeWindow_Buffer *buf, AImage *image)
 void Image_Reader::SetPresentRotation(int32_t angle)
 {
     presentRotation_ = angle;
-}
\ No newline at end of file
+}
+bool GetYuvPlanes(AImage *image, Yuv_Planes *planes)
+{
+    int32_t format = -1;
+    int32_t num_planes = 0;
+    if (AImage_getFormat(image, &format) != AMEDIA_OK ||
+        format != AIMAGE_FORMAT_YUV_420_888 ||
+        AImage_getNumberOfPlanes(image, &num_planes) != AMEDIA_OK || num_planes != 3)
+    {
+        return false;
+    }
+
+    uint8_t *data = nullptr;
+    int32_t len = 0;
+    AImage_getWidth(image, &planes->width);
+    AImage_getHeight(image, &planes->height);
+    AImage_getPlaneRowStride(image, 0, &planes->y_stride);
+    AImage_getPlaneRowStride(image, 1, &planes->uv_stride);
+    AImage_getPlanePixelStride(image, 1, &planes->uv_pixel_stride);
+    AImage_getPlaneData(image, 0, &data, &len);
+    planes->y = data;
+    AImage_getPlaneData(image, 1, &data, &len);
+    planes->u = data;
+    AImage_getPlaneData(image, 2, &data, &len);
+    planes->v = data;
+    if (AImage_getTimestamp(image, &planes->timestamp) != AMEDIA_OK)
+    {
+        planes->timestamp = 0;
+    }
+
+    return planes->y != nullptr && planes->u != nullptr && planes->v != nullptr;
+}
+
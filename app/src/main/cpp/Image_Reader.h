@@ -16,6 +16,7 @@
 
 #ifndef OPENCV_NDK_IMAGE_READER_H
 #define OPENCV_NDK_IMAGE_READER_H
+#include "Grid_Regions.h"  // RotateRect()
 #include "Util.h"
 #include <media/NdkImageReader.h>
 #include <opencv2/core.hpp>
@@ -78,6 +79,7 @@ class Image_Reader {
    *    Human Rotation (rotated degree related to Phone native orientation
    */
   void SetPresentRotation(int32_t angle);
+  int32_t GetPresentRotation(void) const { return presentRotation_; }
 
  private:
   int32_t presentRotation_;
@@ -99,4 +101,11 @@ class Image_Reader {
   int32_t uvPixelStride;
 };
 
+/**
+ * Fills planes with the plane pointers and strides of a YUV_420_888 image.
+ * The pointers stay valid until the image is deleted.
+ * @return false if the image is not a 3 plane YUV image
+ */
+bool GetYuvPlanes(AImage* image, Yuv_Planes* planes);
+
 #endif  // OPENCV_NDK_IMAGE_READER_H
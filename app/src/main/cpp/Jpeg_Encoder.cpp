@@ -0,0 +1,463 @@
+#include "Jpeg_Encoder.h"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+// Zigzag position to natural, row major, index of an 8x8 block
+static const uint8_t ZIGZAG[64] = {
+        0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+        12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+        35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+        58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+// Quantization and Huffman tables from Annex K of the standard
+static const uint8_t LUMA_QUANT[64] = {
+        16, 11, 10, 16, 24, 40, 51, 61,
+        12, 12, 14, 19, 26, 58, 60, 55,
+        14, 13, 16, 24, 40, 57, 69, 56,
+        14, 17, 22, 29, 51, 87, 80, 62,
+        18, 22, 37, 56, 68, 109, 103, 77,
+        24, 35, 55, 64, 81, 104, 113, 92,
+        49, 64, 78, 87, 103, 121, 120, 101,
+        72, 92, 95, 98, 112, 100, 103, 99};
+
+static const uint8_t CHROMA_QUANT[64] = {
+        17, 18, 24, 47, 99, 99, 99, 99,
+        18, 21, 26, 66, 99, 99, 99, 99,
+        24, 26, 56, 99, 99, 99, 99, 99,
+        47, 66, 99, 99, 99, 99, 99, 99,
+        99, 99, 99, 99, 99, 99, 99, 99,
+        99, 99, 99, 99, 99, 99, 99, 99,
+        99, 99, 99, 99, 99, 99, 99, 99,
+        99, 99, 99, 99, 99, 99, 99, 99};
+
+static const uint8_t DC_LUMA_BITS[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+static const uint8_t DC_CHROMA_BITS[16] = {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0};
+static const uint8_t DC_VALUES[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+
+static const uint8_t AC_LUMA_BITS[16] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d};
+static const uint8_t AC_LUMA_VALUES[162] = {
+        0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51,
+        0x61, 0x07, 0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1,
+        0x15, 0x52, 0xd1, 0xf0, 0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18,
+        0x19, 0x1a, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39,
+        0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57,
+        0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75,
+        0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92,
+        0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+        0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+        0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8,
+        0xd9, 0xda, 0xe1, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2,
+        0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa};
+
+static const uint8_t AC_CHROMA_BITS[16] = {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77};
+static const uint8_t AC_CHROMA_VALUES[162] = {
+        0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07,
+        0x61, 0x71, 0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09,
+        0x23, 0x33, 0x52, 0xf0, 0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25,
+        0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38,
+        0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56,
+        0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74,
+        0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+        0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+        0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba,
+        0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6,
+        0xd7, 0xd8, 0xd9, 0xda, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2,
+        0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa};
+
+// Code and length of every symbol of one Huffman table
+struct Huffman_Code
+{
+    uint16_t code[256];
+    uint8_t size[256];
+
+    Huffman_Code(const uint8_t bits[16], const uint8_t *values)
+    {
+        std::fill(size, size + 256, 0);
+        uint16_t next = 0;
+        int32_t k = 0;
+        for (int32_t length = 1; length <= 16; length++, next <<= 1)
+        {
+            for (int32_t i = 0; i < bits[length - 1]; i++, k++, next++)
+            {
+                code[values[k]] = next;
+                size[values[k]] = (uint8_t) length;
+            }
+        }
+    }
+};
+
+// Per component state of one encode: quantization and Huffman tables
+struct Jpeg_Tables
+{
+    uint8_t quant[2][64];
+    // reciprocals of the quantizers with the scaling of the AAN DCT folded in
+    float divisor[2][64];
+    const Huffman_Code *dc[2];
+    const Huffman_Code *ac[2];
+};
+
+static void BuildTables(int32_t quality, Jpeg_Tables &tables)
+{
+    static const Huffman_Code dc_luma(DC_LUMA_BITS, DC_VALUES);
+    static const Huffman_Code dc_chroma(DC_CHROMA_BITS, DC_VALUES);
+    static const Huffman_Code ac_luma(AC_LUMA_BITS, AC_LUMA_VALUES);
+    static const Huffman_Code ac_chroma(AC_CHROMA_BITS, AC_CHROMA_VALUES);
+    static const double AAN_SCALE[8] = {1.0, 1.387039845, 1.306562965, 1.175875602,
+                                        1.0, 0.785694958, 0.541196100, 0.275899379};
+
+    // same curve as libjpeg's jpeg_set_quality
+    quality = std::min(100, std::max(1, quality));
+    const int32_t scale = quality < 50 ? 5000 / quality : 200 - 2 * quality;
+    const uint8_t *base[2] = {LUMA_QUANT, CHROMA_QUANT};
+    for (int32_t t = 0; t < 2; t++)
+    {
+        for (int32_t i = 0; i < 64; i++)
+        {
+            int32_t q = std::min(255, std::max(1, (base[t][i] * scale + 50) / 100));
+            tables.quant[t][i] = (uint8_t) q;
+            tables.divisor[t][i] = (float) (1.0 / (q * AAN_SCALE[i / 8] * AAN_SCALE[i % 8] * 8.0));
+        }
+    }
+    tables.dc[0] = &dc_luma;
+    tables.dc[1] = &dc_chroma;
+    tables.ac[0] = &ac_luma;
+    tables.ac[1] = &ac_chroma;
+}
+
+// Entropy coded bytes of one slice, 0xff stuffed with a zero byte
+class Bit_Writer
+{
+public:
+    explicit Bit_Writer(std::vector<uint8_t> &out) : m_out(out)
+    {}
+
+    void Put(uint32_t code, int32_t size)
+    {
+        m_bits = (m_bits << size) | (code & ((1u << size) - 1));
+        m_count += size;
+        while (m_count >= 8)
+        {
+            uint8_t byte = (uint8_t) (m_bits >> (m_count - 8));
+            m_out.push_back(byte);
+            if (byte == 0xff)
+            {
+                m_out.push_back(0);
+            }
+            m_count -= 8;
+        }
+    }
+
+    // pads the last byte with ones, as a restart marker or EOI must follow
+    // on a byte boundary
+    void Flush()
+    {
+        if (m_count > 0)
+        {
+            Put(0x7f, 8 - m_count);
+        }
+    }
+
+private:
+    std::vector<uint8_t> &m_out;
+    uint32_t m_bits = 0;
+    int32_t m_count = 0;
+};
+
+// Forward DCT of a level shifted block in place, the float AAN version of
+// libjpeg's jfdctflt.c. Outputs are scaled, the divisors undo that.
+static void ForwardDct(float *data)
+{
+    for (int32_t pass = 0; pass < 2; pass++)
+    {
+        // rows first, then columns
+        const int32_t step = pass == 0 ? 1 : 8;
+        const int32_t next = pass == 0 ? 8 : 1;
+        for (int32_t k = 0; k < 8; k++)
+        {
+            float *d = data + k * next;
+            float tmp0 = d[0] + d[7 * step];
+            float tmp7 = d[0] - d[7 * step];
+            float tmp1 = d[step] + d[6 * step];
+            float tmp6 = d[step] - d[6 * step];
+            float tmp2 = d[2 * step] + d[5 * step];
+            float tmp5 = d[2 * step] - d[5 * step];
+            float tmp3 = d[3 * step] + d[4 * step];
+            float tmp4 = d[3 * step] - d[4 * step];
+
+            float tmp10 = tmp0 + tmp3;
+            float tmp13 = tmp0 - tmp3;
+            float tmp11 = tmp1 + tmp2;
+            float tmp12 = tmp1 - tmp2;
+            d[0] = tmp10 + tmp11;
+            d[4 * step] = tmp10 - tmp11;
+            float z1 = (tmp12 + tmp13) * 0.707106781f;
+            d[2 * step] = tmp13 + z1;
+            d[6 * step] = tmp13 - z1;
+
+            tmp10 = tmp4 + tmp5;
+            tmp11 = tmp5 + tmp6;
+            tmp12 = tmp6 + tmp7;
+            float z5 = (tmp10 - tmp12) * 0.382683433f;
+            float z2 = 0.541196100f * tmp10 + z5;
+            float z4 = 1.306562965f * tmp12 + z5;
+            float z3 = tmp11 * 0.707106781f;
+            float z11 = tmp7 + z3;
+            float z13 = tmp7 - z3;
+            d[5 * step] = z13 + z2;
+            d[3 * step] = z13 - z2;
+            d[step] = z11 + z4;
+            d[7 * step] = z11 - z4;
+        }
+    }
+}
+
+// Copies the 8x8 block at (x0, y0) of a plane, level shifted, repeating the
+// last row and column past the plane's edge
+static void LoadBlock(const uint8_t *plane, int32_t stride, int32_t pixel_stride,
+                      int32_t width, int32_t height, int32_t x0, int32_t y0, float *block)
+{
+    for (int32_t r = 0; r < 8; r++)
+    {
+        const uint8_t *row = plane + (size_t) std::min(y0 + r, height - 1) * stride;
+        if (x0 + 8 <= width && pixel_stride == 1)
+        {
+            for (int32_t c = 0; c < 8; c++)
+            {
+                block[r * 8 + c] = (float) row[x0 + c] - 128.0f;
+            }
+            continue;
+        }
+        for (int32_t c = 0; c < 8; c++)
+        {
+            block[r * 8 + c] = (float) row[std::min(x0 + c, width - 1) * pixel_stride] - 128.0f;
+        }
+    }
+}
+
+static inline int32_t BitLength(int32_t value)
+{
+    int32_t length = 0;
+    for (value = value < 0 ? -value : value; value != 0; value >>= 1)
+    {
+        length++;
+    }
+    return length;
+}
+
+static void EncodeBlock(float *block, const Jpeg_Tables &tables, int32_t table,
+                        int32_t &predictor, Bit_Writer &writer)
+{
+    ForwardDct(block);
+    int32_t quantized[64];
+    const float *divisor = tables.divisor[table];
+    for (int32_t i = 0; i < 64; i++)
+    {
+        float value = block[ZIGZAG[i]] * divisor[ZIGZAG[i]];
+        quantized[i] = (int32_t) (value + 16384.5f) - 16384;
+    }
+
+    // negative values are sent as their ones' complement in size bits
+    const Huffman_Code &dc = *tables.dc[table];
+    int32_t diff = quantized[0] - predictor;
+    predictor = quantized[0];
+    int32_t size = BitLength(diff);
+    writer.Put(dc.code[size], dc.size[size]);
+    if (size > 0)
+    {
+        writer.Put((uint32_t) (diff < 0 ? diff - 1 : diff), size);
+    }
+
+    const Huffman_Code &ac = *tables.ac[table];
+    int32_t run = 0;
+    for (int32_t i = 1; i < 64; i++)
+    {
+        int32_t value = quantized[i];
+        if (value == 0)
+        {
+            run++;
+            continue;
+        }
+        for (; run >= 16; run -= 16)
+        {
+            writer.Put(ac.code[0xf0], ac.size[0xf0]);
+        }
+        size = BitLength(value);
+        int32_t symbol = (run << 4) | size;
+        writer.Put(ac.code[symbol], ac.size[symbol]);
+        writer.Put((uint32_t) (value < 0 ? value - 1 : value), size);
+        run = 0;
+    }
+    if (run > 0)
+    {
+        writer.Put(ac.code[0x00], ac.size[0x00]);
+    }
+}
+
+// MCU rows first to last, 16x16 pixels each as four Y blocks, Cb and Cr
+static void EncodeSlice(const Yuv_Planes &planes, const Jpeg_Tables &tables, int32_t first,
+                        int32_t last, std::vector<uint8_t> &out)
+{
+    const int32_t uv_width = (planes.width + 1) / 2;
+    const int32_t uv_height = (planes.height + 1) / 2;
+    const int32_t mcus = (planes.width + 15) / 16;
+    out.clear();
+    out.reserve((size_t) planes.width * 16 * (last - first) / 4);
+    Bit_Writer writer(out);
+    // predictors restart with every slice
+    int32_t predictor[3] = {0, 0, 0};
+    float block[64];
+    for (int32_t my = first; my < last; my++)
+    {
+        for (int32_t mx = 0; mx < mcus; mx++)
+        {
+            for (int32_t b = 0; b < 4; b++)
+            {
+                LoadBlock(planes.y, planes.y_stride, 1, planes.width, planes.height,
+                          mx * 16 + (b & 1) * 8, my * 16 + (b >> 1) * 8, block);
+                EncodeBlock(block, tables, 0, predictor[0], writer);
+            }
+            LoadBlock(planes.u, planes.uv_stride, planes.uv_pixel_stride, uv_width, uv_height,
+                      mx * 8, my * 8, block);
+            EncodeBlock(block, tables, 1, predictor[1], writer);
+            LoadBlock(planes.v, planes.uv_stride, planes.uv_pixel_stride, uv_width, uv_height,
+                      mx * 8, my * 8, block);
+            EncodeBlock(block, tables, 1, predictor[2], writer);
+        }
+    }
+    writer.Flush();
+}
+
+static void PutMarker(std::vector<uint8_t> &out, uint8_t marker, uint16_t length)
+{
+    out.push_back(0xff);
+    out.push_back(marker);
+    out.push_back((uint8_t) (length >> 8));
+    out.push_back((uint8_t) length);
+}
+
+static void PutHuffman(std::vector<uint8_t> &out, uint8_t id, const uint8_t bits[16],
+                       const uint8_t *values)
+{
+    int32_t count = 0;
+    for (int32_t i = 0; i < 16; i++)
+    {
+        count += bits[i];
+    }
+    out.push_back(id);
+    out.insert(out.end(), bits, bits + 16);
+    out.insert(out.end(), values, values + count);
+}
+
+// Everything up to the entropy coded data
+static void BuildHeaders(const Yuv_Planes &planes, const Jpeg_Tables &tables,
+                         uint16_t restart_interval, std::vector<uint8_t> &out)
+{
+    out.push_back(0xff);
+    out.push_back(0xd8);
+
+    static const uint8_t jfif[14] = {'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0};
+    PutMarker(out, 0xe0, 16);
+    out.insert(out.end(), jfif, jfif + 14);
+
+    PutMarker(out, 0xdb, 2 + 2 * 65);
+    for (int32_t t = 0; t < 2; t++)
+    {
+        out.push_back((uint8_t) t);
+        for (int32_t i = 0; i < 64; i++)
+        {
+            out.push_back(tables.quant[t][ZIGZAG[i]]);
+        }
+    }
+
+    // baseline, 8 bit, Y sampled 2x2 against Cb and Cr
+    PutMarker(out, 0xc0, 17);
+    out.push_back(8);
+    out.push_back((uint8_t) (planes.height >> 8));
+    out.push_back((uint8_t) planes.height);
+    out.push_back((uint8_t) (planes.width >> 8));
+    out.push_back((uint8_t) planes.width);
+    out.push_back(3);
+    const uint8_t components[9] = {1, 0x22, 0, 2, 0x11, 1, 3, 0x11, 1};
+    out.insert(out.end(), components, components + 9);
+
+    PutMarker(out, 0xc4, 2 + 2 * (17 + 12) + 2 * (17 + 162));
+    PutHuffman(out, 0x00, DC_LUMA_BITS, DC_VALUES);
+    PutHuffman(out, 0x10, AC_LUMA_BITS, AC_LUMA_VALUES);
+    PutHuffman(out, 0x01, DC_CHROMA_BITS, DC_VALUES);
+    PutHuffman(out, 0x11, AC_CHROMA_BITS, AC_CHROMA_VALUES);
+
+    PutMarker(out, 0xdd, 4);
+    out.push_back((uint8_t) (restart_interval >> 8));
+    out.push_back((uint8_t) restart_interval);
+
+    PutMarker(out, 0xda, 12);
+    out.push_back(3);
+    const uint8_t scan[6] = {1, 0x00, 2, 0x11, 3, 0x11};
+    out.insert(out.end(), scan, scan + 6);
+    // full spectral range, no successive approximation
+    out.push_back(0);
+    out.push_back(63);
+    out.push_back(0);
+}
+
+bool WriteJpeg(const Yuv_Planes &planes, const std::string &filename, Worker_Pool *pool,
+               int32_t quality, int32_t restart_rows)
+{
+    if (planes.width <= 0 || planes.height <= 0 || planes.width > 0xffff ||
+        planes.height > 0xffff)
+    {
+        LOGE("WriteJpeg: cannot encode %dx%d", planes.width, planes.height);
+        return false;
+    }
+    const int32_t mcus = (planes.width + 15) / 16;
+    const int32_t mcu_rows = (planes.height + 15) / 16;
+    // the restart interval counts MCUs and has 16 bits
+    restart_rows = std::max(1, std::min(restart_rows, 0xffff / mcus));
+    const int32_t count = (mcu_rows + restart_rows - 1) / restart_rows;
+
+    Jpeg_Tables tables;
+    BuildTables(quality, tables);
+
+    std::vector<std::vector<uint8_t> > slices(count);
+    std::function<void(size_t)> task = [&](size_t s)
+    {
+        int32_t first = (int32_t) s * restart_rows;
+        EncodeSlice(planes, tables, first, std::min(mcu_rows, first + restart_rows), slices[s]);
+    };
+    if (pool != nullptr)
+    {
+        pool->ParallelFor(slices.size(), task);
+    }
+    else
+    {
+        for (size_t s = 0; s < slices.size(); s++)
+        {
+            task(s);
+        }
+    }
+
+    std::vector<uint8_t> headers;
+    BuildHeaders(planes, tables, (uint16_t) (mcus * restart_rows), headers);
+
+    FILE *file = fopen(filename.c_str(), "wb");
+    if (file == nullptr)
+    {
+        LOGE("WriteJpeg: cannot open %s", filename.c_str());
+        return false;
+    }
+    bool ok = fwrite(headers.data(), 1, headers.size(), file) == headers.size();
+    for (size_t s = 0; s < slices.size() && ok; s++)
+    {
+        if (s > 0)
+        {
+            // RST0 to RST7 in turn
+            const uint8_t marker[2] = {0xff, (uint8_t) (0xd0 + (s - 1) % 8)};
+            ok = fwrite(marker, 1, 2, file) == 2;
+        }
+        ok = ok && fwrite(slices[s].data(), 1, slices[s].size(), file) == slices[s].size();
+    }
+    const uint8_t end[2] = {0xff, 0xd9};
+    ok = ok && fwrite(end, 1, 2, file) == 2;
+    return fclose(file) == 0 && ok;
+}
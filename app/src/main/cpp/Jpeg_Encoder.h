@@ -0,0 +1,19 @@
+#ifndef OPENCV_NDK_JPEG_ENCODER_H
+#define OPENCV_NDK_JPEG_ENCODER_H
+
+// OpenCV-NDK App
+#include "Util.h"
+#include "Worker_Pool.h"
+// STD Libs
+#include <cstdint>
+#include <string>
+
+// Writes a YUV frame as a baseline 4:2:0 JPEG straight from its planes, no
+// RGB conversion and no chroma upsampling on the way. quality follows the
+// libjpeg scale of 1 to 100. A restart marker follows every restart_rows
+// rows of 16 pixel blocks, the slices between them are independent and get
+// encoded in parallel on pool.
+bool WriteJpeg(const Yuv_Planes &planes, const std::string &filename, Worker_Pool *pool,
+               int32_t quality = 90, int32_t restart_rows = 1);
+
+#endif  // OPENCV_NDK_JPEG_ENCODER_H
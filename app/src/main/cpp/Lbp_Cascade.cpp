@@ -0,0 +1,207 @@
+#include "Lbp_Cascade.h"
+#include "Util.h"
+
+// Flattens a sequence node into numbers, same as in Haar_Cascade.cpp
+static void ReadNumbers(const cv::FileNode &node, std::vector<double> &values)
+{
+    values.clear();
+    if (node.isSeq())
+    {
+        for (cv::FileNodeIterator it = node.begin(); it != node.end(); ++it)
+        {
+            values.push_back((double) *it);
+        }
+    }
+    else if (node.isReal() || node.isInt())
+    {
+        values.push_back((double) node);
+    }
+}
+
+bool Lbp_Cascade::Load(const std::string &filename)
+{
+    cv::FileStorage fs(filename, cv::FileStorage::READ);
+    if (!fs.isOpened())
+    {
+        LOGE("Lbp_Cascade: cannot open %s", filename.c_str());
+        return false;
+    }
+    return Read(fs.getFirstTopLevelNode());
+}
+
+bool Lbp_Cascade::LoadMemory(const char *data, size_t size)
+{
+    cv::FileStorage fs(cv::String(data, size), cv::FileStorage::READ | cv::FileStorage::MEMORY);
+    if (!fs.isOpened())
+    {
+        LOGE("Lbp_Cascade: cannot parse %zu bytes", size);
+        return false;
+    }
+    return Read(fs.getFirstTopLevelNode());
+}
+
+bool Lbp_Cascade::Read(const cv::FileNode &root)
+{
+    width = height = 0;
+    stages.clear();
+    features.clear();
+
+    if ((std::string) root["stageType"] != "BOOST" || (std::string) root["featureType"] != "LBP")
+    {
+        LOGE("Lbp_Cascade: only BOOST cascades of LBP features are supported");
+        return false;
+    }
+
+    width = (int) root["width"];
+    height = (int) root["height"];
+
+    // internalNodes hold left, right, feature and the 8 subset words
+    const size_t NODE_SIZE = 11;
+    std::vector<double> values;
+    cv::FileNode stage_nodes = root["stages"];
+    for (cv::FileNodeIterator s = stage_nodes.begin(); s != stage_nodes.end(); ++s)
+    {
+        Lbp_Stage stage;
+        stage.threshold = (float) (*s)["stageThreshold"];
+
+        cv::FileNode weak_nodes = (*s)["weakClassifiers"];
+        for (cv::FileNodeIterator w = weak_nodes.begin(); w != weak_nodes.end(); ++w)
+        {
+            Lbp_Weak weak;
+            ReadNumbers((*w)["internalNodes"], values);
+            if (values.empty() || values.size() % NODE_SIZE != 0)
+            {
+                stages.clear();
+                return false;
+            }
+            for (size_t i = 0; i < values.size(); i += NODE_SIZE)
+            {
+                Lbp_Node node;
+                node.left = (int32_t) values[i + 0];
+                node.right = (int32_t) values[i + 1];
+                node.feature = (int32_t) values[i + 2];
+                for (size_t k = 0; k < 8; k++)
+                {
+                    node.subset[k] = (int32_t) values[i + 3 + k];
+                }
+                weak.nodes.push_back(node);
+            }
+
+            ReadNumbers((*w)["leafValues"], values);
+            for (size_t i = 0; i < values.size(); i++)
+            {
+                weak.leaves.push_back((float) values[i]);
+            }
+            stage.weaks.push_back(weak);
+        }
+        stages.push_back(stage);
+    }
+
+    cv::FileNode feature_nodes = root["features"];
+    for (cv::FileNodeIterator f = feature_nodes.begin(); f != feature_nodes.end(); ++f)
+    {
+        ReadNumbers((*f)["rect"], values);
+        if (values.size() != 4)
+        {
+            stages.clear();
+            return false;
+        }
+        Lbp_Feature feature = {(int32_t) values[0], (int32_t) values[1],
+                               (int32_t) values[2], (int32_t) values[3]};
+        features.push_back(feature);
+    }
+
+    for (size_t s = 0; s < stages.size(); s++)
+    {
+        for (size_t w = 0; w < stages[s].weaks.size(); w++)
+        {
+            const Lbp_Weak &weak = stages[s].weaks[w];
+            for (size_t n = 0; n < weak.nodes.size(); n++)
+            {
+                if (weak.nodes[n].feature < 0 || weak.nodes[n].feature >= (int32_t) features.size())
+                {
+                    stages.clear();
+                    return false;
+                }
+            }
+        }
+    }
+
+    return width > 0 && height > 0 && !stages.empty();
+}
+
+// Neighbour blocks are coded clockwise from the top left one, 128 down to 1.
+// A clockwise quarter turn moves each of them two places further round.
+static int32_t RotateCode(int32_t code, int32_t quarters)
+{
+    int32_t shift = 2 * quarters;
+    return ((code >> shift) | (code << (8 - shift))) & 0xff;
+}
+
+Lbp_Cascade Lbp_Cascade::Rotated(int32_t angle) const
+{
+    int32_t quarters = angle / 90;
+    if (quarters <= 0 || quarters > 3)
+    {
+        return *this;
+    }
+
+    Lbp_Cascade rotated = *this;
+    if (quarters != 2)
+    {
+        rotated.width = height;
+        rotated.height = width;
+    }
+
+    for (size_t f = 0; f < features.size(); f++)
+    {
+        const Lbp_Feature &in = features[f];
+        Lbp_Feature &out = rotated.features[f];
+        int32_t grid_width = 3 * in.width;
+        int32_t grid_height = 3 * in.height;
+        switch (quarters)
+        {
+            case 1:
+                out.x = height - in.y - grid_height;
+                out.y = in.x;
+                out.width = in.height;
+                out.height = in.width;
+                break;
+            case 2:
+                out.x = width - in.x - grid_width;
+                out.y = height - in.y - grid_height;
+                break;
+            default:
+                out.x = in.y;
+                out.y = width - in.x - grid_width;
+                out.width = in.height;
+                out.height = in.width;
+                break;
+        }
+    }
+
+    for (size_t s = 0; s < rotated.stages.size(); s++)
+    {
+        for (size_t w = 0; w < rotated.stages[s].weaks.size(); w++)
+        {
+            std::vector<Lbp_Node> &nodes = rotated.stages[s].weaks[w].nodes;
+            for (size_t n = 0; n < nodes.size(); n++)
+            {
+                int32_t subset[8] = {0};
+                for (int32_t code = 0; code < 256; code++)
+                {
+                    if (nodes[n].subset[code >> 5] & (int32_t) (1u << (code & 31)))
+                    {
+                        int32_t turned = RotateCode(code, quarters);
+                        subset[turned >> 5] |= (int32_t) (1u << (turned & 31));
+                    }
+                }
+                for (int32_t k = 0; k < 8; k++)
+                {
+                    nodes[n].subset[k] = subset[k];
+                }
+            }
+        }
+    }
+    return rotated;
+}
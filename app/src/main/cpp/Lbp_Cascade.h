@@ -0,0 +1,64 @@
+#ifndef OPENCV_NDK_LBP_CASCADE_H
+#define OPENCV_NDK_LBP_CASCADE_H
+
+// OpenCV
+#include <opencv2/core.hpp>
+// STD Libs
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Multi-block LBP feature: a 3x3 grid of width x height blocks whose top
+// left corner is (x, y), in window pixels
+struct Lbp_Feature
+{
+    int32_t x, y, width, height;
+};
+
+// Categorical node. The 8 bit LBP code c goes left when bit c of subset is
+// set. Children use the same encoding as Haar_Node.
+struct Lbp_Node
+{
+    int32_t left, right;
+    int32_t feature;
+    int32_t subset[8];
+};
+
+struct Lbp_Weak
+{
+    std::vector<Lbp_Node> nodes;
+    std::vector<float> leaves;
+};
+
+struct Lbp_Stage
+{
+    float threshold;
+    std::vector<Lbp_Weak> weaks;
+};
+
+// In memory copy of a BOOST/LBP cascade such as lbpcascade_frontalface.xml.
+// The features only need the plain integral image and integer compares,
+// which makes them a lot cheaper than Haar features on ARM.
+class Lbp_Cascade
+{
+public:
+    bool Load(const std::string &filename);
+    // Parses XML already in memory, e.g. an Asset_File
+    bool LoadMemory(const char *data, size_t size);
+    bool Read(const cv::FileNode &root);
+
+    bool Empty() const
+    { return stages.empty(); }
+
+    // Same convention as Haar_Cascade::Rotated(). Turning the grid moves
+    // every neighbour block two places round the centre, so the codes and
+    // the subsets are rotated with it.
+    Lbp_Cascade Rotated(int32_t angle) const;
+
+    int32_t width = 0;
+    int32_t height = 0;
+    std::vector<Lbp_Stage> stages;
+    std::vector<Lbp_Feature> features;
+};
+
+#endif  // OPENCV_NDK_LBP_CASCADE_H
@@ -0,0 +1,162 @@
+#include "Motion_Detector.h"
+#include "Grid_Regions.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cstdlib>
+
+const int32_t Motion_Detector::BLOCK_SIZE;
+
+Motion_Detector::Motion_Detector(int32_t subsample, int32_t threshold)
+        : m_subsample(std::max(1, subsample)), m_threshold(threshold)
+{
+}
+
+void Motion_Detector::Reset()
+{
+    m_has_previous = false;
+}
+
+// Keeps every m_subsample-th pixel of every m_subsample-th row
+void Motion_Detector::Subsample(const uint8_t *luma, int32_t stride, uint8_t *dst)
+{
+    for (int32_t y = 0; y < m_plane_height; y++)
+    {
+        const uint8_t *src = luma + (y * m_subsample) * stride;
+        uint8_t *out = dst + y * m_plane_stride;
+        int32_t x = 0;
+
+        if (m_subsample == 4)
+        {
+            // 64 source bytes give 16 output bytes per iteration
+#if defined(OPENCV_NDK_NEON)
+            for (; (x + 16) * 4 <= m_width; x += 16)
+            {
+                uint8x16x4_t v = vld4q_u8(src + x * 4);
+                vst1q_u8(out + x, v.val[0]);
+            }
+#elif defined(OPENCV_NDK_SSE2)
+            const __m128i low_byte = _mm_set1_epi32(0xFF);
+            for (; (x + 16) * 4 <= m_width; x += 16)
+            {
+                const __m128i *p = reinterpret_cast<const __m128i *>(src + x * 4);
+                __m128i a0 = _mm_and_si128(_mm_loadu_si128(p + 0), low_byte);
+                __m128i a1 = _mm_and_si128(_mm_loadu_si128(p + 1), low_byte);
+                __m128i a2 = _mm_and_si128(_mm_loadu_si128(p + 2), low_byte);
+                __m128i a3 = _mm_and_si128(_mm_loadu_si128(p + 3), low_byte);
+                __m128i packed = _mm_packus_epi16(_mm_packs_epi32(a0, a1),
+                                                  _mm_packs_epi32(a2, a3));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x), packed);
+            }
+#endif
+        }
+
+        for (; x < m_plane_width; x++)
+        {
+            out[x] = src[x * m_subsample];
+        }
+    }
+}
+
+// Adds |a - b| of one padded row into the per 8 pixel block sums
+static void AccumulateRowSad(const uint8_t *a, const uint8_t *b, int32_t stride,
+                             uint32_t *block_sad)
+{
+    int32_t x = 0;
+#if defined(OPENCV_NDK_NEON)
+    for (; x + 16 <= stride; x += 16)
+    {
+        uint8x16_t diff = vabdq_u8(vld1q_u8(a + x), vld1q_u8(b + x));
+        uint64x2_t sum = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(diff)));
+        block_sad[(x >> 3) + 0] += (uint32_t) vgetq_lane_u64(sum, 0);
+        block_sad[(x >> 3) + 1] += (uint32_t) vgetq_lane_u64(sum, 1);
+    }
+#elif defined(OPENCV_NDK_SSE2)
+    for (; x + 16 <= stride; x += 16)
+    {
+        __m128i sum = _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + x)),
+                                   _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + x)));
+        block_sad[(x >> 3) + 0] += (uint32_t) _mm_cvtsi128_si32(sum);
+        block_sad[(x >> 3) + 1] += (uint32_t) _mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+    }
+#endif
+    for (; x < stride; x++)
+    {
+        block_sad[x >> 3] += (uint32_t) std::abs((int) a[x] - (int) b[x]);
+    }
+}
+
+bool Motion_Detector::Update(const uint8_t *luma, int32_t width, int32_t height, int32_t stride)
+{
+    if (luma == nullptr || width <= 0 || height <= 0)
+    {
+        return false;
+    }
+
+    if (width != m_width || height != m_height)
+    {
+        m_width = width;
+        m_height = height;
+        m_plane_width = (width + m_subsample - 1) / m_subsample;
+        m_plane_height = (height + m_subsample - 1) / m_subsample;
+        m_plane_stride = (m_plane_width + 15) & ~15;
+        // zeroed padding never contributes to the SAD
+        m_current.assign(m_plane_stride * m_plane_height, 0);
+        m_previous.assign(m_plane_stride * m_plane_height, 0);
+
+        m_blocks_x = (m_plane_width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        m_blocks_y = (m_plane_height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        m_block_count = m_blocks_x * m_blocks_y;
+        m_block_sad.assign((m_plane_stride / BLOCK_SIZE) * m_blocks_y, 0);
+        m_moving.assign(m_block_count, 0);
+        m_has_previous = false;
+    }
+
+    m_current.swap(m_previous);
+    Subsample(luma, stride, m_current.data());
+
+    if (!m_has_previous)
+    {
+        m_has_previous = true;
+        std::fill(m_moving.begin(), m_moving.end(), 1);
+        m_moving_count = m_block_count;
+        return true;
+    }
+
+    const int32_t sad_stride = m_plane_stride / BLOCK_SIZE;
+    std::fill(m_block_sad.begin(), m_block_sad.end(), 0);
+    for (int32_t y = 0; y < m_plane_height; y++)
+    {
+        AccumulateRowSad(m_current.data() + y * m_plane_stride,
+                         m_previous.data() + y * m_plane_stride,
+                         m_plane_stride,
+                         m_block_sad.data() + (y / BLOCK_SIZE) * sad_stride);
+    }
+
+    m_moving_count = 0;
+    for (int32_t by = 0; by < m_blocks_y; by++)
+    {
+        int32_t rows = std::min(BLOCK_SIZE, m_plane_height - by * BLOCK_SIZE);
+        for (int32_t bx = 0; bx < m_blocks_x; bx++)
+        {
+            int32_t cols = std::min(BLOCK_SIZE, m_plane_width - bx * BLOCK_SIZE);
+            uint32_t limit = (uint32_t) (m_threshold * rows * cols);
+            bool moved = m_block_sad[by * sad_stride + bx] > limit;
+            m_moving[by * m_blocks_x + bx] = moved ? 1 : 0;
+            m_moving_count += moved ? 1 : 0;
+        }
+    }
+
+    return m_moving_count > 0;
+}
+
+std::vector<cv::Rect> Motion_Detector::GetMotionRegions(int32_t margin) const
+{
+    if (m_moving_count == 0)
+    {
+        return std::vector<cv::Rect>();
+    }
+
+    const int32_t block_pixels = BLOCK_SIZE * m_subsample;
+    return GridRegions(m_moving.data(), m_blocks_x, m_blocks_y, block_pixels, block_pixels,
+                       margin, cv::Rect(0, 0, m_width, m_height));
+}
@@ -0,0 +1,80 @@
+#ifndef OPENCV_NDK_MOTION_DETECTOR_H
+#define OPENCV_NDK_MOTION_DETECTOR_H
+
+// OpenCV
+#include <opencv2/core.hpp>
+// STD Libs
+#include <cstdint>
+#include <vector>
+
+// Cheap scene activity estimator used to gate the cascades.
+// Every frame the luma plane is subsampled and compared block by block with
+// the previous one (sum of absolute differences). Blocks whose mean difference
+// is above the threshold are reported as moving.
+class Motion_Detector
+{
+public:
+    // Side of a SAD block in subsampled pixels, matches the 8 byte SIMD lanes
+    static const int32_t BLOCK_SIZE = 8;
+
+    // subsample: keep every Nth pixel in both directions
+    // threshold: mean absolute difference per pixel that counts as motion
+    explicit Motion_Detector(int32_t subsample = 4, int32_t threshold = 10);
+
+    // Feeds the next luma plane, returns true if any block moved since the
+    // previous call. The first frame and any size change count as motion.
+    bool Update(const uint8_t *luma, int32_t width, int32_t height, int32_t stride);
+
+    // Forget the previous frame, next Update() reports full motion
+    void Reset();
+
+    // Fraction of blocks that moved in the last Update(), 0 to 1
+    float GetActivity() const
+    { return m_block_count ? (float) m_moving_count / m_block_count : 0.0f; }
+
+    // Bounding boxes of connected moving blocks in full resolution pixels,
+    // grown by margin on every side and clipped to the frame
+    std::vector<cv::Rect> GetMotionRegions(int32_t margin) const;
+
+    // Subsampled luma of the last Update(), row stride is GetPlaneStride()
+    const uint8_t *GetPlane() const
+    { return m_current.data(); }
+    const uint8_t *GetPreviousPlane() const
+    { return m_previous.data(); }
+    int32_t GetPlaneWidth() const
+    { return m_plane_width; }
+    int32_t GetPlaneHeight() const
+    { return m_plane_height; }
+    int32_t GetPlaneStride() const
+    { return m_plane_stride; }
+    int32_t GetSubsample() const
+    { return m_subsample; }
+
+private:
+    void Subsample(const uint8_t *luma, int32_t stride, uint8_t *dst);
+
+    int32_t m_subsample;
+    int32_t m_threshold;
+
+    // full resolution size of the frames being fed
+    int32_t m_width = 0;
+    int32_t m_height = 0;
+
+    // subsampled planes, stride padded to 16 bytes with zeroes
+    int32_t m_plane_width = 0;
+    int32_t m_plane_height = 0;
+    int32_t m_plane_stride = 0;
+    std::vector<uint8_t> m_current;
+    std::vector<uint8_t> m_previous;
+    bool m_has_previous = false;
+
+    // per block SAD and the moving flag grid
+    int32_t m_blocks_x = 0;
+    int32_t m_blocks_y = 0;
+    int32_t m_block_count = 0;
+    int32_t m_moving_count = 0;
+    std::vector<uint32_t> m_block_sad;
+    std::vector<uint8_t> m_moving;
+};
+
+#endif  // OPENCV_NDK_MOTION_DETECTOR_H
@@ -2,12 +2,19 @@
 #define OPENCV_NDK_NATIVE_CAMERA_H
 
 #include "Util.h"
+#include "Capture_Writer.h"
+#include "Hal_Face_Detector.h"
+#include "Zsl_Ring.h"
 
 
 
 #include <string>
 #include <map>
 #include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+#include <vector>
 #include <unistd.h>
 #include <assert.h>
 #include <jni.h>
@@ -265,53 +272,24 @@ private:
     int mOnReady = 0;
     int mOnActive = 0;
 };
-#ifndef MAX
-#define MAX(a, b)           \
-  ({                        \
-    __typeof__(a) _a = (a); \
-    __typeof__(b) _b = (b); \
-    _a > _b ? _a : _b;      \
-  })
-#define MIN(a, b)           \
-  ({                        \
-    __typeof__(a) _a = (a); \
-    __typeof__(b) _b = (b); \
-    _a < _b ? _a : _b;      \
-  })
-#endif
-
-// This value is 2 ^ 18 - 1, and is used to clamp the RGB values before their
-// ranges
-// are normalized to eight bits.
-static const int kMaxChannelValue = 262143;
-
-static inline uint32_t YUV2RGB(int nY, int nU, int nV)
+
+// How a burst went: frames that arrived, time from the trigger to the first,
+// the rate they came at and the mean time from exposure to arrival, -1 when
+// the sensor's clock cannot be compared with ours
+struct Burst_Report
 {
-    nY -= 16;
-    nU -= 128;
-    nV -= 128;
-    if (nY < 0) nY = 0;
-
-    // This is the floating point equivalent. We do the conversion in integer
-    // because some Android devices do not have floating point in hardware.
-    // nR = (int)(1.164 * nY + 1.596 * nV);
-    // nG = (int)(1.164 * nY - 0.813 * nV - 0.391 * nU);
-    // nB = (int)(1.164 * nY + 2.018 * nU);
-
-    int nR = (int) (1192 * nY + 1634 * nV);
-    int nG = (int) (1192 * nY - 833 * nV - 400 * nU);
-    int nB = (int) (1192 * nY + 2066 * nU);
-
-    nR = MIN(kMaxChannelValue, MAX(0, nR));
-    nG = MIN(kMaxChannelValue, MAX(0, nG));
-    nB = MIN(kMaxChannelValue, MAX(0, nB));
-
-    nR = (nR >> 10) & 0xff;
-    nG = (nG >> 10) & 0xff;
-    nB = (nB >> 10) & 0xff;
-
-    return 0xff000000 | (nB << 16) | (nG << 8) | nR;
-}
+    int32_t frames = 0;
+    double first_frame_ms = 0.0;
+    double fps = 0.0;
+    double mean_latency_ms = -1.0;
+};
+
+// Called once per burst on the reader's thread, when its last frame arrived
+// or the rest were lost. requested tells a short burst from a complete one.
+// Best shot bursts hand over their sharpest frame, owned by the callee, and
+// its index and score, the others nullptr.
+typedef std::function<void(const Burst_Report &report, int32_t requested, AImage *best,
+                           int32_t index, double score)> Burst_Callback;
 
 class ImageReaderListener
 {
@@ -340,7 +318,7 @@ public:
             return;
         }
         ImageReaderListener *thiz = reinterpret_cast<ImageReaderListener *>(obj);
-        std::lock_guard<std::mutex> lock(thiz->mMutex);
+        std::unique_lock<std::mutex> lock(thiz->mMutex);
         thiz->mOnImageAvailableCount++;
         AImage *img = nullptr;
         media_status_t ret = AImageReader_acquireNextImage(reader, &img);
@@ -350,182 +328,86 @@ public:
                  __FUNCTION__, reader, ret, img);
             return;
         }
-        // TODO: validate image content
-        int32_t format = -1;
-        ret = AImage_getFormat(img, &format);
-        if (ret != AMEDIA_OK || format == -1)
-        {
-            LOGI("%s: get format for image %p failed! ret: %d, format %d",
-                 __FUNCTION__, img, ret, format);
-        }
-        // Save jpeg to SD card AIMAGE_FORMAT_YUV_420_888
-        //  if (thiz->mDumpFilePathBase && format == AIMAGE_FORMAT_JPEG)
-
-        // To-do
-        if (format == AIMAGE_FORMAT_JPEG)
+        // in ZSL mode every preview frame lands here, kept until captured
+        // or pushed out by newer ones. The tap sees it first, before a
+        // capture can take it away.
+        if (thiz->mZsl != nullptr)
         {
-            int32_t numPlanes = 0;
-            ret = AImage_getNumberOfPlanes(img, &numPlanes);
-            if (ret != AMEDIA_OK || numPlanes != 1)
-            {
-                LOGI("%s: get numPlanes for image %p failed! ret: %d, numPlanes %d",
-                     __FUNCTION__, img, ret, numPlanes);
-                AImage_delete(img);
-                return;
-            }
-            int32_t width = -1, height = -1;
-            ret = AImage_getWidth(img, &width);
-            if (ret != AMEDIA_OK || width <= 0)
-            {
-                LOGI("%s: get width for image %p failed! ret: %d, width %d",
-                     __FUNCTION__, img, ret, width);
-                AImage_delete(img);
-                return;
-            }
-            ret = AImage_getHeight(img, &height);
-            if (ret != AMEDIA_OK || height <= 0)
+            Zsl_Ring *zsl = thiz->mZsl;
+            std::function<void(AImage *)> tap = thiz->mFrameTap;
+            lock.unlock();
+            if (tap)
             {
-                LOGI("%s: get height for image %p failed! ret: %d, height %d",
-                     __FUNCTION__, img, ret, height);
-                AImage_delete(img);
-                return;
+                tap(img);
             }
-            uint8_t *data = nullptr;
-            int dataLength = 0;
-            ret = AImage_getPlaneData(img, /*planeIdx*/0, &data, &dataLength);
-            if (ret != AMEDIA_OK || data == nullptr || dataLength <= 0)
-            {
-                LOGI("%s: get jpeg data for image %p failed! ret: %d, data %p, len %d",
-                     __FUNCTION__, img, ret, data, dataLength);
-                AImage_delete(img);
-                return;
-            }
-
-            char dumpFilePath[512];
-            strcpy(dumpFilePath, thiz->filenamecapture );
-            strcat(dumpFilePath,"jpg" );
-            LOGI("Writing jpeg file to %s", dumpFilePath);
-            FILE *file = fopen(dumpFilePath, "w+");
-            if (file != nullptr)
-            {
-                fwrite(data, 1, dataLength, file);
-                fflush(file);
-                fclose(file);
-            }
-
+            zsl->Push(img);
+            return;
         }
-        else if ( format == AIMAGE_FORMAT_YUV_420_888)
+        // encoding and disk writes happen on the writer's threads, the
+        // camera gets its buffer back as soon as the planes are copied
+        if (thiz->mWriter == nullptr)
         {
-            int32_t numPlanes = 0;
-            ret = AImage_getNumberOfPlanes(img, &numPlanes);
-            if (ret != AMEDIA_OK || numPlanes != 3)
-            {
-                LOGI("%s: get numPlanes for image %p failed! ret: %d, numPlanes %d",
-                     __FUNCTION__, img, ret, numPlanes);
-                AImage_delete(img);
-                return;
-            }
-            int32_t width = -1, height = -1;
-            ret = AImage_getWidth(img, &width);
-            if (ret != AMEDIA_OK || width <= 0)
-            {
-                LOGI("%s: get width for image %p failed! ret: %d, width %d",
-                     __FUNCTION__, img, ret, width);
-                AImage_delete(img);
-                return;
-            }
-            ret = AImage_getHeight(img, &height);
-            if (ret != AMEDIA_OK || height <= 0)
-            {
-                LOGI("%s: get height for image %p failed! ret: %d, height %d",
-                     __FUNCTION__, img, ret, height);
-                AImage_delete(img);
-                return;
-            }
-
-            int32_t yStride, uvStride, rgbStride, *rgbPixel;
-            uint8_t *yPixel, *uPixel, *vPixel ;
-            int32_t yLen, uLen, vLen;
-            int32_t uvPixelStride;
-            uint8_t *data = nullptr;
-            int dataLength = 0;
-
-            AImage_getPlaneRowStride(img, 0, &yStride);
-            AImage_getPlaneRowStride(img, 1, &uvStride);
-
-            thiz->RGBBuffer_ = (int32_t *) malloc(width * height * 4);
-            ASSERT(thiz->RGBBuffer_ != nullptr, "Failed to allocate RGBBuffer_");
-            rgbPixel = thiz->RGBBuffer_ ;
-            rgbStride = width  ;
-
-            uint8_t * imageBuffer_ = (uint8_t *) malloc(width * height * 4);
-            ASSERT(imageBuffer_ != nullptr, "Failed to allocate imageBuffer_");
-
-            yPixel = imageBuffer_;
-            AImage_getPlaneData(img, 0, &yPixel, &yLen);
-
-            vPixel = imageBuffer_ + yLen;
-            AImage_getPlaneData(img, 1, &vPixel, &vLen);
-
-            uPixel = imageBuffer_ + yLen + vLen;
-            AImage_getPlaneData(img, 2, &uPixel, &uLen);
-
-            AImage_getPlanePixelStride(img, 1, &uvPixelStride);
-
-            // swap up to down for YUV format
-            rgbPixel += rgbStride * ( height - 1 ) ;
-            for (int32_t y = 0; y < height; y++)
+            LOGI("%s: no writer, dropping image %p", __FUNCTION__, img);
+            AImage_delete(img);
+            return;
+        }
+        std::string path = thiz->filenamecapture;
+        if (thiz->mBurstCount > 0 && thiz->burstPendingLocked())
+        {
+            int64_t timestamp = 0;
+            AImage_getTimestamp(img, &timestamp);
+            thiz->mBurstArrivals.push_back(Zsl_Ring::Now());
+            thiz->mBurstTimestamps.push_back(timestamp);
+            if (thiz->mShotScore)
             {
-                const uint8_t *pY = yPixel + yStride * y ;
-                int32_t uv_row_start = uvStride * (y  >> 1);
-                const uint8_t *pU = uPixel + uv_row_start ;
-                const uint8_t *pV = vPixel + uv_row_start ;
-
-                for (int32_t x = 0; x < width; x++)
+                // best shot: only the sharpest frame so far is kept. Rated
+                // without mMutex, the camera thread may lose or cancel
+                // frames meanwhile and a cancelled burst drops this one.
+                std::function<double(AImage *)> rate = thiz->mShotScore;
+                const int64_t burst = thiz->mBurstId;
+                const int32_t index = (int32_t) thiz->mBurstArrivals.size() - 1;
+                thiz->mBurstScoring++;
+                lock.unlock();
+                double score = rate(img);
+                lock.lock();
+                thiz->mBurstScoring--;
+                if (burst != thiz->mBurstId ||
+                    (thiz->mBestShot != nullptr && score <= thiz->mBestShotScore))
                 {
-                    const int32_t uv_offset = (x >> 1) * uvPixelStride;
-                    rgbPixel[x] = YUV2RGB(pY[x], pU[uv_offset], pV[uv_offset]);
+                    AImage_delete(img);
                 }
-                rgbPixel -= rgbStride;
+                else
+                {
+                    if (thiz->mBestShot != nullptr)
+                    {
+                        AImage_delete(thiz->mBestShot);
+                    }
+                    thiz->mBestShot = img;
+                    thiz->mBestShotScore = score;
+                    thiz->mBestShotIndex = index;
+                }
+                img = nullptr;
             }
-
-
-            char dumpFilePath[512];
-            strcpy(dumpFilePath, thiz->filenamecapture );
-            strcat(dumpFilePath,"bmp" );
-            LOGI("Writing jpeg file to %s", dumpFilePath);
-            FILE *file = fopen(dumpFilePath, "w+");
-            if (file != nullptr)
+            else if (thiz->mBurstCount > 1)
             {
-                int filesize = 54 + width * height * 4;  //w is your image width, h is image height, both int
-
-                unsigned char bmpfileheader[14] = {'B','M', 0,0,0,0, 0,0, 0,0, 54,0,0,0};
-                unsigned char bmpinfoheader[40] = {40,0,0,0, 0,0,0,0, 0,0,0,0, 1,0, 32,0};
-
-                bmpfileheader[ 2] = (unsigned char)(filesize    );
-                bmpfileheader[ 3] = (unsigned char)(filesize>> 8);
-                bmpfileheader[ 4] = (unsigned char)(filesize>>16);
-                bmpfileheader[ 5] = (unsigned char)(filesize>>24);
-
-                bmpinfoheader[ 4] = (unsigned char)(       width    );
-                bmpinfoheader[ 5] = (unsigned char)(       width>> 8);
-                bmpinfoheader[ 6] = (unsigned char)(       width>>16);
-                bmpinfoheader[ 7] = (unsigned char)(       width>>24);
-                bmpinfoheader[ 8] = (unsigned char)(       height    );
-                bmpinfoheader[ 9] = (unsigned char)(       height>> 8);
-                bmpinfoheader[10] = (unsigned char)(       height>>16);
-                bmpinfoheader[11] = (unsigned char)(       height>>24);
-
-                fwrite(bmpfileheader,1,14,file);
-                fwrite(bmpinfoheader,1,40,file);
-                fwrite(thiz->RGBBuffer_,1,width * height * 4,file);
-
-                fflush(file);
-                fclose(file);
+                // one file per frame: img..._00.bmp, img..._01.bmp, ...
+                char suffix[16];
+                snprintf(suffix, sizeof(suffix), "_%02zu.", thiz->mBurstArrivals.size() - 1);
+                path = path.substr(0, path.size() - 1) + suffix;
             }
-            free(imageBuffer_) ;
         }
-        AImage_delete(img);
+        if (img != nullptr)
+        {
+            int32_t maxImages = 1;
+            AImageReader_getMaxImages(reader, &maxImages);
+            thiz->mWriter->Submit(img, path, maxImages);
+        }
+        if (thiz->burstDoneLocked())
+        {
+            Burst_Finish finish = thiz->finishBurstLocked();
+            lock.unlock();
+            finish.Run();
+        }
     }
 
     // count, acquire image but not delete the image
@@ -571,18 +453,188 @@ public:
         strcpy(filenamecapture, ss.c_str()) ;
 
     }
-    ~ImageReaderListener()
+    void setWriter(Capture_Writer *writer)
     {
-        if (RGBBuffer_) free(RGBBuffer_) ;
+        std::lock_guard<std::mutex> lock(mMutex);
+        mWriter = writer;
+    }
+
+    void setZsl(Zsl_Ring *zsl)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mZsl = zsl;
+    }
+
+    // Runs on every streamed frame, on the reader's thread and without
+    // mMutex. The image is only valid during the call.
+    void setFrameTap(const std::function<void(AImage *)> &tap)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mFrameTap = tap;
+    }
+
+    // Call right before a burst of count frames is triggered, done runs
+    // once they are all in. With a score, frames are not written but rated
+    // and only the best one is handed to done. A burst still pending is
+    // finished short first.
+    void startBurst(int32_t count, const Burst_Callback &done,
+                    const std::function<double(AImage *)> &score = std::function<double(AImage *)>())
+    {
+        cancelBurst();
+        std::lock_guard<std::mutex> lock(mMutex);
+        mShotScore = score;
+        mBurstDone = done;
+        mBurstCount = count;
+        mBurstLost = 0;
+        mBurstStart = Zsl_Ring::Now();
+        mBurstArrivals.clear();
+        mBurstTimestamps.clear();
+        mBestShot = nullptr;
+        mBestShotIndex = -1;
+        mBestShotScore = 0.0;
+    }
+
+    // A burst frame the camera will not deliver, see CameraCaptureListener
+    void lostBurstFrame()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        if (mBurstCount == 0)
+        {
+            return;
+        }
+        mBurstLost++;
+        if (burstDoneLocked())
+        {
+            Burst_Finish finish = finishBurstLocked();
+            lock.unlock();
+            finish.Run();
+        }
+    }
+
+    // Finishes a pending burst with the frames it has, call before the
+    // reader goes so the kept best shot is handed over first
+    void cancelBurst()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        if (mBurstCount == 0)
+        {
+            return;
+        }
+        Burst_Finish finish = finishBurstLocked();
+        lock.unlock();
+        finish.Run();
     }
 
 private:
+    // What finishing a burst hands to its callback, run without mMutex so
+    // the callback may submit and log at leisure
+    struct Burst_Finish
+    {
+        Burst_Callback done;
+        Burst_Report report;
+        int32_t requested = 0;
+        AImage *best = nullptr;
+        int32_t index = -1;
+        double score = 0.0;
+
+        void Run()
+        {
+            if (done)
+            {
+                done(report, requested, best, index, score);
+            }
+            else if (best != nullptr)
+            {
+                AImage_delete(best);
+            }
+        }
+    };
+
+    bool burstPendingLocked() const
+    {
+        return mBurstArrivals.size() + (size_t) mBurstLost < (size_t) mBurstCount;
+    }
+
+    // Every frame arrived or lost, and none is still being rated
+    bool burstDoneLocked() const
+    {
+        return mBurstCount > 0 && !burstPendingLocked() && mBurstScoring == 0;
+    }
+
+    // Reports the burst and resets it, mMutex held
+    Burst_Finish finishBurstLocked()
+    {
+        Burst_Finish finish;
+        const size_t frames = mBurstArrivals.size();
+        Burst_Report &report = finish.report;
+        report.frames = (int32_t) frames;
+        if (frames > 0)
+        {
+            report.first_frame_ms = (mBurstArrivals[0] - mBurstStart) / 1e6;
+        }
+        if (frames > 1)
+        {
+            // sensor timestamps space the frames better than our arrivals
+            int64_t span = mBurstTimestamps[frames - 1] - mBurstTimestamps[0];
+            if (span <= 0)
+            {
+                span = mBurstArrivals[frames - 1] - mBurstArrivals[0];
+            }
+            report.fps = span > 0 ? (frames - 1) * 1e9 / span : 0.0;
+        }
+        double total_latency = 0.0;
+        for (size_t i = 0; i < frames; i++)
+        {
+            int64_t latency = mBurstArrivals[i] - mBurstTimestamps[i];
+            if (latency <= 0 || latency > 1000000000LL)
+            {
+                // not CLOCK_BOOTTIME timestamps
+                total_latency = -1.0;
+                break;
+            }
+            total_latency += latency / 1e6;
+        }
+        if (frames > 0 && total_latency >= 0.0)
+        {
+            report.mean_latency_ms = total_latency / frames;
+        }
+
+        finish.done = mBurstDone;
+        finish.requested = mBurstCount;
+        finish.best = mBestShot;
+        finish.index = mBestShotIndex;
+        finish.score = mBestShotScore;
+        mBestShot = nullptr;
+        mBurstDone = nullptr;
+        mBurstCount = 0;
+        mBurstId++;
+        mShotScore = nullptr;
+        return finish;
+    }
+
     // TODO: add mReader to make sure each listener is associated to one reader?
     std::mutex mMutex;
     int mOnImageAvailableCount = 0;
     char mDumpFilePathBase[512];
     char filenamecapture [512] ;
-    int32_t* RGBBuffer_ = nullptr;
+    Capture_Writer *mWriter = nullptr;
+    Zsl_Ring *mZsl = nullptr;
+    std::function<void(AImage *)> mFrameTap;
+
+    // the burst being captured, 0 when none is. mBurstId changes with every
+    // finished burst, mBurstScoring counts frames rated outside mMutex.
+    int32_t mBurstCount = 0;
+    int64_t mBurstId = 0;
+    int32_t mBurstScoring = 0;
+    int32_t mBurstLost = 0;
+    int64_t mBurstStart = 0;
+    std::vector<int64_t> mBurstArrivals;
+    std::vector<int64_t> mBurstTimestamps;
+    Burst_Callback mBurstDone;
+    std::function<double(AImage *)> mShotScore;
+    AImage *mBestShot = nullptr;
+    double mBestShotScore = 0.0;
+    int32_t mBestShotIndex = -1;
 };
 
 class CameraMetaDataInfo
@@ -813,6 +865,13 @@ public:
     //3.  prototype : ACameraCaptureSession_captureCallback_result
     static void onCaptureCompleted(void* context, ACameraCaptureSession* session, ACaptureRequest* request, const ACameraMetadata* result)
     {
+        CameraCaptureListener *thiz = reinterpret_cast<CameraCaptureListener *>(context);
+        if (thiz != nullptr && thiz->mFaceDetector != nullptr)
+        {
+            // preview results come every frame, only hand the faces on
+            thiz->mFaceDetector->OnResult(result);
+            return;
+        }
         CameraMetaDataInfo info(result);
         if(result)
             LOGI("onCaptureCompleted status: %d", info.get_metadata_af_state());
@@ -824,6 +883,13 @@ public:
     static void onCaptureFailed(void* context, ACameraCaptureSession* session, ACaptureRequest* request, ACameraCaptureFailure* failure)
     {
         LOGI("onCaptureFailed");
+        CameraCaptureListener *thiz = reinterpret_cast<CameraCaptureListener *>(context);
+        // a failed capture whose image was not produced never reaches the reader
+        if (thiz != nullptr && thiz->mBurstListener != nullptr &&
+            (failure == nullptr || !failure->wasImageCaptured))
+        {
+            thiz->mBurstListener->lostBurstFrame();
+        }
     }
 
     //4.  prototype : ACameraCaptureSession_captureCallback_sequenceEnd
@@ -836,6 +902,11 @@ public:
     static void onCaptureSequenceAborted(void* context, ACameraCaptureSession* session,int sequenceId)
     {
         LOGI("onCaptureSequenceAborted");
+        CameraCaptureListener *thiz = reinterpret_cast<CameraCaptureListener *>(context);
+        if (thiz != nullptr && thiz->mBurstListener != nullptr)
+        {
+            thiz->mBurstListener->cancelBurst();
+        }
     }
 
     // prototype : ACameraCaptureSession_captureCallback_bufferLost
@@ -845,6 +916,10 @@ public:
     }
 
 public:
+    // set on the listener of the repeating preview request
+    Hal_Face_Detector *mFaceDetector = nullptr;
+    // set on the still request's listener, told about frames that never come
+    ImageReaderListener *mBurstListener = nullptr;
 };
 
 class PreviewTestCase
@@ -893,6 +968,20 @@ public:
         CameraCaptureListener::onCaptureBufferLost,
     };
 
+    // only onCaptureCompleted, for the faces of the preview results
+    CameraCaptureListener previewCaptureListener;
+    ACameraCaptureSession_captureCallbacks m_preview_capture_callbacks
+    {
+        &previewCaptureListener,
+        nullptr,
+        nullptr,
+        CameraCaptureListener::onCaptureCompleted,
+        nullptr,
+        nullptr,
+        nullptr,
+        nullptr,
+    };
+
     CameraMetaDataRequest mcamerametadata ;
 
     ACameraIdList *mCameraIdList = nullptr;
@@ -994,6 +1083,11 @@ public:
         }
         mImgReaderInited = false;
         mPreviewInited = false;
+        if (previewCaptureListener.mFaceDetector)
+        {
+            previewCaptureListener.mFaceDetector->Disable();
+            previewCaptureListener.mFaceDetector = nullptr;
+        }
     }
 
     camera_status_t initWithErrorLog()
@@ -1125,6 +1219,20 @@ public:
         return AMEDIA_OK;
     }
 
+    // Frees the session outputs and the image reader, so a reader of another
+    // size can be set up after the session refused this one
+    void closeImageReader()
+    {
+        closeSession();
+        if (mImgReader)
+        {
+            AImageReader_delete(mImgReader);
+            mImgReaderAnw = nullptr;
+            mImgReader = nullptr;
+        }
+        mImgReaderInited = false;
+    }
+
     ANativeWindow *initPreviewAnw(JNIEnv *env, jobject jSurface)
     {
         if (mPreviewAnw)
@@ -1346,7 +1454,126 @@ public:
         }
         int previewSeqId;
         return ACameraCaptureSession_setRepeatingRequest(
-                mSession, nullptr, 1, &mPreviewRequest, &previewSeqId);
+                mSession,
+                previewCaptureListener.mFaceDetector ? &m_preview_capture_callbacks : nullptr,
+                1, &mPreviewRequest, &previewSeqId);
+    }
+
+    // Lets the camera detect faces on the preview stream when it can. Call
+    // between createRequestsWithErrorLog() and startPreview().
+    bool enableFaceDetection(Hal_Face_Detector *detector)
+    {
+        if (mDevice == nullptr || mPreviewRequest == nullptr)
+        {
+            LOGI("Cannot enable face detection: device %p, preview request %p",
+                 mDevice, mPreviewRequest);
+            return false;
+        }
+        ACameraMetadata *chars = nullptr;
+        camera_status_t ret = ACameraManager_getCameraCharacteristics(
+                mCameraManager, mCameraId, &chars);
+        if (ret != ACAMERA_OK)
+        {
+            LOG_ERROR(errorString, "Get camera %s characteristics failure. ret %d",
+                      mCameraId, ret);
+            return false;
+        }
+        bool supported = detector->Init(chars);
+        ACameraMetadata_free(chars);
+        if (!supported)
+        {
+            LOGI("Camera %s has no face detection", mCameraId);
+            return false;
+        }
+        if (!detector->Enable(mPreviewRequest))
+        {
+            return false;
+        }
+        previewCaptureListener.mFaceDetector = detector;
+        return true;
+    }
+
+    // Failed still captures are reported to listener, so a burst waiting
+    // for them finishes without
+    void setBurstListener(ImageReaderListener *listener)
+    {
+        cameracaptureListener.mBurstListener = listener;
+    }
+
+    // Submits count still requests as one capture sequence, the camera
+    // then runs them back to back instead of one capture call at a time
+    camera_status_t takeBurst(int32_t count)
+    {
+        if (mSession == nullptr || mStillRequest == nullptr || count < 1)
+        {
+            LOGI("Testcase cannot take a burst: session %p, still request %p, count %d",
+                 mSession, mStillRequest, count);
+            return ACAMERA_ERROR_UNKNOWN;
+        }
+        std::vector<ACaptureRequest *> requests(count, mStillRequest);
+        int seqId;
+        return ACameraCaptureSession_capture(
+                mSession, &m_capture_session_capture_callbacks, count, requests.data(), &seqId);
+    }
+
+    // Fills in the ZSL frame size and clock, call once the camera is open
+    bool initZsl(Zsl_Ring *ring)
+    {
+        if (mDevice == nullptr)
+        {
+            LOGI("Cannot init ZSL before the camera is open");
+            return false;
+        }
+        ACameraMetadata *chars = nullptr;
+        camera_status_t ret = ACameraManager_getCameraCharacteristics(
+                mCameraManager, mCameraId, &chars);
+        if (ret != ACAMERA_OK)
+        {
+            LOG_ERROR(errorString, "Get camera %s characteristics failure. ret %d",
+                      mCameraId, ret);
+            return false;
+        }
+        bool supported = ring->Init(chars);
+        ACameraMetadata_free(chars);
+        return supported;
+    }
+
+    // Degrees the sensor image turns clockwise to be upright on the display
+    // in its natural orientation, 0 when the camera does not tell
+    int32_t getSensorOrientation()
+    {
+        if (mDevice == nullptr)
+        {
+            return 0;
+        }
+        ACameraMetadata *chars = nullptr;
+        if (ACameraManager_getCameraCharacteristics(mCameraManager, mCameraId, &chars) !=
+            ACAMERA_OK)
+        {
+            return 0;
+        }
+        ACameraMetadata_const_entry entry;
+        int32_t orientation = 0;
+        if (ACameraMetadata_getConstEntry(chars, ACAMERA_SENSOR_ORIENTATION, &entry) ==
+            ACAMERA_OK && entry.count > 0)
+        {
+            orientation = entry.data.i32[0];
+        }
+        ACameraMetadata_free(chars);
+        return orientation;
+    }
+
+    // Lets the repeating preview request fill the image reader too. Call
+    // between createRequestsWithErrorLog() and startPreview().
+    camera_status_t streamToImageReader()
+    {
+        if (mPreviewRequest == nullptr || mReqImgReaderOutput == nullptr)
+        {
+            LOGI("Cannot stream to the reader: preview request %p, reader target %p",
+                 mPreviewRequest, mReqImgReaderOutput);
+            return ACAMERA_ERROR_UNKNOWN;
+        }
+        return ACaptureRequest_addTarget(mPreviewRequest, mReqImgReaderOutput);
     }
 
     camera_status_t takePicture()
@@ -0,0 +1,313 @@
+#include "Png_Encoder.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <zlib.h>
+
+static inline uint8_t Clamp8(int32_t value)
+{
+    return (uint8_t) std::min(255, std::max(0, value));
+}
+
+void YuvRowToRgb(const Yuv_Planes &planes, int32_t y, uint8_t *rgb)
+{
+    const uint8_t *py = planes.y + (size_t) y * planes.y_stride;
+    const uint8_t *pu = planes.u + (size_t) (y >> 1) * planes.uv_stride;
+    const uint8_t *pv = planes.v + (size_t) (y >> 1) * planes.uv_stride;
+    for (int32_t x = 0; x < planes.width; x++, rgb += 3)
+    {
+        const int32_t uv = (x >> 1) * planes.uv_pixel_stride;
+        int32_t c = std::max(0, py[x] - 16) * 1192;
+        int32_t d = pu[uv] - 128;
+        int32_t e = pv[uv] - 128;
+        rgb[0] = Clamp8((c + 1634 * e) >> 10);
+        rgb[1] = Clamp8((c - 833 * e - 400 * d) >> 10);
+        rgb[2] = Clamp8((c + 2066 * d) >> 10);
+    }
+}
+
+static const int32_t PNG_BPP = 3;
+
+enum Png_Filter
+{
+    FILTER_SUB = 1,
+    FILTER_UP = 2,
+    FILTER_AVERAGE = 3
+};
+
+static inline void AddCost(uint8_t sub, uint8_t up, uint8_t avg, uint32_t cost[3])
+{
+    cost[0] += (uint32_t) std::abs((int8_t) sub);
+    cost[1] += (uint32_t) std::abs((int8_t) up);
+    cost[2] += (uint32_t) std::abs((int8_t) avg);
+}
+
+// Sub, Up and Average of one row at once, with the usual cost estimate of
+// each: the sum of the filtered bytes taken as signed values
+static void FilterRow(const uint8_t *raw, const uint8_t *prev, int32_t length, uint8_t *sub,
+                      uint8_t *up, uint8_t *avg, uint32_t cost[3])
+{
+    cost[0] = cost[1] = cost[2] = 0;
+    int32_t i = 0;
+    for (; i < PNG_BPP && i < length; i++)
+    {
+        sub[i] = raw[i];
+        up[i] = (uint8_t) (raw[i] - prev[i]);
+        avg[i] = (uint8_t) (raw[i] - (prev[i] >> 1));
+        AddCost(sub[i], up[i], avg[i], cost);
+    }
+
+#if defined(OPENCV_NDK_NEON)
+    uint32x4_t sum_sub = vdupq_n_u32(0);
+    uint32x4_t sum_up = vdupq_n_u32(0);
+    uint32x4_t sum_avg = vdupq_n_u32(0);
+    for (; i + 16 <= length; i += 16)
+    {
+        uint8x16_t x = vld1q_u8(raw + i);
+        uint8x16_t a = vld1q_u8(raw + i - PNG_BPP);
+        uint8x16_t b = vld1q_u8(prev + i);
+        uint8x16_t s = vsubq_u8(x, a);
+        uint8x16_t u = vsubq_u8(x, b);
+        uint8x16_t v = vsubq_u8(x, vhaddq_u8(a, b));
+        vst1q_u8(sub + i, s);
+        vst1q_u8(up + i, u);
+        vst1q_u8(avg + i, v);
+        sum_sub = vpadalq_u16(sum_sub, vpaddlq_u8(vreinterpretq_u8_s8(
+                vabsq_s8(vreinterpretq_s8_u8(s)))));
+        sum_up = vpadalq_u16(sum_up, vpaddlq_u8(vreinterpretq_u8_s8(
+                vabsq_s8(vreinterpretq_s8_u8(u)))));
+        sum_avg = vpadalq_u16(sum_avg, vpaddlq_u8(vreinterpretq_u8_s8(
+                vabsq_s8(vreinterpretq_s8_u8(v)))));
+    }
+    uint32_t lanes[4];
+    vst1q_u32(lanes, sum_sub);
+    cost[0] += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    vst1q_u32(lanes, sum_up);
+    cost[1] += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    vst1q_u32(lanes, sum_avg);
+    cost[2] += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(OPENCV_NDK_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    __m128i sum_sub = zero;
+    __m128i sum_up = zero;
+    __m128i sum_avg = zero;
+    for (; i + 16 <= length; i += 16)
+    {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(raw + i));
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(raw + i - PNG_BPP));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(prev + i));
+        // _mm_avg_epu8 rounds up, PNG rounds down
+        __m128i mean = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+        __m128i s = _mm_sub_epi8(x, a);
+        __m128i u = _mm_sub_epi8(x, b);
+        __m128i v = _mm_sub_epi8(x, mean);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(sub + i), s);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(up + i), u);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(avg + i), v);
+        // |s| of a signed byte is the smaller of s and -s taken unsigned
+        sum_sub = _mm_add_epi64(sum_sub, _mm_sad_epu8(
+                _mm_min_epu8(s, _mm_sub_epi8(zero, s)), zero));
+        sum_up = _mm_add_epi64(sum_up, _mm_sad_epu8(
+                _mm_min_epu8(u, _mm_sub_epi8(zero, u)), zero));
+        sum_avg = _mm_add_epi64(sum_avg, _mm_sad_epu8(
+                _mm_min_epu8(v, _mm_sub_epi8(zero, v)), zero));
+    }
+    cost[0] += (uint32_t) (_mm_cvtsi128_si32(sum_sub) +
+                           _mm_cvtsi128_si32(_mm_srli_si128(sum_sub, 8)));
+    cost[1] += (uint32_t) (_mm_cvtsi128_si32(sum_up) +
+                           _mm_cvtsi128_si32(_mm_srli_si128(sum_up, 8)));
+    cost[2] += (uint32_t) (_mm_cvtsi128_si32(sum_avg) +
+                           _mm_cvtsi128_si32(_mm_srli_si128(sum_avg, 8)));
+#endif
+
+    for (; i < length; i++)
+    {
+        sub[i] = (uint8_t) (raw[i] - raw[i - PNG_BPP]);
+        up[i] = (uint8_t) (raw[i] - prev[i]);
+        avg[i] = (uint8_t) (raw[i] - ((raw[i - PNG_BPP] + prev[i]) >> 1));
+        AddCost(sub[i], up[i], avg[i], cost);
+    }
+}
+
+// One stripe of filtered rows, deflated on its own
+struct Png_Stripe
+{
+    std::vector<uint8_t> data;
+    uLong adler = 1;
+    uLong crc = 0;
+    uLong raw_length = 0;
+    bool ok = false;
+};
+
+static void EncodeStripe(const Yuv_Planes &planes, int32_t first, int32_t last, bool final,
+                         Png_Stripe &stripe)
+{
+    const int32_t length = planes.width * PNG_BPP;
+    std::vector<uint8_t> rows((size_t) (length + 1) * (last - first));
+    std::vector<uint8_t> prev(length, 0);
+    std::vector<uint8_t> raw(length);
+    std::vector<uint8_t> filtered((size_t) length * 3);
+    if (first > 0)
+    {
+        // the filters look at the row above, even across stripes
+        YuvRowToRgb(planes, first - 1, prev.data());
+    }
+
+    uint8_t *out = rows.data();
+    for (int32_t y = first; y < last; y++, out += length + 1)
+    {
+        YuvRowToRgb(planes, y, raw.data());
+        uint32_t cost[3];
+        FilterRow(raw.data(), prev.data(), length, filtered.data(), filtered.data() + length,
+                  filtered.data() + 2 * length, cost);
+        int32_t best = 0;
+        for (int32_t f = 1; f < 3; f++)
+        {
+            if (cost[f] < cost[best])
+            {
+                best = f;
+            }
+        }
+        const Png_Filter types[3] = {FILTER_SUB, FILTER_UP, FILTER_AVERAGE};
+        out[0] = (uint8_t) types[best];
+        std::copy(filtered.begin() + (size_t) best * length,
+                  filtered.begin() + (size_t) (best + 1) * length, out + 1);
+        prev.swap(raw);
+    }
+
+    stripe.raw_length = (uLong) rows.size();
+    stripe.adler = adler32(1L, rows.data(), (uInt) rows.size());
+
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    // raw deflate, the zlib header and checksum are written once for all
+    if (deflateInit2(&stream, Z_BEST_SPEED, Z_DEFLATED, -15, 8, Z_RLE) != Z_OK)
+    {
+        return;
+    }
+    // sync flush bytes on top of the bound
+    stripe.data.resize(deflateBound(&stream, (uLong) rows.size()) + 16);
+    stream.next_in = rows.data();
+    stream.avail_in = (uInt) rows.size();
+    stream.next_out = stripe.data.data();
+    stream.avail_out = (uInt) stripe.data.size();
+    int status = deflate(&stream, final ? Z_FINISH : Z_SYNC_FLUSH);
+    stripe.ok = final ? status == Z_STREAM_END : (status == Z_OK && stream.avail_in == 0);
+    stripe.data.resize(stripe.data.size() - stream.avail_out);
+    deflateEnd(&stream);
+    stripe.crc = crc32(0L, stripe.data.data(), (uInt) stripe.data.size());
+}
+
+static void PutBigEndian(uint8_t *out, uint32_t value)
+{
+    out[0] = (uint8_t) (value >> 24);
+    out[1] = (uint8_t) (value >> 16);
+    out[2] = (uint8_t) (value >> 8);
+    out[3] = (uint8_t) value;
+}
+
+// Length, type, data and CRC of a chunk small enough to build in one go
+static bool WriteChunk(FILE *file, const char *type, const uint8_t *data, uint32_t length)
+{
+    uint8_t head[8];
+    PutBigEndian(head, length);
+    std::copy(type, type + 4, head + 4);
+    uLong crc = crc32(0L, head + 4, 4);
+    if (length > 0)
+    {
+        // zlib restarts the CRC when handed no buffer
+        crc = crc32(crc, data, length);
+    }
+    uint8_t tail[4];
+    PutBigEndian(tail, (uint32_t) crc);
+    return fwrite(head, 1, 8, file) == 8 && fwrite(data, 1, length, file) == length &&
+           fwrite(tail, 1, 4, file) == 4;
+}
+
+bool WritePng(const Yuv_Planes &planes, const std::string &filename, Worker_Pool *pool,
+              int32_t stripe_rows)
+{
+    const int32_t height = planes.height;
+    stripe_rows = std::max(1, stripe_rows);
+    const int32_t count = (height + stripe_rows - 1) / stripe_rows;
+    std::vector<Png_Stripe> stripes(count);
+    std::function<void(size_t)> task = [&](size_t s)
+    {
+        int32_t first = (int32_t) s * stripe_rows;
+        int32_t last = std::min(height, first + stripe_rows);
+        EncodeStripe(planes, first, last, (int32_t) s + 1 == count, stripes[s]);
+    };
+    if (pool != nullptr)
+    {
+        pool->ParallelFor(stripes.size(), task);
+    }
+    else
+    {
+        for (size_t s = 0; s < stripes.size(); s++)
+        {
+            task(s);
+        }
+    }
+
+    // one zlib stream over all stripes: header, the deflate data and the
+    // Adler-32 of every filtered row
+    const uint8_t zlib_header[2] = {0x78, 0x01};
+    uLong adler = 1;
+    uint32_t idat_length = 2 + 4;
+    for (size_t s = 0; s < stripes.size(); s++)
+    {
+        if (!stripes[s].ok)
+        {
+            LOGE("WritePng: deflate failed for %s", filename.c_str());
+            return false;
+        }
+        adler = adler32_combine(adler, stripes[s].adler, (z_off_t) stripes[s].raw_length);
+        idat_length += (uint32_t) stripes[s].data.size();
+    }
+    uint8_t zlib_trailer[4];
+    PutBigEndian(zlib_trailer, (uint32_t) adler);
+
+    FILE *file = fopen(filename.c_str(), "wb");
+    if (file == nullptr)
+    {
+        LOGE("WritePng: cannot open %s", filename.c_str());
+        return false;
+    }
+
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    uint8_t header[13];
+    PutBigEndian(header, (uint32_t) planes.width);
+    PutBigEndian(header + 4, (uint32_t) height);
+    header[8] = 8;   // bits per channel
+    header[9] = 2;   // RGB
+    header[10] = 0;  // deflate
+    header[11] = 0;  // adaptive filtering
+    header[12] = 0;  // not interlaced
+    bool ok = fwrite(signature, 1, 8, file) == 8 && WriteChunk(file, "IHDR", header, 13);
+
+    // the IDAT chunk is written piece by piece, its CRC combined likewise
+    uint8_t head[8];
+    PutBigEndian(head, idat_length);
+    std::copy("IDAT", "IDAT" + 4, head + 4);
+    uLong crc = crc32(0L, head + 4, 4);
+    crc = crc32(crc, zlib_header, 2);
+    ok = ok && fwrite(head, 1, 8, file) == 8 && fwrite(zlib_header, 1, 2, file) == 2;
+    for (size_t s = 0; s < stripes.size() && ok; s++)
+    {
+        const std::vector<uint8_t> &data = stripes[s].data;
+        crc = crc32_combine(crc, stripes[s].crc, (z_off_t) data.size());
+        ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+    }
+    crc = crc32(crc, zlib_trailer, 4);
+    uint8_t crc_bytes[4];
+    PutBigEndian(crc_bytes, (uint32_t) crc);
+    ok = ok && fwrite(zlib_trailer, 1, 4, file) == 4 && fwrite(crc_bytes, 1, 4, file) == 4;
+
+    ok = ok && WriteChunk(file, "IEND", nullptr, 0);
+    return fclose(file) == 0 && ok;
+}
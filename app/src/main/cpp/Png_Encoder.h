@@ -0,0 +1,25 @@
+#ifndef OPENCV_NDK_PNG_ENCODER_H
+#define OPENCV_NDK_PNG_ENCODER_H
+
+// OpenCV-NDK App
+#include "Util.h"
+#include "Worker_Pool.h"
+// STD Libs
+#include <cstdint>
+#include <string>
+
+// Converts row y of a YUV frame to 8 bit RGB triplets, the colors every
+// capture encoder writes
+void YuvRowToRgb(const Yuv_Planes &planes, int32_t y, uint8_t *rgb);
+
+// Writes a YUV frame as a 24 bit RGB PNG, holding exactly the pixels of the
+// BMP dump in typically a third of its size. The frame is cut into
+// stripes of stripe_rows rows that are converted, filtered and deflated in
+// parallel on pool, each ending on a byte boundary, so their streams simply
+// follow each other in one IDAT chunk. Every row takes the cheapest of the
+// Sub, Up and Average filters, deflate runs at its fastest level and only
+// looks for runs, which filtered rows mostly consist of.
+bool WritePng(const Yuv_Planes &planes, const std::string &filename, Worker_Pool *pool,
+              int32_t stripe_rows = 64);
+
+#endif  // OPENCV_NDK_PNG_ENCODER_H
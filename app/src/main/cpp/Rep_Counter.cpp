@@ -0,0 +1,109 @@
+#include "Rep_Counter.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+Rep_Counter::Rep_Counter(int32_t noise, double min_period_ms, double max_period_ms)
+        : m_noise(noise), m_min_period_ms(min_period_ms), m_max_period_ms(max_period_ms)
+{
+}
+
+void Rep_Counter::Reset()
+{
+    m_frames = 0;
+    m_first_time = 0.0;
+    m_last_time = 0.0;
+    m_total_ms = 0.0;
+    m_signal = 0.0f;
+    m_amplitude = 0.0f;
+    m_phase = IDLE;
+    m_up_time = 0.0;
+    m_count = 0;
+    m_first_rep_time = 0.0;
+    m_last_rep_time = 0.0;
+}
+
+// Least squares solution of It + v * Ig = 0 over the moving pixels, with It
+// the frame difference and Ig the central difference along the axis that is
+// vertical on the display. Rotations of 180 and 270 only flip the sign,
+// which does not matter for counting lobes.
+float Rep_Counter::MeasureVelocity(const Motion_Detector &motion, int32_t rotation) const
+{
+    const int32_t width = motion.GetPlaneWidth();
+    const int32_t height = motion.GetPlaneHeight();
+    const int32_t stride = motion.GetPlaneStride();
+    const uint8_t *current = motion.GetPlane();
+    const uint8_t *previous = motion.GetPreviousPlane();
+    // the sensor's x axis is vertical on a portrait display
+    const int32_t step = rotation % 180 == 0 ? stride : 1;
+
+    int64_t num = 0;
+    int64_t den = 0;
+    for (int32_t y = 1; y + 1 < height; y++)
+    {
+        const uint8_t *cur = current + y * stride;
+        const uint8_t *prev = previous + y * stride;
+        for (int32_t x = 1; x + 1 < width; x++)
+        {
+            int32_t dt = (int32_t) cur[x] - (int32_t) prev[x];
+            if (dt < m_noise && dt > -m_noise)
+            {
+                continue;
+            }
+            int32_t dg = (int32_t) cur[x + step] - (int32_t) cur[x - step];
+            num += dt * dg;
+            den += dg * dg;
+        }
+    }
+    // dg spans two pixels
+    return den > 0 ? (float) (-2.0 * num / den) : 0.0f;
+}
+
+bool Rep_Counter::Update(const Motion_Detector &motion, int32_t rotation, double time_ms)
+{
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    if (m_frames == 0)
+    {
+        m_first_time = time_ms;
+    }
+    m_last_time = time_ms;
+
+    // the first frame has no previous plane to compare with
+    float velocity = m_frames > 0 ? MeasureVelocity(motion, rotation) : 0.0f;
+    m_frames++;
+
+    m_signal += SIGNAL_SMOOTHING * (velocity - m_signal);
+    m_amplitude = std::max(std::fabs(m_signal), m_amplitude * AMPLITUDE_DECAY);
+    const float level = std::max(MIN_LEVEL, LEVEL_FRACTION * m_amplitude);
+
+    bool completed = false;
+    if (m_signal > level)
+    {
+        if (m_phase != UP)
+        {
+            m_up_time = time_ms;
+        }
+        m_phase = UP;
+    }
+    else if (m_signal < -level && m_phase == UP)
+    {
+        // a repetition is one up and one down lobe, spaced plausibly
+        m_phase = DOWN;
+        bool slow = time_ms - m_up_time > m_max_period_ms;
+        bool fast = m_count > 0 && time_ms - m_last_rep_time < m_min_period_ms;
+        if (!slow && !fast)
+        {
+            if (m_count == 0)
+            {
+                m_first_rep_time = time_ms;
+            }
+            m_last_rep_time = time_ms;
+            m_count++;
+            completed = true;
+        }
+    }
+
+    m_total_ms += std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - begin).count();
+    return completed;
+}
@@ -0,0 +1,87 @@
+#ifndef OPENCV_NDK_REP_COUNTER_H
+#define OPENCV_NDK_REP_COUNTER_H
+
+// OpenCV-NDK App
+#include "Motion_Detector.h"
+// STD Libs
+#include <cstdint>
+
+// Counts up and down repetitions, jumping jacks for one, from the planes
+// Motion_Detector already subsampled. Every frame gives one sample: the mean
+// vertical (display) velocity of the moving pixels, a single gradient based
+// optical flow estimate over the plane. A repetition is an upward lobe of
+// that signal followed by a downward one, both beyond a threshold that
+// follows the recent amplitude so it adapts to distance and speed.
+class Rep_Counter
+{
+public:
+    // noise: frame difference below which a pixel does not count as moving
+    // min_period_ms, max_period_ms: plausible duration of one repetition
+    explicit Rep_Counter(int32_t noise = 8, double min_period_ms = 350.0,
+                         double max_period_ms = 3000.0);
+
+    // Feeds the planes of motion's last Update(), rotation is sensor to
+    // display and time_ms any monotonic clock. True when the frame
+    // completed a repetition.
+    bool Update(const Motion_Detector &motion, int32_t rotation, double time_ms);
+
+    int32_t GetCount() const
+    { return m_count; }
+
+    // Time since the first frame after Reset()
+    double GetElapsed() const
+    { return m_frames > 0 ? m_last_time - m_first_time : 0.0; }
+
+    // Mean time between repetitions, 0 before the second one
+    double GetMeanPeriod() const
+    { return m_count > 1 ? (m_last_rep_time - m_first_rep_time) / (m_count - 1) : 0.0; }
+
+    // Mean cost of Update() in ms
+    double GetMeanTime() const
+    { return m_frames > 0 ? m_total_ms / m_frames : 0.0; }
+
+    // Smoothed velocity in subsampled pixels per frame, for tuning
+    float GetSignal() const
+    { return m_signal; }
+
+    void Reset();
+
+private:
+    enum Phase
+    {
+        IDLE,
+        UP,
+        DOWN
+    };
+
+    // Mean velocity along the display's vertical axis, 0 without motion
+    float MeasureVelocity(const Motion_Detector &motion, int32_t rotation) const;
+
+    int32_t m_noise;
+    double m_min_period_ms;
+    double m_max_period_ms;
+
+    int64_t m_frames = 0;
+    double m_first_time = 0.0;
+    double m_last_time = 0.0;
+    double m_total_ms = 0.0;
+
+    float m_signal = 0.0f;
+    float m_amplitude = 0.0f;
+    Phase m_phase = IDLE;
+    double m_up_time = 0.0;
+
+    int32_t m_count = 0;
+    double m_first_rep_time = 0.0;
+    double m_last_rep_time = 0.0;
+
+    // smoothing of the raw velocity and decay of the amplitude per frame
+    const float SIGNAL_SMOOTHING = 0.5f;
+    const float AMPLITUDE_DECAY = 0.98f;
+    // the lobes have to pass this part of the amplitude, and at least
+    // MIN_LEVEL pixels per frame so a still scene never counts
+    const float LEVEL_FRACTION = 0.35f;
+    const float MIN_LEVEL = 0.15f;
+};
+
+#endif  // OPENCV_NDK_REP_COUNTER_H
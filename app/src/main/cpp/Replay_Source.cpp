@@ -0,0 +1,206 @@
+#include "Replay_Source.h"
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <cctype>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <thread>
+
+// Lower case extension of a file name, empty without one
+static std::string Extension(const std::string &name)
+{
+    size_t dot = name.rfind('.');
+    if (dot == std::string::npos)
+    {
+        return std::string();
+    }
+    std::string extension = name.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension;
+}
+
+static bool IsImageFile(const std::string &name)
+{
+    std::string extension = Extension(name);
+    return extension == "png" || extension == "jpg" || extension == "jpeg" ||
+           extension == "bmp" || extension == "pgm" || extension == "ppm";
+}
+
+Replay_Source::~Replay_Source()
+{
+    Close();
+}
+
+bool Replay_Source::Open(const std::string &path, double fps, int32_t passes)
+{
+    Close();
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+    {
+        LOGE("Replay_Source: %s does not exist", path.c_str());
+        return false;
+    }
+
+    if (S_ISDIR(info.st_mode))
+    {
+        DIR *dir = opendir(path.c_str());
+        if (dir == nullptr)
+        {
+            LOGE("Replay_Source: cannot list %s", path.c_str());
+            return false;
+        }
+        while (struct dirent *entry = readdir(dir))
+        {
+            std::string name = entry->d_name;
+            if (IsImageFile(name))
+            {
+                m_files.push_back(path + "/" + name);
+            }
+        }
+        closedir(dir);
+        std::sort(m_files.begin(), m_files.end());
+    }
+    else if (Extension(path) == "y4m")
+    {
+        m_y4m.Open(path);
+    }
+    else if (m_recording.Open(path))
+    {
+        // frames the recorder was overwriting when this was opened are left out
+        for (int64_t n = m_recording.GetFirst(); n <= m_recording.GetLast(); n++)
+        {
+            Recorded_Frame frame;
+            Yuv_Planes planes;
+            if (m_recording.Get(n, &frame, &planes))
+            {
+                m_frames.push_back(n);
+            }
+        }
+    }
+
+    if (GetFrameCount() == 0)
+    {
+        LOGE("Replay_Source: no frames in %s", path.c_str());
+        Close();
+        return false;
+    }
+    m_fps = fps;
+    m_passes = std::max(1, passes);
+    LOGI("Replay_Source: %lld frames from %s", (long long) GetFrameCount(), path.c_str());
+    return true;
+}
+
+void Replay_Source::Close()
+{
+    m_recording.Close();
+    m_y4m.Close();
+    m_frames.clear();
+    m_files.clear();
+    m_yuv.release();
+    m_next = 0;
+}
+
+int64_t Replay_Source::GetFrameCount() const
+{
+    if (!m_files.empty())
+    {
+        return (int64_t) m_files.size();
+    }
+    return m_y4m.IsOpen() ? m_y4m.GetFrameCount() : (int64_t) m_frames.size();
+}
+
+bool Replay_Source::AtEnd() const
+{
+    return m_next >= GetFrameCount() * m_passes;
+}
+
+bool Replay_Source::Acquire(Yuv_Planes *planes, int32_t *rotation)
+{
+    // an unreadable frame is skipped, not the end of the replay
+    while (!AtEnd())
+    {
+        int64_t index = m_next++ % GetFrameCount();
+        if (Load(index, planes, rotation))
+        {
+            Pace(index, planes->timestamp);
+            return true;
+        }
+    }
+    return false;
+}
+
+void Replay_Source::Release()
+{
+    // recorded and Y4M planes live in the mapping, images until the next one
+}
+
+bool Replay_Source::Load(int64_t index, Yuv_Planes *planes, int32_t *rotation)
+{
+    if (m_y4m.IsOpen())
+    {
+        *rotation = 0;
+        return m_y4m.Get(index, planes);
+    }
+    if (m_files.empty())
+    {
+        Recorded_Frame frame;
+        if (!m_recording.Get(m_frames[index], &frame, planes))
+        {
+            return false;
+        }
+        *rotation = frame.rotation;
+        return true;
+    }
+
+    cv::Mat image = cv::imread(m_files[index], cv::IMREAD_COLOR);
+    if (image.empty())
+    {
+        LOGE("Replay_Source: cannot decode %s", m_files[index].c_str());
+        return false;
+    }
+    // I420 needs even sizes
+    image = image(cv::Rect(0, 0, image.cols & ~1, image.rows & ~1));
+    cv::cvtColor(image, m_yuv, cv::COLOR_BGR2YUV_I420);
+
+    const int32_t width = image.cols;
+    const int32_t height = image.rows;
+    planes->y = m_yuv.data;
+    planes->u = m_yuv.data + (size_t) width * height;
+    planes->v = planes->u + (size_t) (width / 2) * (height / 2);
+    planes->width = width;
+    planes->height = height;
+    planes->y_stride = width;
+    planes->uv_stride = width / 2;
+    planes->uv_pixel_stride = 1;
+    // images have no time, they are spaced as if taken at the replay rate
+    planes->timestamp = (int64_t) (index * 1e9 / (m_fps > 0.0 ? m_fps : 30.0));
+    *rotation = 0;
+    return true;
+}
+
+void Replay_Source::Pace(int64_t index, int64_t timestamp_ns)
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (index == 0)
+    {
+        m_pass_start = now;
+        m_first_timestamp = timestamp_ns;
+        return;
+    }
+
+    std::chrono::nanoseconds offset(0);
+    if (m_fps > 0.0)
+    {
+        offset = std::chrono::nanoseconds((int64_t) (index * 1e9 / m_fps));
+    }
+    else if (m_fps < 0.0 && m_files.empty() && timestamp_ns != 0)
+    {
+        offset = std::chrono::nanoseconds(std::max((int64_t) 0, timestamp_ns - m_first_timestamp));
+    }
+    std::chrono::steady_clock::time_point due = m_pass_start + offset;
+    if (due > now)
+    {
+        std::this_thread::sleep_until(due);
+    }
+}
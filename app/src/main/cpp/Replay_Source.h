@@ -0,0 +1,63 @@
+#ifndef OPENCV_NDK_REPLAY_SOURCE_H
+#define OPENCV_NDK_REPLAY_SOURCE_H
+
+// OpenCV
+#include <opencv2/core.hpp>
+// OpenCV-NDK App
+#include "Frame_Recorder.h"
+#include "Frame_Source.h"
+#include "Y4m_File.h"
+// STD Libs
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Plays frames back from a Frame_Recorder file, a Y4M file or a directory of
+// images (png, jpg, bmp, pgm, ppm, in name order), for running the CV path
+// on a host or on the same frames again. Recorded and Y4M frames are handed
+// out straight from their mapping, images are decoded to I420 one at a time.
+class Replay_Source : public Frame_Source
+{
+public:
+    Replay_Source() = default;
+    ~Replay_Source() override;
+    Replay_Source(const Replay_Source &other) = delete;
+    Replay_Source &operator=(const Replay_Source &other) = delete;
+
+    // fps > 0 paces the frames at that rate, 0 hands them out as fast as
+    // they are asked for and a negative rate follows the recorded
+    // timestamps, or a Y4M file's own rate. passes > 1 plays everything that
+    // many times.
+    bool Open(const std::string &path, double fps = 0.0, int32_t passes = 1);
+    void Close();
+
+    bool Acquire(Yuv_Planes *planes, int32_t *rotation) override;
+    void Release() override;
+    bool AtEnd() const override;
+
+    // Frames of one pass
+    int64_t GetFrameCount() const;
+
+private:
+    // Frame index of the pass into planes, false when it cannot be read
+    bool Load(int64_t index, Yuv_Planes *planes, int32_t *rotation);
+    // Sleeps until frame index with timestamp_ns is due
+    void Pace(int64_t index, int64_t timestamp_ns);
+
+    Frame_Recording m_recording;
+    Y4m_Reader m_y4m;
+    // frame numbers of the recording that were complete when opened
+    std::vector<int64_t> m_frames;
+    std::vector<std::string> m_files;
+    // current image as I420
+    cv::Mat m_yuv;
+
+    double m_fps = 0.0;
+    int32_t m_passes = 1;
+    int64_t m_next = 0;
+    std::chrono::steady_clock::time_point m_pass_start;
+    int64_t m_first_timestamp = 0;
+};
+
+#endif  // OPENCV_NDK_REPLAY_SOURCE_H
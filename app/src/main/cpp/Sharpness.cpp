@@ -0,0 +1,166 @@
+#include "Sharpness.h"
+#include "Simd.h"
+#include <algorithm>
+
+// Every step-th pixel of a row, count of them
+static void DecimateRow(const uint8_t *src, int32_t step, int32_t count, uint8_t *dst)
+{
+    int32_t x = 0;
+    if (step == 1)
+    {
+        std::copy(src, src + count, dst);
+        return;
+    }
+    if (step == 2)
+    {
+        // 32 source bytes give 16 output bytes per iteration, the last
+        // pixel is left to the plain loop so no byte past it is read
+#if defined(OPENCV_NDK_NEON)
+        for (; x + 16 < count; x += 16)
+        {
+            uint8x16x2_t v = vld2q_u8(src + x * 2);
+            vst1q_u8(dst + x, v.val[0]);
+        }
+#elif defined(OPENCV_NDK_SSE2)
+        const __m128i low_byte = _mm_set1_epi16(0xFF);
+        for (; x + 16 < count; x += 16)
+        {
+            const __m128i *p = reinterpret_cast<const __m128i *>(src + x * 2);
+            __m128i a0 = _mm_and_si128(_mm_loadu_si128(p + 0), low_byte);
+            __m128i a1 = _mm_and_si128(_mm_loadu_si128(p + 1), low_byte);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), _mm_packus_epi16(a0, a1));
+        }
+#endif
+    }
+    for (; x < count; x++)
+    {
+        dst[x] = src[x * step];
+    }
+}
+
+// Sum and sum of squares of 4c - l - r - u - d over the interior pixels of
+// the middle one of three rows
+static void AccumulateLaplacian(const uint8_t *up, const uint8_t *mid, const uint8_t *down,
+                                int32_t count, int64_t &sum, int64_t &sum_squares)
+{
+    int32_t x = 1;
+    // a lane of squares gets at most 2 * 1020^2 per iteration, flushed per row
+#if defined(OPENCV_NDK_NEON)
+    int32x4_t lane_sum = vdupq_n_s32(0);
+    int32x4_t lane_squares = vdupq_n_s32(0);
+    for (; x + 8 + 1 <= count; x += 8)
+    {
+        int16x8_t c = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(mid + x)));
+        int16x8_t l = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(mid + x - 1)));
+        int16x8_t r = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(mid + x + 1)));
+        int16x8_t u = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(up + x)));
+        int16x8_t d = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(down + x)));
+        int16x8_t lap = vsubq_s16(vshlq_n_s16(c, 2),
+                                  vaddq_s16(vaddq_s16(l, r), vaddq_s16(u, d)));
+        lane_sum = vpadalq_s16(lane_sum, lap);
+        lane_squares = vmlal_s16(lane_squares, vget_low_s16(lap), vget_low_s16(lap));
+        lane_squares = vmlal_s16(lane_squares, vget_high_s16(lap), vget_high_s16(lap));
+    }
+    int32_t lanes[4];
+    vst1q_s32(lanes, lane_sum);
+    sum += (int64_t) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    vst1q_s32(lanes, lane_squares);
+    sum_squares += (int64_t) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(OPENCV_NDK_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i lane_sum = zero;
+    __m128i lane_squares = zero;
+    for (; x + 8 + 1 <= count; x += 8)
+    {
+        __m128i c = _mm_unpacklo_epi8(
+                _mm_loadl_epi64(reinterpret_cast<const __m128i *>(mid + x)), zero);
+        __m128i l = _mm_unpacklo_epi8(
+                _mm_loadl_epi64(reinterpret_cast<const __m128i *>(mid + x - 1)), zero);
+        __m128i r = _mm_unpacklo_epi8(
+                _mm_loadl_epi64(reinterpret_cast<const __m128i *>(mid + x + 1)), zero);
+        __m128i u = _mm_unpacklo_epi8(
+                _mm_loadl_epi64(reinterpret_cast<const __m128i *>(up + x)), zero);
+        __m128i d = _mm_unpacklo_epi8(
+                _mm_loadl_epi64(reinterpret_cast<const __m128i *>(down + x)), zero);
+        __m128i lap = _mm_sub_epi16(_mm_slli_epi16(c, 2),
+                                    _mm_add_epi16(_mm_add_epi16(l, r), _mm_add_epi16(u, d)));
+        lane_sum = _mm_add_epi32(lane_sum, _mm_madd_epi16(lap, ones));
+        lane_squares = _mm_add_epi32(lane_squares, _mm_madd_epi16(lap, lap));
+    }
+    int32_t lanes[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), lane_sum);
+    sum += (int64_t) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), lane_squares);
+    sum_squares += (int64_t) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+    for (; x + 1 < count; x++)
+    {
+        int32_t lap = 4 * mid[x] - mid[x - 1] - mid[x + 1] - up[x] - down[x];
+        sum += lap;
+        sum_squares += lap * lap;
+    }
+}
+
+double MeasureSharpness(const Yuv_Planes &planes, const std::vector<cv::Rect> &rois,
+                        const cv::Size &roi_frame, int32_t max_width)
+{
+    const cv::Rect frame(0, 0, planes.width, planes.height);
+    std::vector<cv::Rect> areas;
+    if (roi_frame.width > 0 && roi_frame.height > 0)
+    {
+        const double sx = (double) planes.width / roi_frame.width;
+        const double sy = (double) planes.height / roi_frame.height;
+        for (size_t i = 0; i < rois.size(); i++)
+        {
+            cv::Rect area((int32_t) (rois[i].x * sx), (int32_t) (rois[i].y * sy),
+                          (int32_t) (rois[i].width * sx), (int32_t) (rois[i].height * sy));
+            area &= frame;
+            if (area.area() > 0)
+            {
+                areas.push_back(area);
+            }
+        }
+    }
+    if (areas.empty())
+    {
+        areas.push_back(frame);
+    }
+
+    const int32_t step = std::max(1, (planes.width + max_width - 1) / std::max(1, max_width));
+    int64_t sum = 0;
+    int64_t sum_squares = 0;
+    int64_t count = 0;
+    std::vector<uint8_t> rows;
+    for (size_t a = 0; a < areas.size(); a++)
+    {
+        const cv::Rect &area = areas[a];
+        const int32_t width = (area.width + step - 1) / step;
+        const int32_t height = (area.height + step - 1) / step;
+        if (width < 3 || height < 3)
+        {
+            continue;
+        }
+        // three decimated rows in turn
+        rows.resize((size_t) width * 3);
+        uint8_t *ring[3] = {rows.data(), rows.data() + width, rows.data() + 2 * width};
+        for (int32_t y = 0; y < height; y++)
+        {
+            const uint8_t *src = planes.y + (size_t) (area.y + y * step) * planes.y_stride + area.x;
+            uint8_t *row = ring[y % 3];
+            DecimateRow(src, step, width, row);
+            if (y >= 2)
+            {
+                AccumulateLaplacian(ring[(y - 2) % 3], ring[(y - 1) % 3], row, width, sum,
+                                    sum_squares);
+                count += width - 2;
+            }
+        }
+    }
+    if (count == 0)
+    {
+        return 0.0;
+    }
+    double mean = (double) sum / count;
+    return (double) sum_squares / count - mean * mean;
+}
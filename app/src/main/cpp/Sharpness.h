@@ -0,0 +1,24 @@
+#ifndef OPENCV_NDK_SHARPNESS_H
+#define OPENCV_NDK_SHARPNESS_H
+
+// OpenCV
+#include <opencv2/core.hpp>
+// OpenCV-NDK App
+#include "Util.h"
+// STD Libs
+#include <cstdint>
+#include <vector>
+
+// Focus score of a frame: the variance of the 4-neighbour Laplacian of its
+// luma, taken on every step-th pixel of every step-th row with step chosen
+// so at most max_width pixels per row are looked at. Blur from focus or
+// motion flattens the Laplacian, so of several frames of one scene the
+// sharpest scores highest.
+//
+// rois, given on a frame of roi_frame size such as the detected faces,
+// restrict the score to those areas. With none, or none inside the frame,
+// the whole frame counts.
+double MeasureSharpness(const Yuv_Planes &planes, const std::vector<cv::Rect> &rois,
+                        const cv::Size &roi_frame, int32_t max_width = 1024);
+
+#endif  // OPENCV_NDK_SHARPNESS_H
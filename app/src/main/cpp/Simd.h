@@ -0,0 +1,15 @@
+#ifndef OPENCV_NDK_SIMD_H
+#define OPENCV_NDK_SIMD_H
+
+// Picks the vector instruction set for the hand written kernels. NEON is used
+// on armeabi-v7a (LOCAL_ARM_NEON in Android.mk) and arm64, SSE2 on x86 builds
+// and everything else falls back to the plain C loops.
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define OPENCV_NDK_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define OPENCV_NDK_SSE2 1
+#endif
+
+#endif  // OPENCV_NDK_SIMD_H
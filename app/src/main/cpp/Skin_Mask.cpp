@@ -0,0 +1,64 @@
+#include "Skin_Mask.h"
+#include "Grid_Regions.h"
+#include <algorithm>
+
+// Cb/Cr box of the skin cluster
+static const uint8_t CB_MIN = 77;
+static const uint8_t CB_MAX = 127;
+static const uint8_t CR_MIN = 133;
+static const uint8_t CR_MAX = 173;
+
+Skin_Mask::Skin_Mask(int32_t cell_size, float min_coverage)
+        : m_cell_size(std::max(1, cell_size)), m_min_coverage(min_coverage)
+{
+}
+
+void Skin_Mask::Build(const Yuv_Planes &planes)
+{
+    const int32_t chroma_width = planes.width / 2;
+    const int32_t chroma_height = planes.height / 2;
+
+    m_width = planes.width;
+    m_height = planes.height;
+    m_cols = (chroma_width + m_cell_size - 1) / m_cell_size;
+    m_rows = (chroma_height + m_cell_size - 1) / m_cell_size;
+    m_counts.assign(m_cols * m_rows, 0);
+
+    // unsigned wrap around turns each range test into a single compare
+    const uint8_t cb_span = (uint8_t) (CB_MAX - CB_MIN);
+    const uint8_t cr_span = (uint8_t) (CR_MAX - CR_MIN);
+    const int32_t pixel_stride = planes.uv_pixel_stride;
+
+    for (int32_t y = 0; y < chroma_height; y++)
+    {
+        const uint8_t *pU = planes.u + y * planes.uv_stride;
+        const uint8_t *pV = planes.v + y * planes.uv_stride;
+        uint16_t *counts = m_counts.data() + (y / m_cell_size) * m_cols;
+
+        for (int32_t x = 0; x < chroma_width; x++)
+        {
+            uint8_t cb = (uint8_t) (pU[x * pixel_stride] - CB_MIN);
+            uint8_t cr = (uint8_t) (pV[x * pixel_stride] - CR_MIN);
+            counts[x / m_cell_size] += (cb <= cb_span && cr <= cr_span) ? 1 : 0;
+        }
+    }
+
+    const int32_t cell_area = m_cell_size * m_cell_size;
+    m_candidates.assign(m_cols * m_rows, 0);
+    for (size_t i = 0; i < m_counts.size(); i++)
+    {
+        m_candidates[i] = (m_counts[i] >= m_min_coverage * cell_area) ? 1 : 0;
+    }
+}
+
+std::vector<cv::Rect> Skin_Mask::GetCandidateRegions(int32_t margin) const
+{
+    if (m_candidates.empty())
+    {
+        return std::vector<cv::Rect>();
+    }
+
+    const int32_t cell_pixels = m_cell_size * 2;
+    return GridRegions(m_candidates.data(), m_cols, m_rows, cell_pixels, cell_pixels,
+                       margin, cv::Rect(0, 0, m_width, m_height));
+}
@@ -0,0 +1,43 @@
+#ifndef OPENCV_NDK_SKIN_MASK_H
+#define OPENCV_NDK_SKIN_MASK_H
+
+// OpenCV
+#include <opencv2/core.hpp>
+// OpenCV-NDK App
+#include "Util.h"
+// STD Libs
+#include <cstdint>
+#include <vector>
+
+// Low resolution skin likelihood map built from the chroma planes only.
+// A chroma sample is skin when Cb and Cr fall in the usual skin cluster
+// (Chai & Ngan). Samples are counted per cell so the cascades can skip any
+// region whose skin coverage is too low to contain a face.
+class Skin_Mask
+{
+public:
+    // cell_size: side of a cell in chroma samples (luma pixels / 2)
+    // min_coverage: fraction of skin samples for a cell to be a candidate
+    explicit Skin_Mask(int32_t cell_size = 4, float min_coverage = 0.3f);
+
+    void Build(const Yuv_Planes &planes);
+
+    // Connected candidate cells as boxes in luma pixels, grown by margin
+    std::vector<cv::Rect> GetCandidateRegions(int32_t margin) const;
+
+private:
+    int32_t m_cell_size;
+    float m_min_coverage;
+
+    // luma size of the last frame and the cell grid covering it
+    int32_t m_width = 0;
+    int32_t m_height = 0;
+    int32_t m_cols = 0;
+    int32_t m_rows = 0;
+
+    // skin samples per cell and the candidate flags derived from it
+    std::vector<uint16_t> m_counts;
+    std::vector<uint8_t> m_candidates;
+};
+
+#endif  // OPENCV_NDK_SKIN_MASK_H
@@ -0,0 +1,237 @@
+#include "Thumbnail_Pyramid.h"
+#include "Jpeg_Encoder.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+
+// output rows of the first level per task
+static const int32_t BAND_ROWS = 16;
+
+// Means of 4x4 blocks over four rows, count of them. Sample i of a row is
+// row[i * pixel_stride] and samples past last repeat it.
+static void Box4Row(const uint8_t *const rows[4], int32_t pixel_stride, int32_t last,
+                    int32_t count, uint8_t *dst)
+{
+    int32_t x = 0;
+    // 32 samples give 8 means per iteration. One more sample has to exist,
+    // so the interleaved loads never touch a byte past the plane.
+#if defined(OPENCV_NDK_NEON)
+    for (; pixel_stride <= 2 && x + 8 <= count && 4 * (x + 8) <= last; x += 8)
+    {
+        uint16x8_t a = vdupq_n_u16(0);
+        uint16x8_t b = vdupq_n_u16(0);
+        for (int32_t r = 0; r < 4; r++)
+        {
+            const uint8_t *p = rows[r] + (size_t) 4 * x * pixel_stride;
+            if (pixel_stride == 1)
+            {
+                a = vpadalq_u8(a, vld1q_u8(p));
+                b = vpadalq_u8(b, vld1q_u8(p + 16));
+            }
+            else
+            {
+                a = vpadalq_u8(a, vld2q_u8(p).val[0]);
+                b = vpadalq_u8(b, vld2q_u8(p + 32).val[0]);
+            }
+        }
+        uint16x8_t sums = vcombine_u16(vpadd_u16(vget_low_u16(a), vget_high_u16(a)),
+                                       vpadd_u16(vget_low_u16(b), vget_high_u16(b)));
+        vst1_u8(dst + x, vrshrn_n_u16(sums, 4));
+    }
+#elif defined(OPENCV_NDK_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+    const __m128i low_byte = _mm_set1_epi16(0xFF);
+    const __m128i round = _mm_set1_epi16(8);
+    for (; pixel_stride <= 2 && x + 8 <= count && 4 * (x + 8) <= last; x += 8)
+    {
+        // column sums of samples 0-7, 8-15, 16-23 and 24-31
+        __m128i c[4] = {zero, zero, zero, zero};
+        for (int32_t r = 0; r < 4; r++)
+        {
+            const __m128i *p = reinterpret_cast<const __m128i *>(
+                    rows[r] + (size_t) 4 * x * pixel_stride);
+            if (pixel_stride == 1)
+            {
+                __m128i v0 = _mm_loadu_si128(p);
+                __m128i v1 = _mm_loadu_si128(p + 1);
+                c[0] = _mm_add_epi16(c[0], _mm_unpacklo_epi8(v0, zero));
+                c[1] = _mm_add_epi16(c[1], _mm_unpackhi_epi8(v0, zero));
+                c[2] = _mm_add_epi16(c[2], _mm_unpacklo_epi8(v1, zero));
+                c[3] = _mm_add_epi16(c[3], _mm_unpackhi_epi8(v1, zero));
+            }
+            else
+            {
+                for (int32_t i = 0; i < 4; i++)
+                {
+                    c[i] = _mm_add_epi16(c[i], _mm_and_si128(_mm_loadu_si128(p + i), low_byte));
+                }
+            }
+        }
+        // pairs of columns, then pairs of pairs
+        __m128i pairs01 = _mm_packs_epi32(_mm_madd_epi16(c[0], ones), _mm_madd_epi16(c[1], ones));
+        __m128i pairs23 = _mm_packs_epi32(_mm_madd_epi16(c[2], ones), _mm_madd_epi16(c[3], ones));
+        __m128i sums = _mm_packs_epi32(_mm_madd_epi16(pairs01, ones),
+                                       _mm_madd_epi16(pairs23, ones));
+        sums = _mm_srli_epi16(_mm_add_epi16(sums, round), 4);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + x), _mm_packus_epi16(sums, sums));
+    }
+#endif
+    for (; x < count; x++)
+    {
+        int32_t sum = 0;
+        for (int32_t r = 0; r < 4; r++)
+        {
+            for (int32_t dx = 0; dx < 4; dx++)
+            {
+                sum += rows[r][(size_t) std::min(4 * x + dx, last) * pixel_stride];
+            }
+        }
+        dst[x] = (uint8_t) ((sum + 8) >> 4);
+    }
+}
+
+// 1/4 of a plane of width x height into out_width x out_height
+static void Box4Plane(const uint8_t *src, int32_t width, int32_t height, int32_t stride,
+                      int32_t pixel_stride, uint8_t *dst, int32_t out_width, int32_t y_begin,
+                      int32_t y_end)
+{
+    for (int32_t y = y_begin; y < y_end; y++)
+    {
+        const uint8_t *rows[4];
+        for (int32_t r = 0; r < 4; r++)
+        {
+            rows[r] = src + (size_t) std::min(4 * y + r, height - 1) * stride;
+        }
+        Box4Row(rows, pixel_stride, width - 1, out_width, dst + (size_t) y * out_width);
+    }
+}
+
+// 1/2 of a packed plane of width x height into out_width x out_height
+static void Box2Plane(const uint8_t *src, int32_t width, int32_t height, uint8_t *dst,
+                      int32_t out_width, int32_t out_height)
+{
+    for (int32_t y = 0; y < out_height; y++)
+    {
+        const uint8_t *row0 = src + (size_t) std::min(2 * y, height - 1) * width;
+        const uint8_t *row1 = src + (size_t) std::min(2 * y + 1, height - 1) * width;
+        for (int32_t x = 0; x < out_width; x++)
+        {
+            int32_t x0 = std::min(2 * x, width - 1);
+            int32_t x1 = std::min(2 * x + 1, width - 1);
+            dst[x] = (uint8_t) ((row0[x0] + row0[x1] + row1[x0] + row1[x1] + 2) >> 2);
+        }
+        dst += out_width;
+    }
+}
+
+void Thumbnail_Pyramid::Build(const Yuv_Planes &planes, Worker_Pool *pool)
+{
+    m_timestamp = planes.timestamp;
+    for (int32_t level = 0; level < LEVELS; level++)
+    {
+        Level &out = m_levels[level];
+        const Level *previous = level > 0 ? &m_levels[level - 1] : nullptr;
+        out.width = previous ? previous->width / 2 : planes.width / 4;
+        out.height = previous ? previous->height / 2 : planes.height / 4;
+        if (out.width == 0 || out.height == 0)
+        {
+            out.width = out.height = 0;
+            out.data.clear();
+            continue;
+        }
+        const int32_t uv_width = (out.width + 1) / 2;
+        const int32_t uv_height = (out.height + 1) / 2;
+        out.data.resize((size_t) out.width * out.height + (size_t) uv_width * uv_height * 2);
+        uint8_t *y_out = out.data.data();
+        uint8_t *u_out = y_out + (size_t) out.width * out.height;
+        uint8_t *v_out = u_out + (size_t) uv_width * uv_height;
+
+        if (previous)
+        {
+            // small enough to not be worth spreading
+            const int32_t prev_uv_width = (previous->width + 1) / 2;
+            const int32_t prev_uv_height = (previous->height + 1) / 2;
+            const uint8_t *y_in = previous->data.data();
+            const uint8_t *u_in = y_in + (size_t) previous->width * previous->height;
+            const uint8_t *v_in = u_in + (size_t) prev_uv_width * prev_uv_height;
+            Box2Plane(y_in, previous->width, previous->height, y_out, out.width, out.height);
+            Box2Plane(u_in, prev_uv_width, prev_uv_height, u_out, uv_width, uv_height);
+            Box2Plane(v_in, prev_uv_width, prev_uv_height, v_out, uv_width, uv_height);
+            continue;
+        }
+
+        // bands of luma rows, then bands of chroma rows, read from the
+        // capture as it is laid out
+        const int32_t src_uv_width = (planes.width + 1) / 2;
+        const int32_t src_uv_height = (planes.height + 1) / 2;
+        const size_t y_bands = (size_t) (out.height + BAND_ROWS - 1) / BAND_ROWS;
+        const size_t uv_bands = (size_t) (uv_height + BAND_ROWS - 1) / BAND_ROWS;
+        std::function<void(size_t)> task = [&](size_t band)
+        {
+            if (band < y_bands)
+            {
+                int32_t begin = (int32_t) band * BAND_ROWS;
+                Box4Plane(planes.y, planes.width, planes.height, planes.y_stride, 1, y_out,
+                          out.width, begin, std::min(begin + BAND_ROWS, out.height));
+                return;
+            }
+            int32_t begin = (int32_t) (band - y_bands) * BAND_ROWS;
+            int32_t end = std::min(begin + BAND_ROWS, uv_height);
+            Box4Plane(planes.u, src_uv_width, src_uv_height, planes.uv_stride,
+                      planes.uv_pixel_stride, u_out, uv_width, begin, end);
+            Box4Plane(planes.v, src_uv_width, src_uv_height, planes.uv_stride,
+                      planes.uv_pixel_stride, v_out, uv_width, begin, end);
+        };
+        if (pool != nullptr)
+        {
+            pool->ParallelFor(y_bands + uv_bands, task);
+        }
+        else
+        {
+            for (size_t band = 0; band < y_bands + uv_bands; band++)
+            {
+                task(band);
+            }
+        }
+    }
+}
+
+bool Thumbnail_Pyramid::GetLevel(int32_t level, Yuv_Planes *planes) const
+{
+    if (level < 0 || level >= LEVELS || m_levels[level].data.empty())
+    {
+        return false;
+    }
+    const Level &in = m_levels[level];
+    const int32_t uv_width = (in.width + 1) / 2;
+    const int32_t uv_height = (in.height + 1) / 2;
+    planes->y = in.data.data();
+    planes->u = planes->y + (size_t) in.width * in.height;
+    planes->v = planes->u + (size_t) uv_width * uv_height;
+    planes->width = in.width;
+    planes->height = in.height;
+    planes->y_stride = in.width;
+    planes->uv_stride = uv_width;
+    planes->uv_pixel_stride = 1;
+    planes->timestamp = m_timestamp;
+    return true;
+}
+
+bool Thumbnail_Pyramid::Write(const std::string &path, Worker_Pool *pool, int32_t quality) const
+{
+    bool ok = true;
+    for (int32_t level = 0; level < LEVELS; level++)
+    {
+        Yuv_Planes planes;
+        if (!GetLevel(level, &planes))
+        {
+            continue;
+        }
+        char name[32];
+        snprintf(name, sizeof(name), "thumb%d.jpg", GetFactor(level));
+        ok = WriteJpeg(planes, path + name, pool, quality) && ok;
+    }
+    return ok;
+}
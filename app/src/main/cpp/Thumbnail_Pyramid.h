@@ -0,0 +1,51 @@
+#ifndef OPENCV_NDK_THUMBNAIL_PYRAMID_H
+#define OPENCV_NDK_THUMBNAIL_PYRAMID_H
+
+// OpenCV-NDK App
+#include "Util.h"
+#include "Worker_Pool.h"
+// STD Libs
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Previews of a capture at 1/4, 1/8 and 1/16 of its size, for the gallery
+// and uploads to use instead of decoding the full file. The 1/4 level is the
+// mean of every 4x4 block of the Y, U and V planes, read once straight from
+// the capture's layout, and each further level averages 2x2 of the one
+// before. The planes stay 4:2:0, so they go to WriteJpeg() as they are.
+class Thumbnail_Pyramid
+{
+public:
+    static const int32_t LEVELS = 3;
+
+    // Downsampling factor of a level, 4, 8 and 16
+    static int32_t GetFactor(int32_t level)
+    { return 4 << level; }
+
+    // Rebuilds every level from planes, rows of the first level are split
+    // over pool, or built on the calling thread when it is nullptr. Levels
+    // of a frame too small for them are left empty.
+    void Build(const Yuv_Planes &planes, Worker_Pool *pool);
+
+    // Planes of a level, false when it is empty
+    bool GetLevel(int32_t level, Yuv_Planes *planes) const;
+
+    // Writes every level as path plus "thumb<factor>.jpg", pool may be
+    // nullptr as for WriteJpeg()
+    bool Write(const std::string &path, Worker_Pool *pool, int32_t quality = 80) const;
+
+private:
+    struct Level
+    {
+        int32_t width = 0;
+        int32_t height = 0;
+        // Y, then U and V at half size each way, rounded up
+        std::vector<uint8_t> data;
+    };
+
+    Level m_levels[LEVELS];
+    int64_t m_timestamp = 0;
+};
+
+#endif  // OPENCV_NDK_THUMBNAIL_PYRAMID_H
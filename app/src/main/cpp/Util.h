@@ -5,18 +5,32 @@
 #ifndef OPENCV_NDK_UTIL_H
 #define OPENCV_NDK_UTIL_H
 
+#include <stdint.h>
 #include <unistd.h>
-#include <android/log.h>
 
 // used to get logcat outputs which can be regex filtered by the LOG_TAG we give
 // So in Logcat you can filter this example by putting OpenCV-NDK
 #define LOG_TAG "OpenCV-NDK-Native"
+#ifdef __ANDROID__
+#include <android/log.h>
 #define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
 #define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
 #define ASSERT(cond, fmt, ...)                                \
   if (!(cond)) {                                              \
     __android_log_assert(#cond, LOG_TAG, fmt, ##__VA_ARGS__); \
   }
+#else
+// host builds, see Frame_Replay.cpp, log to stderr
+#include <stdio.h>
+#include <stdlib.h>
+#define LOGI(...) (fprintf(stderr, "I " LOG_TAG ": " __VA_ARGS__), fputc('\n', stderr))
+#define LOGE(...) (fprintf(stderr, "E " LOG_TAG ": " __VA_ARGS__), fputc('\n', stderr))
+#define ASSERT(cond, fmt, ...)                                \
+  if (!(cond)) {                                              \
+    LOGE(#cond ": " fmt, ##__VA_ARGS__);                      \
+    abort();                                                  \
+  }
+#endif
 
 // A Data Structure to communicate resolution between camera and ImageReader
 struct ImageFormat {
@@ -25,6 +39,20 @@ struct ImageFormat {
   int32_t format;  // ex) YUV_420
 };
 
+// Plane pointers and layout of a YUV_420_888 frame as exposed by AImage.
+// u is Cb (plane 1) and v is Cr (plane 2), both subsampled by 2 each way.
+struct Yuv_Planes {
+  const uint8_t* y;
+  const uint8_t* u;
+  const uint8_t* v;
+  int32_t width;
+  int32_t height;
+  int32_t y_stride;
+  int32_t uv_stride;
+  int32_t uv_pixel_stride;  // 1 for planar, 2 for semi-planar layouts
+  int64_t timestamp;        // sensor timestamp in ns, 0 when unknown
+};
+
 /**
  * A helper class to assist image size comparison, by comparing the absolute
  * size
@@ -0,0 +1,93 @@
+#include "Worker_Pool.h"
+
+Worker_Pool::Worker_Pool(int32_t threads)
+        : m_next(0)
+{
+    if (threads < 0)
+    {
+        threads = (int32_t) std::thread::hardware_concurrency() - 1;
+    }
+    for (int32_t i = 0; i < threads; i++)
+    {
+        m_threads.push_back(std::thread(&Worker_Pool::WorkerLoop, this));
+    }
+}
+
+Worker_Pool::~Worker_Pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (size_t i = 0; i < m_threads.size(); i++)
+    {
+        m_threads[i].join();
+    }
+}
+
+void Worker_Pool::RunTasks()
+{
+    for (size_t i = m_next++; i < m_count; i = m_next++)
+    {
+        (*m_task)(i);
+    }
+}
+
+void Worker_Pool::WorkerLoop()
+{
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        m_wake.wait(lock, [&] { return m_stop || m_generation != seen; });
+        if (m_stop)
+        {
+            return;
+        }
+        seen = m_generation;
+
+        lock.unlock();
+        RunTasks();
+        lock.lock();
+
+        if (--m_active == 0)
+        {
+            m_done.notify_one();
+        }
+    }
+}
+
+void Worker_Pool::ParallelFor(size_t count, const std::function<void(size_t)> &task)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    if (m_threads.empty() || count == 1)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            task(i);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> run(m_run_mutex);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_task = &task;
+        m_count = count;
+        m_next = 0;
+        m_active = m_threads.size();
+        m_generation++;
+    }
+    m_wake.notify_all();
+
+    RunTasks();
+
+    // every worker has to leave RunTasks() before task goes out of scope
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this] { return m_active == 0; });
+    m_task = nullptr;
+}
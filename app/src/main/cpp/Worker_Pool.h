@@ -0,0 +1,56 @@
+#ifndef OPENCV_NDK_WORKER_POOL_H
+#define OPENCV_NDK_WORKER_POOL_H
+
+// STD Libs
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small fixed set of threads shared by everything that processes a frame.
+// Work is handed out as parallel loops; the calling thread takes part too,
+// so a pool without threads simply runs the loop inline.
+class Worker_Pool
+{
+public:
+    // threads: number of helper threads, negative picks one less than the
+    // number of cores
+    explicit Worker_Pool(int32_t threads = -1);
+    ~Worker_Pool();
+    Worker_Pool(const Worker_Pool &other) = delete;
+    Worker_Pool &operator=(const Worker_Pool &other) = delete;
+
+    // Calls task(i) for every i below count and returns once all are done.
+    // Indices are handed out one at a time so uneven tasks balance out.
+    // Only one loop runs at a time, concurrent callers wait for each other,
+    // so it must not be called from inside a task.
+    void ParallelFor(size_t count, const std::function<void(size_t)> &task);
+
+    // Helper threads plus the caller
+    int32_t GetConcurrency() const
+    { return (int32_t) m_threads.size() + 1; }
+
+private:
+    void WorkerLoop();
+    void RunTasks();
+
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_run_mutex;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+
+    // current loop, published under m_mutex together with a new generation
+    const std::function<void(size_t)> *m_task = nullptr;
+    size_t m_count = 0;
+    std::atomic<size_t> m_next;
+    size_t m_active = 0;
+    uint64_t m_generation = 0;
+    bool m_stop = false;
+};
+
+#endif  // OPENCV_NDK_WORKER_POOL_H
@@ -0,0 +1,499 @@
+#include "Y4m_File.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char Y4M_MAGIC[] = "YUV4MPEG2";
+static const char Y4M_FRAME[] = "FRAME";
+// a header with every optional field is well below this
+static const size_t MAX_HEADER = 1024;
+// large writes, the camera thread streams whole frames
+static const size_t WRITE_BUFFER = 1 << 20;
+
+Y4m_Writer::~Y4m_Writer()
+{
+    Close();
+}
+
+bool Y4m_Writer::Open(const std::string &path, int32_t width, int32_t height, bool chroma,
+                      int32_t fps_num, int32_t fps_den)
+{
+    Close();
+    m_file = fopen(path.c_str(), "wb");
+    if (m_file == nullptr)
+    {
+        LOGE("Y4m_Writer: cannot create %s", path.c_str());
+        return false;
+    }
+    setvbuf(m_file, nullptr, _IOFBF, WRITE_BUFFER);
+    m_width = width;
+    m_height = height;
+    m_chroma = chroma;
+    m_frames = 0;
+    // XCOLORRANGE is ffmpeg's extension, without it video range is assumed
+    m_ok = fprintf(m_file, "%s W%d H%d F%d:%d Ip A1:1 %s XCOLORRANGE=FULL\n", Y4M_MAGIC,
+                   width, height, fps_num, fps_den, chroma ? "C420jpeg" : "Cmono") > 0;
+    return m_ok;
+}
+
+bool Y4m_Writer::Close()
+{
+    if (m_file == nullptr)
+    {
+        return true;
+    }
+    bool ok = fclose(m_file) == 0 && m_ok;
+    m_file = nullptr;
+    if (!ok)
+    {
+        LOGE("Y4m_Writer: writing failed after %lld frames", (long long) m_frames);
+    }
+    return ok;
+}
+
+bool Y4m_Writer::WritePlane(const uint8_t *data, int32_t width, int32_t height, int32_t stride,
+                            int32_t pixel_stride)
+{
+    if (pixel_stride == 1 && stride == width)
+    {
+        size_t size = (size_t) width * height;
+        return fwrite(data, 1, size, m_file) == size;
+    }
+    for (int32_t y = 0; y < height; y++)
+    {
+        const uint8_t *row = data + (size_t) y * stride;
+        if (pixel_stride != 1)
+        {
+            m_row.resize(width);
+            for (int32_t x = 0; x < width; x++)
+            {
+                m_row[x] = row[x * pixel_stride];
+            }
+            row = m_row.data();
+        }
+        if (fwrite(row, 1, width, m_file) != (size_t) width)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Y4m_Writer::Write(const Yuv_Planes &planes)
+{
+    if (m_file == nullptr || !m_ok)
+    {
+        return false;
+    }
+    if (planes.width != m_width || planes.height != m_height ||
+        (m_chroma && (planes.u == nullptr || planes.v == nullptr)))
+    {
+        LOGE("Y4m_Writer: %dx%d frame does not match the %dx%d stream", planes.width,
+             planes.height, m_width, m_height);
+        return false;
+    }
+
+    const int32_t uv_width = (m_width + 1) / 2;
+    const int32_t uv_height = (m_height + 1) / 2;
+    m_ok = fprintf(m_file, "%s\n", Y4M_FRAME) > 0 &&
+           WritePlane(planes.y, m_width, m_height, planes.y_stride, 1);
+    if (m_ok && m_chroma)
+    {
+        m_ok = WritePlane(planes.u, uv_width, uv_height, planes.uv_stride,
+                          planes.uv_pixel_stride) &&
+               WritePlane(planes.v, uv_width, uv_height, planes.uv_stride,
+                          planes.uv_pixel_stride);
+    }
+    if (m_ok)
+    {
+        m_frames++;
+    }
+    return m_ok;
+}
+
+Y4m_Exporter::Y4m_Exporter(size_t buffers)
+        : m_buffers(std::max((size_t) 1, buffers))
+{
+}
+
+Y4m_Exporter::~Y4m_Exporter()
+{
+    Stop();
+}
+
+bool Y4m_Exporter::Start(const std::string &path, int32_t width, int32_t height, bool chroma,
+                         int32_t fps_num, int32_t fps_den)
+{
+    Stop();
+    if (width <= 0 || height <= 0)
+    {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_width = width;
+    m_height = height;
+    m_chroma = chroma;
+    m_exporting = true;
+    m_failed = false;
+    m_stop = false;
+    m_written = 0;
+    m_dropped = 0;
+    m_thread = std::thread(&Y4m_Exporter::Run, this, path, fps_num, fps_den);
+    return true;
+}
+
+bool Y4m_Exporter::Stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!m_thread.joinable())
+        {
+            return true;
+        }
+        m_exporting = false;
+        // queued frames, the one being written and the ones Export() is
+        // still copying all return to the pool
+        m_idle.wait(lock, [this]()
+        {
+            return m_outstanding == 0;
+        });
+        m_stop = true;
+    }
+    m_work.notify_all();
+    m_thread.join();
+
+    bool ok = m_writer.Close() && !m_failed;
+    LOGI("Y4m_Exporter: %lld frames written, %lld dropped", (long long) m_written,
+         (long long) m_dropped);
+    return ok;
+}
+
+bool Y4m_Exporter::IsExporting() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_exporting;
+}
+
+bool Y4m_Exporter::HasFailed() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_failed;
+}
+
+bool Y4m_Exporter::Export(const Yuv_Planes &planes)
+{
+    std::unique_ptr<std::vector<uint8_t> > frame;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_exporting || m_failed)
+        {
+            return false;
+        }
+        // never wait for the writer thread
+        if (planes.width != m_width || planes.height != m_height ||
+            (m_chroma && (planes.u == nullptr || planes.v == nullptr)) ||
+            m_outstanding >= m_buffers)
+        {
+            m_dropped++;
+            return false;
+        }
+        m_outstanding++;
+        if (m_pool.empty())
+        {
+            frame.reset(new std::vector<uint8_t>());
+        }
+        else
+        {
+            frame = std::move(m_pool.back());
+            m_pool.pop_back();
+        }
+    }
+
+    const int32_t uv_width = (m_width + 1) / 2;
+    const int32_t uv_height = (m_height + 1) / 2;
+    size_t size = (size_t) m_width * m_height;
+    if (m_chroma)
+    {
+        size += 2 * (size_t) uv_width * uv_height;
+    }
+    frame->resize(size);
+
+    uint8_t *out = frame->data();
+    for (int32_t y = 0; y < m_height; y++, out += m_width)
+    {
+        memcpy(out, planes.y + (size_t) y * planes.y_stride, m_width);
+    }
+    if (m_chroma)
+    {
+        const uint8_t *chroma[2] = {planes.u, planes.v};
+        for (int32_t c = 0; c < 2; c++)
+        {
+            for (int32_t y = 0; y < uv_height; y++, out += uv_width)
+            {
+                const uint8_t *row = chroma[c] + (size_t) y * planes.uv_stride;
+                if (planes.uv_pixel_stride == 1)
+                {
+                    memcpy(out, row, uv_width);
+                    continue;
+                }
+                for (int32_t x = 0; x < uv_width; x++)
+                {
+                    out[x] = row[x * planes.uv_pixel_stride];
+                }
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_failed)
+        {
+            // writing failed while the planes were copied
+            m_pool.push_back(std::move(frame));
+            m_outstanding--;
+            m_idle.notify_all();
+            return false;
+        }
+        m_queue.push_back(std::move(frame));
+    }
+    m_work.notify_one();
+    return true;
+}
+
+int64_t Y4m_Exporter::GetWritten() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_written;
+}
+
+int64_t Y4m_Exporter::GetDropped() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_dropped;
+}
+
+void Y4m_Exporter::Run(std::string path, int32_t fps_num, int32_t fps_den)
+{
+    bool opened = m_writer.Open(path, m_width, m_height, m_chroma, fps_num, fps_den);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (!opened)
+    {
+        FailLocked();
+        return;
+    }
+    const int32_t uv_width = (m_width + 1) / 2;
+    const int32_t uv_height = (m_height + 1) / 2;
+    while (true)
+    {
+        m_work.wait(lock, [this]()
+        {
+            return m_stop || !m_queue.empty();
+        });
+        if (m_queue.empty())
+        {
+            return;
+        }
+        std::unique_ptr<std::vector<uint8_t> > frame = std::move(m_queue.front());
+        m_queue.pop_front();
+        lock.unlock();
+
+        Yuv_Planes planes = {};
+        planes.y = frame->data();
+        if (m_chroma)
+        {
+            planes.u = planes.y + (size_t) m_width * m_height;
+            planes.v = planes.u + (size_t) uv_width * uv_height;
+        }
+        planes.width = m_width;
+        planes.height = m_height;
+        planes.y_stride = m_width;
+        planes.uv_stride = uv_width;
+        planes.uv_pixel_stride = 1;
+        bool written = m_writer.Write(planes);
+
+        lock.lock();
+        m_pool.push_back(std::move(frame));
+        m_outstanding--;
+        if (written)
+        {
+            m_written++;
+        }
+        else
+        {
+            FailLocked();
+            return;
+        }
+        m_idle.notify_all();
+    }
+}
+
+void Y4m_Exporter::FailLocked()
+{
+    m_failed = true;
+    while (!m_queue.empty())
+    {
+        m_pool.push_back(std::move(m_queue.front()));
+        m_queue.pop_front();
+        m_outstanding--;
+    }
+    m_idle.notify_all();
+}
+
+Y4m_Reader::~Y4m_Reader()
+{
+    Close();
+}
+
+bool Y4m_Reader::Open(const std::string &path)
+{
+    Close();
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        LOGE("Y4m_Reader: cannot open %s", path.c_str());
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= (off_t) sizeof(Y4M_MAGIC))
+    {
+        LOGE("Y4m_Reader: %s is no Y4M file", path.c_str());
+        close(fd);
+        return false;
+    }
+    void *map = mmap(nullptr, (size_t) info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        LOGE("Y4m_Reader: cannot map %s", path.c_str());
+        close(fd);
+        return false;
+    }
+    m_fd = fd;
+    m_map = static_cast<const uint8_t *>(map);
+    m_map_size = (size_t) info.st_size;
+
+    const char *text = reinterpret_cast<const char *>(m_map);
+    const void *end = memchr(text, '\n', std::min(m_map_size, MAX_HEADER));
+    if (memcmp(text, Y4M_MAGIC, sizeof(Y4M_MAGIC) - 1) != 0 || end == nullptr)
+    {
+        LOGE("Y4m_Reader: %s is no Y4M file", path.c_str());
+        Close();
+        return false;
+    }
+    std::string header(text, static_cast<const char *>(end));
+
+    // the header's fields, separated by single spaces, C420jpeg when absent
+    std::string colorspace = "420jpeg";
+    size_t position = header.find(' ');
+    while (position != std::string::npos)
+    {
+        size_t next = header.find(' ', position + 1);
+        std::string field = header.substr(position + 1, next == std::string::npos ?
+                                                        std::string::npos : next - position - 1);
+        position = next;
+        if (field.empty())
+        {
+            continue;
+        }
+        switch (field[0])
+        {
+            case 'W':
+                m_width = atoi(field.c_str() + 1);
+                break;
+            case 'H':
+                m_height = atoi(field.c_str() + 1);
+                break;
+            case 'F':
+                if (sscanf(field.c_str() + 1, "%d:%d", &m_fps_num, &m_fps_den) != 2)
+                {
+                    m_fps_num = m_fps_den = 0;
+                }
+                break;
+            case 'C':
+                colorspace = field.substr(1);
+                break;
+            default:
+                break;
+        }
+    }
+    m_chroma = colorspace != "mono";
+    // 4:2:0 with any siting, the planes are read the same. A bare C420
+    // prefix would let in 420p10 and other deeper layouts.
+    bool is_420 = colorspace == "420" || colorspace == "420jpeg" ||
+                  colorspace == "420paldv" || colorspace == "420mpeg2";
+    if (m_width <= 0 || m_height <= 0 || (m_chroma && !is_420))
+    {
+        LOGE("Y4m_Reader: %s is not 4:2:0 or mono (W%d H%d C%s)", path.c_str(), m_width,
+             m_height, colorspace.c_str());
+        Close();
+        return false;
+    }
+
+    // every frame is a FRAME line, parameters are allowed, then the planes
+    size_t frame_size = (size_t) m_width * m_height;
+    if (m_chroma)
+    {
+        frame_size += 2 * (size_t) ((m_width + 1) / 2) * ((m_height + 1) / 2);
+    }
+    size_t offset = header.size() + 1;
+    while (offset + sizeof(Y4M_FRAME) - 1 <= m_map_size &&
+           memcmp(m_map + offset, Y4M_FRAME, sizeof(Y4M_FRAME) - 1) == 0)
+    {
+        const void *line_end = memchr(m_map + offset, '\n',
+                                      std::min(m_map_size - offset, MAX_HEADER));
+        if (line_end == nullptr)
+        {
+            break;
+        }
+        size_t pixels = (size_t) (static_cast<const uint8_t *>(line_end) - m_map) + 1;
+        if (pixels + frame_size > m_map_size)
+        {
+            // a recording cut short keeps its complete frames
+            break;
+        }
+        m_offsets.push_back(pixels);
+        offset = pixels + frame_size;
+    }
+    return true;
+}
+
+void Y4m_Reader::Close()
+{
+    if (m_map != nullptr)
+    {
+        munmap(const_cast<uint8_t *>(m_map), m_map_size);
+        close(m_fd);
+    }
+    m_fd = -1;
+    m_map = nullptr;
+    m_map_size = 0;
+    m_width = 0;
+    m_height = 0;
+    m_fps_num = 0;
+    m_fps_den = 0;
+    m_offsets.clear();
+}
+
+bool Y4m_Reader::Get(int64_t n, Yuv_Planes *planes) const
+{
+    if (n < 0 || n >= GetFrameCount())
+    {
+        return false;
+    }
+    const uint8_t *data = m_map + m_offsets[n];
+    const int32_t uv_width = (m_width + 1) / 2;
+    const int32_t uv_height = (m_height + 1) / 2;
+    planes->y = data;
+    planes->u = m_chroma ? data + (size_t) m_width * m_height : nullptr;
+    planes->v = m_chroma ? planes->u + (size_t) uv_width * uv_height : nullptr;
+    planes->width = m_width;
+    planes->height = m_height;
+    planes->y_stride = m_width;
+    planes->uv_stride = uv_width;
+    planes->uv_pixel_stride = 1;
+    planes->timestamp = m_fps_num > 0 ? (int64_t) (n * 1e9 * m_fps_den / m_fps_num) : 0;
+    return true;
+}
@@ -0,0 +1,172 @@
+#ifndef OPENCV_NDK_Y4M_FILE_H
+#define OPENCV_NDK_Y4M_FILE_H
+
+// OpenCV-NDK App
+#include "Util.h"
+// STD Libs
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Streams frames into a YUV4MPEG2 file, the raw format ffmpeg and most
+// video analysis tools read. Frames with chroma are stored as 4:2:0 with
+// JPEG siting and full range, which is what the camera delivers, frames
+// without as mono.
+class Y4m_Writer
+{
+public:
+    Y4m_Writer() = default;
+    ~Y4m_Writer();
+    Y4m_Writer(const Y4m_Writer &other) = delete;
+    Y4m_Writer &operator=(const Y4m_Writer &other) = delete;
+
+    // Every frame written has to be width x height, with chroma or not as
+    // chosen here. The rate is only what players assume, frames are not
+    // timed.
+    bool Open(const std::string &path, int32_t width, int32_t height, bool chroma,
+              int32_t fps_num = 30, int32_t fps_den = 1);
+
+    // Flushes and closes, false when a write failed along the way
+    bool Close();
+
+    bool IsOpen() const
+    { return m_file != nullptr; }
+
+    // Writes the planes as they are laid out, only semi-planar chroma
+    // (uv_pixel_stride 2) goes through a row buffer to be split
+    bool Write(const Yuv_Planes &planes);
+
+    int64_t GetFrames() const
+    { return m_frames; }
+
+private:
+    bool WritePlane(const uint8_t *data, int32_t width, int32_t height, int32_t stride,
+                    int32_t pixel_stride);
+
+    FILE *m_file = nullptr;
+    int32_t m_width = 0;
+    int32_t m_height = 0;
+    bool m_chroma = true;
+    bool m_ok = true;
+    int64_t m_frames = 0;
+    std::vector<uint8_t> m_row;
+};
+
+// A Y4m_Writer on its own thread for live streams. Export() copies the
+// frame into one of a few buffers and returns, a frame that finds none free
+// is dropped rather than holding up the camera.
+class Y4m_Exporter
+{
+public:
+    // buffers: frames that can wait for the writer thread
+    explicit Y4m_Exporter(size_t buffers = 4);
+    ~Y4m_Exporter();
+    Y4m_Exporter(const Y4m_Exporter &other) = delete;
+    Y4m_Exporter &operator=(const Y4m_Exporter &other) = delete;
+
+    // Streams width x height frames into path. The file is created on the
+    // writer thread, HasFailed() tells when that or a later write did not
+    // work.
+    bool Start(const std::string &path, int32_t width, int32_t height, bool chroma,
+               int32_t fps_num = 30, int32_t fps_den = 1);
+
+    // Writes out what is queued and closes the file, false when a write
+    // failed along the way
+    bool Stop();
+
+    bool IsExporting() const;
+
+    // The file could not be created or written, Export() drops every frame
+    // until Stop()
+    bool HasFailed() const;
+
+    // Queues a copy of the frame, false when it was dropped or does not
+    // match the stream
+    bool Export(const Yuv_Planes &planes);
+
+    int64_t GetWritten() const;
+    int64_t GetDropped() const;
+
+private:
+    void Run(std::string path, int32_t fps_num, int32_t fps_den);
+    // no file to write to, what is queued goes back to the pool
+    void FailLocked();
+
+    const size_t m_buffers;
+    int32_t m_width = 0;
+    int32_t m_height = 0;
+    bool m_chroma = true;
+    // only touched by the writer thread until it is joined
+    Y4m_Writer m_writer;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_work;
+    std::condition_variable m_idle;
+    // frames as planar I420 or luma only, tightly packed
+    std::deque<std::unique_ptr<std::vector<uint8_t> > > m_queue;
+    std::vector<std::unique_ptr<std::vector<uint8_t> > > m_pool;
+    // frames out of the pool: being copied, queued or being written
+    size_t m_outstanding = 0;
+    bool m_exporting = false;
+    bool m_failed = false;
+    bool m_stop = false;
+    std::thread m_thread;
+
+    int64_t m_written = 0;
+    int64_t m_dropped = 0;
+};
+
+// Maps a YUV4MPEG2 file and hands its frames out in place. 4:2:0 files (any
+// chroma siting) and mono files are read, other chroma layouts are refused.
+class Y4m_Reader
+{
+public:
+    Y4m_Reader() = default;
+    ~Y4m_Reader();
+    Y4m_Reader(const Y4m_Reader &other) = delete;
+    Y4m_Reader &operator=(const Y4m_Reader &other) = delete;
+
+    bool Open(const std::string &path);
+    void Close();
+
+    bool IsOpen() const
+    { return m_map != nullptr; }
+
+    int32_t GetWidth() const
+    { return m_width; }
+
+    int32_t GetHeight() const
+    { return m_height; }
+
+    // Frame rate from the header, 0 when it has none
+    double GetFps() const
+    { return m_fps_den > 0 ? (double) m_fps_num / m_fps_den : 0.0; }
+
+    int64_t GetFrameCount() const
+    { return (int64_t) m_offsets.size(); }
+
+    // Frame n pointing into the mapping, valid until Close(). The timestamp
+    // follows from the frame rate. u and v are nullptr for mono files.
+    bool Get(int64_t n, Yuv_Planes *planes) const;
+
+private:
+    int m_fd = -1;
+    const uint8_t *m_map = nullptr;
+    size_t m_map_size = 0;
+
+    int32_t m_width = 0;
+    int32_t m_height = 0;
+    int32_t m_fps_num = 0;
+    int32_t m_fps_den = 0;
+    bool m_chroma = true;
+    // where the pixels of each frame start, past its FRAME line
+    std::vector<size_t> m_offsets;
+};
+
+#endif  // OPENCV_NDK_Y4M_FILE_H
@@ -0,0 +1,295 @@
+#include "Zsl_Ring.h"
+#include "Util.h"
+#include <algorithm>
+#include <cstdlib>
+#include <time.h>
+#include <vector>
+
+Zsl_Ring::Zsl_Ring(size_t capacity)
+        : m_capacity(std::max((size_t) 1, capacity))
+{
+}
+
+Zsl_Ring::~Zsl_Ring()
+{
+    Stop();
+}
+
+// Longest frame duration a ZSL stream may have, it rides along with the
+// 30 fps repeating preview request
+static const int64_t ZSL_MAX_FRAME_NS = 1000000000LL / 30 + 500000;
+
+// Duration the camera lists for a YUV output size in an i64 table of format,
+// width, height and duration, 0 when it lists none
+static int64_t YuvDuration(const ACameraMetadata *characteristics, uint32_t tag,
+                           int32_t width, int32_t height)
+{
+    ACameraMetadata_const_entry entry;
+    if (ACameraMetadata_getConstEntry(characteristics, tag, &entry) != ACAMERA_OK)
+    {
+        return 0;
+    }
+    for (uint32_t i = 0; i + 3 < entry.count; i += 4)
+    {
+        if (entry.data.i64[i] == AIMAGE_FORMAT_YUV_420_888 && entry.data.i64[i + 1] == width &&
+            entry.data.i64[i + 2] == height)
+        {
+            return entry.data.i64[i + 3];
+        }
+    }
+    return 0;
+}
+
+bool Zsl_Ring::Init(const ACameraMetadata *characteristics)
+{
+    m_width = m_height = 0;
+    m_sensor_realtime = false;
+    if (characteristics == nullptr)
+    {
+        return false;
+    }
+
+    // LEGACY devices emulate YUV outputs from the preview path, they do not
+    // keep up with a second full size stream
+    ACameraMetadata_const_entry entry;
+    if (ACameraMetadata_getConstEntry(characteristics, ACAMERA_INFO_SUPPORTED_HARDWARE_LEVEL,
+                                      &entry) != ACAMERA_OK || entry.count == 0 ||
+        entry.data.u8[0] == ACAMERA_INFO_SUPPORTED_HARDWARE_LEVEL_LEGACY)
+    {
+        LOGI("ZSL: not on a LEGACY or unknown hardware level");
+        return false;
+    }
+
+    if (ACameraMetadata_getConstEntry(characteristics,
+                                      ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE,
+                                      &entry) == ACAMERA_OK && entry.count > 0)
+    {
+        m_sensor_realtime =
+                entry.data.u8[0] == ACAMERA_SENSOR_INFO_TIMESTAMP_SOURCE_REALTIME;
+    }
+
+    if (ACameraMetadata_getConstEntry(characteristics,
+                                      ACAMERA_SCALER_AVAILABLE_STREAM_CONFIGURATIONS,
+                                      &entry) != ACAMERA_OK)
+    {
+        return false;
+    }
+    // format, width, height, input. Only sizes the camera streams at the
+    // preview rate without a stall qualify.
+    for (uint32_t i = 0; i + 3 < entry.count; i += 4)
+    {
+        if (entry.data.i32[i] != AIMAGE_FORMAT_YUV_420_888 || entry.data.i32[i + 3] != 0)
+        {
+            continue;
+        }
+        int32_t width = entry.data.i32[i + 1];
+        int32_t height = entry.data.i32[i + 2];
+        if ((int64_t) width * height <= (int64_t) m_width * m_height ||
+            YuvDuration(characteristics, ACAMERA_SCALER_AVAILABLE_MIN_FRAME_DURATIONS, width,
+                        height) > ZSL_MAX_FRAME_NS ||
+            YuvDuration(characteristics, ACAMERA_SCALER_AVAILABLE_STALL_DURATIONS, width,
+                        height) > 0)
+        {
+            continue;
+        }
+        m_width = width;
+        m_height = height;
+    }
+    LOGI("ZSL: %dx%d frames, %s timestamps", m_width, m_height,
+         m_sensor_realtime ? "sensor" : "arrival");
+    return m_width > 0 && m_height > 0;
+}
+
+int64_t Zsl_Ring::Now()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_BOOTTIME, &now);
+    return (int64_t) now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+void Zsl_Ring::Push(AImage *image)
+{
+    if (image == nullptr)
+    {
+        return;
+    }
+    int64_t time_ns = 0;
+    if (!m_sensor_realtime || AImage_getTimestamp(image, &time_ns) != AMEDIA_OK)
+    {
+        time_ns = Now();
+    }
+
+    AImage *oldest = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running)
+        {
+            oldest = image;
+        }
+        else
+        {
+            // frames out for rating still hold reader buffers
+            if (m_frames.size() + m_checked_out >= m_capacity)
+            {
+                if (m_frames.empty())
+                {
+                    oldest = image;
+                    image = nullptr;
+                }
+                else
+                {
+                    oldest = m_frames.front().image;
+                    m_frames.pop_front();
+                }
+            }
+            if (image != nullptr)
+            {
+                Zsl_Entry entry = {image, time_ns};
+                m_frames.push_back(entry);
+            }
+        }
+    }
+    if (oldest != nullptr)
+    {
+        AImage_delete(oldest);
+    }
+}
+
+size_t Zsl_Ring::Closest(int64_t time_ns) const
+{
+    size_t best = 0;
+    for (size_t i = 1; i < m_frames.size(); i++)
+    {
+        if (std::llabs(m_frames[i].time_ns - time_ns) <
+            std::llabs(m_frames[best].time_ns - time_ns))
+        {
+            best = i;
+        }
+    }
+    return best;
+}
+
+AImage *Zsl_Ring::Take(int64_t time_ns)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_frames.empty())
+    {
+        return nullptr;
+    }
+    size_t best = Closest(time_ns);
+    AImage *image = m_frames[best].image;
+    LOGI("ZSL: frame %.1f ms from the press, %zu kept",
+         (m_frames[best].time_ns - time_ns) / 1e6, m_frames.size());
+    m_frames.erase(m_frames.begin() + best);
+    return image;
+}
+
+AImage *Zsl_Ring::TakeBest(int64_t time_ns, int64_t window_ns,
+                           const std::function<double(AImage *)> &score)
+{
+    // the candidates leave the ring to be rated without m_mutex, the
+    // reader keeps pushing meanwhile
+    std::vector<Zsl_Entry> candidates;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t i = 0; i < m_frames.size();)
+        {
+            if (std::llabs(m_frames[i].time_ns - time_ns) <= window_ns)
+            {
+                candidates.push_back(m_frames[i]);
+                m_frames.erase(m_frames.begin() + i);
+            }
+            else
+            {
+                i++;
+            }
+        }
+        if (candidates.empty())
+        {
+            if (m_frames.empty())
+            {
+                return nullptr;
+            }
+            size_t closest = Closest(time_ns);
+            AImage *image = m_frames[closest].image;
+            LOGI("ZSL: no frame within the window, closest %.1f ms from the press",
+                 (m_frames[closest].time_ns - time_ns) / 1e6);
+            m_frames.erase(m_frames.begin() + closest);
+            return image;
+        }
+        m_checked_out += candidates.size();
+    }
+
+    size_t best = 0;
+    double best_score = -1.0;
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+        double value = score(candidates[i].image);
+        if (value > best_score)
+        {
+            best = i;
+            best_score = value;
+        }
+    }
+    LOGI("ZSL: best of %zu frames %.1f ms from the press, score %.1f", candidates.size(),
+         (candidates[best].time_ns - time_ns) / 1e6, best_score);
+    AImage *image = candidates[best].image;
+    candidates.erase(candidates.begin() + best);
+
+    // the others go back in time order, unless newer frames took their
+    // place or the ring stopped
+    std::vector<AImage *> dropped;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_checked_out -= candidates.size() + 1;
+        if (m_running)
+        {
+            for (size_t i = 0; i < candidates.size(); i++)
+            {
+                std::deque<Zsl_Entry>::iterator at = m_frames.begin();
+                while (at != m_frames.end() && at->time_ns < candidates[i].time_ns)
+                {
+                    ++at;
+                }
+                m_frames.insert(at, candidates[i]);
+            }
+            while (m_frames.size() + m_checked_out > m_capacity)
+            {
+                dropped.push_back(m_frames.front().image);
+                m_frames.pop_front();
+            }
+        }
+        else
+        {
+            for (size_t i = 0; i < candidates.size(); i++)
+            {
+                dropped.push_back(candidates[i].image);
+            }
+        }
+    }
+    for (size_t i = 0; i < dropped.size(); i++)
+    {
+        AImage_delete(dropped[i]);
+    }
+    return image;
+}
+
+void Zsl_Ring::Start()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_running = true;
+}
+
+void Zsl_Ring::Stop()
+{
+    std::deque<Zsl_Entry> frames;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+        frames.swap(m_frames);
+    }
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        AImage_delete(frames[i].image);
+    }
+}
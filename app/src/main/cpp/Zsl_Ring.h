@@ -0,0 +1,98 @@
+#ifndef OPENCV_NDK_ZSL_RING_H
+#define OPENCV_NDK_ZSL_RING_H
+
+// Android
+#include <camera/NdkCameraMetadata.h>
+#include <media/NdkImage.h>
+// STD Libs
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+// Zero shutter lag: the repeating request also feeds the still image reader
+// and the last few frames are kept here, as the reader's own buffers, so no
+// frame is copied unless it is captured. A capture takes the frame closest
+// to the moment of the button press instead of asking the camera for a new
+// one and waiting for it.
+class Zsl_Ring
+{
+public:
+    // capacity: frames kept, the reader needs capacity plus two images so
+    // the camera and the writer always have one left
+    explicit Zsl_Ring(size_t capacity = 4);
+    ~Zsl_Ring();
+    Zsl_Ring(const Zsl_Ring &other) = delete;
+    Zsl_Ring &operator=(const Zsl_Ring &other) = delete;
+
+    // Reads the largest YUV output size the camera streams at 30 fps without
+    // a stall and whether sensor timestamps run on CLOCK_BOOTTIME. False on
+    // LEGACY devices and when no YUV output size qualifies.
+    bool Init(const ACameraMetadata *characteristics);
+
+    // Streams width x height instead of the size Init() picked, for frames
+    // wanted for what they show rather than as captures
+    void SetSize(int32_t width, int32_t height)
+    {
+        m_width = width;
+        m_height = height;
+    }
+
+    int32_t GetWidth() const
+    { return m_width; }
+
+    int32_t GetHeight() const
+    { return m_height; }
+
+    size_t GetCapacity() const
+    { return m_capacity; }
+
+    // Takes over image, handing the oldest frame back to the reader once
+    // the ring is full. Images arriving after Stop() are deleted right away.
+    void Push(AImage *image);
+
+    // Removes and returns the frame closest to time_ns on CLOCK_BOOTTIME,
+    // nullptr when the ring is empty. The caller owns the image.
+    AImage *Take(int64_t time_ns);
+
+    // Best shot: of the frames within window_ns of time_ns the one score
+    // rates highest, the closest frame when none is that near. score runs
+    // without the ring's lock, the frames it rates are out of the ring
+    // until it is done.
+    AImage *TakeBest(int64_t time_ns, int64_t window_ns,
+                     const std::function<double(AImage *)> &score);
+
+    // Accepts frames again after Stop()
+    void Start();
+
+    // Deletes every kept frame, call before the reader goes
+    void Stop();
+
+    // Now on CLOCK_BOOTTIME, the clock button presses are compared on
+    static int64_t Now();
+
+private:
+    // index of the frame closest to time_ns, m_frames not empty
+    size_t Closest(int64_t time_ns) const;
+
+    struct Zsl_Entry
+    {
+        AImage *image;
+        // sensor timestamp, or the arrival time when the sensor's clock is
+        // not comparable with CLOCK_BOOTTIME
+        int64_t time_ns;
+    };
+
+    const size_t m_capacity;
+    int32_t m_width = 0;
+    int32_t m_height = 0;
+    bool m_sensor_realtime = false;
+
+    std::mutex m_mutex;
+    std::deque<Zsl_Entry> m_frames;
+    // frames TakeBest is rating, counted against m_capacity
+    size_t m_checked_out = 0;
+    bool m_running = true;
+};
+
+#endif  // OPENCV_NDK_ZSL_RING_H
@@ -0,0 +1,137 @@
+// SuppressOverlaps and Box_Tracker on hand placed boxes:
+//
+// - detections of one face at neighbouring scales collapse to the best
+//   scored one, ties to the larger, and scores follow their boxes
+// - a wide kept box suppresses one that starts far to its right
+// - a track is stable after stable_hits detections, coasts through
+//   max_misses searched frames without one and is dropped after that,
+//   frames that did not search it leave it alone
+// - smoothed boxes settle on a steadily moving box and on a jittering one
+//
+// Takes the assets directory like every check, it is not read.
+
+// OpenCV
+#include <opencv2/core.hpp>
+// OpenCV-NDK App
+#include "Box_Tracker.h"
+#include "Test_Util.h"
+// STD Libs
+#include <cstdlib>
+#include <vector>
+
+static const float FACE_NMS_IOU = 0.4f;
+
+static bool Near(const cv::Rect &a, const cv::Rect &b, int32_t tolerance)
+{
+    return std::abs(a.x - b.x) <= tolerance && std::abs(a.y - b.y) <= tolerance &&
+           std::abs(a.width - b.width) <= tolerance && std::abs(a.height - b.height) <= tolerance;
+}
+
+static void CheckSuppression()
+{
+    // one face at four scales and another one apart
+    std::vector<cv::Rect> boxes = {cv::Rect(98, 102, 84, 84), cv::Rect(300, 50, 60, 60),
+                                   cv::Rect(104, 104, 72, 72), cv::Rect(96, 96, 90, 90),
+                                   cv::Rect(100, 100, 80, 80)};
+    std::vector<int> scores = {3, 2, 1, 3, 5};
+    SuppressOverlaps(boxes, scores, FACE_NMS_IOU);
+    CHECK(boxes.size() == 2 && scores.size() == 2);
+    CHECK(boxes[0] == cv::Rect(100, 100, 80, 80) && scores[0] == 5);
+    CHECK(boxes[1] == cv::Rect(300, 50, 60, 60) && scores[1] == 2);
+
+    // equal scores keep the larger box
+    boxes = {cv::Rect(98, 102, 84, 84), cv::Rect(96, 96, 90, 90)};
+    scores = {4, 4};
+    SuppressOverlaps(boxes, scores, FACE_NMS_IOU);
+    CHECK(boxes.size() == 1 && boxes[0] == cv::Rect(96, 96, 90, 90));
+
+    // the wide box is kept first and starts 150 pixels left of the other
+    boxes = {cv::Rect(150, 0, 250, 100), cv::Rect(0, 200, 100, 100),
+             cv::Rect(0, 0, 400, 100)};
+    scores = {3, 1, 5};
+    SuppressOverlaps(boxes, scores, FACE_NMS_IOU);
+    CHECK(boxes.size() == 2 && boxes[0] == cv::Rect(0, 0, 400, 100));
+    CHECK(boxes[1] == cv::Rect(0, 200, 100, 100));
+}
+
+static void CheckLifecycle()
+{
+    const std::vector<cv::Rect> frame = {cv::Rect(0, 0, 640, 480)};
+    const std::vector<cv::Rect> left = {cv::Rect(0, 0, 320, 480)};
+    const std::vector<cv::Rect> none;
+    const std::vector<cv::Rect> face = {cv::Rect(400, 200, 100, 100)};
+    Box_Tracker tracker(0.5f, 0.05f, 2, 2);
+
+    tracker.Update(face, frame);
+    CHECK(tracker.GetTracks().size() == 1 && tracker.GetStable().empty());
+    tracker.Update(face, frame);
+    CHECK(tracker.GetStable().size() == 1 && tracker.GetStable()[0] == face[0]);
+    const int32_t id = tracker.GetTracks()[0].id;
+
+    // not searched: neither missed nor reported
+    for (int32_t i = 0; i < 5; i++)
+    {
+        tracker.Update(none, left);
+    }
+    CHECK(tracker.GetTracks().size() == 1 && tracker.GetTracks()[0].misses == 0);
+    CHECK(tracker.GetStable().empty());
+
+    // coasts through max_misses searched frames
+    for (int32_t i = 1; i <= 2; i++)
+    {
+        tracker.Update(none, frame);
+        CHECK(tracker.GetTracks().size() == 1 && tracker.GetTracks()[0].misses == i);
+        CHECK(tracker.GetStable().size() == 1 && tracker.GetStable()[0] == face[0]);
+    }
+    // a detection before the last miss picks the same track up again
+    tracker.Update(face, frame);
+    CHECK(tracker.GetTracks().size() == 1 && tracker.GetTracks()[0].id == id);
+    CHECK(tracker.GetTracks()[0].misses == 0);
+    for (int32_t i = 0; i < 3; i++)
+    {
+        tracker.Update(none, frame);
+    }
+    CHECK(tracker.GetTracks().empty() && tracker.GetStable().empty());
+
+    // a new face is a new track that has to become stable again
+    tracker.Update(face, frame);
+    CHECK(tracker.GetTracks().size() == 1 && tracker.GetTracks()[0].id != id);
+    CHECK(tracker.GetStable().empty());
+    tracker.Reset();
+    CHECK(tracker.GetTracks().empty());
+}
+
+static void CheckSmoothing()
+{
+    const std::vector<cv::Rect> frame = {cv::Rect(0, 0, 640, 480)};
+    Box_Tracker tracker;
+
+    // 3 pixels right and 1 down every frame, the velocity is learnt
+    cv::Rect moving(100, 100, 80, 80);
+    for (int32_t i = 0; i < 60; i++)
+    {
+        moving += cv::Point(3, 1);
+        tracker.Update(std::vector<cv::Rect>(1, moving), frame);
+    }
+    CHECK(tracker.GetStable().size() == 1 && Near(tracker.GetStable()[0], moving, 1));
+
+    // a still face detected 6 pixels off either way and at two scales
+    tracker.Reset();
+    const cv::Rect still(200, 150, 90, 90);
+    for (int32_t i = 0; i < 60; i++)
+    {
+        int32_t jitter = i % 2 == 0 ? 6 : -6;
+        cv::Rect detected(still.x + jitter, still.y - jitter, still.width + jitter,
+                          still.height + jitter);
+        tracker.Update(std::vector<cv::Rect>(1, detected), frame);
+    }
+    CHECK(tracker.GetStable().size() == 1 && Near(tracker.GetStable()[0], still, 4));
+}
+
+int main(int argc, char **argv)
+{
+    CheckSuppression();
+    CheckLifecycle();
+    CheckSmoothing();
+    return TestResult("Box_Tracker_Test");
+}
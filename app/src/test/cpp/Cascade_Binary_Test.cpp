@@ -0,0 +1,233 @@
+// Cascade_Binary files against the cascades they were written from:
+//
+// - each rotation maps back to the same records Cascade_Evaluator builds
+//   from the rotated model, tilted cascades upright in every slot
+// - truncated files, wrong versions and feature rectangles or LBP blocks
+//   outside the window are refused
+//
+// Takes the assets directory, see Makefile.
+
+// OpenCV
+#include <opencv2/core.hpp>
+// OpenCV-NDK App
+#include "Cascade_Binary.h"
+#include "Cascade_Evaluator.h"
+#include "Haar_Cascade.h"
+#include "Lbp_Cascade.h"
+#include "Test_Util.h"
+// STD Libs
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static const std::string SCRATCH = "build/Cascade_Binary_Test.cascade";
+
+static std::vector<uint8_t> ReadBytes(const std::string &filename)
+{
+    std::vector<uint8_t> bytes;
+    FILE *in = fopen(filename.c_str(), "rb");
+    if (in == nullptr)
+    {
+        return bytes;
+    }
+    uint8_t buffer[4096];
+    size_t got;
+    while ((got = fread(buffer, 1, sizeof(buffer), in)) > 0)
+    {
+        bytes.insert(bytes.end(), buffer, buffer + got);
+    }
+    fclose(in);
+    return bytes;
+}
+
+static bool WriteBytes(const std::string &filename, const std::vector<uint8_t> &bytes)
+{
+    FILE *out = fopen(filename.c_str(), "wb");
+    if (out == nullptr)
+    {
+        return false;
+    }
+    bool written = fwrite(bytes.data(), 1, bytes.size(), out) == bytes.size();
+    return fclose(out) == 0 && written;
+}
+
+static bool SameRecords(const void *a, const void *b, int32_t count, size_t record_size)
+{
+    return count == 0 || memcmp(a, b, count * record_size) == 0;
+}
+
+static bool SameData(const Cascade_Data &a, const Cascade_Data &b)
+{
+    bool lbp = a.type == LBP_CASCADE;
+    int32_t stumps = a.stumps ? a.weak_count : 0;
+    return a.type == b.type && a.width == b.width && a.height == b.height &&
+           a.stumps == b.stumps && a.tilted == b.tilted && a.stage_count == b.stage_count &&
+           a.weak_count == b.weak_count && a.node_count == b.node_count &&
+           a.leaf_count == b.leaf_count && a.feature_count == b.feature_count &&
+           a.lbp_feature_count == b.lbp_feature_count &&
+           SameRecords(a.stages, b.stages, a.stage_count, sizeof(Cascade_Stage)) &&
+           SameRecords(a.weaks, b.weaks, a.weak_count, sizeof(Cascade_Weak)) &&
+           SameRecords(a.nodes, b.nodes, a.node_count, sizeof(Cascade_Node)) &&
+           SameRecords(a.leaves, b.leaves, a.leaf_count, sizeof(float)) &&
+           SameRecords(a.features, b.features, a.feature_count, sizeof(Cascade_Haar_Feature)) &&
+           SameRecords(a.stump_feature, b.stump_feature, stumps, sizeof(int32_t)) &&
+           SameRecords(a.stump_threshold, b.stump_threshold, stumps, sizeof(float)) &&
+           SameRecords(a.stump_left, b.stump_left, stumps, sizeof(float)) &&
+           SameRecords(a.stump_right, b.stump_right, stumps, sizeof(float)) &&
+           SameRecords(a.lbp_features, b.lbp_features, a.lbp_feature_count,
+                       sizeof(Lbp_Feature)) &&
+           SameRecords(a.subsets, b.subsets, lbp ? 8 * a.node_count : 0, sizeof(int32_t));
+}
+
+// Writes bytes with one record replaced and tries to map them. The first
+// copy of the record in the file belongs to the 0 degree model.
+template<typename T>
+static bool MapsPatched(const std::vector<uint8_t> &bytes, const T &record, const T &patched)
+{
+    const uint8_t *found = std::search(bytes.data(), bytes.data() + bytes.size(),
+                                       (const uint8_t *) &record,
+                                       (const uint8_t *) &record + sizeof(T));
+    CHECK(found != bytes.data() + bytes.size());
+    std::vector<uint8_t> copy = bytes;
+    memcpy(copy.data() + (found - bytes.data()), &patched, sizeof(T));
+    Cascade_Binary binary;
+    return WriteBytes(SCRATCH, copy) && binary.Map(SCRATCH);
+}
+
+// Truncated or from another version
+static void CheckDamaged(const std::vector<uint8_t> &bytes)
+{
+    Cascade_Binary binary;
+    std::vector<uint8_t> copy(bytes.begin(), bytes.end() - 16);
+    CHECK(WriteBytes(SCRATCH, copy) && !binary.Map(SCRATCH));
+
+    copy = bytes;
+    copy[4] ^= 0xff;
+    CHECK(WriteBytes(SCRATCH, copy) && !binary.Map(SCRATCH));
+}
+
+static void CheckHaar(const Haar_Cascade &cascade)
+{
+    CHECK(Cascade_Binary::Write(SCRATCH, cascade));
+    std::vector<uint8_t> bytes = ReadBytes(SCRATCH);
+    Cascade_Haar_Feature feature;
+    {
+        // unmapped before the file is rewritten below
+        Cascade_Binary binary;
+        CHECK(binary.Map(SCRATCH));
+        for (int32_t angle = 0; angle < 360; angle += 90)
+        {
+            Cascade_Evaluator expected;
+            CHECK(expected.Load(cascade.Rotated(cascade.HasTilted() ? 0 : angle)));
+            Cascade_Data data;
+            CHECK(binary.Get(angle, data));
+            CHECK(SameData(data, expected.GetData()));
+            if (angle == 0)
+            {
+                feature = data.features[0];
+            }
+        }
+    }
+    CheckDamaged(bytes);
+
+    // push the first feature's first rectangle just past each window edge
+    const Haar_Rect &rect = feature.rects[0];
+    const bool tilted = feature.tilted != 0;
+    const int32_t left = tilted ? rect.height : 0;
+    const int32_t down = tilted ? rect.width + rect.height : rect.height;
+    const int32_t moves[4][2] = {{-rect.x + left - 1, 0},
+                                 {cascade.width - rect.width - rect.x + 1, 0},
+                                 {0, -rect.y - 1},
+                                 {0, cascade.height - down - rect.y + 1}};
+    CHECK(MapsPatched(bytes, feature, feature));
+    for (int32_t m = 0; m < 4; m++)
+    {
+        Cascade_Haar_Feature patched = feature;
+        patched.rects[0].x += moves[m][0];
+        patched.rects[0].y += moves[m][1];
+        CHECK(!MapsPatched(bytes, feature, patched));
+    }
+    Cascade_Haar_Feature empty = feature;
+    empty.rects[0].width = 0;
+    CHECK(!MapsPatched(bytes, feature, empty));
+}
+
+// Smallest LBP cascade, one stump on a block grid in the window's corner
+static Lbp_Cascade TinyLbp()
+{
+    Lbp_Cascade cascade;
+    cascade.width = 24;
+    cascade.height = 24;
+    Lbp_Feature feature = {1, 2, 4, 5};
+    cascade.features.push_back(feature);
+    Lbp_Node node;
+    node.left = 0;
+    node.right = -1;
+    node.feature = 0;
+    for (int32_t i = 0; i < 8; i++)
+    {
+        node.subset[i] = i % 2 == 0 ? -1 : 0x0f0f0f0f;
+    }
+    Lbp_Weak weak;
+    weak.nodes.push_back(node);
+    weak.leaves.push_back(-1.0f);
+    weak.leaves.push_back(1.0f);
+    Lbp_Stage stage;
+    stage.threshold = 0.0f;
+    stage.weaks.push_back(weak);
+    cascade.stages.push_back(stage);
+    return cascade;
+}
+
+static void CheckLbp()
+{
+    Lbp_Cascade cascade = TinyLbp();
+    CHECK(Cascade_Binary::Write(SCRATCH, cascade));
+    std::vector<uint8_t> bytes = ReadBytes(SCRATCH);
+    {
+        Cascade_Binary binary;
+        CHECK(binary.Map(SCRATCH));
+        for (int32_t angle = 0; angle < 360; angle += 90)
+        {
+            Cascade_Evaluator expected;
+            CHECK(expected.Load(cascade.Rotated(angle)));
+            Cascade_Data data;
+            CHECK(binary.Get(angle, data));
+            CHECK(SameData(data, expected.GetData()));
+        }
+    }
+    CheckDamaged(bytes);
+
+    const Lbp_Feature feature = cascade.features[0];
+    Lbp_Feature fits = {24 - 3 * 4, 24 - 3 * 5, 4, 5};
+    CHECK(MapsPatched(bytes, feature, fits));
+    const Lbp_Feature outside[4] = {{-1, 2, 4, 5}, {24 - 3 * 4 + 1, 2, 4, 5},
+                                    {1, 24 - 3 * 5 + 1, 4, 5}, {1, 2, 9, 5}};
+    for (int32_t o = 0; o < 4; o++)
+    {
+        CHECK(!MapsPatched(bytes, feature, outside[o]));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string assets = argc > 1 ? argv[1] : "../../main/assets";
+    // one cascade with tilted features, one without, one with stumps
+    const char *names[] = {"haarcascade_eye_tree_eyeglasses.xml",
+                           "haarcascade_frontalface_alt.xml",
+                           "haarcascade_frontalface_default.xml"};
+    for (size_t n = 0; n < sizeof(names) / sizeof(names[0]); n++)
+    {
+        Haar_Cascade cascade;
+        CHECK(cascade.Load(assets + "/" + names[n]));
+        if (!cascade.Empty())
+        {
+            CheckHaar(cascade);
+        }
+    }
+    CheckLbp();
+    remove(SCRATCH.c_str());
+    return TestResult("Cascade_Binary_Test");
+}
@@ -0,0 +1,235 @@
+// Rotated cascades against OpenCV:
+//
+// - every rotated feature rectangle sums the same pixels on the rotated
+//   window as the original one on the upright window, tilted ones at 180
+// - Cascade_Scheduler at each sensor rotation reports the same raw hits as
+//   detectMultiScale with the rotated model on the sensor frame, or for
+//   tilted cascades with the upright model on the frame turned upright
+// - a tilted child cascade turns only its bands of the parent detections
+//   upright, not the area the parent scanned
+//
+// Takes the assets directory, see Makefile.
+
+// OpenCV
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/objdetect.hpp>
+// OpenCV-NDK App
+#include "Cascade_Scheduler.h"
+#include "Grid_Regions.h"
+#include "Haar_Cascade.h"
+#include "Test_Util.h"
+#include "Worker_Pool.h"
+// STD Libs
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Sum of a feature rectangle of the window at (ox, oy)
+static int64_t RectSum(const cv::Mat &sum, const cv::Mat &tilted, const Haar_Rect &r,
+                       bool is_tilted, int32_t ox, int32_t oy)
+{
+    const cv::Mat &integral = is_tilted ? tilted : sum;
+    auto at = [&](int32_t x, int32_t y)
+    { return (int64_t) integral.at<int32_t>(y + oy, x + ox); };
+    if (is_tilted)
+    {
+        return at(r.x, r.y) - at(r.x - r.height, r.y + r.height) -
+               at(r.x + r.width, r.y + r.width) +
+               at(r.x + r.width - r.height, r.y + r.width + r.height);
+    }
+    return at(r.x, r.y) - at(r.x + r.width, r.y) - at(r.x, r.y + r.height) +
+           at(r.x + r.width, r.y + r.height);
+}
+
+static void CheckFeatures(const Haar_Cascade &cascade, int32_t angle)
+{
+    Haar_Cascade rotated = cascade.Rotated(angle);
+    if (cascade.HasTilted() && (angle == 90 || angle == 270))
+    {
+        CHECK(rotated.Empty());
+        return;
+    }
+    CHECK(!rotated.Empty());
+
+    // one pixel of margin, a tilted rectangle along the left edge turned by
+    // 180 ends one integral column past the window
+    cv::Mat window(cascade.height + 2, cascade.width + 2, CV_8UC1);
+    cv::RNG rng(angle + 1);
+    rng.fill(window, cv::RNG::UNIFORM, 0, 256);
+    cv::Mat turned;
+    RotateImage(window, turned, angle);
+
+    cv::Mat sum, sqsum, tilted, turned_sum, turned_sqsum, turned_tilted;
+    cv::integral(window, sum, sqsum, tilted, CV_32S);
+    cv::integral(turned, turned_sum, turned_sqsum, turned_tilted, CV_32S);
+
+    int32_t mismatches = 0;
+    for (size_t f = 0; f < cascade.features.size(); f++)
+    {
+        const Haar_Feature &feature = cascade.features[f];
+        for (int32_t r = 0; r < feature.rect_count; r++)
+        {
+            int64_t upright = RectSum(sum, tilted, feature.rects[r], feature.tilted, 1, 1);
+            int64_t moved = RectSum(turned_sum, turned_tilted, rotated.features[f].rects[r],
+                                    feature.tilted, 1, 1);
+            mismatches += upright != moved ? 1 : 0;
+        }
+    }
+    CHECK(mismatches == 0);
+}
+
+static bool Less(const cv::Rect &a, const cv::Rect &b)
+{
+    return a.x != b.x ? a.x < b.x : a.y != b.y ? a.y < b.y :
+           a.width != b.width ? a.width < b.width : a.height < b.height;
+}
+
+static std::vector<cv::Rect> Scheduled(const Haar_Cascade &cascade, const cv::Mat &sensor,
+                                       int32_t rotation, Worker_Pool &pool)
+{
+    Cascade_Scheduler scheduler(&pool);
+    Cascade_Config config;
+    config.name = "test";
+    config.min_neighbors = 0;
+    int32_t id = scheduler.Add(config, cascade);
+    CHECK(id >= 0);
+    scheduler.SetRotation(rotation);
+    scheduler.Process(sensor, std::vector<cv::Rect>(1, cv::Rect(0, 0, sensor.cols, sensor.rows)));
+    std::vector<cv::Rect> hits = scheduler.GetDetections(id);
+    std::sort(hits.begin(), hits.end(), Less);
+    return hits;
+}
+
+static std::vector<cv::Rect> Reference(const Haar_Cascade &cascade, const cv::Mat &sensor,
+                                       int32_t rotation)
+{
+    int32_t angle = (360 - rotation) % 360;
+    bool upright = angle != 0 && cascade.HasTilted();
+    cv::CascadeClassifier classifier;
+    CHECK(cascade.Rotated(upright ? 0 : angle).ToClassifier(classifier));
+
+    cv::Mat image = sensor;
+    if (upright)
+    {
+        RotateImage(sensor, image, rotation);
+    }
+    std::vector<cv::Rect> hits;
+    classifier.detectMultiScale(image, hits, 1.18, 0, cv::CASCADE_SCALE_IMAGE);
+    for (size_t i = 0; upright && i < hits.size(); i++)
+    {
+        hits[i] = RotateRect(hits[i], image.cols, image.rows, angle);
+    }
+    std::sort(hits.begin(), hits.end(), Less);
+    return hits;
+}
+
+static void CheckHits(Haar_Cascade cascade, const cv::Mat &sensor, Worker_Pool &pool,
+                      const std::string &name)
+{
+    // a few stages keep plenty of raw hits on a textured frame
+    cascade.stages.resize(std::min<size_t>(cascade.stages.size(), 3));
+    for (int32_t rotation = 0; rotation < 360; rotation += 90)
+    {
+        std::vector<cv::Rect> ours = Scheduled(cascade, sensor, rotation, pool);
+        std::vector<cv::Rect> reference = Reference(cascade, sensor, rotation);
+        std::vector<cv::Rect> differ;
+        std::set_symmetric_difference(ours.begin(), ours.end(), reference.begin(),
+                                      reference.end(), std::back_inserter(differ), Less);
+        printf("%s at %d: %zu hits, %zu reference, %zu differ\n", name.c_str(), rotation,
+               ours.size(), reference.size(), differ.size());
+        CHECK(!reference.empty());
+        // float rounding may flip a window right at a stage threshold
+        CHECK(differ.size() * 100 <= reference.size());
+    }
+}
+
+// Eyes in the upper band of two faces the face cascade is made to report
+static void CheckUprightArea(const Haar_Cascade &face, const Haar_Cascade &eyes,
+                             const cv::Mat &sensor, Worker_Pool &pool)
+{
+    const std::vector<cv::Rect> faces = {cv::Rect(40, 30, 90, 90), cv::Rect(60, 150, 80, 80)};
+    for (int32_t rotation = 0; rotation < 360; rotation += 90)
+    {
+        Cascade_Scheduler scheduler(&pool);
+        Cascade_Config face_config;
+        face_config.name = "face";
+        face_config.min_size = cv::Size(70, 70);
+        int32_t face_id = scheduler.Add(face_config, face);
+        Cascade_Config eye_config;
+        eye_config.name = "eyes";
+        eye_config.parent = face_id;
+        eye_config.roi = cv::Rect_<float>(0.0f, 0.15f, 1.0f, 0.45f);
+        eye_config.min_size = cv::Size(20, 20);
+        int32_t eye_id = scheduler.Add(eye_config, eyes);
+        CHECK(face_id >= 0 && eye_id >= 0);
+        scheduler.SetFilter(face_id, [&faces](std::vector<cv::Rect> &detections,
+                                              const std::vector<cv::Rect> &searched)
+        {
+            detections = faces;
+        });
+        scheduler.SetRotation(rotation);
+        scheduler.Process(sensor, std::vector<cv::Rect>(1, cv::Rect(0, 0, sensor.cols,
+                                                                       sensor.rows)));
+        CHECK(scheduler.Ran(eye_id));
+
+        const cv::Rect area = scheduler.GetUprightArea();
+        if (rotation == 0)
+        {
+            CHECK(area.area() == 0);
+            continue;
+        }
+        // the bounding box of the two bands, the faces only overlap it on
+        // the side across the band
+        cv::Rect bands;
+        for (size_t f = 0; f < faces.size(); f++)
+        {
+            bool swap = rotation == 90 || rotation == 270;
+            int32_t width = swap ? faces[f].height : faces[f].width;
+            int32_t height = swap ? faces[f].width : faces[f].height;
+            cv::Rect upright(0, cvRound(0.15f * height), width, cvRound(0.45f * height));
+            cv::Rect band = RotateRect(upright, width, height, (360 - rotation) % 360) +
+                            faces[f].tl();
+            bands = bands.area() > 0 ? bands | band : band;
+        }
+        printf("upright area at %d: %dx%d, bands %dx%d, frame %dx%d\n", rotation, area.width,
+               area.height, bands.width, bands.height, sensor.cols, sensor.rows);
+        CHECK(area.area() > 0 && (area & bands) == area);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string assets = argc > 1 ? argv[1] : "../../main/assets";
+    // one cascade with tilted features, one without
+    const char *names[] = {"haarcascade_eye_tree_eyeglasses.xml",
+                           "haarcascade_frontalface_alt.xml"};
+
+    // textured and not square, so swapped sides show
+    cv::Mat sensor(240, 320, CV_8UC1);
+    cv::RNG rng(7);
+    rng.fill(sensor, cv::RNG::UNIFORM, 0, 256);
+    cv::GaussianBlur(sensor, sensor, cv::Size(5, 5), 1.5);
+
+    Worker_Pool pool;
+    Haar_Cascade face;
+    Haar_Cascade eyes;
+    CHECK(face.Load(assets + "/" + names[1]) && eyes.Load(assets + "/" + names[0]));
+    CheckUprightArea(face, eyes, sensor, pool);
+    for (size_t n = 0; n < sizeof(names) / sizeof(names[0]); n++)
+    {
+        Haar_Cascade cascade;
+        CHECK(cascade.Load(assets + "/" + names[n]));
+        if (cascade.Empty())
+        {
+            continue;
+        }
+        for (int32_t angle = 0; angle < 360; angle += 90)
+        {
+            CheckFeatures(cascade, angle);
+        }
+        CheckHits(cascade, sensor, pool, names[n]);
+    }
+    return TestResult("Cascade_Rotation_Test");
+}
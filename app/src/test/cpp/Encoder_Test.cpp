@@ -0,0 +1,218 @@
+// WritePng, WriteJpeg and Thumbnail_Pyramid::Write decoded again with zlib
+// and libjpeg:
+//
+// - every PNG chunk has a valid CRC, the IDAT stream inflates and unfilters
+//   to exactly the YuvRowToRgb() colors, for odd sizes, padded strides,
+//   both chroma layouts and any stripe height
+// - the JPEG decodes without warnings to the frame's size and its luma,
+//   read back as YCbCr, stays close to the source
+// - the encoders write the same file on a pool and on the calling thread
+//
+// Takes the assets directory like every check, it is not read.
+
+// OpenCV-NDK App
+#include "Jpeg_Encoder.h"
+#include "Png_Encoder.h"
+#include "Test_Util.h"
+#include "Thumbnail_Pyramid.h"
+// STD Libs
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <jpeglib.h>
+#include <zlib.h>
+
+static const std::string PNG_FILE = "build/Encoder_Test.png";
+static const std::string JPEG_FILE = "build/Encoder_Test.jpg";
+static const std::string THUMBS = "build/Encoder_Test.";
+
+static std::vector<uint8_t> ReadFile(const std::string &path)
+{
+    std::vector<uint8_t> data;
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == nullptr)
+    {
+        return data;
+    }
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0)
+    {
+        data.insert(data.end(), chunk, chunk + n);
+    }
+    fclose(file);
+    return data;
+}
+
+static uint32_t BigEndian(const uint8_t *p)
+{
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+// Decodes a PNG and compares every row with YuvRowToRgb()
+static bool PngMatches(const std::string &path, const Yuv_Planes &planes)
+{
+    const std::vector<uint8_t> data = ReadFile(path);
+    const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    if (data.size() < 8 || memcmp(data.data(), signature, 8) != 0)
+    {
+        return false;
+    }
+    std::vector<uint8_t> idat;
+    for (size_t at = 8; at + 12 <= data.size();)
+    {
+        const uint32_t length = BigEndian(&data[at]);
+        if (at + 12 + length > data.size() ||
+            crc32(0, &data[at + 4], length + 4) != BigEndian(&data[at + 8 + length]))
+        {
+            return false;
+        }
+        if (memcmp(&data[at + 4], "IDAT", 4) == 0)
+        {
+            idat.insert(idat.end(), &data[at + 8], &data[at + 8 + length]);
+        }
+        at += 12 + length;
+    }
+
+    const size_t row_size = 3 * (size_t) planes.width;
+    std::vector<uint8_t> raw((row_size + 1) * planes.height);
+    uLongf raw_size = raw.size();
+    if (uncompress(raw.data(), &raw_size, idat.data(), idat.size()) != Z_OK ||
+        raw_size != raw.size())
+    {
+        return false;
+    }
+    std::vector<uint8_t> previous(row_size, 0);
+    std::vector<uint8_t> row(row_size);
+    std::vector<uint8_t> expected(row_size);
+    for (int32_t y = 0; y < planes.height; y++)
+    {
+        const uint8_t *line = &raw[(row_size + 1) * y];
+        for (size_t i = 0; i < row_size; i++)
+        {
+            const int32_t left = i >= 3 ? row[i - 3] : 0;
+            const int32_t up = previous[i];
+            switch (line[0])
+            {
+                case 0:
+                    row[i] = line[1 + i];
+                    break;
+                case 1:
+                    row[i] = (uint8_t) (line[1 + i] + left);
+                    break;
+                case 2:
+                    row[i] = (uint8_t) (line[1 + i] + up);
+                    break;
+                case 3:
+                    row[i] = (uint8_t) (line[1 + i] + ((left + up) >> 1));
+                    break;
+                default:
+                    return false;
+            }
+        }
+        YuvRowToRgb(planes, y, expected.data());
+        if (row != expected)
+        {
+            return false;
+        }
+        previous = row;
+    }
+    return true;
+}
+
+// Decodes a JPEG as YCbCr, the mean absolute luma error, negative when it
+// does not decode cleanly to the frame's size
+static double JpegLumaError(const std::string &path, const Yuv_Planes &planes)
+{
+    std::vector<uint8_t> data = ReadFile(path);
+    if (data.empty())
+    {
+        return -1.0;
+    }
+    jpeg_decompress_struct info;
+    jpeg_error_mgr errors;
+    info.err = jpeg_std_error(&errors);
+    jpeg_create_decompress(&info);
+    jpeg_mem_src(&info, data.data(), (unsigned long) data.size());
+    jpeg_read_header(&info, TRUE);
+    info.out_color_space = JCS_YCbCr;
+    jpeg_start_decompress(&info);
+    double error = -1.0;
+    if ((int32_t) info.output_width == planes.width &&
+        (int32_t) info.output_height == planes.height)
+    {
+        std::vector<uint8_t> row((size_t) info.output_width * info.output_components);
+        double sum = 0.0;
+        while (info.output_scanline < info.output_height)
+        {
+            const int32_t y = (int32_t) info.output_scanline;
+            uint8_t *rows[1] = {row.data()};
+            jpeg_read_scanlines(&info, rows, 1);
+            for (int32_t x = 0; x < planes.width; x++)
+            {
+                sum += std::fabs((double) row[(size_t) x * info.output_components] -
+                                 planes.y[(size_t) y * planes.y_stride + x]);
+            }
+        }
+        error = sum / ((double) planes.width * planes.height);
+    }
+    jpeg_finish_decompress(&info);
+    if (errors.num_warnings > 0)
+    {
+        error = -1.0;
+    }
+    jpeg_destroy_decompress(&info);
+    return error;
+}
+
+int main(int argc, char **argv)
+{
+    Worker_Pool pool(3);
+    const int32_t sizes[][2] = {{640, 480}, {643, 481}, {35, 70}, {17, 9}, {7, 5}, {1, 1}};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        for (int32_t pixel_stride = 1; pixel_stride <= 2; pixel_stride++)
+        {
+            const Yuv_Frame frame(sizes[s][0], sizes[s][1], pixel_stride,
+                                  (uint32_t) (s * 2 + pixel_stride));
+            const Yuv_Planes planes = frame.Planes();
+
+            CHECK(WritePng(planes, PNG_FILE, &pool, 7));
+            CHECK(PngMatches(PNG_FILE, planes));
+            const std::vector<uint8_t> pooled_png = ReadFile(PNG_FILE);
+            CHECK(WritePng(planes, PNG_FILE, nullptr, 7));
+            CHECK(ReadFile(PNG_FILE) == pooled_png);
+
+            CHECK(WriteJpeg(planes, JPEG_FILE, &pool, 90));
+            double error = JpegLumaError(JPEG_FILE, planes);
+            CHECK(error >= 0.0 && error < 8.0);
+            const std::vector<uint8_t> pooled_jpeg = ReadFile(JPEG_FILE);
+            CHECK(WriteJpeg(planes, JPEG_FILE, nullptr, 90));
+            CHECK(ReadFile(JPEG_FILE) == pooled_jpeg);
+            // a restart interval longer than the frame
+            CHECK(WriteJpeg(planes, JPEG_FILE, nullptr, 100, 3));
+            error = JpegLumaError(JPEG_FILE, planes);
+            CHECK(error >= 0.0 && error < 4.0);
+        }
+    }
+
+    const Yuv_Frame frame(259, 131, 2, 1);
+    Thumbnail_Pyramid thumbnails;
+    thumbnails.Build(frame.Planes(), nullptr);
+    CHECK(thumbnails.Write(THUMBS, nullptr));
+    for (int32_t level = 0; level < Thumbnail_Pyramid::LEVELS; level++)
+    {
+        Yuv_Planes planes;
+        CHECK(thumbnails.GetLevel(level, &planes));
+        std::string path = THUMBS + "thumb" + std::to_string(Thumbnail_Pyramid::GetFactor(level)) +
+                           ".jpg";
+        double error = JpegLumaError(path, planes);
+        CHECK(error >= 0.0 && error < 8.0);
+        remove(path.c_str());
+    }
+    remove(PNG_FILE.c_str());
+    remove(JPEG_FILE.c_str());
+    return TestResult("Encoder_Test");
+}
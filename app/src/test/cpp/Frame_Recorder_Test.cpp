@@ -0,0 +1,150 @@
+// Frame_Recorder and Frame_Recording on a small ring:
+//
+// - a recording longer than the ring keeps the latest slot_count frames,
+//   each read back with the pixels, timestamp and tag it was recorded with
+// - Find() picks the closest timestamp at either end and in between
+// - entries whose size or format do not fit their slot are refused
+// - a file that cannot be created fails the recording, not the caller
+//
+// Takes the assets directory like every check, it is not read.
+
+// OpenCV-NDK App
+#include "Frame_Recorder.h"
+#include "Test_Util.h"
+// STD Libs
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static const std::string SCRATCH = "build/Frame_Recorder_Test.rec";
+static const int32_t WIDTH = 101;
+static const int32_t HEIGHT = 67;
+static const uint32_t SLOTS = 10;
+static const int32_t FRAMES = 25;
+static const int64_t FRAME_NS = 33000000LL;
+
+// Frame i: luma i, semi-planar chroma 100 + i and 200 + i
+static void Record(Frame_Recorder &recorder, int32_t i)
+{
+    std::vector<uint8_t> luma((size_t) WIDTH * HEIGHT, (uint8_t) i);
+    std::vector<uint8_t> chroma((size_t) (WIDTH + 1) * HEIGHT);
+    for (size_t k = 0; k < chroma.size(); k++)
+    {
+        chroma[k] = (uint8_t) ((k & 1) != 0 ? 200 + i : 100 + i);
+    }
+    Yuv_Planes planes = {luma.data(), chroma.data(), chroma.data() + 1, WIDTH, HEIGHT,
+                         WIDTH, WIDTH + 1, 2, FRAME_NS * i + 5};
+    CHECK(recorder.Record(planes, 90, i));
+}
+
+static void CheckFrame(const Frame_Recording &recording, int64_t n)
+{
+    Recorded_Frame info;
+    Yuv_Planes planes;
+    CHECK(recording.Get(n, &info, &planes));
+    CHECK(info.frame_number == n && info.tag == n && info.rotation == 90);
+    CHECK(info.timestamp_ns == FRAME_NS * n + 5 && planes.timestamp == info.timestamp_ns);
+    CHECK(planes.width == WIDTH && planes.height == HEIGHT);
+    const int32_t uv_width = (WIDTH + 1) / 2;
+    const int32_t uv_height = (HEIGHT + 1) / 2;
+    int32_t wrong = 0;
+    for (int32_t y = 0; y < HEIGHT; y++)
+    {
+        for (int32_t x = 0; x < WIDTH; x++)
+        {
+            wrong += planes.y[y * planes.y_stride + x] != n ? 1 : 0;
+        }
+    }
+    for (int32_t y = 0; y < uv_height; y++)
+    {
+        for (int32_t x = 0; x < uv_width; x++)
+        {
+            wrong += planes.u[y * planes.uv_stride + x] != 100 + n ? 1 : 0;
+            wrong += planes.v[y * planes.uv_stride + x] != 200 + n ? 1 : 0;
+        }
+    }
+    CHECK(wrong == 0);
+}
+
+// Rewrites the index entry of frame n with one field changed
+static bool GetsPatched(int64_t n, size_t offset, int32_t value)
+{
+    FILE *file = fopen(SCRATCH.c_str(), "r+b");
+    if (file == nullptr)
+    {
+        return false;
+    }
+    long at = (long) (sizeof(Recording_Header) + (n % SLOTS) * sizeof(Recorded_Frame) + offset);
+    int32_t old_value = 0;
+    fseek(file, at, SEEK_SET);
+    CHECK(fread(&old_value, sizeof(old_value), 1, file) == 1);
+    fseek(file, at, SEEK_SET);
+    fwrite(&value, sizeof(value), 1, file);
+    fflush(file);
+
+    Frame_Recording recording;
+    Recorded_Frame info;
+    Yuv_Planes planes;
+    bool got = recording.Open(SCRATCH) && recording.Get(n, &info, &planes);
+
+    fseek(file, at, SEEK_SET);
+    fwrite(&old_value, sizeof(old_value), 1, file);
+    fclose(file);
+    return got;
+}
+
+int main(int argc, char **argv)
+{
+    {
+        // more buffers than frames, none is dropped
+        Frame_Recorder recorder(FRAMES);
+        CHECK(recorder.Start(SCRATCH, WIDTH, HEIGHT, RECORD_YUV, SLOTS));
+        for (int32_t i = 0; i < FRAMES; i++)
+        {
+            Record(recorder, i);
+        }
+        recorder.Stop();
+        CHECK(!recorder.HasFailed());
+        CHECK(recorder.GetRecorded() == FRAMES && recorder.GetDropped() == 0);
+    }
+
+    {
+        Frame_Recording recording;
+        CHECK(recording.Open(SCRATCH));
+        CHECK(recording.GetFirst() == FRAMES - SLOTS && recording.GetLast() == FRAMES - 1);
+        for (int64_t n = recording.GetFirst(); n <= recording.GetLast(); n++)
+        {
+            CheckFrame(recording, n);
+        }
+        Recorded_Frame info;
+        Yuv_Planes planes;
+        CHECK(!recording.Get(recording.GetFirst() - 1, &info, &planes));
+        CHECK(!recording.Get(FRAMES, &info, &planes));
+
+        CHECK(recording.Find(0) == FRAMES - SLOTS);
+        CHECK(recording.Find(FRAME_NS * 20 + FRAME_NS / 3) == 20);
+        CHECK(recording.Find(FRAME_NS * 20 - FRAME_NS / 3) == 20);
+        CHECK(recording.Find(FRAME_NS * 1000) == FRAMES - 1);
+    }
+
+    // entries that would read past their slot
+    const int64_t n = FRAMES - 1;
+    CHECK(GetsPatched(n, offsetof(Recorded_Frame, tag), 7));
+    CHECK(!GetsPatched(n, offsetof(Recorded_Frame, width), WIDTH * 4));
+    CHECK(!GetsPatched(n, offsetof(Recorded_Frame, height), -HEIGHT));
+    CHECK(!GetsPatched(n, offsetof(Recorded_Frame, format), 3));
+    CHECK(!GetsPatched(n, offsetof(Recorded_Frame, size), 1 << 30));
+    CHECK(!GetsPatched(n, offsetof(Recorded_Frame, format), RECORD_Y));
+
+    {
+        Frame_Recorder recorder(2);
+        CHECK(recorder.Start("build/no such directory/a.rec", WIDTH, HEIGHT, RECORD_Y, SLOTS));
+        recorder.Stop();
+        CHECK(recorder.HasFailed());
+        CHECK(!recorder.IsRecording());
+    }
+    remove(SCRATCH.c_str());
+    return TestResult("Frame_Recorder_Test");
+}
@@ -0,0 +1,162 @@
+// Face_Pipeline fed from a recording against the same frames fed straight
+// from memory, as CV_Main does with camera frames:
+//
+// - a YUV recording replays every frame with its rotation and the pipeline
+//   gives the same results frame by frame
+// - a Y only recording runs with the skin prefilter on, which needs chroma
+//   and is skipped for it
+// - an unchanged frame is gated by the motion detector
+//
+// Takes the assets directory, see Makefile.
+
+// OpenCV
+#include <opencv2/core.hpp>
+// OpenCV-NDK App
+#include "Face_Pipeline.h"
+#include "Frame_Recorder.h"
+#include "Replay_Source.h"
+#include "Test_Util.h"
+// STD Libs
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static const std::string SCRATCH = "build/Frame_Replay_Test.rec";
+static const int32_t WIDTH = 320;
+static const int32_t HEIGHT = 240;
+static const int32_t FRAMES = 12;
+static const int32_t ROTATION = 90;
+
+// I420 frame i: a textured background with a bright square moving across
+struct Frame
+{
+    cv::Mat y;
+    cv::Mat u;
+    cv::Mat v;
+
+    Yuv_Planes Planes(int64_t timestamp, bool chroma) const
+    {
+        Yuv_Planes planes = {y.data, chroma ? u.data : nullptr, chroma ? v.data : nullptr,
+                             y.cols, y.rows, (int32_t) y.step, (int32_t) u.step, 1,
+                             timestamp};
+        return planes;
+    }
+};
+
+static std::vector<Frame> MakeFrames()
+{
+    cv::RNG rng(3);
+    cv::Mat background(HEIGHT, WIDTH, CV_8UC1);
+    rng.fill(background, cv::RNG::UNIFORM, 0, 256);
+    std::vector<Frame> frames(FRAMES);
+    for (int32_t i = 0; i < FRAMES; i++)
+    {
+        frames[i].y = background.clone();
+        frames[i].y(cv::Rect(20 + i * 20, 60, 80, 80)).setTo(cv::Scalar(230));
+        // chroma inside the skin box of Skin_Mask under the square
+        frames[i].u = cv::Mat(HEIGHT / 2, WIDTH / 2, CV_8UC1, cv::Scalar(128));
+        frames[i].v = cv::Mat(HEIGHT / 2, WIDTH / 2, CV_8UC1, cv::Scalar(128));
+        frames[i].u(cv::Rect(10 + i * 10, 30, 40, 40)).setTo(cv::Scalar(100));
+        frames[i].v(cv::Rect(10 + i * 10, 30, 40, 40)).setTo(cv::Scalar(150));
+    }
+    return frames;
+}
+
+static bool LoadPipeline(Face_Pipeline &pipeline, const std::string &assets, bool skin)
+{
+    Cascade_Loader loader;
+    loader.model = [&assets](const std::string &name, bool lbp)
+    {
+        Cascade_Model model;
+        model.loaded = lbp ? model.lbp.Load(assets + "/" + name) :
+                       model.haar.Load(assets + "/" + name);
+        return model;
+    };
+    pipeline.SetSkinPrefilter(skin);
+    return pipeline.Load(loader, HAAR_FACES);
+}
+
+// One line per frame: whether detection ran, then every face with its eyes
+static std::string Describe(bool ran, const Face_Pipeline &pipeline)
+{
+    std::string line = ran ? "ran" : "kept";
+    const std::vector<Face_Result> &faces = pipeline.GetFaces();
+    for (size_t i = 0; i < faces.size(); i++)
+    {
+        char face[96];
+        snprintf(face, sizeof(face), " %d,%d,%d,%d,%zu,%d", faces[i].face.x, faces[i].face.y,
+                 faces[i].face.width, faces[i].face.height, faces[i].eyes.size(),
+                 faces[i].smiling ? 1 : 0);
+        line += face;
+    }
+    return line + "\n";
+}
+
+static void CheckReplay(const std::vector<Frame> &frames, const std::string &assets,
+                        Record_Format format, bool skin)
+{
+    const bool chroma = format == RECORD_YUV;
+    {
+        Frame_Recorder recorder(FRAMES);
+        CHECK(recorder.Start(SCRATCH, WIDTH, HEIGHT, format, FRAMES));
+        for (int32_t i = 0; i < FRAMES; i++)
+        {
+            CHECK(recorder.Record(frames[i].Planes(i * 33000000LL, true), ROTATION, 0));
+        }
+        recorder.Stop();
+    }
+
+    Face_Pipeline direct;
+    CHECK(LoadPipeline(direct, assets, skin));
+    std::string expected;
+    for (int32_t i = 0; i < FRAMES; i++)
+    {
+        bool ran = direct.Process(frames[i].Planes(i * 33000000LL, chroma), ROTATION);
+        expected += Describe(ran, direct);
+    }
+
+    Face_Pipeline replayed;
+    CHECK(LoadPipeline(replayed, assets, skin));
+    Replay_Source source;
+    CHECK(source.Open(SCRATCH));
+    std::string got;
+    int32_t count = 0;
+    Yuv_Planes planes;
+    int32_t rotation = -1;
+    while (source.Acquire(&planes, &rotation))
+    {
+        CHECK(rotation == ROTATION);
+        CHECK((planes.u != nullptr) == chroma);
+        bool ran = replayed.Process(planes, rotation);
+        got += Describe(ran, replayed);
+        source.Release();
+        count++;
+    }
+    CHECK(count == FRAMES);
+    CHECK(got == expected);
+    if (got != expected)
+    {
+        fprintf(stderr, "expected:\n%sreplayed:\n%s", expected.c_str(), got.c_str());
+    }
+}
+
+static void CheckStatic(const std::vector<Frame> &frames, const std::string &assets)
+{
+    Face_Pipeline pipeline;
+    CHECK(LoadPipeline(pipeline, assets, false));
+    Yuv_Planes planes = frames[0].Planes(0, true);
+    pipeline.Process(planes, 0);
+    CHECK(!pipeline.Process(planes, 0));
+}
+
+int main(int argc, char **argv)
+{
+    std::string assets = argc > 1 ? argv[1] : "../../main/assets";
+    std::vector<Frame> frames = MakeFrames();
+    CheckReplay(frames, assets, RECORD_YUV, false);
+    CheckReplay(frames, assets, RECORD_YUV, true);
+    CheckReplay(frames, assets, RECORD_Y, true);
+    CheckStatic(frames, assets);
+    remove(SCRATCH.c_str());
+    return TestResult("Frame_Replay_Test");
+}
@@ -0,0 +1,82 @@
+// Rep_Counter on a smooth texture translated up and down the display, as
+// the motion planes of a Motion_Detector see it:
+//
+// - one repetition per up and down cycle, none while the scene is still
+// - the sensor's x axis is the display's vertical one at 90 degrees
+// - repetitions sooner than min_period_ms after the last one are rejected,
+//   lobes further apart than max_period_ms never count
+//
+// Takes the assets directory like every check, it is not read.
+
+// OpenCV-NDK App
+#include "Motion_Detector.h"
+#include "Rep_Counter.h"
+#include "Test_Util.h"
+// STD Libs
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+static const int32_t WIDTH = 320;
+static const int32_t HEIGHT = 240;
+static const double FRAME_MS = 1000.0 / 30.0;
+// still frames around the cycles, so the count only comes from them
+static const int32_t STILL = 15;
+
+// Luma of a texture shifted offset pixels along the display's vertical
+// axis, x on the sensor when rotation is 90
+static void Render(double offset, int32_t rotation, std::vector<uint8_t> &luma)
+{
+    luma.resize((size_t) WIDTH * HEIGHT);
+    const double pi = std::acos(-1.0);
+    for (int32_t y = 0; y < HEIGHT; y++)
+    {
+        for (int32_t x = 0; x < WIDTH; x++)
+        {
+            double along = (rotation % 180 == 0 ? y : x) + offset;
+            double across = rotation % 180 == 0 ? x : y;
+            double value = 128.0 + 60.0 * std::sin(2.0 * pi * along / 61.0) +
+                           30.0 * std::sin(2.0 * pi * (along + 0.5 * across) / 97.0);
+            luma[(size_t) y * WIDTH + x] = (uint8_t) std::lround(value);
+        }
+    }
+}
+
+// Repetitions counted over cycles of period frames, moving amplitude
+// pixels each way
+static int32_t Count(Rep_Counter &counter, int32_t cycles, int32_t period, double amplitude,
+                     int32_t rotation)
+{
+    const double pi = std::acos(-1.0);
+    Motion_Detector motion;
+    std::vector<uint8_t> luma;
+    counter.Reset();
+    const int32_t frames = STILL + cycles * period + STILL;
+    for (int32_t i = 0; i < frames; i++)
+    {
+        const int32_t moving = std::min(std::max(i - STILL, 0), cycles * period);
+        Render(amplitude * std::sin(2.0 * pi * moving / period), rotation, luma);
+        motion.Update(luma.data(), WIDTH, HEIGHT, WIDTH);
+        counter.Update(motion, rotation, i * FRAME_MS);
+    }
+    return counter.GetCount();
+}
+
+int main(int argc, char **argv)
+{
+    Rep_Counter counter;
+    CHECK(Count(counter, 0, 30, 16.0, 0) == 0);
+    // one second a repetition
+    CHECK(Count(counter, 6, 30, 16.0, 0) == 6);
+    CHECK(counter.GetMeanPeriod() > 900.0 && counter.GetMeanPeriod() < 1100.0);
+    CHECK(Count(counter, 6, 30, 16.0, 90) == 6);
+    CHECK(Count(counter, 4, 20, 12.0, 270) == 4);
+
+    // every other one comes too soon after the last counted
+    Rep_Counter slow(8, 1500.0, 3000.0);
+    CHECK(Count(slow, 6, 30, 16.0, 0) == 3);
+    // the down lobe comes half a second after the up one
+    Rep_Counter fast(8, 100.0, 300.0);
+    CHECK(Count(fast, 6, 30, 16.0, 0) == 0);
+    return TestResult("Rep_Counter_Test");
+}
@@ -0,0 +1,175 @@
+// MeasureSharpness on synthetic luma:
+//
+// - the vector paths give the plain variance of the Laplacian of the
+//   decimated frame, for widths that leave a scalar tail and padded strides
+// - blurring lowers the score, a flat frame scores 0
+// - rois restrict the score to their area, scaled from roi_frame, and
+//   rois outside the frame fall back to the whole frame
+//
+// Takes the assets directory like every check, it is not read.
+
+// OpenCV
+#include <opencv2/core.hpp>
+// OpenCV-NDK App
+#include "Sharpness.h"
+#include "Test_Util.h"
+// STD Libs
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+struct Luma
+{
+    int32_t width;
+    int32_t height;
+    int32_t stride;
+    std::vector<uint8_t> pixels;
+
+    Luma(int32_t w, int32_t h, int32_t padding)
+            : width(w), height(h), stride(w + padding), pixels((size_t) (w + padding) * h, 0)
+    {}
+
+    uint8_t &At(int32_t x, int32_t y)
+    { return pixels[(size_t) y * stride + x]; }
+
+    Yuv_Planes Planes() const
+    {
+        Yuv_Planes planes = {};
+        planes.y = pixels.data();
+        planes.width = width;
+        planes.height = height;
+        planes.y_stride = stride;
+        return planes;
+    }
+};
+
+static Luma Noise(int32_t width, int32_t height, int32_t padding, uint32_t seed)
+{
+    Luma luma(width, height, padding);
+    srand(seed);
+    for (int32_t y = 0; y < height; y++)
+    {
+        for (int32_t x = 0; x < width; x++)
+        {
+            luma.At(x, y) = (uint8_t) (rand() & 0xff);
+        }
+    }
+    return luma;
+}
+
+// 3x3 box blur, edges kept
+static Luma Blurred(Luma luma)
+{
+    Luma out = luma;
+    for (int32_t y = 1; y + 1 < luma.height; y++)
+    {
+        for (int32_t x = 1; x + 1 < luma.width; x++)
+        {
+            int32_t sum = 0;
+            for (int32_t dy = -1; dy <= 1; dy++)
+            {
+                for (int32_t dx = -1; dx <= 1; dx++)
+                {
+                    sum += luma.At(x + dx, y + dy);
+                }
+            }
+            out.At(x, y) = (uint8_t) (sum / 9);
+        }
+    }
+    return out;
+}
+
+// The whole frame, every step-th pixel of every step-th row
+static double Reference(Luma &luma, int32_t step)
+{
+    const int32_t width = (luma.width + step - 1) / step;
+    const int32_t height = (luma.height + step - 1) / step;
+    double sum = 0.0;
+    double sum_squares = 0.0;
+    int64_t count = 0;
+    for (int32_t y = 1; y + 1 < height; y++)
+    {
+        for (int32_t x = 1; x + 1 < width; x++)
+        {
+            double lap = 4.0 * luma.At(x * step, y * step) - luma.At((x - 1) * step, y * step) -
+                         luma.At((x + 1) * step, y * step) - luma.At(x * step, (y - 1) * step) -
+                         luma.At(x * step, (y + 1) * step);
+            sum += lap;
+            sum_squares += lap * lap;
+            count++;
+        }
+    }
+    double mean = sum / count;
+    return sum_squares / count - mean * mean;
+}
+
+static bool Near(double a, double b)
+{
+    return std::fabs(a - b) <= 1e-9 * std::max(1.0, std::fabs(b));
+}
+
+static void CheckReference()
+{
+    const std::vector<cv::Rect> none;
+    const int32_t widths[] = {3, 17, 101, 640};
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++)
+    {
+        Luma luma = Noise(widths[w], 48, w % 2 == 0 ? 0 : 13, (uint32_t) w + 1);
+        // step 1, then step 2 through max_width
+        CHECK(Near(MeasureSharpness(luma.Planes(), none, cv::Size(), 1024), Reference(luma, 1)));
+        if (widths[w] >= 6)
+        {
+            CHECK(Near(MeasureSharpness(luma.Planes(), none, cv::Size(), widths[w] / 2 + 1),
+                       Reference(luma, 2)));
+        }
+    }
+}
+
+static void CheckBlur()
+{
+    const std::vector<cv::Rect> none;
+    Luma sharp = Noise(320, 240, 0, 7);
+    Luma soft = Blurred(sharp);
+    Luma softer = Blurred(soft);
+    double a = MeasureSharpness(sharp.Planes(), none, cv::Size());
+    double b = MeasureSharpness(soft.Planes(), none, cv::Size());
+    double c = MeasureSharpness(softer.Planes(), none, cv::Size());
+    CHECK(a > b && b > c && c > 0.0);
+
+    Luma flat(320, 240, 0);
+    CHECK(MeasureSharpness(flat.Planes(), none, cv::Size()) == 0.0);
+}
+
+static void CheckRois()
+{
+    // noise on the left half, flat on the right
+    Luma luma = Noise(320, 240, 0, 11);
+    for (int32_t y = 0; y < luma.height; y++)
+    {
+        for (int32_t x = 160; x < luma.width; x++)
+        {
+            luma.At(x, y) = 128;
+        }
+    }
+    // rois on a half size preview
+    const cv::Size preview(160, 120);
+    std::vector<cv::Rect> left(1, cv::Rect(10, 10, 60, 100));
+    std::vector<cv::Rect> right(1, cv::Rect(90, 10, 60, 100));
+    double whole = MeasureSharpness(luma.Planes(), std::vector<cv::Rect>(), cv::Size());
+    double on_left = MeasureSharpness(luma.Planes(), left, preview);
+    double on_right = MeasureSharpness(luma.Planes(), right, preview);
+    CHECK(on_right == 0.0);
+    CHECK(on_left > whole && whole > 0.0);
+
+    std::vector<cv::Rect> outside(1, cv::Rect(200, 200, 20, 20));
+    CHECK(MeasureSharpness(luma.Planes(), outside, preview) == whole);
+}
+
+int main(int argc, char **argv)
+{
+    CheckReference();
+    CheckBlur();
+    CheckRois();
+    return TestResult("Sharpness_Test");
+}
@@ -0,0 +1,94 @@
+#ifndef OPENCV_NDK_TEST_UTIL_H
+#define OPENCV_NDK_TEST_UTIL_H
+
+// OpenCV-NDK App
+#include "Util.h"
+// STD Libs
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// Host checks keep going after a failed CHECK() so one run lists every
+// problem, TestResult() turns the count into the exit code
+static int g_failures = 0;
+
+#define CHECK(cond)                                                           \
+  do {                                                                        \
+    if (!(cond)) {                                                            \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+      g_failures++;                                                           \
+    }                                                                         \
+  } while (0)
+
+static inline int TestResult(const char *name)
+{
+    if (g_failures > 0)
+    {
+        fprintf(stderr, "%s: %d checks failed\n", name, g_failures);
+        return 1;
+    }
+    printf("%s: ok\n", name);
+    return 0;
+}
+
+// A gradient with some noise as camera frames come: rows padded past the
+// width, chroma as two planes or interleaved by pixel_stride 2. The padding
+// holds noise too, so reading it shows.
+struct Yuv_Frame
+{
+    int32_t width;
+    int32_t height;
+    int32_t pixel_stride;
+    std::vector<uint8_t> luma;
+    std::vector<uint8_t> chroma;
+
+    Yuv_Frame(int32_t w, int32_t h, int32_t stride, uint32_t seed)
+            : width(w), height(h), pixel_stride(stride)
+    {
+        srand(seed);
+        luma.resize((size_t) YStride() * h);
+        for (int32_t y = 0; y < h; y++)
+        {
+            for (int32_t x = 0; x < YStride(); x++)
+            {
+                luma[(size_t) y * YStride() + x] = (uint8_t) (x < w ?
+                        (3 * x + 5 * y + rand() % 20) & 0xff : rand() & 0xff);
+            }
+        }
+        chroma.resize((size_t) UvStride() * UvHeight() * (stride == 1 ? 2 : 1) + 1);
+        for (size_t i = 0; i < chroma.size(); i++)
+        {
+            chroma[i] = (uint8_t) (i % 2 == 0 ? 100 + rand() % 50 : 120 + rand() % 40);
+        }
+    }
+
+    int32_t YStride() const
+    { return width + 5; }
+
+    int32_t UvWidth() const
+    { return (width + 1) / 2; }
+
+    int32_t UvHeight() const
+    { return (height + 1) / 2; }
+
+    int32_t UvStride() const
+    { return UvWidth() * pixel_stride + 3; }
+
+    Yuv_Planes Planes() const
+    {
+        Yuv_Planes planes = {};
+        planes.y = luma.data();
+        planes.u = chroma.data();
+        planes.v = pixel_stride == 1 ? chroma.data() + (size_t) UvStride() * UvHeight() :
+                   chroma.data() + 1;
+        planes.width = width;
+        planes.height = height;
+        planes.y_stride = YStride();
+        planes.uv_stride = UvStride();
+        planes.uv_pixel_stride = pixel_stride;
+        planes.timestamp = 42;
+        return planes;
+    }
+};
+
+#endif  // OPENCV_NDK_TEST_UTIL_H
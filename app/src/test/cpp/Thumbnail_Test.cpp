@@ -0,0 +1,144 @@
+// Thumbnail_Pyramid on noisy planar and semi-planar frames:
+//
+// - the 1/4 level is the rounded mean of every 4x4 block of each plane,
+//   edge samples repeated, for odd sizes and padded strides
+// - each further level is the rounded mean of 2x2 of the one before
+// - levels come out the same built on a pool and on the calling thread
+// - levels a frame is too small for are empty
+//
+// Takes the assets directory like every check, it is not read.
+
+// OpenCV-NDK App
+#include "Test_Util.h"
+#include "Thumbnail_Pyramid.h"
+// STD Libs
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// Mean of the 4x4 block at x, y of a plane, edge samples repeated
+static int32_t Box4(const uint8_t *plane, int32_t width, int32_t height, int32_t stride,
+                    int32_t pixel_stride, int32_t x, int32_t y)
+{
+    int32_t sum = 0;
+    for (int32_t r = 0; r < 4; r++)
+    {
+        for (int32_t dx = 0; dx < 4; dx++)
+        {
+            sum += plane[(size_t) std::min(4 * y + r, height - 1) * stride +
+                         (size_t) std::min(4 * x + dx, width - 1) * pixel_stride];
+        }
+    }
+    return (sum + 8) >> 4;
+}
+
+// Wrong samples of a level against 4x4 means of the frame's planes
+static int32_t CheckFirst(const Yuv_Frame &frame, const Yuv_Planes &level)
+{
+    const Yuv_Planes planes = frame.Planes();
+    int32_t wrong = 0;
+    for (int32_t y = 0; y < level.height; y++)
+    {
+        for (int32_t x = 0; x < level.width; x++)
+        {
+            wrong += level.y[y * level.y_stride + x] !=
+                     Box4(planes.y, frame.width, frame.height, planes.y_stride, 1, x, y) ? 1 : 0;
+        }
+    }
+    for (int32_t y = 0; y < (level.height + 1) / 2; y++)
+    {
+        for (int32_t x = 0; x < (level.width + 1) / 2; x++)
+        {
+            wrong += level.u[y * level.uv_stride + x] !=
+                     Box4(planes.u, frame.UvWidth(), frame.UvHeight(), planes.uv_stride,
+                          planes.uv_pixel_stride, x, y) ? 1 : 0;
+            wrong += level.v[y * level.uv_stride + x] !=
+                     Box4(planes.v, frame.UvWidth(), frame.UvHeight(), planes.uv_stride,
+                          planes.uv_pixel_stride, x, y) ? 1 : 0;
+        }
+    }
+    return wrong;
+}
+
+// Wrong samples of a packed plane against 2x2 means of the one before
+static int32_t CheckHalf(const uint8_t *src, int32_t width, int32_t height, const uint8_t *dst,
+                         int32_t out_width, int32_t out_height)
+{
+    int32_t wrong = 0;
+    for (int32_t y = 0; y < out_height; y++)
+    {
+        for (int32_t x = 0; x < out_width; x++)
+        {
+            int32_t x0 = std::min(2 * x, width - 1);
+            int32_t x1 = std::min(2 * x + 1, width - 1);
+            const uint8_t *row0 = src + (size_t) std::min(2 * y, height - 1) * width;
+            const uint8_t *row1 = src + (size_t) std::min(2 * y + 1, height - 1) * width;
+            wrong += dst[y * out_width + x] !=
+                     ((row0[x0] + row0[x1] + row1[x0] + row1[x1] + 2) >> 2) ? 1 : 0;
+        }
+    }
+    return wrong;
+}
+
+static int32_t CheckNext(const Yuv_Planes &previous, const Yuv_Planes &level)
+{
+    return CheckHalf(previous.y, previous.width, previous.height, level.y, level.width,
+                     level.height) +
+           CheckHalf(previous.u, previous.uv_stride, (previous.height + 1) / 2, level.u,
+                     level.uv_stride, (level.height + 1) / 2) +
+           CheckHalf(previous.v, previous.uv_stride, (previous.height + 1) / 2, level.v,
+                     level.uv_stride, (level.height + 1) / 2);
+}
+
+static bool SameLevel(const Yuv_Planes &a, const Yuv_Planes &b)
+{
+    const size_t luma = (size_t) a.width * a.height;
+    const size_t chroma = (size_t) a.uv_stride * ((a.height + 1) / 2);
+    return a.width == b.width && a.height == b.height &&
+           memcmp(a.y, b.y, luma) == 0 && memcmp(a.u, b.u, chroma) == 0 &&
+           memcmp(a.v, b.v, chroma) == 0;
+}
+
+int main(int argc, char **argv)
+{
+    Worker_Pool pool(3);
+    const int32_t sizes[][2] = {{640, 480}, {259, 131}, {37, 21}, {17, 9}, {4, 4}, {3, 3}};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        for (int32_t pixel_stride = 1; pixel_stride <= 2; pixel_stride++)
+        {
+            const int32_t width = sizes[s][0];
+            const int32_t height = sizes[s][1];
+            Yuv_Frame frame(width, height, pixel_stride, (uint32_t) (s * 2 + pixel_stride));
+            Thumbnail_Pyramid pooled;
+            Thumbnail_Pyramid serial;
+            pooled.Build(frame.Planes(), &pool);
+            serial.Build(frame.Planes(), nullptr);
+
+            Yuv_Planes previous = {};
+            for (int32_t level = 0; level < Thumbnail_Pyramid::LEVELS; level++)
+            {
+                const int32_t factor = Thumbnail_Pyramid::GetFactor(level);
+                Yuv_Planes a;
+                Yuv_Planes b;
+                bool has_level = pooled.GetLevel(level, &a);
+                CHECK(has_level == (width >= factor && height >= factor));
+                CHECK(serial.GetLevel(level, &b) == has_level);
+                if (!has_level)
+                {
+                    continue;
+                }
+                CHECK(a.width == width / factor && a.height == height / factor);
+                CHECK(a.timestamp == 42);
+                CHECK(SameLevel(a, b));
+                CHECK((level == 0 ? CheckFirst(frame, a) : CheckNext(previous, a)) == 0);
+                previous = a;
+            }
+        }
+    }
+
+    Thumbnail_Pyramid empty;
+    Yuv_Planes planes;
+    CHECK(!empty.GetLevel(0, &planes) && !empty.GetLevel(Thumbnail_Pyramid::LEVELS, &planes));
+    return TestResult("Thumbnail_Test");
+}
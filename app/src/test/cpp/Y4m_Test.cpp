@@ -0,0 +1,194 @@
+// Y4m_Writer, Y4m_Exporter and Y4m_Reader on odd sized frames:
+//
+// - frames written with semi-planar chroma and padded strides, or mono,
+//   read back with the pixels, size and rate they were written with
+// - the exporter thread writes every frame it queued, in order, and drops
+//   the ones that do not match the stream
+// - only the 4:2:0 and mono colorspaces are read, deeper or wider ones are
+//   refused
+// - a file cut short keeps its complete frames
+// - a file that cannot be created fails the export, not the caller
+//
+// Takes the assets directory like every check, it is not read.
+
+// OpenCV-NDK App
+#include "Test_Util.h"
+#include "Y4m_File.h"
+// STD Libs
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const std::string SCRATCH = "build/Y4m_Test.y4m";
+static const int32_t WIDTH = 37;
+static const int32_t HEIGHT = 23;
+static const int32_t PADDING = 5;
+static const int32_t FRAMES = 6;
+
+// Frame i: luma i + x, semi-planar chroma 100 + i + x and 200 + i + y
+struct Frame
+{
+    std::vector<uint8_t> luma;
+    std::vector<uint8_t> chroma;
+
+    explicit Frame(int32_t i)
+            : luma((size_t) (WIDTH + PADDING) * HEIGHT, 0),
+              chroma((size_t) (WIDTH + 1 + PADDING) * ((HEIGHT + 1) / 2), 0)
+    {
+        for (int32_t y = 0; y < HEIGHT; y++)
+        {
+            for (int32_t x = 0; x < WIDTH; x++)
+            {
+                luma[(size_t) y * (WIDTH + PADDING) + x] = (uint8_t) (i + x);
+            }
+        }
+        for (int32_t y = 0; y < (HEIGHT + 1) / 2; y++)
+        {
+            for (int32_t x = 0; x < (WIDTH + 1) / 2; x++)
+            {
+                uint8_t *pair = &chroma[(size_t) y * (WIDTH + 1 + PADDING) + 2 * x];
+                pair[0] = (uint8_t) (100 + i + x);
+                pair[1] = (uint8_t) (200 + i + y);
+            }
+        }
+    }
+
+    Yuv_Planes Planes(bool with_chroma) const
+    {
+        Yuv_Planes planes = {luma.data(), with_chroma ? chroma.data() : nullptr,
+                             with_chroma ? chroma.data() + 1 : nullptr, WIDTH, HEIGHT,
+                             WIDTH + PADDING, WIDTH + 1 + PADDING, 2, 0};
+        return planes;
+    }
+};
+
+static bool SameFrame(const Yuv_Planes &got, int32_t i, bool with_chroma)
+{
+    const Frame frame(i);
+    const Yuv_Planes want = frame.Planes(with_chroma);
+    if (got.width != WIDTH || got.height != HEIGHT || (got.u != nullptr) != with_chroma)
+    {
+        return false;
+    }
+    int32_t wrong = 0;
+    for (int32_t y = 0; y < HEIGHT; y++)
+    {
+        for (int32_t x = 0; x < WIDTH; x++)
+        {
+            wrong += got.y[y * got.y_stride + x] != want.y[y * want.y_stride + x] ? 1 : 0;
+        }
+    }
+    for (int32_t y = 0; with_chroma && y < (HEIGHT + 1) / 2; y++)
+    {
+        for (int32_t x = 0; x < (WIDTH + 1) / 2; x++)
+        {
+            size_t at = (size_t) y * got.uv_stride + x * got.uv_pixel_stride;
+            size_t want_at = (size_t) y * want.uv_stride + x * want.uv_pixel_stride;
+            wrong += got.u[at] != want.u[want_at] ? 1 : 0;
+            wrong += got.v[at] != want.v[want_at] ? 1 : 0;
+        }
+    }
+    return wrong == 0;
+}
+
+static void CheckRead(bool with_chroma, int32_t frames)
+{
+    Y4m_Reader reader;
+    CHECK(reader.Open(SCRATCH));
+    CHECK(reader.GetWidth() == WIDTH && reader.GetHeight() == HEIGHT);
+    CHECK(reader.GetFps() == 15.0);
+    CHECK(reader.GetFrameCount() == frames);
+    for (int32_t i = 0; i < reader.GetFrameCount(); i++)
+    {
+        Yuv_Planes planes;
+        CHECK(reader.Get(i, &planes) && SameFrame(planes, i, with_chroma));
+    }
+}
+
+static void CheckWriter(bool with_chroma)
+{
+    Y4m_Writer writer;
+    CHECK(writer.Open(SCRATCH, WIDTH, HEIGHT, with_chroma, 15, 1));
+    for (int32_t i = 0; i < FRAMES; i++)
+    {
+        CHECK(writer.Write(Frame(i).Planes(with_chroma)));
+    }
+    CHECK(writer.GetFrames() == FRAMES);
+    CHECK(writer.Close());
+    CheckRead(with_chroma, FRAMES);
+
+    // the last frame loses its final byte
+    struct stat info;
+    CHECK(stat(SCRATCH.c_str(), &info) == 0);
+    CHECK(truncate(SCRATCH.c_str(), info.st_size - 1) == 0);
+    CheckRead(with_chroma, FRAMES - 1);
+}
+
+static void CheckExporter(bool with_chroma)
+{
+    // a buffer per frame, none is dropped however slow the thread
+    Y4m_Exporter exporter(FRAMES);
+    CHECK(exporter.Start(SCRATCH, WIDTH, HEIGHT, with_chroma, 15, 1));
+    for (int32_t i = 0; i < FRAMES; i++)
+    {
+        CHECK(exporter.Export(Frame(i).Planes(with_chroma)));
+    }
+    const Frame frame(0);
+    Yuv_Planes narrower = frame.Planes(with_chroma);
+    narrower.width--;
+    CHECK(!exporter.Export(narrower));
+    CHECK(exporter.Stop());
+    CHECK(!exporter.HasFailed() && !exporter.IsExporting());
+    CHECK(exporter.GetWritten() == FRAMES && exporter.GetDropped() == 1);
+    CheckRead(with_chroma, FRAMES);
+}
+
+// A one frame 2x2 file with the given colorspace field
+static bool Reads(const std::string &colorspace)
+{
+    FILE *file = fopen(SCRATCH.c_str(), "wb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+    fprintf(file, "YUV4MPEG2 W2 H2 F30:1 Ip A1:1 %s\nFRAME\n", colorspace.c_str());
+    const uint8_t pixels[6] = {1, 2, 3, 4, 5, 6};
+    fwrite(pixels, 1, sizeof(pixels), file);
+    fclose(file);
+
+    Y4m_Reader reader;
+    return reader.Open(SCRATCH) && reader.GetFrameCount() == 1;
+}
+
+static void CheckColorspaces()
+{
+    CHECK(Reads(""));
+    CHECK(Reads("C420"));
+    CHECK(Reads("C420jpeg"));
+    CHECK(Reads("C420paldv"));
+    CHECK(Reads("C420mpeg2"));
+    CHECK(Reads("Cmono"));
+    CHECK(!Reads("C420p10"));
+    CHECK(!Reads("C420p16"));
+    CHECK(!Reads("C422"));
+    CHECK(!Reads("C444"));
+    CHECK(!Reads("Cmono16"));
+}
+
+int main(int argc, char **argv)
+{
+    CheckWriter(true);
+    CheckWriter(false);
+    CheckExporter(true);
+    CheckExporter(false);
+    CheckColorspaces();
+
+    Y4m_Exporter exporter;
+    CHECK(exporter.Start("build/no such directory/a.y4m", WIDTH, HEIGHT, true));
+    CHECK(!exporter.Stop());
+    CHECK(exporter.HasFailed());
+    remove(SCRATCH.c_str());
+    return TestResult("Y4m_Test");
+}